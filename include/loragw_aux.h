@@ -20,7 +20,7 @@ Maintainer: Sylvain Miermont
 /* -------------------------------------------------------------------------- */
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
-#include <arduino.h>   /* delay */
+#include "loragw_port.h"   /* delay */
 #include "config.h"    /* library configuration options (dynamically generated) */
 
 /* -------------------------------------------------------------------------- */
@@ -35,6 +35,11 @@ Maintainer: Sylvain Miermont
 */
 #define TAKE_N_BITS_FROM(b, p, n) (((b) >> (p)) & ((1 << (n)) - 1))
 
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LGW_LZ_WINDOW   256     /* history of the packed images, also the size of the unpacked chunks */
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
 
@@ -44,6 +49,29 @@ Maintainer: Sylvain Miermont
 */
 void wait_ms(unsigned long t);
 
+/**
+@brief Update a running CRC-32 (IEEE 802.3) with a block of data
+@param crc CRC of the previous blocks, 0 for the first one
+@param data pointer to the block
+@param size size of the block, in bytes
+@return CRC of the data seen so far
+*/
+uint32_t lgw_crc32(uint32_t crc, const void *data, uint32_t size);
+
+/**
+@brief Unpack an image packed by util_fw_pack, streaming it in chunks of LGW_LZ_WINDOW bytes at most
+
+Packed format, a sequence of tokens:
+ - 0nnnnnnn: n+1 literal bytes follow
+ - 1nnnnnnn dddddddd: copy n+3 bytes starting d+1 bytes back in the output
+@param packed pointer to the packed image
+@param size size of the packed image, in bytes
+@param sink function receiving the unpacked data in order, a non-zero return aborts
+@param arg opaque pointer given to the sink
+@return number of bytes unpacked, -1 if the image is malformed or the sink failed
+*/
+int32_t lgw_lz_unpack(const uint8_t *packed, uint32_t size, int (*sink)(void *arg, const uint8_t *data, uint16_t size), void *arg);
+
 #endif
 
 /* --- EOF ------------------------------------------------------------------ */
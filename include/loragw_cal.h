@@ -0,0 +1,102 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Calibration cache: results of the calibration firmware kept in a
+    persistent store, so a warm restart with the same radios, frequencies
+    and board can skip the calibration run.
+    Stores are NVS on the ESP32 and a plain file (any stdio file system).
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORAGW_CAL_H
+#define _LORAGW_CAL_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>        /* C99 types*/
+#include <stdbool.h>       /* bool type */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LGW_CAL_SUCCESS     0
+#define LGW_CAL_ERROR       -1
+
+#define LGW_CAL_MAGIC       0x4C47574B  /* record signature */
+#define LGW_CAL_VERSION     1           /* record layout version */
+#define LGW_CAL_RF_NB       2           /* radios covered by a record */
+#define LGW_CAL_KEY_DEFAULT "lgw_cal"   /* NVS key or file path used when none is given */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct lgw_cal_rec_s
+@brief Calibration result as kept in a store
+*/
+struct lgw_cal_rec_s {
+    uint32_t    magic;                      /*!> LGW_CAL_MAGIC */
+    uint16_t    version;                    /*!> LGW_CAL_VERSION */
+    uint16_t    nb_restore;                 /*!> warm starts served by this calibration */
+    uint64_t    board_id;                   /*!> board the calibration was done on */
+    uint32_t    freq_hz[LGW_CAL_RF_NB];     /*!> RX frequency of each radio */
+    uint8_t     radio_type[LGW_CAL_RF_NB];  /*!> radio type of each radio */
+    uint8_t     cal_cmd;                    /*!> calibration command word, enabled radios and TX */
+    uint8_t     cal_status;                 /*!> status reported by the calibration firmware */
+    uint32_t    saved_at;                   /*!> calibration time, seconds since epoch, 0 if the clock was not set */
+    int8_t      offset_a_i[8];              /*!> TX I offset for radio A, mixer gain 8 to 15 */
+    int8_t      offset_a_q[8];              /*!> TX Q offset for radio A */
+    int8_t      offset_b_i[8];              /*!> TX I offset for radio B */
+    int8_t      offset_b_q[8];              /*!> TX Q offset for radio B */
+    uint8_t     iq_mismatch[5];             /*!> RX image rejection coefficients, A amp/phi, B amp/sel_i/phi */
+    uint32_t    crc;                        /*!> CRC-32 of the record up to this field */
+};
+
+/**
+@struct lgw_cal_store_s
+@brief Persistent storage for a calibration record
+*/
+struct lgw_cal_store_s {
+    const char *name;
+    int (*load)(const char *key, struct lgw_cal_rec_s *rec);
+    int (*save)(const char *key, const struct lgw_cal_rec_s *rec);
+    int (*erase)(const char *key);
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC VARIABLES ----------------------------------------------------- */
+
+extern const struct lgw_cal_store_s lgw_cal_store_file;    /* key is a file path */
+#ifdef ARDUINO
+extern const struct lgw_cal_store_s lgw_cal_store_nvs;     /* key is an NVS key, 15 characters at most */
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Set the signature and CRC of a record before it is saved
+@param rec pointer to the record, padding included in the CRC must be zeroed
+@return status of the operation (LGW_CAL_SUCCESS/LGW_CAL_ERROR)
+*/
+int lgw_cal_seal(struct lgw_cal_rec_s *rec);
+
+/**
+@brief Check the signature, layout version and CRC of a loaded record
+@param rec pointer to the record
+@return LGW_CAL_SUCCESS if the record is intact, LGW_CAL_ERROR else
+*/
+int lgw_cal_check(const struct lgw_cal_rec_s *rec);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -1,4 +1,4 @@
-#include <arduino.h>   /* delay */
+#include "loragw_port.h"   /* delay */
 
 /* -------------------------------------------------------------------------- */
 /* --- DECLARACIONES DE FUNCIONES PRIVADAS ---------------------------------- */
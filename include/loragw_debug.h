@@ -3,7 +3,7 @@
     Si se pone 1, se mostrará mensajes a traves de la comunicación serial de la computadora
 */
 
-#include <arduino.h>   /* delay */
+#include "loragw_port.h"   /* delay */
 
 #define DEBUG_AUX 0
 #define DEBUG_SPI 0
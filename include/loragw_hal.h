@@ -22,7 +22,10 @@ Maintainer: Sylvain Miermont
 
 #include <stdint.h>     /* C99 types */
 #include <stdbool.h>    /* bool type */
-#include <arduino.h>   /* delay */
+#include "loragw_port.h"   /* delay */
+#include "loragw_spi.h"    /* lgw_spi_tune_s */
+#include "loragw_reg.h"    /* lgw_reg_ctx_s */
+#include "loragw_cal.h"    /* lgw_cal_store_s */
 
 #include "config.h"     /* library configuration options (dynamically generated) */
 
@@ -46,11 +49,14 @@ Maintainer: Sylvain Miermont
 #define LGW_HAL_SUCCESS     0
 #define LGW_HAL_ERROR       -1
 #define LGW_LBT_ISSUE       1
+#define LGW_START_DONE          LGW_HAL_SUCCESS /* lgw_start_step: concentrator started */
+#define LGW_START_IN_PROGRESS   2               /* lgw_start_step: call again to run the next step */
 
 /* radio-specific parameters */
 #define LGW_XTAL_FREQU      32000000            /* frequency of the RF reference oscillator */
 #define LGW_RF_CHAIN_NB     2                   /* number of RF chains */
 #define LGW_RF_RX_BANDWIDTH {1000000, 1000000}  /* bandwidth of the radios */
+#define LGW_RF_RETUNE_MAX   300000              /* largest move of lgw_rxrf_retune from the calibrated frequency, in Hz */
 
 /* type of if_chain + modem */
 #define IF_UNDEFINED        0
@@ -156,6 +162,16 @@ Maintainer: Sylvain Miermont
 /* LBT constants */
 #define LBT_CHANNEL_FREQ_NB 8 /* Number of LBT channels */
 
+/* phases of lgw_start, run one per lgw_start_step, for the boot timing report */
+#define LGW_BOOT_CONNECT    0   /* SPI link opening and clock tuning */
+#define LGW_BOOT_XTAL       1   /* radios power up, until they answer */
+#define LGW_BOOT_RADIO      2   /* radios reset and setup, PLL lock */
+#define LGW_BOOT_CALIB      3   /* calibration firmware run */
+#define LGW_BOOT_MODEM      4   /* modems configuration */
+#define LGW_BOOT_FIRMWARE   5   /* ARB and AGC firmwares load */
+#define LGW_BOOT_AGC        6   /* AGC firmware init handshake */
+#define LGW_BOOT_PHASE_NB   7
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC TYPES --------------------------------------------------------- */
 
@@ -180,6 +196,18 @@ struct lgw_conf_board_s {
     uint8_t clksrc;         /*!> Index of RF chain which provides clock to concentrator */
 };
 
+/**
+@struct lgw_conf_cal_s
+@brief Configuration structure for the calibration cache
+*/
+struct lgw_conf_cal_s {
+    const struct lgw_cal_store_s *store;    /*!> where calibrations are kept, NULL to calibrate on every start */
+    const char  *key;                       /*!> NVS key or file path of the record, NULL for LGW_CAL_KEY_DEFAULT */
+    uint64_t    board_id;                   /*!> board identifier, a record of another board is never used */
+    uint32_t    max_age;                    /*!> seconds a calibration stays valid, 0 for no limit (checked when the clock is set) */
+    uint16_t    max_restore;                /*!> warm starts served by one calibration, 0 for no limit */
+};
+
 /**
 @struct lgw_conf_lbt_chan_s
 @brief Configuration structure for LBT channels
@@ -295,9 +323,229 @@ struct lgw_tx_gain_lut_s {
     uint8_t                 size;                       /*!> Number of LUT indexes */
 };
 
+/**
+@struct lgw_boot_timing_s
+@brief Duration of the phases of the last lgw_start
+*/
+struct lgw_boot_timing_s {
+    uint32_t    phase[LGW_BOOT_PHASE_NB];   /*!> time spent in each phase (LGW_BOOT_xxx), in us */
+    uint32_t    total;                      /*!> duration of the whole start, time between lgw_start_step calls included, in us */
+    uint8_t     reached;                    /*!> last phase entered, tells where a failed start stopped */
+    bool        cal_cached;                 /*!> calibration restored from the cache, calibration firmware skipped */
+};
+
+/**
+@struct lgw_agc_timing_s
+@brief Latency of the last AGC firmware init handshake, at start or by lgw_txgain_update
+*/
+struct lgw_agc_timing_s {
+    uint32_t    boot;       /*!> wait for the AGC firmware ready status, in us */
+    uint32_t    last;       /*!> last command, from its write to its acknowledge, in us */
+    uint32_t    max;        /*!> slowest command acknowledge, in us */
+    uint32_t    total;      /*!> whole handshake, firmware reload included for an update, in us */
+    uint16_t    nb_cmd;     /*!> commands acknowledged */
+    uint16_t    nb_poll;    /*!> status reads, ready status and acknowledges */
+};
+
+/**
+@struct lgw_ctx_s
+@brief State of one concentrator: link, configuration set and calibration
+
+Fields are private to the HAL, the structure is only public so contexts can
+be allocated statically. Initialize with lgw_ctx_init.
+*/
+typedef struct lgw_ctx_s {
+    struct lgw_reg_ctx_s        reg;                                /*!> SPI link and register page */
+    bool                        is_started;
+    bool                        rf_enable[LGW_RF_CHAIN_NB];
+    uint32_t                    rf_rx_freq[LGW_RF_CHAIN_NB];        /*!> absolute, in Hz */
+    uint32_t                    rf_cal_freq[LGW_RF_CHAIN_NB];       /*!> RX center frequency of the running calibration, in Hz */
+    float                       rf_rssi_offset[LGW_RF_CHAIN_NB];
+    bool                        rf_tx_enable[LGW_RF_CHAIN_NB];
+    uint32_t                    rf_tx_notch_freq[LGW_RF_CHAIN_NB];
+    enum lgw_radio_type_e       rf_radio_type[LGW_RF_CHAIN_NB];
+    bool                        if_enable[LGW_IF_CHAIN_NB];
+    bool                        if_rf_chain[LGW_IF_CHAIN_NB];       /*!> for each IF, 0 -> radio A, 1 -> radio B */
+    int32_t                     if_freq[LGW_IF_CHAIN_NB];           /*!> relative to radio frequency, +/- in Hz */
+    uint8_t                     lora_multi_sfmask[LGW_MULTI_NB];    /*!> enables SF for LoRa 'multi' modems */
+    uint8_t                     lora_rx_bw;                         /*!> bandwidth setting for LoRa standalone modem */
+    uint8_t                     lora_rx_sf;                         /*!> spreading factor setting for LoRa standalone modem */
+    bool                        lora_rx_ppm_offset;
+    uint8_t                     fsk_rx_bw;                          /*!> bandwidth setting of FSK modem */
+    uint32_t                    fsk_rx_dr;                          /*!> FSK modem datarate in bauds */
+    uint8_t                     fsk_sync_word_size;                 /*!> number of bytes for FSK sync word */
+    uint64_t                    fsk_sync_word;                      /*!> FSK sync word (ALIGNED RIGHT, MSbit first) */
+    bool                        lorawan_public;
+    uint8_t                     rf_clkout;
+    struct lgw_tx_gain_lut_s    txgain_lut;
+    int8_t                      cal_offset_a_i[8];                  /*!> TX I offset for radio A, mixer gain 8 to 15 */
+    int8_t                      cal_offset_a_q[8];                  /*!> TX Q offset for radio A */
+    int8_t                      cal_offset_b_i[8];                  /*!> TX I offset for radio B */
+    int8_t                      cal_offset_b_q[8];                  /*!> TX Q offset for radio B */
+    bool                        spi_tune_enable;
+    uint32_t                    spi_tune_max;
+    bool                        fw_trusted;                         /*!> firmwares are not read back after their load */
+    struct lgw_spi_tune_s       spi_tune;                           /*!> result of the last SPI link qualification */
+    uint8_t                     scrub_share;                        /*!> share of the SPI bus used by lgw_scrub, in % */
+    struct lgw_boot_timing_s    boot_timing;                        /*!> phases duration of the last start */
+    struct lgw_agc_timing_s     agc_timing;                         /*!> last AGC firmware handshake */
+    bool                        start_running;                      /*!> a start is halfway, run by lgw_start_step */
+    uint8_t                     start_next;                         /*!> phase the next lgw_start_step runs */
+    bool                        start_cal_wait;                     /*!> calibration firmware running, polled by the calibration phase */
+    uint8_t                     start_cal_cmd;                      /*!> calibration command word of the running start */
+    uint32_t                    start_t0;                           /*!> when the running start began, in us */
+    uint32_t                    start_phase_t0;                     /*!> when the running phase began, in us */
+    uint32_t                    start_cal_t0;                       /*!> when the calibration firmware was started, in ms */
+    struct lgw_conf_cal_s       cal_conf;                           /*!> calibration cache */
+} lgw_ctx_t;
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
 
+/**
+@brief Initialize a concentrator context with the default configuration set
+@param ctx pointer to the context
+@param port where the concentrator is wired, NULL for the default wiring
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_ctx_init(lgw_ctx_t *ctx, const struct lgw_spi_port_s *port);
+
+/**
+@brief Return the built-in context, the one the lgw_* functions without a context work on
+@return pointer to the built-in context
+
+The built-in context is on the default wiring, so a single concentrator
+application never needs a context. The lgw_ctx_* functions hold the HAL lock
+while they work on their context, a lgw_* call from another task waits and
+always reaches the built-in one.
+*/
+lgw_ctx_t *lgw_ctx_default(void);
+
+/**
+@brief lgw_board_setconf on a given concentrator
+*/
+int lgw_ctx_board_setconf(lgw_ctx_t *ctx, struct lgw_conf_board_s conf);
+
+/**
+@brief lgw_cal_setconf on a given concentrator
+*/
+int lgw_ctx_cal_setconf(lgw_ctx_t *ctx, struct lgw_conf_cal_s conf);
+
+/**
+@brief lgw_rxrf_setconf on a given concentrator
+*/
+int lgw_ctx_rxrf_setconf(lgw_ctx_t *ctx, uint8_t rf_chain, struct lgw_conf_rxrf_s conf);
+
+/**
+@brief lgw_rxrf_retune on a given concentrator
+*/
+int lgw_ctx_rxrf_retune(lgw_ctx_t *ctx, uint8_t rf_chain, uint32_t freq_hz);
+
+/**
+@brief lgw_reconfigure on a given concentrator
+*/
+int lgw_ctx_reconfigure(lgw_ctx_t *ctx, const struct lgw_conf_rxrf_s *rfconf, const struct lgw_conf_rxif_s *ifconf);
+
+/**
+@brief lgw_rxif_setconf on a given concentrator
+*/
+int lgw_ctx_rxif_setconf(lgw_ctx_t *ctx, uint8_t if_chain, struct lgw_conf_rxif_s conf);
+
+/**
+@brief lgw_txgain_setconf on a given concentrator
+*/
+int lgw_ctx_txgain_setconf(lgw_ctx_t *ctx, struct lgw_tx_gain_lut_s *conf);
+
+/**
+@brief lgw_txgain_update on a given concentrator
+*/
+int lgw_ctx_txgain_update(lgw_ctx_t *ctx, struct lgw_tx_gain_lut_s *conf);
+
+/**
+@brief lgw_start on a given concentrator
+*/
+int lgw_ctx_start(lgw_ctx_t *ctx);
+
+/**
+@brief lgw_start_step on a given concentrator
+*/
+int lgw_ctx_start_step(lgw_ctx_t *ctx, uint32_t *wait_ms);
+
+/**
+@brief lgw_stop on a given concentrator
+*/
+int lgw_ctx_stop(lgw_ctx_t *ctx);
+
+/**
+@brief lgw_receive on a given concentrator
+*/
+int lgw_ctx_receive(lgw_ctx_t *ctx, uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data);
+
+/**
+@brief lgw_send on a given concentrator
+*/
+int lgw_ctx_send(lgw_ctx_t *ctx, struct lgw_pkt_tx_s pkt_data);
+
+/**
+@brief lgw_status on a given concentrator
+*/
+int lgw_ctx_status(lgw_ctx_t *ctx, uint8_t select, uint8_t *code);
+
+/**
+@brief lgw_scrub on a given concentrator
+*/
+int lgw_ctx_scrub(lgw_ctx_t *ctx, uint32_t *wait_ms);
+
+/**
+@brief lgw_cal_invalidate on a given concentrator
+*/
+int lgw_ctx_cal_invalidate(lgw_ctx_t *ctx);
+
+/**
+@brief lgw_spi_tune_setconf on a given concentrator
+*/
+int lgw_ctx_spi_tune_setconf(lgw_ctx_t *ctx, bool enable, uint32_t max_speed);
+
+/**
+@brief lgw_fw_setconf on a given concentrator
+*/
+int lgw_ctx_fw_setconf(lgw_ctx_t *ctx, bool trusted);
+
+/**
+@brief lgw_get_spi_tune on a given concentrator
+*/
+int lgw_ctx_get_spi_tune(lgw_ctx_t *ctx, struct lgw_spi_tune_s *report);
+
+/**
+@brief lgw_get_boot_timing on a given concentrator
+*/
+int lgw_ctx_get_boot_timing(lgw_ctx_t *ctx, struct lgw_boot_timing_s *timing);
+
+/**
+@brief lgw_get_agc_timing on a given concentrator
+*/
+int lgw_ctx_get_agc_timing(lgw_ctx_t *ctx, struct lgw_agc_timing_s *timing);
+
+/**
+@brief lgw_scrub_setconf on a given concentrator
+*/
+int lgw_ctx_scrub_setconf(lgw_ctx_t *ctx, uint8_t bw_share);
+
+/**
+@brief lgw_abort_tx on a given concentrator
+*/
+int lgw_ctx_abort_tx(lgw_ctx_t *ctx);
+
+/**
+@brief lgw_get_trigcnt on a given concentrator
+*/
+int lgw_ctx_get_trigcnt(lgw_ctx_t *ctx, uint32_t *trig_cnt_us);
+
+/**
+@brief lgw_get_bus_stats on a given concentrator
+*/
+int lgw_ctx_get_bus_stats(lgw_ctx_t *ctx, struct lgw_spi_bus_stats_s *stats, bool clear);
+
 /**
 @brief Configure the gateway board
 @param conf structure containing the configuration parameters
@@ -305,6 +553,23 @@ struct lgw_tx_gain_lut_s {
 */
 int lgw_board_setconf(struct lgw_conf_board_s conf);
 
+/**
+@brief Configure the calibration cache (must configure before start)
+@param conf structure containing the store, the board identifier and the staleness limits
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+When a stored calibration matches the radio types, RX frequencies, enabled
+radios and board, and is fresh enough, lgw_start uses it instead of running
+the calibration firmware. Each calibration run is saved for the next start.
+*/
+int lgw_cal_setconf(struct lgw_conf_cal_s conf);
+
+/**
+@brief Erase the stored calibration, the next start runs the calibration firmware
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_cal_invalidate(void);
+
 /**
 @brief Configure an RF chain (must configure before start)
 @param rf_chain number of the RF chain to configure [0, LGW_RF_CHAIN_NB - 1]
@@ -321,6 +586,36 @@ int lgw_rxrf_setconf(uint8_t rf_chain, struct lgw_conf_rxrf_s conf);
 */
 int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s conf);
 
+/**
+@brief Move the RX center frequency of a running RF chain, without restarting the concentrator
+@param rf_chain number of the RF chain to retune [0, LGW_RF_CHAIN_NB - 1]
+@param freq_hz new RX center frequency, in Hz; IF chains keep their offset to it
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The radios keep the IQ and DC calibration of the start, so the new frequency
+must be within LGW_RF_RETUNE_MAX of the one the chain was started at; a
+larger move needs lgw_rxrf_setconf and a restart. The retune is refused while
+a TX is programmed on a TX enabled chain. The stored calibration no longer
+matches the running radios and is erased.
+*/
+int lgw_rxrf_retune(uint8_t rf_chain, uint32_t freq_hz);
+
+/**
+@brief Apply a new channel plan to the running concentrator, without restarting it
+
+Only the registers of the IF chains that changed are written, the other
+channels keep receiving; a changed LoRa 'std' or FSK modem is disabled
+while it is rewritten. The plan is checked as lgw_rxif_setconf does and is
+rejected as a whole, leaving the running one untouched, if an IF chain is
+invalid or if it needs a restart: RF chain enabled, radio type, TX enable or
+center frequency changed (lgw_rxrf_retune moves it within LGW_RF_RETUNE_MAX),
+or a LoRa 'multi' channel moved to the other radio.
+@param rfconf array of LGW_RF_CHAIN_NB RF chain configurations, only RSSI offset and TX notch may differ; NULL to leave them
+@param ifconf array of LGW_IF_CHAIN_NB IF chain configurations, as given to lgw_rxif_setconf
+@return LGW_HAL_ERROR id the operation failed or was rejected, LGW_HAL_SUCCESS else
+*/
+int lgw_reconfigure(const struct lgw_conf_rxrf_s *rfconf, const struct lgw_conf_rxif_s *ifconf);
+
 /**
 @brief Configure the Tx gain LUT
 @param pointer to structure defining the LUT
@@ -328,12 +623,94 @@ int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s conf);
 */
 int lgw_txgain_setconf(struct lgw_tx_gain_lut_s *conf);
 
+/**
+@brief Give a new TX gain LUT to the running concentrator, without restarting it
+@param conf pointer to LUT configuration, checked as lgw_txgain_setconf does
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The AGC firmware only takes its LUT during its init handshake, so it is
+reloaded and initialized again; radios, calibration and modems are kept.
+For the few ms it takes the AGC firmware does not drive the RX gains, and
+the update is refused while a packet is scheduled or emitted.
+If the reload or the handshake fails, the concentrator is stopped and keeps
+its former LUT, it must be started again with lgw_start.
+*/
+int lgw_txgain_update(struct lgw_tx_gain_lut_s *conf);
+
+/**
+@brief Configure the SPI link qualification done by lgw_start
+@param enable if false, the SPI clock stays at its default value
+@param max_speed fastest SPI clock to try, in Hz
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_spi_tune_setconf(bool enable, uint32_t max_speed);
+
+/**
+@brief Configure the check of the MCU firmwares loaded by lgw_start
+@param trusted if true, the program memories are not read back, the firmware versions are still checked
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_fw_setconf(bool trusted);
+
+/**
+@brief Return the result of the last SPI link qualification
+@param report pointer to a structure receiving the bit errors per clock rate and the clock kept
+@return LGW_HAL_ERROR id no qualification was done, LGW_HAL_SUCCESS else
+*/
+int lgw_get_spi_tune(struct lgw_spi_tune_s *report);
+
+/**
+@brief Return the duration of each phase of the last start
+@param timing pointer to a structure receiving the phases duration
+@return LGW_HAL_ERROR id lgw_start was never called, LGW_HAL_SUCCESS else
+*/
+int lgw_get_boot_timing(struct lgw_boot_timing_s *timing);
+
+/**
+@brief Return the latency of the last AGC firmware init handshake
+@param timing pointer to a structure receiving the handshake figures
+@return LGW_HAL_ERROR id no handshake completed, LGW_HAL_SUCCESS else
+*/
+int lgw_get_agc_timing(struct lgw_agc_timing_s *timing);
+
+/**
+@brief Set the share of the SPI bus the register scrubber may use
+@param bw_share percentage of the bus time, 0 to disable the scrubber
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_scrub_setconf(uint8_t bw_share);
+
+/**
+@brief Check the next register chunk of the running concentrator against its configuration, repairing drifted bytes
+@param wait_ms pointer to the time to wait before the next call, keeping the scrubber to its share of the bus
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_scrub(uint32_t *wait_ms);
+
 /**
 @brief Connect to the LoRa concentrator, reset it and configure it according to previously set parameters
 @return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The register lock is released while the calibration firmware runs, so the
+other concentrators are served meanwhile.
 */
 int lgw_start(void);
 
+/**
+@brief Run the next step of the concentrator start, same sequence as lgw_start
+
+Each call runs one phase (LGW_BOOT_xxx) with the SPI bus and the registers
+held, then releases them, so other tasks can run between two steps. The
+calibration phase spans several calls while the calibration firmware runs;
+wait_ms then gives the time to let pass before the next call.
+Do not access the concentrator registers between two steps, the calibration
+firmware owns them while it runs. The configuration can not be changed
+until the start is done, lgw_stop aborts it.
+@param wait_ms pointer to the time to wait before the next call, may be NULL
+@return LGW_START_IN_PROGRESS while steps remain, LGW_START_DONE when the concentrator is started, LGW_HAL_ERROR if the start failed
+*/
+int lgw_start_step(uint32_t *wait_ms);
+
 /**
 @brief Stop the LoRa concentrator and disconnect it
 @return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
@@ -378,23 +755,34 @@ int lgw_send(struct lgw_pkt_tx_s pkt_data);
 @brief Give the the status of different part of the LoRa concentrator
 @param select is used to select what status we want to know
 @param code is used to return the status code
-@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+@return LGW_HAL_ERROR id the operation failed or the calibration firmware runs, LGW_HAL_SUCCESS else
 */
 int lgw_status(uint8_t select, uint8_t *code);
 
 /**
 @brief Abort a currently scheduled or ongoing TX
-@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+@return LGW_HAL_ERROR id the operation failed or the calibration firmware runs, LGW_HAL_SUCCESS else
 */
 int lgw_abort_tx(void);
 
 /**
 @brief Return value of internal counter when latest event (eg GPS pulse) was captured
 @param trig_cnt_us pointer to receive timestamp value
-@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+@return LGW_HAL_ERROR id the operation failed or the calibration firmware runs, LGW_HAL_SUCCESS else
 */
 int lgw_get_trigcnt(uint32_t* trig_cnt_us);
 
+/**
+@brief Return the SPI bus usage of each kind of HAL operation since the concentrator was connected or the last clear
+@param stats pointer to an array of LGW_SPI_OP_NB structures, indexed by LGW_SPI_OP_xxx
+@param clear if true, counters are reset after being copied
+@return LGW_HAL_ERROR id the concentrator is not connected, LGW_HAL_SUCCESS else
+
+Only the accesses to this concentrator are counted, lgw_spi_get_bus_stats sums
+all of them.
+*/
+int lgw_get_bus_stats(struct lgw_spi_bus_stats_s *stats, bool clear);
+
 /**
 @brief Allow user to check the version/options of the library once compiled
 @return pointer on a human-readable null terminated string
@@ -0,0 +1,135 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Platform services used by the HAL (delays, time base, serial console,
+    recursive mutex, task yield).
+    On the ESP32 they come from the Arduino core. On a host (Linux) build they
+    are mapped to POSIX equivalents so the HAL can run against a simulated SPI
+    backend.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORAGW_PORT_H
+#define _LORAGW_PORT_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#ifdef ARDUINO
+
+#include <arduino.h>
+
+/* -------------------------------------------------------------------------- */
+/* --- RECURSIVE MUTEX ------------------------------------------------------ */
+
+typedef SemaphoreHandle_t lgw_port_mutex_t;
+
+static inline bool lgw_port_mutex_init(lgw_port_mutex_t *m) {
+    *m = xSemaphoreCreateRecursiveMutex();
+    return (*m != NULL);
+}
+
+static inline void lgw_port_mutex_lock(lgw_port_mutex_t *m) {
+    xSemaphoreTakeRecursive(*m, portMAX_DELAY);
+}
+
+static inline void lgw_port_mutex_unlock(lgw_port_mutex_t *m) {
+    xSemaphoreGiveRecursive(*m);
+}
+
+/* let any other task run, including lower priority ones */
+static inline void lgw_port_yield(void) {
+    vTaskDelay(1);
+}
+
+#else
+
+#include <stdint.h>     /* C99 types */
+#include <stdio.h>      /* fputs fprintf */
+#include <stdlib.h>     /* malloc free */
+#include <string.h>     /* memset memcpy */
+#include <time.h>       /* clock_gettime nanosleep */
+#include <stdbool.h>    /* bool type */
+#include <pthread.h>    /* pthread_mutex_* */
+#include <sched.h>      /* sched_yield */
+
+/* -------------------------------------------------------------------------- */
+/* --- HOST REPLACEMENTS FOR THE ARDUINO CORE ------------------------------- */
+
+#define DEC 10
+#define HEX 16
+
+static inline unsigned long micros(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (unsigned long)t.tv_sec * 1000000UL + (unsigned long)(t.tv_nsec / 1000);
+}
+
+static inline unsigned long millis(void) {
+    return micros() / 1000UL;
+}
+
+static inline void delayMicroseconds(unsigned int us) {
+    struct timespec dly;
+    dly.tv_sec = us / 1000000;
+    dly.tv_nsec = (long)(us % 1000000) * 1000L;
+    nanosleep(&dly, NULL);
+}
+
+static inline void delay(unsigned long ms) {
+    struct timespec dly;
+    dly.tv_sec = ms / 1000;
+    dly.tv_nsec = (long)(ms % 1000) * 1000000L;
+    nanosleep(&dly, NULL);
+}
+
+/* debug output goes to stderr, same interface as the Arduino Serial object */
+struct lgw_port_serial_s {
+    void print(const char *s) { fputs(s, stderr); }
+    void print(long v, int base = DEC) { fprintf(stderr, (base == HEX) ? "%lX" : "%ld", v); }
+    void println(const char *s = "") { fprintf(stderr, "%s\n", s); }
+    void println(long v, int base = DEC) { print(v, base); fputs("\n", stderr); }
+};
+static struct lgw_port_serial_s Serial __attribute__((unused));
+
+/* -------------------------------------------------------------------------- */
+/* --- RECURSIVE MUTEX ------------------------------------------------------ */
+
+typedef pthread_mutex_t lgw_port_mutex_t;
+
+static inline bool lgw_port_mutex_init(lgw_port_mutex_t *m) {
+    pthread_mutexattr_t attr;
+    int x;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    x = pthread_mutex_init(m, &attr);
+    pthread_mutexattr_destroy(&attr);
+    return (x == 0);
+}
+
+static inline void lgw_port_mutex_lock(lgw_port_mutex_t *m) {
+    pthread_mutex_lock(m);
+}
+
+static inline void lgw_port_mutex_unlock(lgw_port_mutex_t *m) {
+    pthread_mutex_unlock(m);
+}
+
+static inline void lgw_port_yield(void) {
+    sched_yield();
+}
+
+#endif
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -21,7 +21,7 @@ Maintainer: Michael Coracin
 
 #include <stdint.h>     /* C99 types */
 #include <stdbool.h>    /* bool type */
-#include <arduino.h>   
+#include "loragw_port.h"   /* delay */
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC CONSTANTS ----------------------------------------------------- */
 
@@ -57,9 +57,88 @@ enum lgw_sx127x_rxbw_e {
     LGW_SX127X_RXBW_250K_HZ
 };
 
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct lgw_sx125x_reg_s
+@brief One SX125x register write of a table
+*/
+struct lgw_sx125x_reg_s {
+    uint8_t     addr;   /*!> SX125x register address (7 bit) */
+    uint8_t     data;   /*!> value to write */
+};
+
+/**
+@struct lgw_sx125x_stats_s
+@brief Effect of the radio register image on SX125x writes
+*/
+struct lgw_sx125x_stats_s {
+    uint32_t    nb_written;     /*!> register writes sent to the radio */
+    uint32_t    nb_skipped;     /*!> register writes dropped, the radio already held the value */
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
 
+/**
+@brief Write a list of SX125x registers, in order, through the SX1301 SPI master
+
+Values the radio is known to hold already are not sent again.
+@param channel RF chain of the radio
+@param table pointer to the registers and values to write
+@param nb number of entries in the table
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int sx125x_write_table(uint8_t channel, const struct lgw_sx125x_reg_s *table, uint8_t nb);
+
+/**
+@brief Retune the RX PLL of a running radio, relocking it only if the frequency registers changed
+
+If the AGC MCU drives the radios, the host takes them back for the retune and
+then returns them; sx125x_set_rx_gain and sx125x_verify do the same.
+@param channel RF chain of the radio
+@param rf_radio_type LGW_RADIO_TYPE_SX1255 or LGW_RADIO_TYPE_SX1257
+@param freq_hz new RX center frequency, in Hz
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR), error if the PLL does not lock
+*/
+int sx125x_set_rx_freq(uint8_t channel, uint8_t rf_radio_type, uint32_t freq_hz);
+
+/**
+@brief Change the RX analog gains of a running radio
+@param channel RF chain of the radio
+@param lna_gain LNA gain, 1 (highest) to 6 (lowest)
+@param bb_gain baseband gain, 0 to 15 (2 dB steps)
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int sx125x_set_rx_gain(uint8_t channel, uint8_t lna_gain, uint8_t bb_gain);
+
+/**
+@brief Read back the registers of the radio image and compare them with the radio
+@param channel RF chain of the radio
+@param repair if true, differing registers are written again, else they are dropped from the image
+@param nb_mismatch pointer to the number of registers that differed
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int sx125x_verify(uint8_t channel, bool repair, uint8_t *nb_mismatch);
+
+/**
+@brief Get and optionally clear the radio write counters
+@param channel RF chain of the radio
+@param stats pointer to the structure receiving the counters
+@param clear if true, counters are reset after being copied
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int sx125x_get_stats(uint8_t channel, struct lgw_sx125x_stats_s *stats, bool clear);
+
+/**
+@brief Wait for a powered radio to answer through the SX1301 SPI master
+@param channel RF chain of the radio
+@param timeout_ms longest time to wait, in ms
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR), error on timeout
+*/
+int sx125x_wait_ready(uint8_t channel, uint32_t timeout_ms);
+
 int lgw_setup_sx125x(uint8_t rf_chain, uint8_t rf_clkout, bool rf_enable, uint8_t rf_radio_type, uint32_t freq_hz);
 
 
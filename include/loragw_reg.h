@@ -25,8 +25,8 @@ Maintainer: Sylvain Miermont
 
 #include <stdint.h>        /* C99 types */
 #include <stdbool.h>    /* bool type */
-#include <arduino.h>   
-#include <SPI.h>
+#include "loragw_port.h"   /* delay */
+#include "loragw_spi.h"    /* lgw_spi_tune_s */
 
 #include "config.h"    /* library configuration options (dynamically generated) */
 
@@ -43,11 +43,156 @@ struct lgw_reg_s {
     int32_t dflt;        /*!< register default value */
 };
 
+#define LGW_REG_PAGE_NB 3   /* register pages, common registers are kept with page 0 */
+#define LGW_REG_RADIO_NB 2  /* SX125x radios behind the SX1301 SPI masters */
+
+/**
+@struct lgw_reg_shadow_stats_s
+@brief Effect of the register shadow on read-modify-write accesses
+*/
+struct lgw_reg_shadow_stats_s {
+    uint32_t    nb_avoided;     /*!> sub-byte writes done without reading the byte first */
+    uint32_t    nb_read;        /*!> sub-byte writes that still had to read the byte */
+};
+
+/**
+@struct lgw_reg_radio_s
+@brief Registers of one SX125x radio last written through the SPI master, kept by loragw_radio
+*/
+struct lgw_reg_radio_s {
+    uint8_t     val[128];       /*!> last value written to each radio register */
+    uint8_t     valid[16];      /*!> one bit per register, cleared when the radio is reset */
+    uint32_t    nb_written;     /*!> register writes sent to the radio */
+    uint32_t    nb_skipped;     /*!> register writes dropped, the radio already held the value */
+};
+
+/**
+@struct lgw_reg_arbiter_stats_s
+@brief Register lock arbitration between TX loads and long operations
+*/
+struct lgw_reg_arbiter_stats_s {
+    uint32_t    nb_prio;        /*!> priority holds taken, one per TX load */
+    uint32_t    nb_yield;       /*!> times a long operation handed the lock over between two units */
+    uint32_t    wait_max;       /*!> longest wait of a priority holder for the lock, in us */
+    uint32_t    latency_last;   /*!> request to release of the last priority hold, in us */
+    uint32_t    latency_max;    /*!> worst request to release of a priority hold, in us */
+};
+
+/**
+@struct lgw_reg_scrub_stats_s
+@brief Result of the register scrubber, comparing the chip with the shadow
+*/
+struct lgw_reg_scrub_stats_s {
+    uint32_t    nb_round;       /*!> complete passes over the register pages */
+    uint32_t    nb_checked;     /*!> bytes compared with the configuration written */
+    uint32_t    nb_drift;       /*!> bytes that no longer held the configuration */
+    uint32_t    nb_repaired;    /*!> drifted bytes written again */
+    uint32_t    bus_time;       /*!> time spent by the scrubber on the bus, in us */
+    uint8_t     last_page;      /*!> page of the last drifted byte, when nb_drift is not 0 */
+    uint8_t     last_addr;      /*!> address of the last drifted byte */
+};
+
+/**
+@struct lgw_reg_pair_s
+@brief One register write of a batch
+*/
+struct lgw_reg_pair_s {
+    uint16_t    register_id;    /*!> register number in the data structure describing registers */
+    int32_t     value;          /*!> signed value to write to the register (for u32, use cast) */
+};
+
+/**
+@struct lgw_reg_ctx_s
+@brief Link state of one concentrator, selected with lgw_reg_select
+*/
+struct lgw_reg_ctx_s {
+    void                    *spi_target;    /*!> generic pointer to the SPI device, NULL when unconnected */
+    uint8_t                 spi_mux_mode;   /*!> SPI mux mode used */
+    int                     regpage;        /*!> register page selected, -1 when unknown */
+    bool                    has_port;       /*!> false to connect on the default wiring */
+    struct lgw_spi_port_s   port;           /*!> wiring used by lgw_connect */
+    uint8_t                 shadow[LGW_REG_PAGE_NB][128];       /*!> last value written, whole byte */
+    uint8_t                 shadow_valid[LGW_REG_PAGE_NB][16];  /*!> one bit per shadow byte */
+    struct lgw_reg_shadow_stats_s shadow_stats;
+    bool                    defer;          /*!> writes are held until the next barrier */
+    uint16_t                defer_nb;       /*!> bytes held */
+    uint8_t                 defer_val[LGW_REG_PAGE_NB + 1][128]; /*!> held bytes, last slot for common registers */
+    uint8_t                 defer_set[LGW_REG_PAGE_NB + 1][128]; /*!> held bits of each byte */
+    struct lgw_reg_radio_s  radio[LGW_REG_RADIO_NB];    /*!> image of the radio registers */
+    uint8_t                 scrub_page;     /*!> next page checked by lgw_reg_scrub */
+    uint8_t                 scrub_addr;     /*!> next address checked by lgw_reg_scrub, 0 to start the page */
+    struct lgw_reg_scrub_stats_s scrub_stats;
+};
+
+/**
+@struct lgw_reg_snapshot_s
+@brief Image of the register pages, common registers are in the page 0 image
+*/
+struct lgw_reg_snapshot_s {
+    uint8_t     page[LGW_REG_PAGE_NB][128];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- INTERNAL SHARED VARIABLES -------------------------------------------- */
+
+extern const struct lgw_reg_s *const loregs; /*! register descriptors, indexed by register id */
+
 /* -------------------------------------------------------------------------- */
 /* --- INTERNAL SHARED FUNCTIONS -------------------------------------------- */
 
-int reg_w_align32(SPIClass* spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, struct lgw_reg_s r, int32_t reg_value);
-int reg_r_align32(SPIClass* spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, struct lgw_reg_s r, int32_t *reg_value);
+int reg_w_align32(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, struct lgw_reg_s r, int32_t reg_value);
+int reg_r_align32(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, struct lgw_reg_s r, int32_t *reg_value);
+
+/**
+@brief Write a bit field of one byte, used by lgw_reg_write
+@param page page of the register, -1 for all pages
+@param addr address of the byte, 0 to 127
+@param mask bits of the field in the byte
+@param bits new value of the field, already shifted and masked
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_w_field(int8_t page, uint8_t addr, uint8_t mask, uint8_t bits);
+
+/**
+@brief Write a register made of whole bytes, used by lgw_reg_write
+@param page page of the register, -1 for all pages
+@param addr address of the first byte, the last one must be below 128
+@param size number of bytes (1 to 4), least significant first
+@param value value to write
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_w_bytes(int8_t page, uint8_t addr, uint8_t size, uint32_t value);
+
+/**
+@brief Read 1 to 4 bytes of registers, used by lgw_reg_read
+@param page page of the register, -1 for all pages
+@param addr address of the first byte, the last one must be below 128
+@param size number of bytes (1 to 4), least significant first
+@param value pointer to the value read
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_r_bytes(int8_t page, uint8_t addr, uint8_t size, uint32_t *value);
+
+/**
+@brief Get the radio register image of the selected concentrator, used by loragw_radio
+@param channel RF chain of the radio
+@return pointer to the image, NULL if the channel is out of range
+*/
+struct lgw_reg_radio_s *lgw_reg_radio(uint8_t channel);
+
+/**
+@brief Initialize the link state of a concentrator, unconnected
+@param ctx pointer to the link state
+@param port wiring of the concentrator, NULL for the default one
+*/
+void lgw_reg_ctx_init(struct lgw_reg_ctx_s *ctx, const struct lgw_spi_port_s *port);
+
+/**
+@brief Select the concentrator the lgw_reg_* and lgw_connect functions work on
+@param ctx pointer to the link state, NULL for the built-in one
+@return link state selected before the call
+*/
+struct lgw_reg_ctx_s *lgw_reg_select(struct lgw_reg_ctx_s *ctx);
 
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC CONSTANTS ----------------------------------------------------- */
@@ -394,6 +539,70 @@ this file is autogenerated from registers description
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
 
+/**
+@brief Take the register lock, for a sequence of accesses that must not interleave with other tasks
+
+Every lgw_reg_* function holds the lock around its own page switch and
+access. The lock is recursive, each lgw_reg_lock needs one lgw_reg_unlock.
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_lock(void);
+
+/**
+@brief Release the register lock taken by lgw_reg_lock
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_unlock(void);
+
+/**
+@brief Take the register lock ahead of the tasks that are not waiting yet
+
+A holder running a long operation sees the request through lgw_reg_yield
+and hands the lock over at its next unit boundary.
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_lock_prio(void);
+
+/**
+@brief Release the register lock taken by lgw_reg_lock_prio, and account its latency
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_unlock_prio(void);
+
+/**
+@brief Tell whether a task waits in lgw_reg_lock_prio
+@return true if the lock holder should call lgw_reg_yield at its next unit boundary
+*/
+bool lgw_reg_prio_pending(void);
+
+/**
+@brief Hand the register lock over to waiting priority holders, then take it back
+
+The link selected with lgw_reg_select is the one the priority holders find;
+a caller working on another link selects the usual one first, and gets its
+own selected again on return.
+@return true if the lock was handed over, the caller must not rely on any page or pointer it set before
+*/
+bool lgw_reg_yield(void);
+
+/**
+@brief Wait with the register lock released, then take it back
+
+Used by a holder that has nothing to do on the bus for a while, so the
+other links are not stalled. The selection rules of lgw_reg_yield apply,
+and the caller must check on return that nobody changed its state.
+@param ms time to wait, in milliseconds
+*/
+void lgw_reg_sleep(uint32_t ms);
+
+/**
+@brief Get and optionally clear the register lock arbitration counters
+@param stats pointer to the structure receiving the counters
+@param clear if true, counters are reset after being copied
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_get_arbiter_stats(struct lgw_reg_arbiter_stats_s *stats, bool clear);
+
 /**
 @brief Connect LoRa concentrator by opening SPI link
 @param spi_only indicates if we only want to create the SPI connexion to the
@@ -423,6 +632,98 @@ int lgw_soft_reset(void);
 */
 int lgw_reg_check(FILE *f);
 
+/**
+@brief Read all the register pages in a few bursts
+@param snap pointer to the image receiving the registers
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+
+Data ports are not read, reading them would move their pointer; their bytes
+are left at 0 in the image.
+*/
+int lgw_reg_snapshot(struct lgw_reg_snapshot_s *snap);
+
+/**
+@brief Decode a register from a snapshot
+@param snap pointer to the image taken with lgw_reg_snapshot
+@param register_id register number in the data structure describing registers
+@param reg_value pointer to a variable where to write register value
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_snapshot_get(const struct lgw_reg_snapshot_s *snap, uint16_t register_id, int32_t *reg_value);
+
+/**
+@brief List the registers that differ between two snapshots
+@param snap pointer to the image to check
+@param ref pointer to the reference image, NULL to compare with the default values
+@param config_only if true, only the registers written by the host alone are compared
+@param diff array receiving the numbers of the registers that differ, can be NULL
+@param max_diff size of the diff array
+@param nb_diff pointer to the number of registers that differ, can be above max_diff
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_snapshot_diff(const struct lgw_reg_snapshot_s *snap, const struct lgw_reg_snapshot_s *ref, bool config_only, uint16_t *diff, uint16_t max_diff, uint16_t *nb_diff);
+
+/**
+@brief Qualify the SPI link and set the fastest reliable clock
+@param max_speed fastest clock to try, in Hz
+@param margin number of clock steps kept below the fastest error-free rate
+@param report pointer to a structure receiving the bit errors of each rate
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+
+Patterns are written to and read back from SW_TEST_REG1..3 at rising clock
+rates. Stray writes are possible at the highest rates, so it must be called
+before the soft reset of the concentrator.
+*/
+int lgw_reg_spi_tune(uint32_t max_speed, uint8_t margin, struct lgw_spi_tune_s *report);
+
+/**
+@brief Enable the register shadow, used to skip the read of read-modify-write accesses
+@param enable if false, every sub-byte write reads the byte first
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+
+The shadow holds the bytes of the registers only the host changes, as last
+written to the chip. On soft reset it is seeded with the default values of the
+bytes fully described by the register table; the other bytes are read once.
+*/
+int lgw_reg_shadow_setconf(bool enable);
+
+/**
+@brief Forget every value held in the register shadow
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+
+To call when an MCU had control of the registers, the next accesses of each
+byte read it from the chip again.
+*/
+int lgw_reg_shadow_invalidate(void);
+
+/**
+@brief Get the register shadow counters of the selected concentrator
+@param stats pointer to the structure receiving the counters
+@param clear if true, counters are reset after being copied
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_get_shadow_stats(struct lgw_reg_shadow_stats_s *stats, bool clear);
+
+/**
+@brief Check the next bytes of the register pages against the shadow and repair the drifted ones
+
+Successive calls go round the pages. Only bytes whose writable bits are
+known from the shadow are compared, bits the chip or its MCUs change are
+left alone.
+@param size number of addresses to cover in this call (1 to 128)
+@param nb_drift pointer to the number of bytes found drifted, NULL if not needed
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_scrub(uint8_t size, uint16_t *nb_drift);
+
+/**
+@brief Get and optionally clear the register scrubber counters
+@param stats pointer to the structure receiving the counters
+@param clear if true, counters are reset after being copied
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_get_scrub_stats(struct lgw_reg_scrub_stats_s *stats, bool clear);
+
 /**
 @brief LoRa concentrator register write
 @param register_id register number in the data structure describing registers
@@ -431,6 +732,38 @@ int lgw_reg_check(FILE *f);
 */
 int lgw_reg_w(uint16_t register_id, int32_t reg_value);
 
+/**
+@brief Write a list of registers, grouped by page and merged into bursts
+@param list pointer to the registers and values to write
+@param nb number of entries in the list
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+
+Writes are reordered: the list must only hold configuration registers whose
+write order does not matter. Fields sharing a byte are merged in memory, the
+rest of a partly written byte comes from the register shadow, or is read once.
+When a register is listed several times, the last value is written. Data
+ports, pointers and triggers are rejected, nothing is written in that case.
+*/
+int lgw_reg_w_batch(const struct lgw_reg_pair_s *list, uint16_t nb);
+
+/**
+@brief Hold register writes and send them grouped by page at the next barrier
+@param enable true to start holding writes, false to send them and stop
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+
+Held writes are merged like lgw_reg_w_batch: the current page is written
+first, then the other pages, common registers last. Any read, burst, write
+to a data port, pointer or trigger, soft reset or lgw_reg_barrier sends them
+first, so accesses the hardware sequences on keep their order.
+*/
+int lgw_reg_defer(bool enable);
+
+/**
+@brief Send the register writes held by lgw_reg_defer
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_barrier(void);
+
 /**
 @brief LoRa concentrator register read
 @param register_id register number in the data structure describing registers
@@ -458,6 +791,416 @@ int lgw_reg_wb(uint16_t register_id, uint8_t *data, uint16_t size);
 int lgw_reg_rb(uint16_t register_id, uint8_t *data, uint16_t size);
 
 
+/* -------------------------------------------------------------------------- */
+/* --- REGISTER MAP --------------------------------------------------------- */
+
+/**
+@struct lgw_reg_map
+@brief Register descriptors, visible to the compiler for the accessors below
+*/
+struct lgw_reg_map {
+    /*
+    auto generated register mapping for C code : 11-Jul-2013 13:20:40
+    this file contains autogenerated C struct used to access the LoRa register from the Primer firmware
+    this file is autogenerated from registers description
+    293 registers are defined
+    */
+    static constexpr struct lgw_reg_s table[LGW_TOTALREGS] = {
+        {-1,0,0,0,2,0,0},         /* PAGE_REG */
+        {-1,0,7,0,1,0,0},         /* SOFT_RESET */
+        {-1,1,0,0,8,1,103},       /* VERSION */
+        {-1,2,0,0,16,0,0},        /* RX_DATA_BUF_ADDR */
+        {-1,4,0,0,8,0,0},         /* RX_DATA_BUF_DATA */
+        {-1,5,0,0,8,0,0},         /* TX_DATA_BUF_ADDR */
+        {-1,6,0,0,8,0,0},         /* TX_DATA_BUF_DATA */
+        {-1,7,0,0,8,0,0},         /* CAPTURE_RAM_ADDR */
+        {-1,8,0,0,8,1,0},         /* CAPTURE_RAM_DATA */
+        {-1,9,0,0,8,0,0},         /* MCU_PROM_ADDR */
+        {-1,10,0,0,8,0,0},        /* MCU_PROM_DATA */
+        {-1,11,0,0,8,0,0},        /* RX_PACKET_DATA_FIFO_NUM_STORED */
+        {-1,12,0,0,16,1,0},       /* RX_PACKET_DATA_FIFO_ADDR_POINTER */
+        {-1,14,0,0,8,1,0},        /* RX_PACKET_DATA_FIFO_STATUS */
+        {-1,15,0,0,8,1,0},        /* RX_PACKET_DATA_FIFO_PAYLOAD_SIZE */
+        {-1,16,0,0,1,0,0},        /* MBWSSF_MODEM_ENABLE */
+        {-1,16,1,0,1,0,0},        /* CONCENTRATOR_MODEM_ENABLE */
+        {-1,16,2,0,1,0,0},        /* FSK_MODEM_ENABLE */
+        {-1,16,3,0,1,0,0},        /* GLOBAL_EN */
+        {-1,17,0,0,1,0,1},        /* CLK32M_EN */
+        {-1,17,1,0,1,0,1},        /* CLKHS_EN */
+        {-1,18,0,0,1,0,0},        /* START_BIST0 */
+        {-1,18,1,0,1,0,0},        /* START_BIST1 */
+        {-1,18,2,0,1,0,0},        /* CLEAR_BIST0 */
+        {-1,18,3,0,1,0,0},        /* CLEAR_BIST1 */
+        {-1,19,0,0,1,1,0},        /* BIST0_FINISHED */
+        {-1,19,1,0,1,1,0},        /* BIST1_FINISHED */
+        {-1,20,0,0,1,1,0},        /* MCU_AGC_PROG_RAM_BIST_STATUS */
+        {-1,20,1,0,1,1,0},        /* MCU_ARB_PROG_RAM_BIST_STATUS */
+        {-1,20,2,0,1,1,0},        /* CAPTURE_RAM_BIST_STATUS */
+        {-1,20,3,0,1,1,0},        /* CHAN_FIR_RAM0_BIST_STATUS */
+        {-1,20,4,0,1,1,0},        /* CHAN_FIR_RAM1_BIST_STATUS */
+        {-1,21,0,0,1,1,0},        /* CORR0_RAM_BIST_STATUS */
+        {-1,21,1,0,1,1,0},        /* CORR1_RAM_BIST_STATUS */
+        {-1,21,2,0,1,1,0},        /* CORR2_RAM_BIST_STATUS */
+        {-1,21,3,0,1,1,0},        /* CORR3_RAM_BIST_STATUS */
+        {-1,21,4,0,1,1,0},        /* CORR4_RAM_BIST_STATUS */
+        {-1,21,5,0,1,1,0},        /* CORR5_RAM_BIST_STATUS */
+        {-1,21,6,0,1,1,0},        /* CORR6_RAM_BIST_STATUS */
+        {-1,21,7,0,1,1,0},        /* CORR7_RAM_BIST_STATUS */
+        {-1,22,0,0,1,1,0},        /* MODEM0_RAM0_BIST_STATUS */
+        {-1,22,1,0,1,1,0},        /* MODEM1_RAM0_BIST_STATUS */
+        {-1,22,2,0,1,1,0},        /* MODEM2_RAM0_BIST_STATUS */
+        {-1,22,3,0,1,1,0},        /* MODEM3_RAM0_BIST_STATUS */
+        {-1,22,4,0,1,1,0},        /* MODEM4_RAM0_BIST_STATUS */
+        {-1,22,5,0,1,1,0},        /* MODEM5_RAM0_BIST_STATUS */
+        {-1,22,6,0,1,1,0},        /* MODEM6_RAM0_BIST_STATUS */
+        {-1,22,7,0,1,1,0},        /* MODEM7_RAM0_BIST_STATUS */
+        {-1,23,0,0,1,1,0},        /* MODEM0_RAM1_BIST_STATUS */
+        {-1,23,1,0,1,1,0},        /* MODEM1_RAM1_BIST_STATUS */
+        {-1,23,2,0,1,1,0},        /* MODEM2_RAM1_BIST_STATUS */
+        {-1,23,3,0,1,1,0},        /* MODEM3_RAM1_BIST_STATUS */
+        {-1,23,4,0,1,1,0},        /* MODEM4_RAM1_BIST_STATUS */
+        {-1,23,5,0,1,1,0},        /* MODEM5_RAM1_BIST_STATUS */
+        {-1,23,6,0,1,1,0},        /* MODEM6_RAM1_BIST_STATUS */
+        {-1,23,7,0,1,1,0},        /* MODEM7_RAM1_BIST_STATUS */
+        {-1,24,0,0,1,1,0},        /* MODEM0_RAM2_BIST_STATUS */
+        {-1,24,1,0,1,1,0},        /* MODEM1_RAM2_BIST_STATUS */
+        {-1,24,2,0,1,1,0},        /* MODEM2_RAM2_BIST_STATUS */
+        {-1,24,3,0,1,1,0},        /* MODEM3_RAM2_BIST_STATUS */
+        {-1,24,4,0,1,1,0},        /* MODEM4_RAM2_BIST_STATUS */
+        {-1,24,5,0,1,1,0},        /* MODEM5_RAM2_BIST_STATUS */
+        {-1,24,6,0,1,1,0},        /* MODEM6_RAM2_BIST_STATUS */
+        {-1,24,7,0,1,1,0},        /* MODEM7_RAM2_BIST_STATUS */
+        {-1,25,0,0,1,1,0},        /* MODEM_MBWSSF_RAM0_BIST_STATUS */
+        {-1,25,1,0,1,1,0},        /* MODEM_MBWSSF_RAM1_BIST_STATUS */
+        {-1,25,2,0,1,1,0},        /* MODEM_MBWSSF_RAM2_BIST_STATUS */
+        {-1,26,0,0,1,1,0},        /* MCU_AGC_DATA_RAM_BIST0_STATUS */
+        {-1,26,1,0,1,1,0},        /* MCU_AGC_DATA_RAM_BIST1_STATUS */
+        {-1,26,2,0,1,1,0},        /* MCU_ARB_DATA_RAM_BIST0_STATUS */
+        {-1,26,3,0,1,1,0},        /* MCU_ARB_DATA_RAM_BIST1_STATUS */
+        {-1,26,4,0,1,1,0},        /* TX_TOP_RAM_BIST0_STATUS */
+        {-1,26,5,0,1,1,0},        /* TX_TOP_RAM_BIST1_STATUS */
+        {-1,26,6,0,1,1,0},        /* DATA_MNGT_RAM_BIST0_STATUS */
+        {-1,26,7,0,1,1,0},        /* DATA_MNGT_RAM_BIST1_STATUS */
+        {-1,27,0,0,4,0,0},        /* GPIO_SELECT_INPUT */
+        {-1,28,0,0,4,0,0},        /* GPIO_SELECT_OUTPUT */
+        {-1,29,0,0,5,0,0},        /* GPIO_MODE */
+        {-1,30,0,0,5,1,0},        /* GPIO_PIN_REG_IN */
+        {-1,31,0,0,5,0,0},        /* GPIO_PIN_REG_OUT */
+        {-1,32,0,0,8,1,0},        /* MCU_AGC_STATUS */
+        {-1,125,0,0,8,1,0},       /* MCU_ARB_STATUS */
+        {-1,126,0,0,8,1,1},       /* CHIP_ID */
+        {-1,127,0,0,1,0,1},       /* EMERGENCY_FORCE_HOST_CTRL */
+        {0,33,0,0,1,0,0},         /* RX_INVERT_IQ */
+        {0,33,1,0,1,0,1},         /* MODEM_INVERT_IQ */
+        {0,33,2,0,1,0,0},         /* MBWSSF_MODEM_INVERT_IQ */
+        {0,33,3,0,1,0,0},         /* RX_EDGE_SELECT */
+        {0,33,4,0,1,0,0},         /* MISC_RADIO_EN */
+        {0,33,5,0,1,0,0},         /* FSK_MODEM_INVERT_IQ */
+        {0,34,0,0,4,0,7},         /* FILTER_GAIN */
+        {0,35,0,0,8,0,240},       /* RADIO_SELECT */
+        {0,36,0,1,13,0,-384},     /* IF_FREQ_0 */
+        {0,38,0,1,13,0,-128},     /* IF_FREQ_1 */
+        {0,40,0,1,13,0,128},      /* IF_FREQ_2 */
+        {0,42,0,1,13,0,384},      /* IF_FREQ_3 */
+        {0,44,0,1,13,0,-384},     /* IF_FREQ_4 */
+        {0,46,0,1,13,0,-128},     /* IF_FREQ_5 */
+        {0,48,0,1,13,0,128},      /* IF_FREQ_6 */
+        {0,50,0,1,13,0,384},      /* IF_FREQ_7 */
+        {0,52,0,1,13,0,0},        /* IF_FREQ_8 */
+        {0,54,0,1,13,0,0},        /* IF_FREQ_9 */
+        {0,64,0,0,1,0,0},        /* CHANN_OVERRIDE_AGC_GAIN */
+        {0,64,1,0,4,0,7},        /* CHANN_AGC_GAIN */
+        {0,65,0,0,7,0,0},        /* CORR0_DETECT_EN */
+        {0,66,0,0,7,0,0},        /* CORR1_DETECT_EN */
+        {0,67,0,0,7,0,0},        /* CORR2_DETECT_EN */
+        {0,68,0,0,7,0,0},        /* CORR3_DETECT_EN */
+        {0,69,0,0,7,0,0},        /* CORR4_DETECT_EN */
+        {0,70,0,0,7,0,0},        /* CORR5_DETECT_EN */
+        {0,71,0,0,7,0,0},        /* CORR6_DETECT_EN */
+        {0,72,0,0,7,0,0},        /* CORR7_DETECT_EN */
+        {0,73,0,0,1,0,0},        /* CORR_SAME_PEAKS_OPTION_SF6 */
+        {0,73,1,0,1,0,1},        /* CORR_SAME_PEAKS_OPTION_SF7 */
+        {0,73,2,0,1,0,1},        /* CORR_SAME_PEAKS_OPTION_SF8 */
+        {0,73,3,0,1,0,1},        /* CORR_SAME_PEAKS_OPTION_SF9 */
+        {0,73,4,0,1,0,1},        /* CORR_SAME_PEAKS_OPTION_SF10 */
+        {0,73,5,0,1,0,1},        /* CORR_SAME_PEAKS_OPTION_SF11 */
+        {0,73,6,0,1,0,1},        /* CORR_SAME_PEAKS_OPTION_SF12 */
+        {0,74,0,0,4,0,4},        /* CORR_SIG_NOISE_RATIO_SF6 */
+        {0,74,4,0,4,0,4},        /* CORR_SIG_NOISE_RATIO_SF7 */
+        {0,75,0,0,4,0,4},        /* CORR_SIG_NOISE_RATIO_SF8 */
+        {0,75,4,0,4,0,4},        /* CORR_SIG_NOISE_RATIO_SF9 */
+        {0,76,0,0,4,0,4},        /* CORR_SIG_NOISE_RATIO_SF10 */
+        {0,76,4,0,4,0,4},        /* CORR_SIG_NOISE_RATIO_SF11 */
+        {0,77,0,0,4,0,4},        /* CORR_SIG_NOISE_RATIO_SF12 */
+        {0,78,0,0,4,0,4},        /* CORR_NUM_SAME_PEAK */
+        {0,78,4,0,3,0,5},        /* CORR_MAC_GAIN */
+        {0,81,0,0,12,0,0},       /* ADJUST_MODEM_START_OFFSET_RDX4 */
+        {0,83,0,0,12,0,4092},    /* ADJUST_MODEM_START_OFFSET_SF12_RDX4 */
+        {0,85,0,0,8,0,7},        /* DBG_CORR_SELECT_SF */
+        {0,86,0,0,8,0,0},        /* DBG_CORR_SELECT_CHANNEL */
+        {0,87,0,0,8,1,0},        /* DBG_DETECT_CPT */
+        {0,88,0,0,8,1,0},        /* DBG_SYMB_CPT */
+        {0,89,0,0,1,0,1},        /* CHIRP_INVERT_RX */
+        {0,89,1,0,1,0,1},        /* DC_NOTCH_EN */
+        {0,90,0,0,1,0,0},        /* IMPLICIT_CRC_EN */
+        {0,90,1,0,3,0,0},        /* IMPLICIT_CODING_RATE */
+        {0,91,0,0,8,0,0},        /* IMPLICIT_PAYLOAD_LENGHT */
+        {0,92,0,0,8,0,29},       /* FREQ_TO_TIME_INVERT */
+        {0,93,0,0,6,0,9},        /* FREQ_TO_TIME_DRIFT */
+        {0,94,0,0,2,0,2},        /* PAYLOAD_FINE_TIMING_GAIN */
+        {0,94,2,0,2,0,1},        /* PREAMBLE_FINE_TIMING_GAIN */
+        {0,94,4,0,2,0,0},        /* TRACKING_INTEGRAL */
+        {0,95,0,0,4,0,1},        /* FRAME_SYNCH_PEAK1_POS */
+        {0,95,4,0,4,0,2},        /* FRAME_SYNCH_PEAK2_POS */
+        {0,96,0,0,16,0,10},      /* PREAMBLE_SYMB1_NB */
+        {0,98,0,0,1,0,1},        /* FRAME_SYNCH_GAIN */
+        {0,98,1,0,1,0,1},        /* SYNCH_DETECT_TH */
+        {0,99,0,0,4,0,8},        /* LLR_SCALE */
+        {0,99,4,0,2,0,2},        /* SNR_AVG_CST */
+        {0,100,0,0,7,0,0},       /* PPM_OFFSET */
+        {0,101,0,0,8,0,255},     /* MAX_PAYLOAD_LEN */
+        {0,102,0,0,1,0,1},        /* ONLY_CRC_EN */
+        {0,103,0,0,8,0,0},        /* ZERO_PAD */
+        {0,104,0,0,4,0,8},        /* DEC_GAIN_OFFSET */
+        {0,104,4,0,4,0,7},        /* CHAN_GAIN_OFFSET */
+        {0,105,1,0,1,0,1},        /* FORCE_HOST_RADIO_CTRL */
+        {0,105,2,0,1,0,1},        /* FORCE_HOST_FE_CTRL */
+        {0,105,3,0,1,0,1},        /* FORCE_DEC_FILTER_GAIN */
+        {0,106,0,0,1,0,1},        /* MCU_RST_0 */
+        {0,106,1,0,1,0,1},        /* MCU_RST_1 */
+        {0,106,2,0,1,0,0},        /* MCU_SELECT_MUX_0 */
+        {0,106,3,0,1,0,0},        /* MCU_SELECT_MUX_1 */
+        {0,106,4,0,1,1,0},        /* MCU_CORRUPTION_DETECTED_0 */
+        {0,106,5,0,1,1,0},        /* MCU_CORRUPTION_DETECTED_1 */
+        {0,106,6,0,1,0,0},        /* MCU_SELECT_EDGE_0 */
+        {0,106,7,0,1,0,0},        /* MCU_SELECT_EDGE_1 */
+        {0,107,0,0,8,0,1},        /* CHANN_SELECT_RSSI */
+        {0,108,0,0,8,0,32},       /* RSSI_BB_DEFAULT_VALUE */
+        {0,109,0,0,8,0,100},      /* RSSI_DEC_DEFAULT_VALUE */
+        {0,110,0,0,8,0,100},      /* RSSI_CHANN_DEFAULT_VALUE */
+        {0,111,0,0,5,0,7},        /* RSSI_BB_FILTER_ALPHA */
+        {0,112,0,0,5,0,5},        /* RSSI_DEC_FILTER_ALPHA */
+        {0,113,0,0,5,0,8},        /* RSSI_CHANN_FILTER_ALPHA */
+        {0,114,0,0,6,0,0},        /* IQ_MISMATCH_A_AMP_COEFF */
+        {0,115,0,0,6,0,0},        /* IQ_MISMATCH_A_PHI_COEFF */
+        {0,116,0,0,6,0,0},        /* IQ_MISMATCH_B_AMP_COEFF */
+        {0,116,6,0,1,0,0},        /* IQ_MISMATCH_B_SEL_I */
+        {0,117,0,0,6,0,0},        /* IQ_MISMATCH_B_PHI_COEFF */
+        {1,33,0,0,1,0,0},         /* TX_TRIG_IMMEDIATE */
+        {1,33,1,0,1,0,0},         /* TX_TRIG_DELAYED */
+        {1,33,2,0,1,0,0},         /* TX_TRIG_GPS */
+        {1,34,0,0,16,0,0},        /* TX_START_DELAY */
+        {1,36,0,0,4,0,1},        /* TX_FRAME_SYNCH_PEAK1_POS */
+        {1,36,4,0,4,0,2},        /* TX_FRAME_SYNCH_PEAK2_POS */
+        {1,37,0,0,3,0,0},        /* TX_RAMP_DURATION */
+        {1,39,0,1,8,0,0},        /* TX_OFFSET_I */
+        {1,40,0,1,8,0,0},        /* TX_OFFSET_Q */
+        {1,41,0,0,1,0,0},        /* TX_MODE */
+        {1,41,1,0,4,0,0},        /* TX_ZERO_PAD */
+        {1,41,5,0,1,0,0},        /* TX_EDGE_SELECT */
+        {1,41,6,0,1,0,0},        /* TX_EDGE_SELECT_TOP */
+        {1,42,0,0,2,0,0},        /* TX_GAIN */
+        {1,42,2,0,3,0,5},        /* TX_CHIRP_LOW_PASS */
+        {1,42,5,0,2,0,0},        /* TX_FCC_WIDEBAND */
+        {1,42,7,0,1,0,1},        /* TX_SWAP_IQ */
+        {1,43,0,0,1,0,0},        /* MBWSSF_IMPLICIT_HEADER */
+        {1,43,1,0,1,0,0},        /* MBWSSF_IMPLICIT_CRC_EN */
+        {1,43,2,0,3,0,0},        /* MBWSSF_IMPLICIT_CODING_RATE */
+        {1,44,0,0,8,0,0},        /* MBWSSF_IMPLICIT_PAYLOAD_LENGHT */
+        {1,45,0,0,1,0,1},        /* MBWSSF_AGC_FREEZE_ON_DETECT */
+        {1,46,0,0,4,0,1},        /* MBWSSF_FRAME_SYNCH_PEAK1_POS */
+        {1,46,4,0,4,0,2},        /* MBWSSF_FRAME_SYNCH_PEAK2_POS */
+        {1,47,0,0,16,0,10},      /* MBWSSF_PREAMBLE_SYMB1_NB */
+        {1,49,0,0,1,0,1},        /* MBWSSF_FRAME_SYNCH_GAIN */
+        {1,49,1,0,1,0,1},        /* MBWSSF_SYNCH_DETECT_TH */
+        {1,50,0,0,8,0,10},       /* MBWSSF_DETECT_MIN_SINGLE_PEAK */
+        {1,51,0,0,3,0,3},        /* MBWSSF_DETECT_TRIG_SAME_PEAK_NB */
+        {1,52,0,0,8,0,29},       /* MBWSSF_FREQ_TO_TIME_INVERT */
+        {1,53,0,0,6,0,36},       /* MBWSSF_FREQ_TO_TIME_DRIFT */
+        {1,54,0,0,12,0,0},       /* MBWSSF_PPM_CORRECTION */
+        {1,56,0,0,2,0,2},        /* MBWSSF_PAYLOAD_FINE_TIMING_GAIN */
+        {1,56,2,0,2,0,1},        /* MBWSSF_PREAMBLE_FINE_TIMING_GAIN */
+        {1,56,4,0,2,0,0},        /* MBWSSF_TRACKING_INTEGRAL */
+        {1,57,0,0,8,0,0},        /* MBWSSF_ZERO_PAD */
+        {1,58,0,0,2,0,0},        /* MBWSSF_MODEM_BW */
+        {1,58,2,0,1,0,0},        /* MBWSSF_RADIO_SELECT */
+        {1,58,3,0,1,0,1},        /* MBWSSF_RX_CHIRP_INVERT */
+        {1,59,0,0,4,0,8},        /* MBWSSF_LLR_SCALE */
+        {1,59,4,0,2,0,3},        /* MBWSSF_SNR_AVG_CST */
+        {1,59,6,0,1,0,0},        /* MBWSSF_PPM_OFFSET */
+        {1,60,0,0,4,0,7},        /* MBWSSF_RATE_SF */
+        {1,60,4,0,1,0,1},        /* MBWSSF_ONLY_CRC_EN */
+        {1,61,0,0,8,0,255},      /* MBWSSF_MAX_PAYLOAD_LEN */
+        {1,62,0,0,8,1,128},      /* TX_STATUS */
+        {1,63,0,0,3,0,0},        /* FSK_CH_BW_EXPO */
+        {1,63,3,0,3,0,0},        /* FSK_RSSI_LENGTH */
+        {1,63,6,0,1,0,0},        /* FSK_RX_INVERT */
+        {1,63,7,0,1,0,0},        /* FSK_PKT_MODE */
+        {1,64,0,0,3,0,0},        /* FSK_PSIZE */
+        {1,64,3,0,1,0,0},        /* FSK_CRC_EN */
+        {1,64,4,0,2,0,0},        /* FSK_DCFREE_ENC */
+        {1,64,6,0,1,0,0},        /* FSK_CRC_IBM */
+        {1,65,0,0,5,0,0},        /* FSK_ERROR_OSR_TOL */
+        {1,65,7,0,1,0,0},        /* FSK_RADIO_SELECT */
+        {1,66,0,0,16,0,0},       /* FSK_BR_RATIO */
+        {1,68,0,0,32,0,0},       /* FSK_REF_PATTERN_LSB */
+        {1,72,0,0,32,0,0},       /* FSK_REF_PATTERN_MSB */
+        {1,76,0,0,8,0,0},        /* FSK_PKT_LENGTH */
+        {1,77,0,0,1,0,1},        /* FSK_TX_GAUSSIAN_EN */
+        {1,77,1,0,2,0,0},        /* FSK_TX_GAUSSIAN_SELECT_BT */
+        {1,77,3,0,1,0,1},        /* FSK_TX_PATTERN_EN */
+        {1,77,4,0,1,0,0},        /* FSK_TX_PREAMBLE_SEQ */
+        {1,77,5,0,3,0,0},        /* FSK_TX_PSIZE */
+        {1,80,0,0,8,0,0},        /* FSK_NODE_ADRS */
+        {1,81,0,0,8,0,0},        /* FSK_BROADCAST */
+        {1,82,0,0,1,0,1},        /* FSK_AUTO_AFC_ON */
+        {1,83,0,0,10,0,0},       /* FSK_PATTERN_TIMEOUT_CFG */
+        {2,33,0,0,8,0,0},        /* SPI_RADIO_A__DATA */
+        {2,34,0,0,8,1,0},        /* SPI_RADIO_A__DATA_READBACK */
+        {2,35,0,0,8,0,0},        /* SPI_RADIO_A__ADDR */
+        {2,37,0,0,1,0,0},        /* SPI_RADIO_A__CS */
+        {2,38,0,0,8,0,0},        /* SPI_RADIO_B__DATA */
+        {2,39,0,0,8,1,0},        /* SPI_RADIO_B__DATA_READBACK */
+        {2,40,0,0,8,0,0},        /* SPI_RADIO_B__ADDR */
+        {2,42,0,0,1,0,0},        /* SPI_RADIO_B__CS */
+        {2,43,0,0,1,0,0},        /* RADIO_A_EN */
+        {2,43,1,0,1,0,0},        /* RADIO_B_EN */
+        {2,43,2,0,1,0,1},        /* RADIO_RST */
+        {2,43,3,0,1,0,0},        /* LNA_A_EN */
+        {2,43,4,0,1,0,0},        /* PA_A_EN */
+        {2,43,5,0,1,0,0},        /* LNA_B_EN */
+        {2,43,6,0,1,0,0},        /* PA_B_EN */
+        {2,44,0,0,2,0,0},        /* PA_GAIN */
+        {2,45,0,0,4,0,2},        /* LNA_A_CTRL_LUT */
+        {2,45,4,0,4,0,4},        /* PA_A_CTRL_LUT */
+        {2,46,0,0,4,0,2},        /* LNA_B_CTRL_LUT */
+        {2,46,4,0,4,0,4},        /* PA_B_CTRL_LUT */
+        {2,47,0,0,5,0,0},        /* CAPTURE_SOURCE */
+        {2,47,5,0,1,0,0},        /* CAPTURE_START */
+        {2,47,6,0,1,0,0},        /* CAPTURE_FORCE_TRIGGER */
+        {2,47,7,0,1,0,0},        /* CAPTURE_WRAP */
+        {2,48,0,0,16,0,0},       /* CAPTURE_PERIOD */
+        {2,51,0,0,8,1,0},        /* MODEM_STATUS */
+        {2,52,0,0,8,1,0},        /* VALID_HEADER_COUNTER_0 */
+        {2,54,0,0,8,1,0},        /* VALID_PACKET_COUNTER_0 */
+        {2,56,0,0,8,1,0},        /* VALID_HEADER_COUNTER_MBWSSF */
+        {2,57,0,0,8,1,0},        /* VALID_HEADER_COUNTER_FSK */
+        {2,58,0,0,8,1,0},        /* VALID_PACKET_COUNTER_MBWSSF */
+        {2,59,0,0,8,1,0},        /* VALID_PACKET_COUNTER_FSK */
+        {2,60,0,0,8,1,0},        /* CHANN_RSSI */
+        {2,61,0,0,8,1,0},        /* BB_RSSI */
+        {2,62,0,0,8,1,0},        /* DEC_RSSI */
+        {2,63,0,0,8,1,0},        /* DBG_MCU_DATA */
+        {2,64,0,0,8,1,0},        /* DBG_ARB_MCU_RAM_DATA */
+        {2,65,0,0,8,1,0},        /* DBG_AGC_MCU_RAM_DATA */
+        {2,66,0,0,16,1,0},       /* NEXT_PACKET_CNT */
+        {2,68,0,0,16,1,0},       /* ADDR_CAPTURE_COUNT */
+        {2,70,0,0,32,1,0},       /* TIMESTAMP */
+        {2,74,0,0,4,1,0},        /* DBG_CHANN0_GAIN */
+        {2,74,4,0,4,1,0},        /* DBG_CHANN1_GAIN */
+        {2,75,0,0,4,1,0},        /* DBG_CHANN2_GAIN */
+        {2,75,4,0,4,1,0},        /* DBG_CHANN3_GAIN */
+        {2,76,0,0,4,1,0},        /* DBG_CHANN4_GAIN */
+        {2,76,4,0,4,1,0},        /* DBG_CHANN5_GAIN */
+        {2,77,0,0,4,1,0},        /* DBG_CHANN6_GAIN */
+        {2,77,4,0,4,1,0},        /* DBG_CHANN7_GAIN */
+        {2,78,0,0,4,1,0},        /* DBG_DEC_FILT_GAIN */
+        {2,79,0,0,3,1,0},        /* SPI_DATA_FIFO_PTR */
+        {2,79,3,0,3,1,0},        /* PACKET_DATA_FIFO_PTR */
+        {2,80,0,0,8,0,0},        /* DBG_ARB_MCU_RAM_ADDR */
+        {2,81,0,0,8,0,0},        /* DBG_AGC_MCU_RAM_ADDR */
+        {2,82,0,0,1,0,0},        /* SPI_MASTER_CHIP_SELECT_POLARITY */
+        {2,82,1,0,1,0,0},        /* SPI_MASTER_CPOL */
+        {2,82,2,0,1,0,0},        /* SPI_MASTER_CPHA */
+        {2,83,0,0,1,0,0},        /* SIG_GEN_ANALYSER_MUX_SEL */
+        {2,84,0,0,1,0,0},        /* SIG_GEN_EN */
+        {2,84,1,0,1,0,0},        /* SIG_ANALYSER_EN */
+        {2,84,2,0,2,0,0},        /* SIG_ANALYSER_AVG_LEN */
+        {2,84,4,0,3,0,0},        /* SIG_ANALYSER_PRECISION */
+        {2,84,7,0,1,1,0},        /* SIG_ANALYSER_VALID_OUT */
+        {2,85,0,0,8,0,0},        /* SIG_GEN_FREQ */
+        {2,86,0,0,8,0,0},        /* SIG_ANALYSER_FREQ */
+        {2,87,0,0,8,1,0},        /* SIG_ANALYSER_I_OUT */
+        {2,88,0,0,8,1,0},        /* SIG_ANALYSER_Q_OUT */
+        {2,89,0,0,1,0,0},        /* GPS_EN */
+        {2,89,1,0,1,0,1},        /* GPS_POL */
+        {2,90,0,1,8,0,0},        /* SW_TEST_REG1 */
+        {2,91,2,1,6,0,0},        /* SW_TEST_REG2 */
+        {2,92,0,1,16,0,0},       /* SW_TEST_REG3 */
+        {2,94,0,0,4,1,0},        /* DATA_MNGT_STATUS */
+        {2,95,0,0,5,1,0},        /* DATA_MNGT_CPT_FRAME_ALLOCATED */
+        {2,96,0,0,5,1,0},        /* DATA_MNGT_CPT_FRAME_FINISHED */
+        {2,97,0,0,5,1,0},        /* DATA_MNGT_CPT_FRAME_READEN */
+        {1,33,0,0,8,0,0}         /* TX_TRIG_ALL (alias) */
+    };
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- COMPILE-TIME ACCESSORS ----------------------------------------------- */
+
+/**
+@struct lgw_reg_desc
+@brief Descriptor of one register, folded into constants
+*/
+template <uint16_t register_id>
+struct lgw_reg_desc {
+    static_assert(register_id < LGW_TOTALREGS, "register number out of defined range");
+    static constexpr int8_t  page  = lgw_reg_map::table[register_id].page;
+    static constexpr uint8_t addr  = lgw_reg_map::table[register_id].addr;
+    static constexpr uint8_t offs  = lgw_reg_map::table[register_id].offs;
+    static constexpr uint8_t leng  = lgw_reg_map::table[register_id].leng;
+    static constexpr bool    sign  = lgw_reg_map::table[register_id].sign;
+    static constexpr bool    rdon  = lgw_reg_map::table[register_id].rdon;
+    static constexpr bool    field = ((offs + leng) <= 8) && (leng < 8);   /* part of a byte */
+    static constexpr uint8_t size  = ((offs + leng) <= 8) ? 1 : ((leng + 7) / 8);
+    static constexpr uint8_t mask  = field ? (uint8_t)(((1u << leng) - 1) << offs) : 0xFF;
+};
+
+/**
+@brief LoRa concentrator register write, resolved at compile time
+@param reg_value signed value to write to the register (for u32, use cast)
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+
+Same result as lgw_reg_w(register_id, reg_value), writing a read-only
+register does not compile.
+*/
+template <uint16_t register_id>
+inline int lgw_reg_write(int32_t reg_value) {
+    typedef lgw_reg_desc<register_id> d;
+    static_assert(d::rdon == false, "trying to write a read-only register");
+    static_assert((register_id != LGW_PAGE_REG) && (register_id != LGW_SOFT_RESET), "use lgw_reg_w for paging and reset");
+    static_assert(d::field || (d::offs == 0), "register size and offset are not supported");
+    if (d::field) {
+        return lgw_reg_w_field(d::page, d::addr, d::mask, (uint8_t)(reg_value << d::offs) & d::mask);
+    } else {
+        return lgw_reg_w_bytes(d::page, d::addr, d::size, (uint32_t)reg_value);
+    }
+}
+
+/**
+@brief LoRa concentrator register read, resolved at compile time
+@param reg_value pointer to a variable where to write register read value
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+template <uint16_t register_id>
+inline int lgw_reg_read(int32_t *reg_value) {
+    typedef lgw_reg_desc<register_id> d;
+    static_assert(d::field || (d::offs == 0), "register size and offset are not supported");
+    uint32_t u = 0;
+    int reg_stat;
+
+    reg_stat = lgw_reg_r_bytes(d::page, d::addr, d::size, &u);
+    if (d::field) {
+        u = (u & d::mask) >> d::offs;
+    }
+    if (d::sign) {
+        *reg_value = (int32_t)(u << (32 - d::leng)) >> (32 - d::leng); /* sign extension */
+    } else {
+        *reg_value = (int32_t)u; /* unsigned value -> return 'as is' */
+    }
+    return reg_stat;
+}
+
 #endif
 
 /* --- EOF ------------------------------------------------------------------ */
@@ -12,6 +12,8 @@ Description:
     Single-byte read/write and burst read/write.
     Does not handle pagination.
     Could be used with multiple SPI ports in parallel (explicit file descriptor)
+    The bus access itself is delegated to a backend (ESP32 SPI peripheral,
+    in-memory simulated concentrator, ...) selected before connecting.
 
 License: Revised BSD License, see LICENSE.TXT file include in the project
 Maintainer: Sylvain Miermont
@@ -25,8 +27,8 @@ Maintainer: Sylvain Miermont
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
 #include <stdint.h>        /* C99 types*/
-#include <arduino.h>   
-#include <SPI.h>
+#include <stdbool.h>       /* bool type */
+#include "loragw_port.h"   /* delay */
 
 #include "config.h"    /* library configuration options (dynamically generated) */
 
@@ -37,9 +39,43 @@ Maintainer: Sylvain Miermont
 #define LGW_SPI_ERROR       -1
 #define LGW_BURST_CHUNK     1024
 
+#define LGW_SPI_BURST_BYTEWISE  0   /* one driver call per byte (legacy) */
+#define LGW_SPI_BURST_BULK      1   /* whole burst payload in one driver call */
+
+/* HAL operations a bus session can be opened for, also bus counter buckets */
+#define LGW_SPI_OP_NONE     0   /* outside of any HAL operation */
+#define LGW_SPI_OP_START    1
+#define LGW_SPI_OP_RECEIVE  2
+#define LGW_SPI_OP_SEND     3
+#define LGW_SPI_OP_STATUS   4
+#define LGW_SPI_OP_RADIO    5   /* SX125x access through the SX1301 SPI master */
+#define LGW_SPI_OP_AGC      6   /* AGC firmware reload and handshake of a running concentrator */
+#define LGW_SPI_OP_NB       7
+
 #define LGW_SPI_MUX_MODE0   0x0     /* No FPGA */
 #define LGW_SPI_MUX_TARGET_SX1301   0x0
 
+#define LGW_SPI_TUNE_RATE_NB    9   /* number of clock rates tried by the link qualification */
+
+/*
+Transaction recorder trace format, records are packed back to back:
+  [0..3] timestamp in us (little endian)
+  [4]    bits 0-1: kind (LGW_SPI_REC_xxx), bit 2: burst, bit 3: data truncated,
+         bits 4-7: mux target
+  [5]    register address, or HAL operation for session records
+  [6..7] transfer size in bytes (little endian)
+  [8..]  data, size bytes, or LGW_SPI_REC_TRUNC_SIZE bytes if truncated
+*/
+#define LGW_SPI_REC_WRITE           0
+#define LGW_SPI_REC_READ            1
+#define LGW_SPI_REC_SESSION_BEGIN   2
+#define LGW_SPI_REC_SESSION_END     3
+#define LGW_SPI_REC_KIND_MASK       0x03
+#define LGW_SPI_REC_BURST           0x04
+#define LGW_SPI_REC_TRUNC           0x08
+#define LGW_SPI_REC_HEADER_SIZE     8
+#define LGW_SPI_REC_TRUNC_SIZE      64  /* bytes kept of bursts larger than a quarter of the ring */
+
 #define LORA_DEFAULT_SPI           SPI
 #define LORA_DEFAULT_SPI_FREQUENCY 8E6 
 #define LORA_DEFAULT_SS_PIN        4
@@ -48,17 +84,115 @@ Maintainer: Sylvain Miermont
 #define LORA_DEFAULT_MISO_PIN      19
 #define LORA_DEFAULT_MOSI_PIN      23
 
+#define LGW_SPI_HOST_DEFAULT    0   /* LORA_DEFAULT_SPI on its default pins */
+#define LGW_SPI_HOST_ALT        1   /* second SPI host (HSPI on the ESP32), on its own default pins */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct lgw_spi_port_s
+@brief Where a concentrator is wired, a NULL port means the LORA_DEFAULT_xxx wiring
+*/
+struct lgw_spi_port_s {
+    uint8_t     host;   /*!> SPI host the concentrator is on (LGW_SPI_HOST_xxx) */
+    int8_t      ss;     /*!> chip select pin */
+    int8_t      reset;  /*!> reset pin, -1 if not wired */
+};
+
+/**
+@struct lgw_spi_backend_s
+@brief Bus access functions of a SPI backend, same semantic as lgw_spi_* functions
+*/
+struct lgw_spi_backend_s {
+    const char  *name;  /*!> backend name, for debug messages */
+    int (*open)(void **spi_target_ptr, const struct lgw_spi_port_s *port);
+    int (*close)(void *spi_target);
+    int (*bus_acquire)(void *spi_target);   /*!> hold the bus until bus_release, NULL if not supported */
+    int (*bus_release)(void *spi_target);
+    int (*w)(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t data);
+    int (*r)(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data);
+    int (*wb)(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size);
+    int (*rb)(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size);
+    int (*set_speed)(void *spi_target, uint32_t speed); /*!> change the SPI clock, NULL if not supported */
+};
+
+/**
+@struct lgw_spi_session_stats_s
+@brief Bus session figures for one kind of HAL operation
+*/
+struct lgw_spi_session_stats_s {
+    uint32_t    nb_session;     /*!> number of sessions opened for that operation */
+    uint32_t    nb_transaction; /*!> SPI transactions issued inside those sessions */
+    uint32_t    last_duration;  /*!> duration of the last session, in us */
+    uint32_t    last_saved;     /*!> bus acquire/release time saved by the last session, in us */
+    uint32_t    total_saved;    /*!> bus acquire/release time saved by all sessions, in us */
+};
+
+/**
+@struct lgw_spi_bus_stats_s
+@brief Bus usage of one kind of HAL operation
+*/
+struct lgw_spi_bus_stats_s {
+    uint32_t    nb_transaction; /*!> number of SPI transactions */
+    uint32_t    bytes;          /*!> data bytes moved (address bytes excluded) */
+    uint32_t    cs_low_time;    /*!> time spent inside transactions, in us */
+    uint32_t    nb_page_switch; /*!> number of register page changes */
+};
+
+/**
+@struct lgw_spi_tune_s
+@brief Result of the SPI link qualification
+*/
+struct lgw_spi_tune_s {
+    uint8_t     nb_rate;                            /*!> number of clock rates tested */
+    uint32_t    speed[LGW_SPI_TUNE_RATE_NB];        /*!> tested clock rates, in Hz */
+    uint32_t    bit_errors[LGW_SPI_TUNE_RATE_NB];   /*!> bit errors seen at each clock rate */
+    uint32_t    bits_tested;                        /*!> number of bits checked at each clock rate */
+    uint32_t    selected;                           /*!> clock rate kept, in Hz */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC VARIABLES ----------------------------------------------------- */
+
+#ifdef ARDUINO
+extern const struct lgw_spi_backend_s lgw_spi_backend_native;  /* ESP32 SPI peripheral */
+#endif
+extern const struct lgw_spi_backend_s lgw_spi_backend_sim;     /* in-memory simulated SX1301 */
+
+/* -------------------------------------------------------------------------- */
+/* --- INTERNAL SHARED FUNCTIONS -------------------------------------------- */
+
+void lgw_spi_count_page_switch(void *spi_target);
 
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
 
+/**
+@brief Select the backend used by the next lgw_spi_open calls
+@param backend pointer to the backend function table
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR), error if a target is opened
+*/
+int lgw_spi_set_backend(const struct lgw_spi_backend_s *backend);
+
 /**
 @brief LoRa concentrator SPI setup (configure I/O and peripherals)
 @param spi_target_ptr pointer on a generic pointer to SPI target (implementation dependant)
 @return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
 */
 
-int lgw_spi_open(SPIClass **spi_target);
+int lgw_spi_open(void **spi_target_ptr);
+
+/**
+@brief LoRa concentrator SPI setup for a concentrator that is not on the default wiring
+@param spi_target_ptr pointer on a generic pointer to SPI target (implementation dependant)
+@param port host and pins of the concentrator, NULL for the default wiring
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+
+Each opened target is independent, several concentrators can be opened on
+separate chip selects or SPI hosts.
+*/
+int lgw_spi_open_port(void **spi_target_ptr, const struct lgw_spi_port_s *port);
 
 /**
 @brief LoRa concentrator SPI close
@@ -66,7 +200,98 @@ int lgw_spi_open(SPIClass **spi_target);
 @return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
 */
 
-int lgw_spi_close(SPIClass *spi_target);
+int lgw_spi_close(void *spi_target);
+
+/**
+@brief Select how lgw_spi_wb and lgw_spi_rb move the burst payload
+@param mode LGW_SPI_BURST_BULK (default) or LGW_SPI_BURST_BYTEWISE
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+*/
+int lgw_spi_set_burst_mode(uint8_t mode);
+
+/**
+@brief Enable or disable bus sessions (enabled by default)
+@param enable if false, every transaction acquires and releases the bus, sessions are only counted
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+*/
+int lgw_spi_set_session_mode(bool enable);
+
+/**
+@brief Open a bus session: the bus is acquired on the first transaction and held until lgw_spi_session_end
+@param op HAL operation the session is accounted to (LGW_SPI_OP_xxx)
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+
+Sessions can be nested, only the outermost one is accounted in the session
+figures. Bus counters go to the innermost one.
+*/
+int lgw_spi_session_begin(uint8_t op);
+
+/**
+@brief Close the current bus session and release the bus
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+*/
+int lgw_spi_session_end(void);
+
+/**
+@brief Get the bus session figures of a HAL operation
+@param op HAL operation (LGW_SPI_OP_xxx)
+@param stats pointer to the structure receiving the figures
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+*/
+int lgw_spi_get_session_stats(uint8_t op, struct lgw_spi_session_stats_s *stats);
+
+/**
+@brief Change the SPI clock of an opened target
+@param spi_target generic pointer to SPI target (implementation dependant)
+@param speed SPI clock, in Hz
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR), error if the backend has a fixed clock
+*/
+int lgw_spi_set_speed(void *spi_target, uint32_t speed);
+
+/**
+@brief Get the bus counters of a HAL operation
+@param op HAL operation (LGW_SPI_OP_xxx), transactions are accounted to the innermost session
+@param stats pointer to the structure receiving the counters
+@param clear if true, counters of that operation are reset after being copied
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+*/
+int lgw_spi_get_bus_stats(uint8_t op, struct lgw_spi_bus_stats_s *stats, bool clear);
+
+/**
+@brief Get the bus counters of a HAL operation on one opened target
+@param spi_target generic pointer to SPI target (implementation dependant)
+@param op HAL operation (LGW_SPI_OP_xxx), transactions are accounted to the innermost session
+@param stats pointer to the structure receiving the counters, since the target was opened
+@param clear if true, counters of that operation and target are reset after being copied
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR), error if the target is not opened
+
+lgw_spi_get_bus_stats sums all the targets.
+*/
+int lgw_spi_get_target_bus_stats(void *spi_target, uint8_t op, struct lgw_spi_bus_stats_s *stats, bool clear);
+
+/**
+@brief Start recording every lgw_spi_* call in a ring buffer, oldest records are dropped when full
+@param buf memory used for the ring buffer, owned by the caller until lgw_spi_rec_stop
+@param size size of buf in bytes
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+*/
+int lgw_spi_rec_start(uint8_t *buf, uint32_t size);
+
+/**
+@brief Stop recording, the recorded trace can still be dumped
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+*/
+int lgw_spi_rec_stop(void);
+
+/**
+@brief Copy the recorded trace, oldest record first
+@param out destination buffer
+@param size size of out in bytes
+@param len pointer receiving the number of bytes copied (whole records only)
+@param nb_dropped pointer receiving the number of records dropped since start, can be NULL
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+*/
+int lgw_spi_rec_dump(uint8_t *out, uint32_t size, uint32_t *len, uint32_t *nb_dropped);
 
 /**
 @brief LoRa concentrator SPI single-byte write
@@ -75,7 +300,7 @@ int lgw_spi_close(SPIClass *spi_target);
 @param data data byte to write
 @return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
 */
-int lgw_spi_w(SPIClass *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t data);
+int lgw_spi_w(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t data);
 
 /**
 @brief LoRa concentrator SPI single-byte read
@@ -84,7 +309,7 @@ int lgw_spi_w(SPIClass *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target
 @param data data byte to write
 @return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
 */
-int lgw_spi_r(SPIClass *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data);
+int lgw_spi_r(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data);
 
 /**
 @brief LoRa concentrator SPI burst (multiple-byte) write
@@ -94,7 +319,7 @@ int lgw_spi_r(SPIClass *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target
 @param size size of the transfer, in byte(s)
 @return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
 */
-int lgw_spi_wb(SPIClass *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size);
+int lgw_spi_wb(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size);
 
 /**
 @brief LoRa concentrator SPI burst (multiple-byte) read
@@ -104,7 +329,7 @@ int lgw_spi_wb(SPIClass *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_targe
 @param size size of the transfer, in byte(s)
 @return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
 */
-int lgw_spi_rb(SPIClass *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size);
+int lgw_spi_rb(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size);
 
 #endif
 
@@ -0,0 +1,95 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    SPI backend replaying a trace captured with the transaction recorder.
+    Reads are answered with the recorded data, writes are checked against the
+    recorded ones. Calls the trace does not script are served by a simulated
+    concentrator.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORAGW_SPI_REPLAY_H
+#define _LORAGW_SPI_REPLAY_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>        /* C99 types*/
+#include <stdbool.h>       /* bool type */
+
+#include "loragw_spi.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct lgw_replay_session_s
+@brief A HAL operation as seen in the trace
+*/
+struct lgw_replay_session_s {
+    uint8_t     op;             /*!> HAL operation (LGW_SPI_OP_xxx) */
+    uint32_t    duration;       /*!> recorded duration, in us */
+    uint32_t    nb_transaction; /*!> recorded SPI transactions */
+    uint32_t    bytes;          /*!> recorded data bytes */
+};
+
+/**
+@struct lgw_replay_stats_s
+@brief How well the HAL followed the trace
+*/
+struct lgw_replay_stats_s {
+    uint32_t    matched;        /*!> calls answered from the trace */
+    uint32_t    data_mismatch;  /*!> matched writes whose data differs from the trace */
+    uint32_t    skipped;        /*!> recorded transactions the HAL did not issue */
+    uint32_t    unscripted;     /*!> calls not found in the trace, served by the sim */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC VARIABLES ----------------------------------------------------- */
+
+extern const struct lgw_spi_backend_s lgw_spi_backend_replay;
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Load a trace, the replay starts at its first record
+@param trace pointer to the trace (lgw_spi_rec_dump output), must stay valid during the replay
+@param size size of the trace in bytes
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR), error if the trace is malformed
+*/
+int lgw_replay_load(const uint8_t *trace, uint32_t size);
+
+/**
+@brief Move the replay to the next recorded HAL operation
+@param session pointer to the structure receiving the operation figures
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR), error at the end of the trace
+*/
+int lgw_replay_next_session(struct lgw_replay_session_s *session);
+
+/**
+@brief Suspend the replay: every call is served by the sim and the trace is left untouched
+@param suspend true to suspend, false to resume
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+*/
+int lgw_replay_suspend(bool suspend);
+
+/**
+@brief Get and optionally clear the replay counters
+@param stats pointer to the structure receiving the counters
+@param clear if true, counters are reset after being copied
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+*/
+int lgw_replay_get_stats(struct lgw_replay_stats_s *stats, bool clear);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
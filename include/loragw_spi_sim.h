@@ -0,0 +1,94 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    In-memory SX1301 model used as SPI backend on a host build.
+    Models the register pages, the RX packet FIFO and data buffer, the TX data
+    buffer, the MCU program RAMs, the SX125x radios behind the SPI master and
+    the handshakes of the calibration and AGC firmwares.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORAGW_SPI_SIM_H
+#define _LORAGW_SPI_SIM_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>        /* C99 types*/
+#include <stdbool.h>       /* bool type */
+
+#include "loragw_spi.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LGW_SIM_METADATA_NB     16      /* metadata bytes following each RX payload */
+#define LGW_SIM_TX_BUF_SIZE     256     /* size of the TX data buffer */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct lgw_sim_stats_s
+@brief Bus activity seen by a simulated concentrator
+*/
+struct lgw_sim_stats_s {
+    uint32_t    nb_w;       /*!> number of single-byte writes */
+    uint32_t    nb_r;       /*!> number of single-byte reads */
+    uint32_t    nb_wb;      /*!> number of burst writes */
+    uint32_t    nb_rb;      /*!> number of burst reads */
+    uint32_t    bytes_w;    /*!> data bytes written (address bytes excluded) */
+    uint32_t    bytes_r;    /*!> data bytes read (address bytes excluded) */
+    uint32_t    nb_tx;      /*!> number of TX triggered */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Queue a packet in the RX FIFO of a simulated concentrator
+@param spi_target target returned by lgw_spi_open with the sim backend
+@param payload pointer to the packet payload
+@param size payload size in bytes
+@param metadata pointer to the LGW_SIM_METADATA_NB metadata bytes (if_chain, SF/CR, SNR, RSSI, timestamp, CRC)
+@param status CRC status as reported in the FIFO (5 CRC ok, 7 CRC bad, 1 no CRC)
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+*/
+int lgw_sim_rx_push(void *spi_target, const uint8_t *payload, uint8_t size, const uint8_t *metadata, uint8_t status);
+
+/**
+@brief Get the content of the TX data buffer when the last TX was triggered
+@param spi_target target returned by lgw_spi_open with the sim backend
+@param buf pointer to an array of LGW_SIM_TX_BUF_SIZE bytes
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+*/
+int lgw_sim_tx_last(void *spi_target, uint8_t *buf);
+
+/**
+@brief Set the fastest SPI clock the simulated link carries without errors
+@param spi_target target returned by lgw_spi_open with the sim backend, NULL to set it for targets opened afterwards
+@param max_speed clock in Hz above which read data is corrupted, 0 for no limit
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+*/
+int lgw_sim_set_max_speed(void *spi_target, uint32_t max_speed);
+
+/**
+@brief Get and optionally clear the bus activity counters
+@param spi_target target returned by lgw_spi_open with the sim backend
+@param stats pointer to the structure receiving the counters
+@param clear if true, counters are reset after being copied
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+*/
+int lgw_sim_get_stats(void *spi_target, struct lgw_sim_stats_s *stats, bool clear);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,92 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Linux spidev SPI backend.
+    Writes that only select a register page or set a data port pointer are
+    held back and sent in the same SPI_IOC_MESSAGE as the next access, so a
+    page switch and the access it prepares cost one system call.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORAGW_SPI_SPIDEV_H
+#define _LORAGW_SPI_SPIDEV_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>        /* C99 types*/
+#include <stdbool.h>       /* bool type */
+
+#include "loragw_spi.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LGW_SPIDEV_PATH_DEFAULT "/dev/spidev0.0"    /* device used when opened without a port */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct lgw_spidev_io_s
+@brief System calls used by the spidev backend, same semantic as the libc ones
+*/
+struct lgw_spidev_io_s {
+    int (*open)(const char *path, int flags);
+    int (*close)(int fd);
+    int (*ioctl)(int fd, unsigned long request, void *arg);
+};
+
+/**
+@struct lgw_spidev_stats_s
+@brief System call usage of a spidev target
+*/
+struct lgw_spidev_stats_s {
+    uint32_t    nb_ioctl;       /*!> number of SPI_IOC_MESSAGE calls */
+    uint32_t    nb_frame;       /*!> number of chip select frames carried by those calls */
+    uint32_t    nb_deferred;    /*!> writes sent along with a later access */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC VARIABLES ----------------------------------------------------- */
+
+extern const struct lgw_spi_backend_s lgw_spi_backend_spidev;  /* Linux /dev/spidevB.C */
+extern const struct lgw_spidev_io_s lgw_spidev_io_sim;         /* fake spidev driving a simulated SX1301 */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Replace the system calls of the spidev backend
+@param io pointer to the system call table, NULL for the libc one
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR), error if a target is opened
+*/
+int lgw_spidev_set_io(const struct lgw_spidev_io_s *io);
+
+/**
+@brief Get and optionally clear the system call counters of a target
+@param spi_target target returned by lgw_spi_open with the spidev backend
+@param stats pointer to the structure receiving the counters
+@param clear if true, counters are reset after being copied
+@return status of register operation (LGW_SPI_SUCCESS/LGW_SPI_ERROR)
+*/
+int lgw_spidev_get_stats(void *spi_target, struct lgw_spidev_stats_s *stats, bool clear);
+
+/**
+@brief Get the simulated concentrator behind a target, when running on lgw_spidev_io_sim
+@param spi_target target returned by lgw_spi_open with the spidev backend
+@return target to use with the lgw_sim_* functions, NULL if the target is not simulated
+*/
+void *lgw_spidev_sim_target(void *spi_target);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -25,8 +25,10 @@ Maintainer: Sylvain Miermont
 #endif
 
 #include <stdio.h>  /* printf fprintf */
+#include <stdint.h> /* C99 types */
 #include <time.h>   /* clock_nanosleep */
 
+#include "loragw_aux.h"
 #include "loragw_debug.h"   /* Activar mensajes seriales */
 
 /* -------------------------------------------------------------------------- */
@@ -35,7 +37,7 @@ Maintainer: Sylvain Miermont
     #define DEBUG_MSG(str)                Serial.print(str)
     #define DEBUG_PRINTF(fmt, args...)    {\
                                             memset(debug_msg, 0, sizeof(debug_msg));\
-                                            sprintf(debug_msg,"%s:%d: " fmt, __func__, __LINE__, args);\
+                                            snprintf(debug_msg, sizeof(debug_msg),"%s:%d: " fmt, __func__, __LINE__, args);\
                                             Serial.print(debug_msg);\
                                             }
 #else
@@ -43,6 +45,17 @@ Maintainer: Sylvain Miermont
     #define DEBUG_PRINTF(fmt, args...)
 #endif
 
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+/* CRC-32 of the 16 values of a nibble, reflected polynomial 0xEDB88320 */
+static const uint32_t crc32_nibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -61,4 +74,67 @@ void wait_ms(unsigned long a) {
     return;
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint32_t lgw_crc32(uint32_t crc, const void *data, uint32_t size) {
+    const uint8_t *p = (const uint8_t *)data;
+
+    crc = ~crc;
+    while (size-- > 0) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ crc32_nibble[crc & 0x0F];
+        crc = (crc >> 4) ^ crc32_nibble[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int32_t lgw_lz_unpack(const uint8_t *packed, uint32_t size, int (*sink)(void *arg, const uint8_t *data, uint16_t size), void *arg) {
+    uint8_t win[LGW_LZ_WINDOW]; /* last unpacked bytes, sent to the sink each time it fills up */
+    uint16_t pos = 0;
+    uint32_t i = 0;
+    int32_t out = 0;
+    uint16_t n, dist;
+    uint8_t token;
+
+    if ((packed == NULL) || (sink == NULL)) {
+        return -1;
+    }
+    while (i < size) {
+        token = packed[i++];
+        if ((token & 0x80) == 0) {
+            n = token + 1; /* literals */
+            if ((i + n) > size) {
+                return -1;
+            }
+            dist = 0;
+        } else {
+            n = (token & 0x7F) + 3; /* match */
+            if (i >= size) {
+                return -1;
+            }
+            dist = packed[i++] + 1;
+            if (dist > out) {
+                return -1;
+            }
+        }
+        while (n-- > 0) {
+            /* the source byte is read before its slot can be reused, a full window back is fine */
+            win[pos] = (dist == 0) ? packed[i++] : win[(pos + LGW_LZ_WINDOW - dist) % LGW_LZ_WINDOW];
+            ++out;
+            if (++pos == LGW_LZ_WINDOW) {
+                if (sink(arg, win, pos) != 0) {
+                    return -1;
+                }
+                pos = 0;
+            }
+        }
+    }
+    if ((pos > 0) && (sink(arg, win, pos) != 0)) {
+        return -1;
+    }
+    return out;
+}
+
 /* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,192 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Calibration cache stores and record integrity.
+    A record is one fixed size blob, written whole; its CRC catches a write
+    cut by a reset, the HAL then simply calibrates again.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>        /* C99 types */
+#include <stdbool.h>       /* bool type */
+#include <stdio.h>         /* fopen fread fwrite remove */
+#include <stddef.h>        /* offsetof */
+#include <string.h>        /* memset */
+
+#ifdef ARDUINO
+#include <Preferences.h>   /* NVS key-value storage */
+#endif
+
+#include "loragw_cal.h"
+#include "loragw_aux.h"
+#include "loragw_debug.h"   /* Activar mensajes seriales */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#if DEBUG_HAL == 1
+    #define DEBUG_MSG(str)                Serial.print(str)
+#else
+    #define DEBUG_MSG(str)
+#endif
+#define CHECK_NULL(a)                if(a==NULL){return LGW_CAL_ERROR;}
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define CAL_NVS_NAMESPACE   "lgw"   /* NVS namespace of the records */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static int file_load(const char *key, struct lgw_cal_rec_s *rec) {
+    FILE *f;
+    size_t n;
+
+    CHECK_NULL(key);
+    CHECK_NULL(rec);
+    f = fopen(key, "rb");
+    if (f == NULL) {
+        return LGW_CAL_ERROR; /* no calibration saved yet */
+    }
+    n = fread(rec, 1, sizeof(struct lgw_cal_rec_s), f);
+    fclose(f);
+    return (n == sizeof(struct lgw_cal_rec_s)) ? LGW_CAL_SUCCESS : LGW_CAL_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int file_save(const char *key, const struct lgw_cal_rec_s *rec) {
+    FILE *f;
+    size_t n;
+
+    CHECK_NULL(key);
+    CHECK_NULL(rec);
+    f = fopen(key, "wb");
+    if (f == NULL) {
+        DEBUG_MSG("ERROR: CANNOT CREATE THE CALIBRATION FILE\n");
+        return LGW_CAL_ERROR;
+    }
+    n = fwrite(rec, 1, sizeof(struct lgw_cal_rec_s), f);
+    if ((fclose(f) != 0) || (n != sizeof(struct lgw_cal_rec_s))) {
+        DEBUG_MSG("ERROR: CALIBRATION FILE WRITE FAILED\n");
+        return LGW_CAL_ERROR;
+    }
+    return LGW_CAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int file_erase(const char *key) {
+    CHECK_NULL(key);
+    remove(key);
+    return LGW_CAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+#ifdef ARDUINO
+
+static int nvs_load(const char *key, struct lgw_cal_rec_s *rec) {
+    Preferences prefs;
+    size_t n;
+
+    CHECK_NULL(key);
+    CHECK_NULL(rec);
+    if (prefs.begin(CAL_NVS_NAMESPACE, true) == false) {
+        return LGW_CAL_ERROR; /* namespace not created yet */
+    }
+    n = prefs.getBytes(key, rec, sizeof(struct lgw_cal_rec_s));
+    prefs.end();
+    return (n == sizeof(struct lgw_cal_rec_s)) ? LGW_CAL_SUCCESS : LGW_CAL_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int nvs_save(const char *key, const struct lgw_cal_rec_s *rec) {
+    Preferences prefs;
+    size_t n;
+
+    CHECK_NULL(key);
+    CHECK_NULL(rec);
+    if (prefs.begin(CAL_NVS_NAMESPACE, false) == false) {
+        DEBUG_MSG("ERROR: CANNOT OPEN THE NVS NAMESPACE\n");
+        return LGW_CAL_ERROR;
+    }
+    n = prefs.putBytes(key, rec, sizeof(struct lgw_cal_rec_s));
+    prefs.end();
+    return (n == sizeof(struct lgw_cal_rec_s)) ? LGW_CAL_SUCCESS : LGW_CAL_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int nvs_erase(const char *key) {
+    Preferences prefs;
+
+    CHECK_NULL(key);
+    if (prefs.begin(CAL_NVS_NAMESPACE, false) == false) {
+        return LGW_CAL_ERROR;
+    }
+    prefs.remove(key);
+    prefs.end();
+    return LGW_CAL_SUCCESS;
+}
+
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC VARIABLES ----------------------------------------------------- */
+
+const struct lgw_cal_store_s lgw_cal_store_file = {
+    "file",
+    file_load,
+    file_save,
+    file_erase
+};
+
+#ifdef ARDUINO
+const struct lgw_cal_store_s lgw_cal_store_nvs = {
+    "nvs",
+    nvs_load,
+    nvs_save,
+    nvs_erase
+};
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int lgw_cal_seal(struct lgw_cal_rec_s *rec) {
+    CHECK_NULL(rec);
+    rec->magic = LGW_CAL_MAGIC;
+    rec->version = LGW_CAL_VERSION;
+    rec->crc = lgw_crc32(0, rec, offsetof(struct lgw_cal_rec_s, crc));
+    return LGW_CAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_cal_check(const struct lgw_cal_rec_s *rec) {
+    CHECK_NULL(rec);
+    if ((rec->magic != LGW_CAL_MAGIC) || (rec->version != LGW_CAL_VERSION)) {
+        return LGW_CAL_ERROR;
+    }
+    if (rec->crc != lgw_crc32(0, rec, offsetof(struct lgw_cal_rec_s, crc))) {
+        DEBUG_MSG("WARNING: corrupted calibration record\n");
+        return LGW_CAL_ERROR;
+    }
+    return LGW_CAL_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -22,6 +22,7 @@ Maintainer: Sylvain Miermont
 #include <stdio.h>      /* printf fprintf */
 #include <string.h>     /* memcpy */
 #include <math.h>       /* pow, cell */
+#include <time.h>       /* time */
 
 
 #include "loragw_reg.h"
@@ -29,6 +30,7 @@ Maintainer: Sylvain Miermont
 #include "loragw_aux.h"
 #include "loragw_spi.h"
 #include "loragw_radio.h"
+#include "loragw_cal.h"
 #include "loragw_debug.h"   /* Activar mensajes seriales */
 
 /* -------------------------------------------------------------------------- */
@@ -39,7 +41,7 @@ Maintainer: Sylvain Miermont
     #define DEBUG_MSG(str)                Serial.print(str)
     #define DEBUG_PRINTF(fmt, args...)    {\
                                             memset(debug_msg, 0, sizeof(debug_msg));\
-                                            sprintf(debug_msg,"%s:%d: " fmt, __func__, __LINE__, args);\
+                                            snprintf(debug_msg, sizeof(debug_msg),"%s:%d: " fmt, __func__, __LINE__, args);\
                                             Serial.print(debug_msg);\
                                             }
     #define DEBUG_ARRAY(a,b,c)            {\
@@ -51,7 +53,7 @@ Maintainer: Sylvain Miermont
     #define CHECK_NULL(a)                 {\
                                             if(a==NULL){\
                                                 memset(debug_msg, 0, sizeof(debug_msg));\
-                                                sprintf(debug_msg,"%s:%d: ERROR: NULL POINTER AS ARGUMENT\n", __FUNCTION__, __LINE__);\
+                                                snprintf(debug_msg, sizeof(debug_msg),"%s:%d: ERROR: NULL POINTER AS ARGUMENT\n", __FUNCTION__, __LINE__);\
                                                 Serial.print(debug_msg);\
                                                 return LGW_HAL_ERROR;}\
                                           }
@@ -77,12 +79,21 @@ Maintainer: Sylvain Miermont
 #define FW_VERSION_CAL      2 /* Expected version of calibration firmware */
 #define FW_VERSION_AGC      4 /* Expected version of AGC firmware */
 #define FW_VERSION_ARB      1 /* Expected version of arbiter firmware */
+#define FW_CHUNK_SIZE       256 /* firmware readback chunk, the only stack used by the check */
 
 #define TX_METADATA_NB      16
 #define RX_METADATA_NB      16
 
 #define AGC_CMD_WAIT        16
 #define AGC_CMD_ABORT       17
+#define AGC_CMD_SETTLE_US   1000 /* time for the AGC firmware to see AGC_CMD_WAIT before the command, the former fixed wait */
+#define AGC_ACK_TIMEOUT_US  1000 /* longest wait for a command acknowledge, the former fixed wait */
+#define AGC_BOOT_TIMEOUT_US 10000 /* longest wait for the AGC firmware ready status after its release */
+
+#define XTAL_READY_TIMEOUT_MS   500     /* radios power up, the former fixed wait */
+#define CAL_TIMEOUT_MS          3000    /* calibration measured between 2.1 and 2.2 sec, because 1 TX only */
+#define CAL_POLL_MS             10      /* calibration status polling period */
+#define CAL_CLOCK_VALID         1577836800  /* 2020-01-01, earlier times mean the clock was not set */
 
 #define MIN_LORA_PREAMBLE   6
 #define STD_LORA_PREAMBLE   8
@@ -102,54 +113,50 @@ Maintainer: Sylvain Miermont
 
 #define TX_START_DELAY_DEFAULT  1497 /* Calibrated value for 500KHz BW and notch filter disabled */
 
+#define SPI_TUNE_MAX_DEFAULT    20000000    /* fastest SPI clock tried at start, in Hz */
+#define SPI_TUNE_MARGIN         1           /* clock steps kept below the fastest error-free rate */
+
+#define SCRUB_CHUNK             16          /* register addresses checked per lgw_scrub call */
+#define SCRUB_SHARE_DEFAULT     2           /* share of the SPI bus given to the scrubber, in % */
+#define SCRUB_IDLE_MS           1000        /* wait returned by lgw_scrub while disabled */
+
 /* constant arrays defining hardware capability */
 const uint8_t ifmod_config[LGW_IF_CHAIN_NB] = LGW_IFMODEM_CONFIG;
 
+/* the part of the context lgw_reconfigure can change, kept to undo a rejected plan */
+struct if_plan_s {
+    bool        if_enable[LGW_IF_CHAIN_NB];
+    bool        if_rf_chain[LGW_IF_CHAIN_NB];
+    int32_t     if_freq[LGW_IF_CHAIN_NB];
+    uint8_t     lora_multi_sfmask[LGW_MULTI_NB];
+    uint8_t     lora_rx_bw;
+    uint8_t     lora_rx_sf;
+    bool        lora_rx_ppm_offset;
+    uint8_t     fsk_rx_bw;
+    uint32_t    fsk_rx_dr;
+    uint8_t     fsk_sync_word_size;
+    uint64_t    fsk_sync_word;
+};
+
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
-#include "arb_fw.var" /* external definition of the variable */
-#include "agc_fw.var" /* external definition of the variable */
-#include "cal_fw.var" /* external definition of the variable */
+/* packed by util_fw_pack from arb_fw.var, agc_fw.var and cal_fw.var */
+#include "arb_fw_lz.var" /* external definition of the variable */
+#include "agc_fw_lz.var" /* external definition of the variable */
+#include "cal_fw_lz.var" /* external definition of the variable */
 
 /*
-The following static variables are the configuration set that the user can
-modify using rxrf_setconf, rxif_setconf and txgain_setconf functions.
+The concentrator contexts hold the configuration set that the user can modify
+using rxrf_setconf, rxif_setconf and txgain_setconf functions.
 The functions _start and _send then use that set to configure the hardware.
 
 Parameters validity and coherency is verified by the _setconf functions and
 the _start and _send functions assume they are valid.
 */
 
-static bool lgw_is_started=false;
-
-static bool rf_enable[LGW_RF_CHAIN_NB];
-static uint32_t rf_rx_freq[LGW_RF_CHAIN_NB]; /* absolute, in Hz */
-static float rf_rssi_offset[LGW_RF_CHAIN_NB];
-static bool rf_tx_enable[LGW_RF_CHAIN_NB];
-static uint32_t rf_tx_notch_freq[LGW_RF_CHAIN_NB];
-static enum lgw_radio_type_e rf_radio_type[LGW_RF_CHAIN_NB];
-
-static bool if_enable[LGW_IF_CHAIN_NB];
-static bool if_rf_chain[LGW_IF_CHAIN_NB]; /* for each IF, 0 -> radio A, 1 -> radio B */
-static int32_t if_freq[LGW_IF_CHAIN_NB]; /* relative to radio frequency, +/- in Hz */
-
-static uint8_t lora_multi_sfmask[LGW_MULTI_NB]; /* enables SF for LoRa 'multi' modems */
-
-static uint8_t lora_rx_bw; /* bandwidth setting for LoRa standalone modem */
-static uint8_t lora_rx_sf; /* spreading factor setting for LoRa standalone modem */
-static bool lora_rx_ppm_offset;
-
-static uint8_t fsk_rx_bw; /* bandwidth setting of FSK modem */
-static uint32_t fsk_rx_dr; /* FSK modem datarate in bauds */
-static uint8_t fsk_sync_word_size = 3; /* default number of bytes for FSK sync word */
-static uint64_t fsk_sync_word= 0xC194C1; /* default FSK sync word (ALIGNED RIGHT, MSbit first) */
-
-static bool lorawan_public = false;
-static uint8_t rf_clkout = 0;
-
-static struct lgw_tx_gain_lut_s txgain_lut = {
+static const struct lgw_tx_gain_lut_s txgain_lut_default = {
     {  {
         .dig_gain = 0,
         .pa_gain = 2,
@@ -167,30 +174,276 @@ static struct lgw_tx_gain_lut_s txgain_lut = {
     .size = 2
     };
 
-/* TX I/Q imbalance coefficients for mixer gain = 8 to 15 */
-static int8_t cal_offset_a_i[8]; /* TX I offset for radio A */
-static int8_t cal_offset_a_q[8]; /* TX Q offset for radio A */
-static int8_t cal_offset_b_i[8]; /* TX I offset for radio B */
-static int8_t cal_offset_b_q[8]; /* TX Q offset for radio B */
+static lgw_ctx_t ctx_default; /*! context of the single-concentrator API */
+static lgw_ctx_t *ctx = &ctx_default; /*! context the lgw_* functions work on */
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
 
-int load_firmware(uint8_t target, uint8_t *firmware, uint16_t size);
+int load_firmware(uint8_t target, const uint8_t *firmware, uint16_t packed_size, uint16_t size, uint32_t crc);
 
 void lgw_constant_adjust(void);
 
+void lgw_freq_to_time_drift(void);
+
+static lgw_ctx_t *ctx_select(lgw_ctx_t *c);
+static void ctx_yield(void);
+static void ctx_sleep(uint32_t ms);
+static bool conf_locked(void);
+static int rxrf_conf(uint8_t rf_chain, struct lgw_conf_rxrf_s conf);
+static int rxif_conf(uint8_t if_chain, struct lgw_conf_rxif_s conf);
+static void plan_save(struct if_plan_s *plan);
+static void plan_restore(const struct if_plan_s *plan);
+static int txgain_conf(struct lgw_tx_gain_lut_s *conf);
+static int agc_wait_status(uint8_t status, uint32_t timeout_us, uint32_t *latency);
+static int agc_command(uint8_t cmd, uint8_t status);
+static uint8_t agc_radio_select(void);
+static int agc_init(uint8_t radio_select);
+
+static uint32_t cal_clock(void);
+static void cal_key(struct lgw_cal_rec_s *rec, uint8_t cal_cmd);
+static bool cal_restore(uint8_t cal_cmd);
+static void cal_save(uint8_t cal_cmd, uint8_t cal_status);
+static uint8_t cal_command(void);
+static int calibrate_begin(uint8_t cal_cmd);
+static bool calibrate_done(void);
+static int calibrate_end(uint8_t cal_cmd);
+
 int32_t lgw_sf_getval(int x);
 int32_t lgw_bw_getval(int x);
 
+static void multi_setup(uint8_t mask);
+static int lora_std_setup(void);
+static void fsk_setup(void);
+static int start_connect(void);
+static int start_xtal(void);
+static int start_radio(void);
+static int start_calib(void);
+static int start_modem(void);
+static int start_firmware(void);
+static int start_agc(void);
+static int start_step(uint32_t *wait_ms);
+int receive_packets(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data);
+int send_packet(struct lgw_pkt_tx_s pkt_data);
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
-/* size is the firmware size in bytes (not 14b words) */
-int load_firmware(uint8_t target, uint8_t *firmware, uint16_t size) {
+/* the built-in context is set up by the static initialization, before setup() */
+static bool ctx_default_setup(void) {
+    lgw_ctx_init(&ctx_default, NULL);
+    lgw_reg_select(&ctx_default.reg);
+    return true;
+}
+
+static bool ctx_default_ready = ctx_default_setup();
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* only with the register lock held: the lgw_* calls of other tasks wait for
+   the lock and find the built-in context selected again */
+static lgw_ctx_t *ctx_select(lgw_ctx_t *c) {
+    lgw_ctx_t *prev = ctx;
+
+    ctx = (c != NULL) ? c : &ctx_default;
+    lgw_reg_select(&ctx->reg);
+    return prev;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* lgw_reg_yield for a holder that may run on another context: the priority
+   holders get the lock with the built-in context selected, as usual */
+static void ctx_yield(void) {
+    lgw_ctx_t *prev = ctx_select(NULL);
+
+    lgw_reg_yield();
+    ctx_select(prev);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* lgw_reg_sleep with the same selection rule as ctx_yield */
+static void ctx_sleep(uint32_t ms) {
+    lgw_ctx_t *prev = ctx_select(NULL);
+
+    lgw_reg_sleep(ms);
+    ctx_select(prev);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* the configuration is in use from the first start step until lgw_stop */
+static bool conf_locked(void) {
+    return (ctx->is_started == true) || (ctx->start_running == true);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void plan_save(struct if_plan_s *plan) {
+    memcpy(plan->if_enable, ctx->if_enable, sizeof plan->if_enable);
+    memcpy(plan->if_rf_chain, ctx->if_rf_chain, sizeof plan->if_rf_chain);
+    memcpy(plan->if_freq, ctx->if_freq, sizeof plan->if_freq);
+    memcpy(plan->lora_multi_sfmask, ctx->lora_multi_sfmask, sizeof plan->lora_multi_sfmask);
+    plan->lora_rx_bw = ctx->lora_rx_bw;
+    plan->lora_rx_sf = ctx->lora_rx_sf;
+    plan->lora_rx_ppm_offset = ctx->lora_rx_ppm_offset;
+    plan->fsk_rx_bw = ctx->fsk_rx_bw;
+    plan->fsk_rx_dr = ctx->fsk_rx_dr;
+    plan->fsk_sync_word_size = ctx->fsk_sync_word_size;
+    plan->fsk_sync_word = ctx->fsk_sync_word;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void plan_restore(const struct if_plan_s *plan) {
+    memcpy(ctx->if_enable, plan->if_enable, sizeof ctx->if_enable);
+    memcpy(ctx->if_rf_chain, plan->if_rf_chain, sizeof ctx->if_rf_chain);
+    memcpy(ctx->if_freq, plan->if_freq, sizeof ctx->if_freq);
+    memcpy(ctx->lora_multi_sfmask, plan->lora_multi_sfmask, sizeof ctx->lora_multi_sfmask);
+    ctx->lora_rx_bw = plan->lora_rx_bw;
+    ctx->lora_rx_sf = plan->lora_rx_sf;
+    ctx->lora_rx_ppm_offset = plan->lora_rx_ppm_offset;
+    ctx->fsk_rx_bw = plan->fsk_rx_bw;
+    ctx->fsk_rx_dr = plan->fsk_rx_dr;
+    ctx->fsk_sync_word_size = plan->fsk_sync_word_size;
+    ctx->fsk_sync_word = plan->fsk_sync_word;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* poll the AGC firmware status until it reads the expected value, first read right away */
+static int agc_wait_status(uint8_t status, uint32_t timeout_us, uint32_t *latency) {
+    uint32_t t0 = micros();
+    uint32_t dt;
+    int32_t read_val;
+
+    do {
+        lgw_reg_read<LGW_MCU_AGC_STATUS>(&read_val);
+        ++ctx->agc_timing.nb_poll;
+        dt = (uint32_t)(micros() - t0);
+        if (read_val == status) {
+            *latency = dt;
+            return LGW_HAL_SUCCESS;
+        }
+    } while (dt <= timeout_us);
+
+    DEBUG_PRINTF("ERROR: AGC FIRMWARE INITIALIZATION FAILURE, STATUS 0x%02X INSTEAD OF 0x%02X\n", (uint8_t)read_val, status);
+    return LGW_HAL_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/*
+One host command of the AGC firmware init, acknowledged by the status it sets.
+Only a status change is an acknowledge: when the command sets the status that
+is already in place, the firmware gets the former fixed wait before the status
+is checked.
+*/
+static int agc_command(uint8_t cmd, uint8_t status) {
+    uint32_t latency;
+    int32_t read_val;
+
+    lgw_reg_write<LGW_RADIO_SELECT>(AGC_CMD_WAIT); /* start a transaction */
+    delayMicroseconds(AGC_CMD_SETTLE_US);
+    lgw_reg_read<LGW_MCU_AGC_STATUS>(&read_val);
+    ++ctx->agc_timing.nb_poll;
+    lgw_reg_write<LGW_RADIO_SELECT>(cmd);
+    if (read_val == status) {
+        delayMicroseconds(AGC_ACK_TIMEOUT_US);
+        if (agc_wait_status(status, 0, &latency) != LGW_HAL_SUCCESS) {
+            return LGW_HAL_ERROR;
+        }
+        latency += AGC_ACK_TIMEOUT_US;
+    } else if (agc_wait_status(status, AGC_ACK_TIMEOUT_US, &latency) != LGW_HAL_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+    ctx->agc_timing.last = latency;
+    if (latency > ctx->agc_timing.max) {
+        ctx->agc_timing.max = latency;
+    }
+    ++ctx->agc_timing.nb_cmd;
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* IF mapping to radio A/B (per bit, 0=A, 1=B), given to the AGC firmware at the end of its init */
+static uint8_t agc_radio_select(void) {
+    uint8_t radio_select = 0;
+    int i;
+
+    for(i=0; i<LGW_MULTI_NB; ++i) {
+        radio_select += (ctx->if_rf_chain[i] == 1 ? 1 << i : 0); /* transform bool array into binary word */
+    }
+    return radio_select;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/*
+AGC firmware init handshake, from its ready status to RADIO_SELECT given back.
+The firmware takes one command at a time and acknowledges each before it
+looks at RADIO_SELECT again, so commands can not be queued: each one is sent
+as soon as the previous acknowledge is read.
+*/
+static int agc_init(uint8_t radio_select) {
+    int i;
+    uint8_t load_val;
+
+    if (agc_wait_status(0x10, AGC_BOOT_TIMEOUT_US, &ctx->agc_timing.boot) != LGW_HAL_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+
+    /* Update Tx gain LUT and start AGC */
+    for (i = 0; i < ctx->txgain_lut.size; ++i) {
+        load_val = ctx->txgain_lut.lut[i].mix_gain + (16 * ctx->txgain_lut.lut[i].dac_gain) + (64 * ctx->txgain_lut.lut[i].pa_gain);
+        if (agc_command(load_val, 0x30 + i) != LGW_HAL_SUCCESS) {
+            return LGW_HAL_ERROR;
+        }
+    }
+    /* As the AGC fw is waiting for 16 entries, we need to abort the transaction if we get less entries */
+    if (ctx->txgain_lut.size < TX_GAIN_LUT_SIZE_MAX) {
+        if (agc_command(AGC_CMD_ABORT, 0x30) != LGW_HAL_SUCCESS) {
+            return LGW_HAL_ERROR;
+        }
+    }
+
+    /* Load Tx freq MSBs (always 3 if f > 768 for SX1257 or f > 384 for SX1255 */
+    if (agc_command(3, 0x33) != LGW_HAL_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+
+    /* Load chan_select firmware option */
+    if (agc_command(0, 0x30) != LGW_HAL_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+
+    /* End AGC firmware init and check status */
+    DEBUG_MSG("Info: putting back original RADIO_SELECT value\n");
+    return agc_command(radio_select, 0x40); /* Load intended value of RADIO_SELECT */
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* one burst into the MCU program memory per unpacked chunk */
+static int prom_sink(void *arg, const uint8_t *data, uint16_t size) {
+    uint32_t *crc = (uint32_t *)arg;
+
+    *crc = lgw_crc32(*crc, data, size);
+    return (lgw_reg_wb(LGW_MCU_PROM_DATA, (uint8_t *)data, size) == LGW_REG_SUCCESS) ? 0 : -1;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* firmware is packed by util_fw_pack, size is the unpacked size in bytes (not 14b words) and crc its CRC-32 */
+int load_firmware(uint8_t target, const uint8_t *firmware, uint16_t packed_size, uint16_t size, uint32_t crc) {
     int reg_rst;
     int reg_sel;
-    uint8_t fw_check[8192];
+    uint8_t chunk[FW_CHUNK_SIZE];
+    uint32_t crc_written = 0;
+    uint32_t crc_prom = 0;
+    uint16_t done, n;
     int32_t dummy;
     
     /* check parameters */
@@ -220,20 +473,32 @@ int load_firmware(uint8_t target, uint8_t *firmware, uint16_t size) {
 
     /* set mux to access MCU program RAM and set address to 0 */
     lgw_reg_w(reg_sel, 0);
-    lgw_reg_w(LGW_MCU_PROM_ADDR, 0);
+    lgw_reg_write<LGW_MCU_PROM_ADDR>(0);
   
-    /* write the program in one burst */
-    lgw_reg_wb(LGW_MCU_PROM_DATA, firmware, size);
-
-    /* Read back firmware code for check */
-    lgw_reg_r( LGW_MCU_PROM_DATA, &dummy ); /* bug workaround */
-    lgw_reg_rb( LGW_MCU_PROM_DATA, fw_check, size );
-
-    if (memcmp(firmware, fw_check, size) != 0) {
-        printf ("ERROR: Failed to load fw %d\n", (int)target);
+    /* unpack the program straight into the program RAM, the address auto-increments across bursts */
+    if (lgw_lz_unpack(firmware, packed_size, prom_sink, &crc_written) != size) {
+        printf ("ERROR: Failed to unpack fw %d\n", (int)target);
+        return -1;
+    }
+    if (crc_written != crc) {
+        printf ("ERROR: Failed to unpack fw %d, CRC 0x%08X instead of 0x%08X\n", (int)target, crc_written, crc);
         return -1;
     }
 
+    /* Read back firmware code for check, chunk by chunk against the CRC of the image */
+    if (ctx->fw_trusted == false) {
+        lgw_reg_read<LGW_MCU_PROM_DATA>(&dummy); /* bug workaround */
+        for (done = 0; done < size; done += n) {
+            n = ((size - done) < FW_CHUNK_SIZE) ? (size - done) : FW_CHUNK_SIZE;
+            lgw_reg_rb(LGW_MCU_PROM_DATA, chunk, n);
+            crc_prom = lgw_crc32(crc_prom, chunk, n);
+        }
+        if (crc_prom != crc) {
+            printf ("ERROR: Failed to load fw %d, CRC 0x%08X instead of 0x%08X\n", (int)target, crc_prom, crc);
+            return -1;
+        }
+    }
+
     /* give back control of the MCU program ram to the MCU */
     lgw_reg_w(reg_sel, 1);
 
@@ -251,14 +516,14 @@ void lgw_constant_adjust(void) {
     // lgw_reg_w(LGW_RX_EDGE_SELECT,0); /* default 0 */
     // lgw_reg_w(LGW_MBWSSF_MODEM_INVERT_IQ,0); /* default 0 */
     // lgw_reg_w(LGW_DC_NOTCH_EN,1); /* default 1 */
-    lgw_reg_w(LGW_RSSI_BB_FILTER_ALPHA,6); /* default 7 */
-    lgw_reg_w(LGW_RSSI_DEC_FILTER_ALPHA,7); /* default 5 */
-    lgw_reg_w(LGW_RSSI_CHANN_FILTER_ALPHA,7); /* default 8 */
-    lgw_reg_w(LGW_RSSI_BB_DEFAULT_VALUE,23); /* default 32 */
-    lgw_reg_w(LGW_RSSI_CHANN_DEFAULT_VALUE,85); /* default 100 */
-    lgw_reg_w(LGW_RSSI_DEC_DEFAULT_VALUE,66); /* default 100 */
-    lgw_reg_w(LGW_DEC_GAIN_OFFSET,7); /* default 8 */
-    lgw_reg_w(LGW_CHAN_GAIN_OFFSET,6); /* default 7 */
+    lgw_reg_write<LGW_RSSI_BB_FILTER_ALPHA>(6); /* default 7 */
+    lgw_reg_write<LGW_RSSI_DEC_FILTER_ALPHA>(7); /* default 5 */
+    lgw_reg_write<LGW_RSSI_CHANN_FILTER_ALPHA>(7); /* default 8 */
+    lgw_reg_write<LGW_RSSI_BB_DEFAULT_VALUE>(23); /* default 32 */
+    lgw_reg_write<LGW_RSSI_CHANN_DEFAULT_VALUE>(85); /* default 100 */
+    lgw_reg_write<LGW_RSSI_DEC_DEFAULT_VALUE>(66); /* default 100 */
+    lgw_reg_write<LGW_DEC_GAIN_OFFSET>(7); /* default 8 */
+    lgw_reg_write<LGW_CHAN_GAIN_OFFSET>(6); /* default 7 */
 
     /* Correlator setup */
     // lgw_reg_w(LGW_CORR_DETECT_EN,126); /* default 126 */
@@ -285,13 +550,13 @@ void lgw_constant_adjust(void) {
     // lgw_reg_w(LGW_FRAME_SYNCH_GAIN,1); /* default 1 */
     // lgw_reg_w(LGW_SYNCH_DETECT_TH,1); /* default 1 */
     // lgw_reg_w(LGW_ZERO_PAD,0); /* default 0 */
-    lgw_reg_w(LGW_SNR_AVG_CST,3); /* default 2 */
-    if (lorawan_public) { /* LoRa network */
-        lgw_reg_w(LGW_FRAME_SYNCH_PEAK1_POS,3); /* default 1 */
-        lgw_reg_w(LGW_FRAME_SYNCH_PEAK2_POS,4); /* default 2 */
+    lgw_reg_write<LGW_SNR_AVG_CST>(3); /* default 2 */
+    if (ctx->lorawan_public) { /* LoRa network */
+        lgw_reg_write<LGW_FRAME_SYNCH_PEAK1_POS>(3); /* default 1 */
+        lgw_reg_write<LGW_FRAME_SYNCH_PEAK2_POS>(4); /* default 2 */
     } else { /* private network */
-        lgw_reg_w(LGW_FRAME_SYNCH_PEAK1_POS,1); /* default 1 */
-        lgw_reg_w(LGW_FRAME_SYNCH_PEAK2_POS,2); /* default 2 */
+        lgw_reg_write<LGW_FRAME_SYNCH_PEAK1_POS>(1); /* default 1 */
+        lgw_reg_write<LGW_FRAME_SYNCH_PEAK2_POS>(2); /* default 2 */
     }
 
     // lgw_reg_w(LGW_PREAMBLE_FINE_TIMING_GAIN,1); /* default 1 */
@@ -308,12 +573,12 @@ void lgw_constant_adjust(void) {
     // lgw_reg_w(LGW_MBWSSF_FRAME_SYNCH_GAIN,1); /* default 1 */
     // lgw_reg_w(LGW_MBWSSF_SYNCH_DETECT_TH,1); /* default 1 */
     // lgw_reg_w(LGW_MBWSSF_ZERO_PAD,0); /* default 0 */
-    if (lorawan_public) { /* LoRa network */
-        lgw_reg_w(LGW_MBWSSF_FRAME_SYNCH_PEAK1_POS,3); /* default 1 */
-        lgw_reg_w(LGW_MBWSSF_FRAME_SYNCH_PEAK2_POS,4); /* default 2 */
+    if (ctx->lorawan_public) { /* LoRa network */
+        lgw_reg_write<LGW_MBWSSF_FRAME_SYNCH_PEAK1_POS>(3); /* default 1 */
+        lgw_reg_write<LGW_MBWSSF_FRAME_SYNCH_PEAK2_POS>(4); /* default 2 */
     } else {
-        lgw_reg_w(LGW_MBWSSF_FRAME_SYNCH_PEAK1_POS,1); /* default 1 */
-        lgw_reg_w(LGW_MBWSSF_FRAME_SYNCH_PEAK2_POS,2); /* default 2 */
+        lgw_reg_write<LGW_MBWSSF_FRAME_SYNCH_PEAK1_POS>(1); /* default 1 */
+        lgw_reg_write<LGW_MBWSSF_FRAME_SYNCH_PEAK2_POS>(2); /* default 2 */
     }
     // lgw_reg_w(LGW_MBWSSF_ONLY_CRC_EN,1); /* default 1 */
     // lgw_reg_w(LGW_MBWSSF_PAYLOAD_FINE_TIMING_GAIN,2); /* default 2 */
@@ -322,44 +587,44 @@ void lgw_constant_adjust(void) {
     // lgw_reg_w(LGW_MBWSSF_AGC_FREEZE_ON_DETECT,1); /* default 1 */
 
     /* Improvement of reference clock frequency error tolerance */
-    lgw_reg_w(LGW_ADJUST_MODEM_START_OFFSET_RDX4, 1); /* default 0 */
-    lgw_reg_w(LGW_ADJUST_MODEM_START_OFFSET_SF12_RDX4, 4094); /* default 4092 */
-    lgw_reg_w(LGW_CORR_MAC_GAIN, 7); /* default 5 */
+    lgw_reg_write<LGW_ADJUST_MODEM_START_OFFSET_RDX4>(1); /* default 0 */
+    lgw_reg_write<LGW_ADJUST_MODEM_START_OFFSET_SF12_RDX4>(4094); /* default 4092 */
+    lgw_reg_write<LGW_CORR_MAC_GAIN>(7); /* default 5 */
 
     /* FSK datapath setup */
-    lgw_reg_w(LGW_FSK_RX_INVERT,1); /* default 0 */
-    lgw_reg_w(LGW_FSK_MODEM_INVERT_IQ,1); /* default 0 */
+    lgw_reg_write<LGW_FSK_RX_INVERT>(1); /* default 0 */
+    lgw_reg_write<LGW_FSK_MODEM_INVERT_IQ>(1); /* default 0 */
 
     /* FSK demodulator setup */
-    lgw_reg_w(LGW_FSK_RSSI_LENGTH,4); /* default 0 */
-    lgw_reg_w(LGW_FSK_PKT_MODE,1); /* variable length, default 0 */
-    lgw_reg_w(LGW_FSK_CRC_EN,1); /* default 0 */
-    lgw_reg_w(LGW_FSK_DCFREE_ENC,2); /* default 0 */
+    lgw_reg_write<LGW_FSK_RSSI_LENGTH>(4); /* default 0 */
+    lgw_reg_write<LGW_FSK_PKT_MODE>(1); /* variable length, default 0 */
+    lgw_reg_write<LGW_FSK_CRC_EN>(1); /* default 0 */
+    lgw_reg_write<LGW_FSK_DCFREE_ENC>(2); /* default 0 */
     // lgw_reg_w(LGW_FSK_CRC_IBM,0); /* default 0 */
-    lgw_reg_w(LGW_FSK_ERROR_OSR_TOL,10); /* default 0 */
-    lgw_reg_w(LGW_FSK_PKT_LENGTH,255); /* max packet length in variable length mode */
+    lgw_reg_write<LGW_FSK_ERROR_OSR_TOL>(10); /* default 0 */
+    lgw_reg_write<LGW_FSK_PKT_LENGTH>(255); /* max packet length in variable length mode */
     // lgw_reg_w(LGW_FSK_NODE_ADRS,0); /* default 0 */
     // lgw_reg_w(LGW_FSK_BROADCAST,0); /* default 0 */
     // lgw_reg_w(LGW_FSK_AUTO_AFC_ON,0); /* default 0 */
-    lgw_reg_w(LGW_FSK_PATTERN_TIMEOUT_CFG,128); /* sync timeout (allow 8 bytes preamble + 8 bytes sync word, default 0 */
+    lgw_reg_write<LGW_FSK_PATTERN_TIMEOUT_CFG>(128); /* sync timeout (allow 8 bytes preamble + 8 bytes sync word, default 0 */
 
     /* TX general parameters */
-    lgw_reg_w(LGW_TX_START_DELAY, TX_START_DELAY_DEFAULT); /* default 0 */
+    lgw_reg_write<LGW_TX_START_DELAY>(TX_START_DELAY_DEFAULT); /* default 0 */
 
     /* TX LoRa */
     // lgw_reg_w(LGW_TX_MODE,0); /* default 0 */
-    lgw_reg_w(LGW_TX_SWAP_IQ,1); /* "normal" polarity; default 0 */
-    if (lorawan_public) { /* LoRa network */
-        lgw_reg_w(LGW_TX_FRAME_SYNCH_PEAK1_POS,3); /* default 1 */
-        lgw_reg_w(LGW_TX_FRAME_SYNCH_PEAK2_POS,4); /* default 2 */
+    lgw_reg_write<LGW_TX_SWAP_IQ>(1); /* "normal" polarity; default 0 */
+    if (ctx->lorawan_public) { /* LoRa network */
+        lgw_reg_write<LGW_TX_FRAME_SYNCH_PEAK1_POS>(3); /* default 1 */
+        lgw_reg_write<LGW_TX_FRAME_SYNCH_PEAK2_POS>(4); /* default 2 */
     } else { /* Private network */
-        lgw_reg_w(LGW_TX_FRAME_SYNCH_PEAK1_POS,1); /* default 1 */
-        lgw_reg_w(LGW_TX_FRAME_SYNCH_PEAK2_POS,2); /* default 2 */
+        lgw_reg_write<LGW_TX_FRAME_SYNCH_PEAK1_POS>(1); /* default 1 */
+        lgw_reg_write<LGW_TX_FRAME_SYNCH_PEAK2_POS>(2); /* default 2 */
     }
 
     /* TX FSK */
     // lgw_reg_w(LGW_FSK_TX_GAUSSIAN_EN,1); /* default 1 */
-    lgw_reg_w(LGW_FSK_TX_GAUSSIAN_SELECT_BT,2); /* Gaussian filter always on TX, default 0 */
+    lgw_reg_write<LGW_FSK_TX_GAUSSIAN_SELECT_BT>(2); /* Gaussian filter always on TX, default 0 */
     // lgw_reg_w(LGW_FSK_TX_PATTERN_EN,1); /* default 1 */
     // lgw_reg_w(LGW_FSK_TX_PREAMBLE_SEQ,0); /* default 0 */
 
@@ -368,6 +633,21 @@ void lgw_constant_adjust(void) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+/* timing drift compensation of the demodulators, follows the radio A frequency */
+void lgw_freq_to_time_drift(void) {
+    uint32_t x;
+
+    x = 4096000000 / (ctx->rf_rx_freq[0] >> 1); /* dividend: (4*2048*1000000) >> 1, rescaled to avoid 32b overflow */
+    x = ( x > 63 ) ? 63 : x; /* saturation */
+    lgw_reg_write<LGW_FREQ_TO_TIME_DRIFT>(x); /* default 9 */
+
+    x = 4096000000 / (ctx->rf_rx_freq[0] >> 3); /* dividend: (16*2048*1000000) >> 3, rescaled to avoid 32b overflow */
+    x = ( x > 63 ) ? 63 : x; /* saturation */
+    lgw_reg_write<LGW_MBWSSF_FREQ_TO_TIME_DRIFT>(x); /* default 36 */
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int32_t lgw_bw_getval(int x) {
     switch (x) {
         case BW_500KHZ: return 500000;
@@ -422,35 +702,101 @@ uint16_t lgw_get_tx_start_delay(uint8_t bw) {
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
+int lgw_ctx_init(lgw_ctx_t *c, const struct lgw_spi_port_s *port) {
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* any context may be in use by another task, not only the selected one */
+    if ((c->is_started == true) || (c->start_running == true)) {
+        lgw_reg_unlock();
+        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE RESETTING ITS CONTEXT\n");
+        return LGW_HAL_ERROR;
+    }
+    memset(c, 0, sizeof(lgw_ctx_t));
+    lgw_reg_ctx_init(&c->reg, port);
+    c->fsk_sync_word_size = 3; /* default number of bytes for FSK sync word */
+    c->fsk_sync_word = 0xC194C1; /* default FSK sync word (ALIGNED RIGHT, MSbit first) */
+    c->txgain_lut = txgain_lut_default;
+    c->spi_tune_enable = true;
+    c->spi_tune_max = SPI_TUNE_MAX_DEFAULT;
+    c->scrub_share = SCRUB_SHARE_DEFAULT;
+    lgw_reg_unlock();
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+lgw_ctx_t *lgw_ctx_default(void) {
+    return &ctx_default;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_board_setconf(struct lgw_conf_board_s conf) {
 
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+
     /* check if the concentrator is running */
-    if (lgw_is_started == true) {
+    if (conf_locked() == true) {
+        lgw_reg_unlock();
         DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
         return LGW_HAL_ERROR;
     }
 
     /* set internal config according to parameters */
-    lorawan_public = conf.lorawan_public;
-    rf_clkout = conf.clksrc;
+    ctx->lorawan_public = conf.lorawan_public;
+    ctx->rf_clkout = conf.clksrc;
+    lgw_reg_unlock();
 
-    DEBUG_PRINTF("Note: board configuration; lorawan_public:%d, clksrc:%d\n", lorawan_public, rf_clkout);
+    DEBUG_PRINTF("Note: board configuration; lorawan_public:%d, clksrc:%d\n", conf.lorawan_public, conf.clksrc);
 
     return LGW_HAL_SUCCESS;
 }
 
-
-
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_rxrf_setconf(uint8_t rf_chain, struct lgw_conf_rxrf_s conf) {
+int lgw_cal_setconf(struct lgw_conf_cal_s conf) {
+
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
 
     /* check if the concentrator is running */
-    if (lgw_is_started == true) {
+    if (conf_locked() == true) {
+        lgw_reg_unlock();
         DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
         return LGW_HAL_ERROR;
     }
 
+    ctx->cal_conf = conf;
+    lgw_reg_unlock();
+    if (conf.store != NULL) {
+        DEBUG_PRINTF("Note: calibration cache; store:%s, max_age:%u s, max_restore:%u\n", conf.store->name, conf.max_age, conf.max_restore);
+    }
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_cal_invalidate(void) {
+    const char *key;
+    int x;
+
+    lgw_reg_lock();
+    if (ctx->cal_conf.store == NULL) {
+        lgw_reg_unlock();
+        DEBUG_MSG("ERROR: NO CALIBRATION CACHE CONFIGURED\n");
+        return LGW_HAL_ERROR;
+    }
+    key = (ctx->cal_conf.key != NULL) ? ctx->cal_conf.key : LGW_CAL_KEY_DEFAULT;
+    x = ctx->cal_conf.store->erase(key);
+    lgw_reg_unlock();
+    return (x == LGW_CAL_SUCCESS) ? LGW_HAL_SUCCESS : LGW_HAL_ERROR;
+}
+
+
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* check a radio configuration and commit it to the context */
+static int rxrf_conf(uint8_t rf_chain, struct lgw_conf_rxrf_s conf) {
+
     /* check input range (segfault prevention) */
     if (rf_chain >= LGW_RF_CHAIN_NB) {
         DEBUG_MSG("ERROR: NOT A VALID RF_CHAIN NUMBER\n");
@@ -466,30 +812,44 @@ int lgw_rxrf_setconf(uint8_t rf_chain, struct lgw_conf_rxrf_s conf) {
     /* check if TX notch filter frequency is supported */
 
     /* set internal config according to parameters */
-    rf_enable[rf_chain] = conf.enable;
-    rf_rx_freq[rf_chain] = conf.freq_hz;
-    rf_rssi_offset[rf_chain] = conf.rssi_offset;
-    rf_radio_type[rf_chain] = conf.type;
-    rf_tx_enable[rf_chain] = conf.tx_enable;
-    rf_tx_notch_freq[rf_chain] = conf.tx_notch_freq;
+    ctx->rf_enable[rf_chain] = conf.enable;
+    ctx->rf_rx_freq[rf_chain] = conf.freq_hz;
+    ctx->rf_rssi_offset[rf_chain] = conf.rssi_offset;
+    ctx->rf_radio_type[rf_chain] = conf.type;
+    ctx->rf_tx_enable[rf_chain] = conf.tx_enable;
+    ctx->rf_tx_notch_freq[rf_chain] = conf.tx_notch_freq;
 
-    DEBUG_PRINTF("Note: rf_chain %d configuration; en:%d freq:%d rssi_offset:%f radio_type:%d tx_enable:%d tx_notch_freq:%u\n", rf_chain, rf_enable[rf_chain], rf_rx_freq[rf_chain], rf_rssi_offset[rf_chain], rf_radio_type[rf_chain], rf_tx_enable[rf_chain], rf_tx_notch_freq[rf_chain]);
+    DEBUG_PRINTF("Note: rf_chain %d configuration; en:%d freq:%d rssi_offset:%f radio_type:%d tx_enable:%d tx_notch_freq:%u\n", rf_chain, ctx->rf_enable[rf_chain], ctx->rf_rx_freq[rf_chain], ctx->rf_rssi_offset[rf_chain], ctx->rf_radio_type[rf_chain], ctx->rf_tx_enable[rf_chain], ctx->rf_tx_notch_freq[rf_chain]);
 
     return LGW_HAL_SUCCESS;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s conf) {
-    int32_t bw_hz;
-    uint32_t rf_rx_bandwidth;
+int lgw_rxrf_setconf(uint8_t rf_chain, struct lgw_conf_rxrf_s conf) {
+    int x;
+
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
 
     /* check if the concentrator is running */
-    if (lgw_is_started == true) {
+    if (conf_locked() == true) {
+        lgw_reg_unlock();
         DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
         return LGW_HAL_ERROR;
     }
 
+    x = rxrf_conf(rf_chain, conf);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* check an IF chain configuration and commit it to the context, shared with lgw_reconfigure */
+static int rxif_conf(uint8_t if_chain, struct lgw_conf_rxif_s conf) {
+    int32_t bw_hz;
+    uint32_t rf_rx_bandwidth;
+
     /* check input range (segfault prevention) */
     if (if_chain >= LGW_IF_CHAIN_NB) {
         DEBUG_PRINTF("ERROR: %d NOT A VALID IF_CHAIN NUMBER\n", if_chain);
@@ -498,8 +858,8 @@ int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s conf) {
 
     /* if chain is disabled, don't care about most parameters */
     if (conf.enable == false) {
-        if_enable[if_chain] = false;
-        if_freq[if_chain] = 0;
+        ctx->if_enable[if_chain] = false;
+        ctx->if_freq[if_chain] = 0;
         DEBUG_PRINTF("Note: if_chain %d disabled\n", if_chain);
         return LGW_HAL_SUCCESS;
     }
@@ -555,18 +915,18 @@ int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s conf) {
                 return LGW_HAL_ERROR;
             }
             /* set internal configuration  */
-            if_enable[if_chain] = conf.enable;
-            if_rf_chain[if_chain] = conf.rf_chain;
-            if_freq[if_chain] = conf.freq_hz;
-            lora_rx_bw = conf.bandwidth;
-            lora_rx_sf = (uint8_t)(DR_LORA_MULTI & conf.datarate); /* filter SF out of the 7-12 range */
+            ctx->if_enable[if_chain] = conf.enable;
+            ctx->if_rf_chain[if_chain] = conf.rf_chain;
+            ctx->if_freq[if_chain] = conf.freq_hz;
+            ctx->lora_rx_bw = conf.bandwidth;
+            ctx->lora_rx_sf = (uint8_t)(DR_LORA_MULTI & conf.datarate); /* filter SF out of the 7-12 range */
             if (SET_PPM_ON(conf.bandwidth, conf.datarate)) {
-                lora_rx_ppm_offset = true;
+                ctx->lora_rx_ppm_offset = true;
             } else {
-                lora_rx_ppm_offset = false;
+                ctx->lora_rx_ppm_offset = false;
             }
 
-            DEBUG_PRINTF("Note: LoRa 'std' if_chain %d configuration; en:%d freq:%d bw:%d dr:%d\n", if_chain, if_enable[if_chain], if_freq[if_chain], lora_rx_bw, lora_rx_sf);
+            DEBUG_PRINTF("Note: LoRa 'std' if_chain %d configuration; en:%d freq:%d bw:%d dr:%d\n", if_chain, ctx->if_enable[if_chain], ctx->if_freq[if_chain], ctx->lora_rx_bw, ctx->lora_rx_sf);
             break;
 
         case IF_LORA_MULTI:
@@ -587,12 +947,12 @@ int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s conf) {
                 return LGW_HAL_ERROR;
             }
             /* set internal configuration  */
-            if_enable[if_chain] = conf.enable;
-            if_rf_chain[if_chain] = conf.rf_chain;
-            if_freq[if_chain] = conf.freq_hz;
-            lora_multi_sfmask[if_chain] = (uint8_t)(DR_LORA_MULTI & conf.datarate); /* filter SF out of the 7-12 range */
+            ctx->if_enable[if_chain] = conf.enable;
+            ctx->if_rf_chain[if_chain] = conf.rf_chain;
+            ctx->if_freq[if_chain] = conf.freq_hz;
+            ctx->lora_multi_sfmask[if_chain] = (uint8_t)(DR_LORA_MULTI & conf.datarate); /* filter SF out of the 7-12 range */
 
-            DEBUG_PRINTF("Note: LoRa 'multi' if_chain %d configuration; en:%d freq:%d SF_mask:0x%02x\n", if_chain, if_enable[if_chain], if_freq[if_chain], lora_multi_sfmask[if_chain]);
+            DEBUG_PRINTF("Note: LoRa 'multi' if_chain %d configuration; en:%d freq:%d SF_mask:0x%02x\n", if_chain, ctx->if_enable[if_chain], ctx->if_freq[if_chain], ctx->lora_multi_sfmask[if_chain]);
             break;
 
         case IF_FSK_STD:
@@ -613,16 +973,16 @@ int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s conf) {
                 return LGW_HAL_ERROR;
             }
             /* set internal configuration  */
-            if_enable[if_chain] = conf.enable;
-            if_rf_chain[if_chain] = conf.rf_chain;
-            if_freq[if_chain] = conf.freq_hz;
-            fsk_rx_bw = conf.bandwidth;
-            fsk_rx_dr = conf.datarate;
+            ctx->if_enable[if_chain] = conf.enable;
+            ctx->if_rf_chain[if_chain] = conf.rf_chain;
+            ctx->if_freq[if_chain] = conf.freq_hz;
+            ctx->fsk_rx_bw = conf.bandwidth;
+            ctx->fsk_rx_dr = conf.datarate;
             if (conf.sync_word > 0) {
-                fsk_sync_word_size = conf.sync_word_size;
-                fsk_sync_word = conf.sync_word;
+                ctx->fsk_sync_word_size = conf.sync_word_size;
+                ctx->fsk_sync_word = conf.sync_word;
             }
-            DEBUG_PRINTF("Note: FSK if_chain %d configuration; en:%d freq:%d bw:%d dr:%d (%d real dr) sync:0x%0*llX\n", if_chain, if_enable[if_chain], if_freq[if_chain], fsk_rx_bw, fsk_rx_dr, LGW_XTAL_FREQU/(LGW_XTAL_FREQU/fsk_rx_dr), 2*fsk_sync_word_size, fsk_sync_word);
+            DEBUG_PRINTF("Note: FSK if_chain %d configuration; en:%d freq:%d bw:%d dr:%d (%d real dr) sync:0x%0*llX\n", if_chain, ctx->if_enable[if_chain], ctx->if_freq[if_chain], ctx->fsk_rx_bw, ctx->fsk_rx_dr, LGW_XTAL_FREQU/(LGW_XTAL_FREQU/ctx->fsk_rx_dr), 2*ctx->fsk_sync_word_size, ctx->fsk_sync_word);
             break;
 
         default:
@@ -635,7 +995,27 @@ int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s conf) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_txgain_setconf(struct lgw_tx_gain_lut_s *conf) {
+int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s conf) {
+    int x;
+
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+
+    /* check if the concentrator is running */
+    if (conf_locked() == true) {
+        lgw_reg_unlock();
+        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+        return LGW_HAL_ERROR;
+    }
+
+    x = rxif_conf(if_chain, conf);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* check a TX gain LUT and commit it to the context, shared with lgw_txgain_update */
+static int txgain_conf(struct lgw_tx_gain_lut_s *conf) {
     int i;
 
     /* Check LUT size */
@@ -644,9 +1024,9 @@ int lgw_txgain_setconf(struct lgw_tx_gain_lut_s *conf) {
         return LGW_HAL_ERROR;
     }
 
-    txgain_lut.size = conf->size;
+    ctx->txgain_lut.size = conf->size;
 
-    for (i = 0; i < txgain_lut.size; i++) {
+    for (i = 0; i < ctx->txgain_lut.size; i++) {
         /* Check gain range */
         if (conf->lut[i].dig_gain > 3) {
             DEBUG_MSG("ERROR: TX gain LUT: SX1301 digital gain must be between 0 and 3\n");
@@ -669,11 +1049,11 @@ int lgw_txgain_setconf(struct lgw_tx_gain_lut_s *conf) {
         }
 
         /* Set internal LUT */
-        txgain_lut.lut[i].dig_gain = conf->lut[i].dig_gain;
-        txgain_lut.lut[i].dac_gain = conf->lut[i].dac_gain;
-        txgain_lut.lut[i].mix_gain = conf->lut[i].mix_gain;
-        txgain_lut.lut[i].pa_gain  = conf->lut[i].pa_gain;
-        txgain_lut.lut[i].rf_power = conf->lut[i].rf_power;
+        ctx->txgain_lut.lut[i].dig_gain = conf->lut[i].dig_gain;
+        ctx->txgain_lut.lut[i].dac_gain = conf->lut[i].dac_gain;
+        ctx->txgain_lut.lut[i].mix_gain = conf->lut[i].mix_gain;
+        ctx->txgain_lut.lut[i].pa_gain  = conf->lut[i].pa_gain;
+        ctx->txgain_lut.lut[i].rf_power = conf->lut[i].rf_power;
     }
 
     return LGW_HAL_SUCCESS;
@@ -681,23 +1061,595 @@ int lgw_txgain_setconf(struct lgw_tx_gain_lut_s *conf) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_start(void) {
-    int i, err;
-    int reg_stat;
-    unsigned x;
-    uint8_t radio_select;
+int lgw_txgain_setconf(struct lgw_tx_gain_lut_s *conf) {
+    int x;
+
+    CHECK_NULL(conf);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    x = txgain_conf(conf);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_txgain_update(struct lgw_tx_gain_lut_s *conf) {
+    struct lgw_tx_gain_lut_s old;
+    uint8_t tx_status;
+    unsigned long t0;
+    int x;
+
+    CHECK_NULL(conf);
+
+    lgw_reg_lock();
+    if (ctx->is_started == false) {
+        lgw_reg_unlock();
+        DEBUG_MSG("ERROR: CONCENTRATOR IS NOT RUNNING, USE LGW_TXGAIN_SETCONF\n");
+        return LGW_HAL_ERROR;
+    }
+    lgw_status(TX_STATUS, &tx_status);
+    if (tx_status != TX_FREE) {
+        lgw_reg_unlock();
+        DEBUG_MSG("ERROR: A PACKET IS SCHEDULED OR EMITTED, TX GAIN LUT NOT UPDATED\n");
+        return LGW_HAL_ERROR;
+    }
+    old = ctx->txgain_lut;
+    if (txgain_conf(conf) != LGW_HAL_SUCCESS) {
+        ctx->txgain_lut = old; /* setconf stops at the first bad entry */
+        lgw_reg_unlock();
+        return LGW_HAL_ERROR;
+    }
+
+    /* the AGC firmware only reads its LUT at init, reload it and run the handshake again */
+    t0 = micros();
+    memset(&ctx->agc_timing, 0, sizeof ctx->agc_timing);
+    lgw_spi_session_begin(LGW_SPI_OP_AGC);
+    x = LGW_HAL_ERROR;
+    if (load_firmware(MCU_AGC, agc_firmware_lz, AGC_FW_LZ_BYTE, MCU_AGC_FW_BYTE, AGC_FW_CRC) == 0) {
+        lgw_reg_write<LGW_RADIO_SELECT>(0); /* MUST not be = to 1 or 2 at firmware init */
+        lgw_reg_write<LGW_MCU_RST_1>(0);
+        x = agc_init(agc_radio_select());
+    }
+    lgw_spi_session_end();
+    ctx->agc_timing.total = (uint32_t)(micros() - t0);
+    if (x != LGW_HAL_SUCCESS) {
+        /* no AGC firmware, nothing may run until a restart */
+        ctx->txgain_lut = old;
+        lgw_stop();
+        lgw_reg_unlock();
+        DEBUG_MSG("ERROR: AGC FIRMWARE NOT RUNNING, THE CONCENTRATOR MUST BE RESTARTED\n");
+        return LGW_HAL_ERROR;
+    }
+    lgw_reg_unlock();
+    DEBUG_PRINTF("Note: TX gain LUT updated in %u us, %u AGC commands, slowest acknowledge %u us\n", ctx->agc_timing.total, ctx->agc_timing.nb_cmd, ctx->agc_timing.max);
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_rxrf_retune(uint8_t rf_chain, uint32_t freq_hz) {
+    int32_t read_val;
+    uint32_t shift;
+
+    /* check input parameters */
+    if (rf_chain >= LGW_RF_CHAIN_NB) {
+        DEBUG_MSG("ERROR: NOT A VALID RF_CHAIN NUMBER\n");
+        return LGW_HAL_ERROR;
+    }
+    if (freq_hz == 0) {
+        DEBUG_MSG("ERROR: INVALID RF FREQUENCY\n");
+        return LGW_HAL_ERROR;
+    }
+
+    lgw_reg_lock();
+    if ((ctx->is_started == false) || (ctx->rf_enable[rf_chain] == false)) {
+        lgw_reg_unlock();
+        DEBUG_MSG("ERROR: RF CHAIN IS NOT RUNNING, USE LGW_RXRF_SETCONF\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* the IQ and DC calibration of the start only holds close to its frequency */
+    shift = (freq_hz > ctx->rf_cal_freq[rf_chain]) ? (freq_hz - ctx->rf_cal_freq[rf_chain]) : (ctx->rf_cal_freq[rf_chain] - freq_hz);
+    if (shift > LGW_RF_RETUNE_MAX) {
+        lgw_reg_unlock();
+        DEBUG_PRINTF("ERROR: RETUNE OF %u HZ, OVER LGW_RF_RETUNE_MAX, RESTART NEEDED\n", shift);
+        return LGW_HAL_ERROR;
+    }
+
+    /* relocking the PLL would cut a packet on the air */
+    if (ctx->rf_tx_enable[rf_chain] == true) {
+        lgw_reg_read<LGW_TX_STATUS>(&read_val);
+        if ((read_val & 0x10) != 0) { /* bit 4 @1: TX programmed */
+            lgw_reg_unlock();
+            DEBUG_MSG("ERROR: TX PROGRAMMED, RETRY THE RETUNE ONCE IT IS DONE\n");
+            return LGW_HAL_ERROR;
+        }
+    }
+
+    /* only the radio PLL bytes that change are written */
+    if (sx125x_set_rx_freq(rf_chain, ctx->rf_radio_type[rf_chain], freq_hz) != LGW_REG_SUCCESS) {
+        lgw_reg_unlock();
+        DEBUG_PRINTF("ERROR: FAIL TO RETUNE RF CHAIN %d\n", rf_chain);
+        return LGW_HAL_ERROR;
+    }
+    ctx->rf_rx_freq[rf_chain] = freq_hz;
+    if (rf_chain == 0) {
+        lgw_freq_to_time_drift();
+    }
+
+    /* the stored calibration was made for the old frequency */
+    if (ctx->cal_conf.store != NULL) {
+        lgw_cal_invalidate();
+    }
+    lgw_reg_unlock();
+
+    DEBUG_PRINTF("Note: rf_chain %d retuned to %u Hz\n", rf_chain, freq_hz);
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_reconfigure(const struct lgw_conf_rxrf_s *rfconf, const struct lgw_conf_rxif_s *ifconf) {
+    struct if_plan_s old;
+    unsigned long t0;
+    uint8_t multi_mask = 0;
+    bool std_changed, fsk_changed;
+    int i;
+
+    CHECK_NULL(ifconf);
+
+    lgw_reg_lock();
+    if (ctx->is_started == false) {
+        lgw_reg_unlock();
+        DEBUG_MSG("ERROR: CONCENTRATOR IS NOT RUNNING, USE LGW_RXIF_SETCONF\n");
+        return LGW_HAL_ERROR;
+    }
+    t0 = micros();
+
+    /* the radios were calibrated and the AGC firmware initialized for these, they can not change */
+    for (i = 0; (rfconf != NULL) && (i < LGW_RF_CHAIN_NB); ++i) {
+        if ((rfconf[i].enable != ctx->rf_enable[i]) || (rfconf[i].type != ctx->rf_radio_type[i]) || (rfconf[i].tx_enable != ctx->rf_tx_enable[i])) {
+            lgw_reg_unlock();
+            DEBUG_PRINTF("ERROR: RF CHAIN %d CHANGE NEEDS A RESTART\n", i);
+            return LGW_HAL_ERROR;
+        }
+        if ((rfconf[i].enable == true) && (rfconf[i].freq_hz != ctx->rf_rx_freq[i])) {
+            lgw_reg_unlock();
+            DEBUG_PRINTF("ERROR: RF CHAIN %d MOVED, USE LGW_RXRF_RETUNE FOR SMALL MOVES, ELSE RESTART\n", i);
+            return LGW_HAL_ERROR;
+        }
+    }
+
+    /* check the whole plan against the context before any register is touched */
+    plan_save(&old);
+    for (i = 0; i < LGW_IF_CHAIN_NB; ++i) {
+        if (rxif_conf(i, ifconf[i]) != LGW_HAL_SUCCESS) {
+            plan_restore(&old);
+            lgw_reg_unlock();
+            DEBUG_PRINTF("ERROR: INVALID CONFIGURATION FOR IF CHAIN %d, CHANNEL PLAN UNCHANGED\n", i);
+            return LGW_HAL_ERROR;
+        }
+    }
+    /* the radio of each 'multi' channel was given to the AGC firmware at start, in RADIO_SELECT */
+    if (memcmp(ctx->if_rf_chain, old.if_rf_chain, LGW_MULTI_NB * sizeof ctx->if_rf_chain[0]) != 0) {
+        plan_restore(&old);
+        lgw_reg_unlock();
+        DEBUG_MSG("ERROR: LORA MULTI CHANNEL RADIO CHANGE NEEDS A RESTART\n");
+        return LGW_HAL_ERROR;
+    }
+    for (i = 0; (rfconf != NULL) && (i < LGW_RF_CHAIN_NB); ++i) {
+        ctx->rf_rssi_offset[i] = rfconf[i].rssi_offset; /* only used to process packets */
+        ctx->rf_tx_notch_freq[i] = rfconf[i].tx_notch_freq;
+    }
+
+    /* only the channels that changed are written, the others keep receiving */
+    for (i = 0; i < LGW_MULTI_NB; ++i) {
+        if ((ctx->if_freq[i] != old.if_freq[i]) || (ctx->if_enable[i] != old.if_enable[i]) || (ctx->lora_multi_sfmask[i] != old.lora_multi_sfmask[i])) {
+            multi_mask |= (1 << i);
+        }
+    }
+    multi_setup(multi_mask);
+
+    std_changed = (ctx->if_enable[8] != old.if_enable[8]) || (ctx->if_freq[8] != old.if_freq[8]) || (ctx->if_rf_chain[8] != old.if_rf_chain[8]);
+    std_changed |= (ctx->if_enable[8] == true) && ((ctx->lora_rx_bw != old.lora_rx_bw) || (ctx->lora_rx_sf != old.lora_rx_sf) || (ctx->lora_rx_ppm_offset != old.lora_rx_ppm_offset));
+    if (std_changed == true) {
+        lgw_reg_write<LGW_MBWSSF_MODEM_ENABLE>(0); /* no packet demodulated with half of the new settings */
+        if (lora_std_setup() != LGW_HAL_SUCCESS) {
+            lgw_reg_unlock();
+            return LGW_HAL_ERROR;
+        }
+    }
+
+    fsk_changed = (ctx->if_enable[9] != old.if_enable[9]) || (ctx->if_freq[9] != old.if_freq[9]) || (ctx->if_rf_chain[9] != old.if_rf_chain[9]);
+    fsk_changed |= (ctx->fsk_sync_word_size != old.fsk_sync_word_size) || (ctx->fsk_sync_word != old.fsk_sync_word);
+    fsk_changed |= (ctx->if_enable[9] == true) && ((ctx->fsk_rx_bw != old.fsk_rx_bw) || (ctx->fsk_rx_dr != old.fsk_rx_dr));
+    if (fsk_changed == true) {
+        lgw_reg_write<LGW_FSK_MODEM_ENABLE>(0);
+        fsk_setup();
+    }
+    lgw_reg_unlock();
+
+    DEBUG_PRINTF("Note: channel plan updated in %lu us, multi channels 0x%02X, std %d, fsk %d\n", (unsigned long)(micros() - t0), multi_mask, std_changed, fsk_changed);
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_tune_setconf(bool enable, uint32_t max_speed) {
+
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+
+    /* check if the concentrator is running */
+    if (conf_locked() == true) {
+        lgw_reg_unlock();
+        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+        return LGW_HAL_ERROR;
+    }
+
+    ctx->spi_tune_enable = enable;
+    ctx->spi_tune_max = max_speed;
+    lgw_reg_unlock();
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_fw_setconf(bool trusted) {
+
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+
+    /* check if the concentrator is running */
+    if (conf_locked() == true) {
+        lgw_reg_unlock();
+        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+        return LGW_HAL_ERROR;
+    }
+
+    ctx->fw_trusted = trusted;
+    lgw_reg_unlock();
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_spi_tune(struct lgw_spi_tune_s *report) {
+    int x = LGW_HAL_ERROR;
+
+    CHECK_NULL(report);
+    lgw_reg_lock();
+    if (ctx->spi_tune.nb_rate != 0) {
+        *report = ctx->spi_tune;
+        x = LGW_HAL_SUCCESS;
+    }
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_boot_timing(struct lgw_boot_timing_s *timing) {
+    int x = LGW_HAL_ERROR;
+
+    CHECK_NULL(timing);
+    lgw_reg_lock();
+    if (ctx->boot_timing.total != 0) {
+        *timing = ctx->boot_timing;
+        x = LGW_HAL_SUCCESS;
+    }
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_agc_timing(struct lgw_agc_timing_s *timing) {
+    int x = LGW_HAL_ERROR;
+
+    CHECK_NULL(timing);
+    lgw_reg_lock();
+    if (ctx->agc_timing.total != 0) {
+        *timing = ctx->agc_timing;
+        x = LGW_HAL_SUCCESS;
+    }
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_scrub_setconf(uint8_t bw_share) {
+    if (bw_share > 100) {
+        DEBUG_MSG("ERROR: SCRUBBER SHARE OF THE SPI BUS ABOVE 100%\n");
+        return LGW_HAL_ERROR;
+    }
+    lgw_reg_lock();
+    ctx->scrub_share = bw_share;
+    lgw_reg_unlock();
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_scrub(uint32_t *wait_ms) {
+    unsigned long t0;
+    uint32_t busy, idle;
+    int x;
+
+    CHECK_NULL(wait_ms);
+
+    lgw_reg_lock();
+
+    /* check if the concentrator is running */
+    if (ctx->is_started == false) {
+        lgw_reg_unlock();
+        DEBUG_MSG("ERROR: CONCENTRATOR IS NOT RUNNING, NOTHING TO SCRUB\n");
+        return LGW_HAL_ERROR;
+    }
+    if (ctx->scrub_share == 0) {
+        lgw_reg_unlock();
+        *wait_ms = SCRUB_IDLE_MS;
+        return LGW_HAL_SUCCESS;
+    }
+
+    /* one chunk, then stay off the bus long enough to keep to the share */
+    t0 = micros();
+    x = lgw_reg_scrub(SCRUB_CHUNK, NULL);
+    busy = (uint32_t)(micros() - t0);
+    idle = busy * (100 - ctx->scrub_share) / ctx->scrub_share;
+    lgw_reg_unlock();
+    *wait_ms = (idle + 999) / 1000;
+    if (*wait_ms == 0) {
+        *wait_ms = 1;
+    }
+
+    return (x == LGW_REG_SUCCESS) ? LGW_HAL_SUCCESS : LGW_HAL_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* wall clock in seconds, 0 while it is not set */
+static uint32_t cal_clock(void) {
+    time_t now = time(NULL);
+
+    return (now < CAL_CLOCK_VALID) ? 0 : (uint32_t)now;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* fields a stored calibration must match to be used */
+static void cal_key(struct lgw_cal_rec_s *rec, uint8_t cal_cmd) {
+    int i;
+
+    memset(rec, 0, sizeof(struct lgw_cal_rec_s)); /* padding is covered by the CRC */
+    rec->board_id = ctx->cal_conf.board_id;
+    for (i = 0; i < LGW_RF_CHAIN_NB; ++i) {
+        rec->radio_type[i] = (uint8_t)ctx->rf_radio_type[i];
+        rec->freq_hz[i] = (ctx->rf_enable[i] == true) ? ctx->rf_rx_freq[i] : 0;
+    }
+    rec->cal_cmd = cal_cmd;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* load the stored calibration if it still holds for this start */
+static bool cal_restore(uint8_t cal_cmd) {
+    const struct lgw_cal_store_s *store = ctx->cal_conf.store;
+    const char *key = (ctx->cal_conf.key != NULL) ? ctx->cal_conf.key : LGW_CAL_KEY_DEFAULT;
+    struct lgw_cal_rec_s rec, ref;
+    uint32_t now;
+
+    if (store == NULL) {
+        return false;
+    }
+    if ((store->load(key, &rec) != LGW_CAL_SUCCESS) || (lgw_cal_check(&rec) != LGW_CAL_SUCCESS)) {
+        DEBUG_MSG("Note: no stored calibration\n");
+        return false;
+    }
+
+    /* same board, radios and frequencies */
+    cal_key(&ref, cal_cmd);
+    if ((rec.board_id != ref.board_id) || (rec.cal_cmd != ref.cal_cmd) || (memcmp(rec.radio_type, ref.radio_type, sizeof rec.radio_type) != 0) || (memcmp(rec.freq_hz, ref.freq_hz, sizeof rec.freq_hz) != 0)) {
+        DEBUG_MSG("Note: stored calibration does not match the configuration\n");
+        return false;
+    }
+
+    /* staleness policy */
+    if ((ctx->cal_conf.max_restore != 0) && (rec.nb_restore >= ctx->cal_conf.max_restore)) {
+        DEBUG_PRINTF("Note: stored calibration already used for %u starts\n", rec.nb_restore);
+        return false;
+    }
+    now = cal_clock();
+    if ((ctx->cal_conf.max_age != 0) && (now != 0) && (rec.saved_at != 0) && ((now - rec.saved_at) > ctx->cal_conf.max_age)) {
+        DEBUG_PRINTF("Note: stored calibration is %u s old\n", now - rec.saved_at);
+        return false;
+    }
+
+    /* TX offsets stay in the context, RX image rejection goes back in the registers */
+    memcpy(ctx->cal_offset_a_i, rec.offset_a_i, sizeof ctx->cal_offset_a_i);
+    memcpy(ctx->cal_offset_a_q, rec.offset_a_q, sizeof ctx->cal_offset_a_q);
+    memcpy(ctx->cal_offset_b_i, rec.offset_b_i, sizeof ctx->cal_offset_b_i);
+    memcpy(ctx->cal_offset_b_q, rec.offset_b_q, sizeof ctx->cal_offset_b_q);
+    lgw_reg_write<LGW_IQ_MISMATCH_A_AMP_COEFF>(rec.iq_mismatch[0]);
+    lgw_reg_write<LGW_IQ_MISMATCH_A_PHI_COEFF>(rec.iq_mismatch[1]);
+    lgw_reg_write<LGW_IQ_MISMATCH_B_AMP_COEFF>(rec.iq_mismatch[2]);
+    lgw_reg_write<LGW_IQ_MISMATCH_B_SEL_I>(rec.iq_mismatch[3]);
+    lgw_reg_write<LGW_IQ_MISMATCH_B_PHI_COEFF>(rec.iq_mismatch[4]);
+
+    ++rec.nb_restore;
+    lgw_cal_seal(&rec);
+    store->save(key, &rec);
+    ctx->boot_timing.cal_cached = true;
+    DEBUG_PRINTF("Note: calibration restored from %s (warm start %u)\n", store->name, rec.nb_restore);
+    return true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* keep a successful calibration for the next starts */
+static void cal_save(uint8_t cal_cmd, uint8_t cal_status) {
+    const struct lgw_cal_store_s *store = ctx->cal_conf.store;
+    const char *key = (ctx->cal_conf.key != NULL) ? ctx->cal_conf.key : LGW_CAL_KEY_DEFAULT;
+    struct lgw_cal_rec_s rec;
+    uint8_t expect;
+    int32_t read_val;
+
+    if (store == NULL) {
+        return;
+    }
+
+    /* only a calibration where every requested step succeeded is worth keeping */
+    expect = 0x81;
+    expect |= ctx->rf_enable[0] ? 0x0A : 0x00;
+    expect |= ctx->rf_enable[1] ? 0x14 : 0x00;
+    expect |= (ctx->rf_enable[0] && ctx->rf_tx_enable[0]) ? 0x20 : 0x00;
+    expect |= (ctx->rf_enable[1] && ctx->rf_tx_enable[1]) ? 0x40 : 0x00;
+    if ((cal_status & expect) != expect) {
+        store->erase(key);
+        return;
+    }
+
+    cal_key(&rec, cal_cmd);
+    rec.cal_status = cal_status;
+    rec.saved_at = cal_clock();
+    memcpy(rec.offset_a_i, ctx->cal_offset_a_i, sizeof rec.offset_a_i);
+    memcpy(rec.offset_a_q, ctx->cal_offset_a_q, sizeof rec.offset_a_q);
+    memcpy(rec.offset_b_i, ctx->cal_offset_b_i, sizeof rec.offset_b_i);
+    memcpy(rec.offset_b_q, ctx->cal_offset_b_q, sizeof rec.offset_b_q);
+    lgw_reg_read<LGW_IQ_MISMATCH_A_AMP_COEFF>(&read_val);
+    rec.iq_mismatch[0] = (uint8_t)read_val;
+    lgw_reg_read<LGW_IQ_MISMATCH_A_PHI_COEFF>(&read_val);
+    rec.iq_mismatch[1] = (uint8_t)read_val;
+    lgw_reg_read<LGW_IQ_MISMATCH_B_AMP_COEFF>(&read_val);
+    rec.iq_mismatch[2] = (uint8_t)read_val;
+    lgw_reg_read<LGW_IQ_MISMATCH_B_SEL_I>(&read_val);
+    rec.iq_mismatch[3] = (uint8_t)read_val;
+    lgw_reg_read<LGW_IQ_MISMATCH_B_PHI_COEFF>(&read_val);
+    rec.iq_mismatch[4] = (uint8_t)read_val;
+    lgw_cal_seal(&rec);
+    if (store->save(key, &rec) != LGW_CAL_SUCCESS) {
+        DEBUG_MSG("WARNING: calibration could not be stored\n");
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* load the calibration firmware and hand it the registers, it then runs on its own */
+static int calibrate_begin(uint8_t cal_cmd) {
     int32_t read_val;
-    uint8_t load_val;
     uint8_t fw_version;
-    uint8_t cal_cmd;
-    uint16_t cal_time;
+
+    /* Load the calibration firmware  */
+    if (load_firmware(MCU_AGC, cal_firmware_lz, CAL_FW_LZ_BYTE, MCU_AGC_FW_BYTE, CAL_FW_CRC) != 0) {
+        return LGW_HAL_ERROR;
+    }
+    lgw_reg_write<LGW_FORCE_HOST_RADIO_CTRL>(0); /* gives to AGC MCU the control of the radios */
+    lgw_reg_write<LGW_RADIO_SELECT>(cal_cmd); /* send calibration configuration word */
+    lgw_reg_write<LGW_MCU_RST_1>(0);
+
+    
+    /* Check firmware version */
+    lgw_reg_write<LGW_DBG_AGC_MCU_RAM_ADDR>(FW_VERSION_ADDR);
+    lgw_reg_read<LGW_DBG_AGC_MCU_RAM_DATA>(&read_val);
+    
+    fw_version = (uint8_t)read_val;
+    if (fw_version != FW_VERSION_CAL) {
+        printf("ERROR: Version of calibration firmware not expected, actual:%d expected:%d\n", fw_version, FW_VERSION_CAL);
+        return LGW_HAL_ERROR;
+    }
+
+    lgw_reg_w(LGW_PAGE_REG, 3); /* Calibration will start on this condition as soon as MCU can talk to concentrator registers */
+    lgw_reg_write<LGW_EMERGENCY_FORCE_HOST_CTRL>(0); /* Give control of concentrator registers to MCU */
+
+    DEBUG_PRINTF("Note: calibration started (timeout: %u ms)\n", CAL_TIMEOUT_MS);
+    ctx->start_cal_t0 = millis();
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* MCU_AGC_STATUS is a common register the host can read while the calibration runs */
+static bool calibrate_done(void) {
+    int32_t read_val;
+
+    lgw_reg_read<LGW_MCU_AGC_STATUS>(&read_val);
+    return ((read_val & 0x80) != 0) || ((millis() - ctx->start_cal_t0) >= CAL_TIMEOUT_MS);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* take the registers back and read the calibration results */
+static int calibrate_end(uint8_t cal_cmd) {
+    int i;
+    int32_t read_val;
     uint8_t cal_status;
 
-    uint64_t fsk_sync_word_reg;
+    lgw_reg_write<LGW_EMERGENCY_FORCE_HOST_CTRL>(1); /* Take back control */
+    lgw_reg_shadow_invalidate(); /* the calibration firmware wrote registers, IQ mismatch coefficients among them */
 
-    if (lgw_is_started == true) {
-        DEBUG_MSG("Note: LoRa concentrator already started, restarting it now\n");
+    /* Get calibration status */
+    lgw_reg_read<LGW_MCU_AGC_STATUS>(&read_val);
+    cal_status = (uint8_t)read_val;
+    DEBUG_PRINTF("Note: calibration took %lu ms\n", (unsigned long)(millis() - ctx->start_cal_t0));
+    /*
+        bit 7: calibration finished
+        bit 0: could access SX1301 registers
+        bit 1: could access radio A registers
+        bit 2: could access radio B registers
+        bit 3: radio A RX image rejection successful
+        bit 4: radio B RX image rejection successful
+        bit 5: radio A TX DC Offset correction successful
+        bit 6: radio B TX DC Offset correction successful
+    */
+    if ((cal_status & 0x81) != 0x81) {
+        DEBUG_PRINTF("ERROR: CALIBRATION FAILURE (STATUS = %u)\n", cal_status);
+        return LGW_HAL_ERROR;
+    } else {
+        DEBUG_PRINTF("Note: calibration finished (status = %u)\n", cal_status);
+    }
+    if (ctx->rf_enable[0] && ((cal_status & 0x02) == 0)) {
+        DEBUG_MSG("WARNING: calibration could not access radio A\n");
+    }
+    if (ctx->rf_enable[1] && ((cal_status & 0x04) == 0)) {
+        DEBUG_MSG("WARNING: calibration could not access radio B\n");
+    }
+    if (ctx->rf_enable[0] && ((cal_status & 0x08) == 0)) {
+        DEBUG_MSG("WARNING: problem in calibration of radio A for image rejection\n");
+    }
+    if (ctx->rf_enable[1] && ((cal_status & 0x10) == 0)) {
+        DEBUG_MSG("WARNING: problem in calibration of radio B for image rejection\n");
+    }
+    if (ctx->rf_enable[0] && ctx->rf_tx_enable[0] && ((cal_status & 0x20) == 0)) {
+        DEBUG_MSG("WARNING: problem in calibration of radio A for TX DC offset\n");
     }
+    if (ctx->rf_enable[1] && ctx->rf_tx_enable[1] && ((cal_status & 0x40) == 0)) {
+        DEBUG_MSG("WARNING: problem in calibration of radio B for TX DC offset\n");
+    }
+
+    /* Get TX DC offset values */
+    for(i=0; i<=7; ++i) {
+        lgw_reg_write<LGW_DBG_AGC_MCU_RAM_ADDR>(0xA0+i);
+        lgw_reg_read<LGW_DBG_AGC_MCU_RAM_DATA>(&read_val);
+        ctx->cal_offset_a_i[i] = (int8_t)read_val;
+        lgw_reg_write<LGW_DBG_AGC_MCU_RAM_ADDR>(0xA8+i);
+        lgw_reg_read<LGW_DBG_AGC_MCU_RAM_DATA>(&read_val);
+        ctx->cal_offset_a_q[i] = (int8_t)read_val;
+        lgw_reg_write<LGW_DBG_AGC_MCU_RAM_ADDR>(0xB0+i);
+        lgw_reg_read<LGW_DBG_AGC_MCU_RAM_DATA>(&read_val);
+        ctx->cal_offset_b_i[i] = (int8_t)read_val;
+        lgw_reg_write<LGW_DBG_AGC_MCU_RAM_ADDR>(0xB8+i);
+        lgw_reg_read<LGW_DBG_AGC_MCU_RAM_DATA>(&read_val);
+        ctx->cal_offset_b_q[i] = (int8_t)read_val;
+    }
+
+    cal_save(cal_cmd, cal_status);
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* LGW_BOOT_CONNECT: open the link, reset the chip */
+static int start_connect(void) {
+    int reg_stat;
 
     reg_stat = lgw_connect(false);
     if (reg_stat == LGW_REG_ERROR) {
@@ -705,40 +1657,74 @@ int lgw_start(void) {
         return LGW_HAL_ERROR;
     }
 
+    /* qualify the SPI link and run it at the fastest reliable clock, before the reset wipes any stray write */
+    memset(&ctx->spi_tune, 0, sizeof ctx->spi_tune);
+    if (ctx->spi_tune_enable == true) {
+        if (lgw_reg_spi_tune(ctx->spi_tune_max, SPI_TUNE_MARGIN, &ctx->spi_tune) == LGW_REG_SUCCESS) {
+            DEBUG_PRINTF("Note: SPI clock tuned to %u Hz\n", ctx->spi_tune.selected);
+        } else {
+            DEBUG_MSG("WARNING: SPI clock tuning failed, keeping default clock\n");
+        }
+    }
+
     /* reset the registers (also shuts the radios down) */
     lgw_soft_reset();
 
     /* gate clocks */
-    lgw_reg_w(LGW_GLOBAL_EN, 0);
-    lgw_reg_w(LGW_CLK32M_EN, 0);
-
-    /* switch on and reset the radios (also starts the 32 MHz XTAL) */
-    lgw_reg_w(LGW_RADIO_A_EN,1);
-    lgw_reg_w(LGW_RADIO_B_EN,1);
-    wait_ms(500); /* TODO: optimize */
-    lgw_reg_w(LGW_RADIO_RST,1);
+    lgw_reg_write<LGW_GLOBAL_EN>(0);
+    lgw_reg_write<LGW_CLK32M_EN>(0);
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* LGW_BOOT_XTAL: switch on the radios (also starts the 32 MHz XTAL) */
+static int start_xtal(void) {
+    int i;
+
+    lgw_reg_write<LGW_RADIO_A_EN>(1);
+    lgw_reg_write<LGW_RADIO_B_EN>(1);
+    for (i = 0; i < LGW_RF_CHAIN_NB; ++i) {
+        if ((ctx->rf_enable[i] == true) || (ctx->rf_clkout == i)) {
+            if (sx125x_wait_ready(i, XTAL_READY_TIMEOUT_MS) != LGW_REG_SUCCESS) {
+                DEBUG_PRINTF("ERROR: SX125x RADIO %d DID NOT POWER UP\n", i);
+                return LGW_HAL_ERROR;
+            }
+        }
+    }
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* LGW_BOOT_RADIO: reset and setup the radios, enable the clocks */
+static int start_radio(void) {
+    int err;
+
+    lgw_reg_write<LGW_RADIO_RST>(1);
     wait_ms(5);
-    lgw_reg_w(LGW_RADIO_RST,0);
+    lgw_reg_write<LGW_RADIO_RST>(0);
 
     /* setup the radios */
-    err = lgw_setup_sx125x(0, rf_clkout, rf_enable[0], rf_radio_type[0], rf_rx_freq[0]);
+    err = lgw_setup_sx125x(0, ctx->rf_clkout, ctx->rf_enable[0], ctx->rf_radio_type[0], ctx->rf_rx_freq[0]);
     if (err != 0) {
         DEBUG_MSG("ERROR: Failed to setup sx125x radio for RF chain 0\n");
         return LGW_HAL_ERROR;
     }
-    err = lgw_setup_sx125x(1, rf_clkout, rf_enable[1], rf_radio_type[1], rf_rx_freq[1]);
+    err = lgw_setup_sx125x(1, ctx->rf_clkout, ctx->rf_enable[1], ctx->rf_radio_type[1], ctx->rf_rx_freq[1]);
     if (err != 0) {
         DEBUG_MSG("ERROR: Failed to setup sx125x radio for RF chain 0\n");
         return LGW_HAL_ERROR;
     }
 
     /* gives AGC control of GPIOs to enable Tx external digital filter */
-    lgw_reg_w(LGW_GPIO_MODE,31); /* Set all GPIOs as output */
-    lgw_reg_w(LGW_GPIO_SELECT_OUTPUT,2);
+    lgw_reg_write<LGW_GPIO_MODE>(31); /* Set all GPIOs as output */
+    lgw_reg_write<LGW_GPIO_SELECT_OUTPUT>(2);
 
     /* Enable clocks */
-    lgw_reg_w(LGW_GLOBAL_EN, 1);
-    lgw_reg_w(LGW_CLK32M_EN, 1);
+    lgw_reg_write<LGW_GLOBAL_EN>(1);
+    lgw_reg_write<LGW_CLK32M_EN>(1);
 
     /* GPIOs table :
     DGPIO0 -> N/A
@@ -748,15 +1734,23 @@ int lgw_start(void) {
     DGPIO4 -> TX ON
     */
 
-    /* select calibration command */
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* calibration command word for the current configuration */
+static uint8_t cal_command(void) {
+    uint8_t cal_cmd;
+
     cal_cmd = 0;
-    cal_cmd |= rf_enable[0] ? 0x01 : 0x00; /* Bit 0: Calibrate Rx IQ mismatch compensation on radio A */
-    cal_cmd |= rf_enable[1] ? 0x02 : 0x00; /* Bit 1: Calibrate Rx IQ mismatch compensation on radio B */
-    cal_cmd |= (rf_enable[0] && rf_tx_enable[0]) ? 0x04 : 0x00; /* Bit 2: Calibrate Tx DC offset on radio A */
-    cal_cmd |= (rf_enable[1] && rf_tx_enable[1]) ? 0x08 : 0x00; /* Bit 3: Calibrate Tx DC offset on radio B */
+    cal_cmd |= ctx->rf_enable[0] ? 0x01 : 0x00; /* Bit 0: Calibrate Rx IQ mismatch compensation on radio A */
+    cal_cmd |= ctx->rf_enable[1] ? 0x02 : 0x00; /* Bit 1: Calibrate Rx IQ mismatch compensation on radio B */
+    cal_cmd |= (ctx->rf_enable[0] && ctx->rf_tx_enable[0]) ? 0x04 : 0x00; /* Bit 2: Calibrate Tx DC offset on radio A */
+    cal_cmd |= (ctx->rf_enable[1] && ctx->rf_tx_enable[1]) ? 0x08 : 0x00; /* Bit 3: Calibrate Tx DC offset on radio B */
     cal_cmd |= 0x10; /* Bit 4: 0: calibrate with DAC gain=2, 1: with DAC gain=3 (use 3) */
     
-    switch (rf_radio_type[0]) { /* we assume that there is only one radio type on the board */
+    switch (ctx->rf_radio_type[0]) { /* we assume that there is only one radio type on the board */
         case LGW_RADIO_TYPE_SX1255:
             cal_cmd |= 0x20; /* Bit 5: 0: SX1257, 1: SX1255 */
             break;
@@ -764,312 +1758,348 @@ int lgw_start(void) {
             cal_cmd |= 0x00; /* Bit 5: 0: SX1257, 1: SX1255 */
             break;
         default:
-            DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d FOR RADIO TYPE\n", rf_radio_type[0]);
+            DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d FOR RADIO TYPE\n", ctx->rf_radio_type[0]);
             break;
     }
     
     cal_cmd |= 0x00; /* Bit 6-7: Board type 0: ref, 1: FPGA, 3: board X */
-    cal_time = 2300; /* measured between 2.1 and 2.2 sec, because 1 TX only */
-    
-    /* Load the calibration firmware  */
-    load_firmware(MCU_AGC, cal_firmware, MCU_AGC_FW_BYTE);
-    lgw_reg_w(LGW_FORCE_HOST_RADIO_CTRL, 0); /* gives to AGC MCU the control of the radios */
-    lgw_reg_w(LGW_RADIO_SELECT, cal_cmd); /* send calibration configuration word */
-    lgw_reg_w(LGW_MCU_RST_1, 0);
-
-    
-    /* Check firmware version */
-    lgw_reg_w(LGW_DBG_AGC_MCU_RAM_ADDR, FW_VERSION_ADDR);
-    lgw_reg_r(LGW_DBG_AGC_MCU_RAM_DATA, &read_val);
-    
-    fw_version = (uint8_t)read_val;
-    if (fw_version != FW_VERSION_CAL) {
-        printf("ERROR: Version of calibration firmware not expected, actual:%d expected:%d\n", fw_version, FW_VERSION_CAL);
-        return -1;
-    }
-
-    lgw_reg_w(LGW_PAGE_REG, 3); /* Calibration will start on this condition as soon as MCU can talk to concentrator registers */
-    lgw_reg_w(LGW_EMERGENCY_FORCE_HOST_CTRL, 0); /* Give control of concentrator registers to MCU */
+    return cal_cmd;
+}
 
-    /* Wait for calibration to end */
-    DEBUG_PRINTF("Note: calibration started (time: %u ms)\n", cal_time);
-    wait_ms(cal_time); /* Wait for end of calibration */
-    lgw_reg_w(LGW_EMERGENCY_FORCE_HOST_CTRL, 1); /* Take back control */
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    /* Get calibration status */
-    lgw_reg_r(LGW_MCU_AGC_STATUS, &read_val);
-    cal_status = (uint8_t)read_val;
-    /*
-        bit 7: calibration finished
-        bit 0: could access SX1301 registers
-        bit 1: could access radio A registers
-        bit 2: could access radio B registers
-        bit 3: radio A RX image rejection successful
-        bit 4: radio B RX image rejection successful
-        bit 5: radio A TX DC Offset correction successful
-        bit 6: radio B TX DC Offset correction successful
-    */
-    if ((cal_status & 0x81) != 0x81) {
-        DEBUG_PRINTF("ERROR: CALIBRATION FAILURE (STATUS = %u)\n", cal_status);
-        return LGW_HAL_ERROR;
-    } else {
-        DEBUG_PRINTF("Note: calibration finished (status = %u)\n", cal_status);
-    }
-    if (rf_enable[0] && ((cal_status & 0x02) == 0)) {
-        DEBUG_MSG("WARNING: calibration could not access radio A\n");
-    }
-    if (rf_enable[1] && ((cal_status & 0x04) == 0)) {
-        DEBUG_MSG("WARNING: calibration could not access radio B\n");
+/* LGW_BOOT_CALIB: restore a stored calibration or start the calibration firmware, then poll it one step at a time */
+static int start_calib(void) {
+    if (ctx->start_cal_wait == false) {
+        ctx->start_cal_cmd = cal_command();
+        memcpy(ctx->rf_cal_freq, ctx->rf_rx_freq, sizeof ctx->rf_cal_freq);
+        if (cal_restore(ctx->start_cal_cmd) == true) {
+            return LGW_HAL_SUCCESS;
+        }
+        if (calibrate_begin(ctx->start_cal_cmd) != LGW_HAL_SUCCESS) {
+            return LGW_HAL_ERROR;
+        }
+        ctx->start_cal_wait = true;
+        return LGW_START_IN_PROGRESS;
     }
-    if (rf_enable[0] && ((cal_status & 0x08) == 0)) {
-        DEBUG_MSG("WARNING: problem in calibration of radio A for image rejection\n");
+    if (calibrate_done() == false) {
+        return LGW_START_IN_PROGRESS;
     }
-    if (rf_enable[1] && ((cal_status & 0x10) == 0)) {
-        DEBUG_MSG("WARNING: problem in calibration of radio B for image rejection\n");
+    ctx->start_cal_wait = false;
+    return calibrate_end(ctx->start_cal_cmd);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* IF frequency and correlators of the 'multi' channels in mask (bit i for IF i), in one batch */
+static void multi_setup(uint8_t mask) {
+    int i;
+    uint16_t nb = 0;
+    struct lgw_reg_pair_s chan_regs[2 * LGW_MULTI_NB];
+
+    for (i = 0; i < LGW_MULTI_NB; ++i) {
+        if ((mask & (1 << i)) == 0) {
+            continue;
+        }
+        chan_regs[nb].register_id = LGW_IF_FREQ_0 + i; /* default -384 -128 128 384 -384 -128 128 384 */
+        chan_regs[nb].value = IF_HZ_TO_REG(ctx->if_freq[i]);
+        chan_regs[nb + 1].register_id = LGW_CORR0_DETECT_EN + i; /* default 0 */
+        chan_regs[nb + 1].value = (ctx->if_enable[i] == true) ? ctx->lora_multi_sfmask[i] : 0;
+        nb += 2;
     }
-    if (rf_enable[0] && rf_tx_enable[0] && ((cal_status & 0x20) == 0)) {
-        DEBUG_MSG("WARNING: problem in calibration of radio A for TX DC offset\n");
+    if (nb > 0) {
+        lgw_reg_w_batch(chan_regs, nb);
     }
-    if (rf_enable[1] && rf_tx_enable[1] && ((cal_status & 0x40) == 0)) {
-        DEBUG_MSG("WARNING: problem in calibration of radio B for TX DC offset\n");
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* LoRa 'stand-alone' modem (IF8), enabled last */
+static int lora_std_setup(void) {
+    lgw_reg_write<LGW_IF_FREQ_8>(IF_HZ_TO_REG(ctx->if_freq[8])); /* MBWSSF modem (default 0) */
+    if (ctx->if_enable[8] == true) {
+        lgw_reg_write<LGW_MBWSSF_RADIO_SELECT>(ctx->if_rf_chain[8]);
+        switch(ctx->lora_rx_bw) {
+            case BW_125KHZ: lgw_reg_write<LGW_MBWSSF_MODEM_BW>(0); break;
+            case BW_250KHZ: lgw_reg_write<LGW_MBWSSF_MODEM_BW>(1); break;
+            case BW_500KHZ: lgw_reg_write<LGW_MBWSSF_MODEM_BW>(2); break;
+            default:
+                DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\n", ctx->lora_rx_bw);
+                return LGW_HAL_ERROR;
+        }
+        switch(ctx->lora_rx_sf) {
+            case DR_LORA_SF7: lgw_reg_write<LGW_MBWSSF_RATE_SF>(7); break;
+            case DR_LORA_SF8: lgw_reg_write<LGW_MBWSSF_RATE_SF>(8); break;
+            case DR_LORA_SF9: lgw_reg_write<LGW_MBWSSF_RATE_SF>(9); break;
+            case DR_LORA_SF10: lgw_reg_write<LGW_MBWSSF_RATE_SF>(10); break;
+            case DR_LORA_SF11: lgw_reg_write<LGW_MBWSSF_RATE_SF>(11); break;
+            case DR_LORA_SF12: lgw_reg_write<LGW_MBWSSF_RATE_SF>(12); break;
+            default:
+                DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\n", ctx->lora_rx_sf);
+                return LGW_HAL_ERROR;
+        }
+        lgw_reg_write<LGW_MBWSSF_PPM_OFFSET>(ctx->lora_rx_ppm_offset); /* default 0 */
+        lgw_reg_write<LGW_MBWSSF_MODEM_ENABLE>(1); /* default 0 */
+    } else {
+        lgw_reg_write<LGW_MBWSSF_MODEM_ENABLE>(0);
     }
+    return LGW_HAL_SUCCESS;
+}
 
-    /* Get TX DC offset values */
-    for(i=0; i<=7; ++i) {
-        lgw_reg_w(LGW_DBG_AGC_MCU_RAM_ADDR, 0xA0+i);
-        lgw_reg_r(LGW_DBG_AGC_MCU_RAM_DATA, &read_val);
-        cal_offset_a_i[i] = (int8_t)read_val;
-        lgw_reg_w(LGW_DBG_AGC_MCU_RAM_ADDR, 0xA8+i);
-        lgw_reg_r(LGW_DBG_AGC_MCU_RAM_DATA, &read_val);
-        cal_offset_a_q[i] = (int8_t)read_val;
-        lgw_reg_w(LGW_DBG_AGC_MCU_RAM_ADDR, 0xB0+i);
-        lgw_reg_r(LGW_DBG_AGC_MCU_RAM_DATA, &read_val);
-        cal_offset_b_i[i] = (int8_t)read_val;
-        lgw_reg_w(LGW_DBG_AGC_MCU_RAM_ADDR, 0xB8+i);
-        lgw_reg_r(LGW_DBG_AGC_MCU_RAM_DATA, &read_val);
-        cal_offset_b_q[i] = (int8_t)read_val;
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* FSK modem (IF9), enabled last */
+static void fsk_setup(void) {
+    uint64_t fsk_sync_word_reg;
+
+    lgw_reg_write<LGW_IF_FREQ_9>(IF_HZ_TO_REG(ctx->if_freq[9])); /* FSK modem, default 0 */
+    lgw_reg_write<LGW_FSK_PSIZE>(ctx->fsk_sync_word_size-1);
+    lgw_reg_write<LGW_FSK_TX_PSIZE>(ctx->fsk_sync_word_size-1);
+    fsk_sync_word_reg = ctx->fsk_sync_word << (8 * (8 - ctx->fsk_sync_word_size));
+    lgw_reg_write<LGW_FSK_REF_PATTERN_LSB>((uint32_t)(0xFFFFFFFF & fsk_sync_word_reg));
+    lgw_reg_write<LGW_FSK_REF_PATTERN_MSB>((uint32_t)(0xFFFFFFFF & (fsk_sync_word_reg >> 32)));
+    if (ctx->if_enable[9] == true) {
+        lgw_reg_write<LGW_FSK_RADIO_SELECT>(ctx->if_rf_chain[9]);
+        lgw_reg_write<LGW_FSK_BR_RATIO>(LGW_XTAL_FREQU/ctx->fsk_rx_dr); /* setting the dividing ratio for datarate */
+        lgw_reg_write<LGW_FSK_CH_BW_EXPO>(ctx->fsk_rx_bw);
+        lgw_reg_write<LGW_FSK_MODEM_ENABLE>(1); /* default 0 */
+    } else {
+        lgw_reg_write<LGW_FSK_MODEM_ENABLE>(0);
     }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* LGW_BOOT_MODEM: modem configuration is written page by page, modems enabled last */
+static int start_modem(void) {
+    lgw_reg_defer(true);
 
     /* load adjusted parameters */
     lgw_constant_adjust();
 
     /* Sanity check for RX frequency */
-    if (rf_rx_freq[0] == 0) {
+    if (ctx->rf_rx_freq[0] == 0) {
         DEBUG_MSG("ERROR: wrong configuration, rf_rx_freq[0] is not set\n");
+        lgw_reg_defer(false);
         return LGW_HAL_ERROR;
     }
 
     /* Freq-to-time-drift calculation */
-    x = 4096000000 / (rf_rx_freq[0] >> 1); /* dividend: (4*2048*1000000) >> 1, rescaled to avoid 32b overflow */
-    x = ( x > 63 ) ? 63 : x; /* saturation */
-    lgw_reg_w(LGW_FREQ_TO_TIME_DRIFT, x); /* default 9 */
+    lgw_freq_to_time_drift();
 
-    x = 4096000000 / (rf_rx_freq[0] >> 3); /* dividend: (16*2048*1000000) >> 3, rescaled to avoid 32b overflow */
-    x = ( x > 63 ) ? 63 : x; /* saturation */
-    lgw_reg_w(LGW_MBWSSF_FREQ_TO_TIME_DRIFT, x); /* default 36 */
+    /* configure LoRa 'multi' demodulators aka. LoRa 'sensor' channels (IF0-7) */
+    multi_setup(0xFF);
 
-    /* configure LoRa 'multi' demodulators aka. LoRa 'sensor' channels (IF0-3) */
-    radio_select = 0; /* IF mapping to radio A/B (per bit, 0=A, 1=B) */
-    for(i=0; i<LGW_MULTI_NB; ++i) {
-        radio_select += (if_rf_chain[i] == 1 ? 1 << i : 0); /* transform bool array into binary word */
-    }
-    /*
-    lgw_reg_w(LGW_RADIO_SELECT, radio_select);
+    lgw_reg_write<LGW_PPM_OFFSET>(0x60); /* as the threshold is 16ms, use 0x60 to enable ppm_offset for SF12 and SF11 @125kHz*/
 
-    LGW_RADIO_SELECT is used for communication with the firmware, "radio_select"
-    will be loaded in LGW_RADIO_SELECT at the end of start procedure.
-    */
+    lgw_reg_write<LGW_CONCENTRATOR_MODEM_ENABLE>(1); /* default 0 */
 
-    lgw_reg_w(LGW_IF_FREQ_0, IF_HZ_TO_REG(if_freq[0])); /* default -384 */
-    lgw_reg_w(LGW_IF_FREQ_1, IF_HZ_TO_REG(if_freq[1])); /* default -128 */
-    lgw_reg_w(LGW_IF_FREQ_2, IF_HZ_TO_REG(if_freq[2])); /* default 128 */
-    lgw_reg_w(LGW_IF_FREQ_3, IF_HZ_TO_REG(if_freq[3])); /* default 384 */
-    lgw_reg_w(LGW_IF_FREQ_4, IF_HZ_TO_REG(if_freq[4])); /* default -384 */
-    lgw_reg_w(LGW_IF_FREQ_5, IF_HZ_TO_REG(if_freq[5])); /* default -128 */
-    lgw_reg_w(LGW_IF_FREQ_6, IF_HZ_TO_REG(if_freq[6])); /* default 128 */
-    lgw_reg_w(LGW_IF_FREQ_7, IF_HZ_TO_REG(if_freq[7])); /* default 384 */
+    /* configure LoRa 'stand-alone' modem (IF8) */
+    if (lora_std_setup() != LGW_HAL_SUCCESS) {
+        lgw_reg_defer(false);
+        return LGW_HAL_ERROR;
+    }
 
-    lgw_reg_w(LGW_CORR0_DETECT_EN, (if_enable[0] == true) ? lora_multi_sfmask[0] : 0); /* default 0 */
-    lgw_reg_w(LGW_CORR1_DETECT_EN, (if_enable[1] == true) ? lora_multi_sfmask[1] : 0); /* default 0 */
-    lgw_reg_w(LGW_CORR2_DETECT_EN, (if_enable[2] == true) ? lora_multi_sfmask[2] : 0); /* default 0 */
-    lgw_reg_w(LGW_CORR3_DETECT_EN, (if_enable[3] == true) ? lora_multi_sfmask[3] : 0); /* default 0 */
-    lgw_reg_w(LGW_CORR4_DETECT_EN, (if_enable[4] == true) ? lora_multi_sfmask[4] : 0); /* default 0 */
-    lgw_reg_w(LGW_CORR5_DETECT_EN, (if_enable[5] == true) ? lora_multi_sfmask[5] : 0); /* default 0 */
-    lgw_reg_w(LGW_CORR6_DETECT_EN, (if_enable[6] == true) ? lora_multi_sfmask[6] : 0); /* default 0 */
-    lgw_reg_w(LGW_CORR7_DETECT_EN, (if_enable[7] == true) ? lora_multi_sfmask[7] : 0); /* default 0 */
+    /* configure FSK modem (IF9) */
+    fsk_setup();
 
-    lgw_reg_w(LGW_PPM_OFFSET, 0x60); /* as the threshold is 16ms, use 0x60 to enable ppm_offset for SF12 and SF11 @125kHz*/
+    lgw_reg_defer(false);
 
-    lgw_reg_w(LGW_CONCENTRATOR_MODEM_ENABLE, 1); /* default 0 */
+    return LGW_HAL_SUCCESS;
+}
 
-    /* configure LoRa 'stand-alone' modem (IF8) */
-    lgw_reg_w(LGW_IF_FREQ_8, IF_HZ_TO_REG(if_freq[8])); /* MBWSSF modem (default 0) */
-    if (if_enable[8] == true) {
-        lgw_reg_w(LGW_MBWSSF_RADIO_SELECT, if_rf_chain[8]);
-        switch(lora_rx_bw) {
-            case BW_125KHZ: lgw_reg_w(LGW_MBWSSF_MODEM_BW, 0); break;
-            case BW_250KHZ: lgw_reg_w(LGW_MBWSSF_MODEM_BW, 1); break;
-            case BW_500KHZ: lgw_reg_w(LGW_MBWSSF_MODEM_BW, 2); break;
-            default:
-                DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\n", lora_rx_bw);
-                return LGW_HAL_ERROR;
-        }
-        switch(lora_rx_sf) {
-            case DR_LORA_SF7: lgw_reg_w(LGW_MBWSSF_RATE_SF, 7); break;
-            case DR_LORA_SF8: lgw_reg_w(LGW_MBWSSF_RATE_SF, 8); break;
-            case DR_LORA_SF9: lgw_reg_w(LGW_MBWSSF_RATE_SF, 9); break;
-            case DR_LORA_SF10: lgw_reg_w(LGW_MBWSSF_RATE_SF, 10); break;
-            case DR_LORA_SF11: lgw_reg_w(LGW_MBWSSF_RATE_SF, 11); break;
-            case DR_LORA_SF12: lgw_reg_w(LGW_MBWSSF_RATE_SF, 12); break;
-            default:
-                DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\n", lora_rx_sf);
-                return LGW_HAL_ERROR;
-        }
-        lgw_reg_w(LGW_MBWSSF_PPM_OFFSET, lora_rx_ppm_offset); /* default 0 */
-        lgw_reg_w(LGW_MBWSSF_MODEM_ENABLE, 1); /* default 0 */
-    } else {
-        lgw_reg_w(LGW_MBWSSF_MODEM_ENABLE, 0);
-    }
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    /* configure FSK modem (IF9) */
-    lgw_reg_w(LGW_IF_FREQ_9, IF_HZ_TO_REG(if_freq[9])); /* FSK modem, default 0 */
-    lgw_reg_w(LGW_FSK_PSIZE, fsk_sync_word_size-1);
-    lgw_reg_w(LGW_FSK_TX_PSIZE, fsk_sync_word_size-1);
-    fsk_sync_word_reg = fsk_sync_word << (8 * (8 - fsk_sync_word_size));
-    lgw_reg_w(LGW_FSK_REF_PATTERN_LSB, (uint32_t)(0xFFFFFFFF & fsk_sync_word_reg));
-    lgw_reg_w(LGW_FSK_REF_PATTERN_MSB, (uint32_t)(0xFFFFFFFF & (fsk_sync_word_reg >> 32)));
-    if (if_enable[9] == true) {
-        lgw_reg_w(LGW_FSK_RADIO_SELECT, if_rf_chain[9]);
-        lgw_reg_w(LGW_FSK_BR_RATIO, LGW_XTAL_FREQU/fsk_rx_dr); /* setting the dividing ratio for datarate */
-        lgw_reg_w(LGW_FSK_CH_BW_EXPO, fsk_rx_bw);
-        lgw_reg_w(LGW_FSK_MODEM_ENABLE, 1); /* default 0 */
-    } else {
-        lgw_reg_w(LGW_FSK_MODEM_ENABLE, 0);
-    }
+/* LGW_BOOT_FIRMWARE: load the ARB and AGC firmwares and get the MCUs out of reset */
+static int start_firmware(void) {
+    int32_t read_val;
+    uint8_t fw_version;
 
-    /* Load firmware */
-    load_firmware(MCU_ARB, arb_firmware, MCU_ARB_FW_BYTE);
-    load_firmware(MCU_AGC, agc_firmware, MCU_AGC_FW_BYTE);
+    if ((load_firmware(MCU_ARB, arb_firmware_lz, ARB_FW_LZ_BYTE, MCU_ARB_FW_BYTE, ARB_FW_CRC) != 0) || (load_firmware(MCU_AGC, agc_firmware_lz, AGC_FW_LZ_BYTE, MCU_AGC_FW_BYTE, AGC_FW_CRC) != 0)) {
+        return LGW_HAL_ERROR;
+    }
 
     /* gives the AGC MCU control over radio, RF front-end and filter gain */
-    lgw_reg_w(LGW_FORCE_HOST_RADIO_CTRL, 0);
-    lgw_reg_w(LGW_FORCE_HOST_FE_CTRL, 0);
-    lgw_reg_w(LGW_FORCE_DEC_FILTER_GAIN, 0);
+    lgw_reg_write<LGW_FORCE_HOST_RADIO_CTRL>(0);
+    lgw_reg_write<LGW_FORCE_HOST_FE_CTRL>(0);
+    lgw_reg_write<LGW_FORCE_DEC_FILTER_GAIN>(0);
 
     /* Get MCUs out of reset */
-    lgw_reg_w(LGW_RADIO_SELECT, 0); /* MUST not be = to 1 or 2 at firmware init */
-    lgw_reg_w(LGW_MCU_RST_0, 0);
-    lgw_reg_w(LGW_MCU_RST_1, 0);
+    lgw_reg_write<LGW_RADIO_SELECT>(0); /* MUST not be = to 1 or 2 at firmware init */
+    lgw_reg_write<LGW_MCU_RST_0>(0);
+    lgw_reg_write<LGW_MCU_RST_1>(0);
 
     /* Check firmware version */
-    lgw_reg_w(LGW_DBG_AGC_MCU_RAM_ADDR, FW_VERSION_ADDR);
-    lgw_reg_r(LGW_DBG_AGC_MCU_RAM_DATA, &read_val);
+    lgw_reg_write<LGW_DBG_AGC_MCU_RAM_ADDR>(FW_VERSION_ADDR);
+    lgw_reg_read<LGW_DBG_AGC_MCU_RAM_DATA>(&read_val);
     fw_version = (uint8_t)read_val;
 
     if (fw_version != FW_VERSION_AGC) {
         DEBUG_PRINTF("ERROR: Version of AGC firmware not expected, actual:%d expected:%d\n", fw_version, FW_VERSION_AGC);
         //return LGW_HAL_ERROR;
     }
-    lgw_reg_w(LGW_DBG_ARB_MCU_RAM_ADDR, FW_VERSION_ADDR);
-    lgw_reg_r(LGW_DBG_ARB_MCU_RAM_DATA, &read_val);
+    lgw_reg_write<LGW_DBG_ARB_MCU_RAM_ADDR>(FW_VERSION_ADDR);
+    lgw_reg_read<LGW_DBG_ARB_MCU_RAM_DATA>(&read_val);
     fw_version = (uint8_t)read_val;
     if (fw_version != FW_VERSION_ARB) {
         DEBUG_PRINTF("ERROR: Version of arbiter firmware not expected, actual:%d expected:%d\n", fw_version, FW_VERSION_ARB);
         //return LGW_HAL_ERROR;
     }
 
-    DEBUG_MSG("Info: Initialising AGC firmware...\n");
-    wait_ms(1);
+    return LGW_HAL_SUCCESS;
+}
 
-    lgw_reg_r(LGW_MCU_AGC_STATUS, &read_val);
-    if (read_val != 0x10) {
-        DEBUG_PRINTF("ERROR: AGC FIRMWARE INITIALIZATION FAILURE, STATUS 0x%02X\n", (uint8_t)read_val);
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* LGW_BOOT_AGC: AGC firmware init handshake, the concentrator is started after it */
+static int start_agc(void) {
+    /*
+    LGW_RADIO_SELECT is used for communication with the firmware, "radio_select"
+    will be loaded in LGW_RADIO_SELECT at the end of start procedure.
+    */
+
+    DEBUG_MSG("Info: Initialising AGC firmware...\n");
+    memset(&ctx->agc_timing, 0, sizeof ctx->agc_timing);
+    if (agc_init(agc_radio_select()) != LGW_HAL_SUCCESS) {
         return LGW_HAL_ERROR;
     }
+    ctx->agc_timing.total = (uint32_t)(micros() - ctx->start_phase_t0);
 
-    /* Update Tx gain LUT and start AGC */
-    for (i = 0; i < txgain_lut.size; ++i) {
-        lgw_reg_w(LGW_RADIO_SELECT, AGC_CMD_WAIT); /* start a transaction */
-        wait_ms(1);
-        load_val = txgain_lut.lut[i].mix_gain + (16 * txgain_lut.lut[i].dac_gain) + (64 * txgain_lut.lut[i].pa_gain);
-        lgw_reg_w(LGW_RADIO_SELECT, load_val);
-        wait_ms(1);
-        lgw_reg_r(LGW_MCU_AGC_STATUS, &read_val);
-        if (read_val != (0x30 + i)) {
-            DEBUG_PRINTF("ERROR: AGC FIRMWARE INITIALIZATION FAILURE, STATUS 0x%02X\n", (uint8_t)read_val);
-            return LGW_HAL_ERROR;
+    /* enable GPS event capture */
+    lgw_reg_write<LGW_GPS_EN>(1);
+
+    /* */
+
+    ctx->is_started = true;
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* one entry per LGW_BOOT_xxx phase, in order */
+static int (* const start_phases[LGW_BOOT_PHASE_NB])(void) = {
+    start_connect,
+    start_xtal,
+    start_radio,
+    start_calib,
+    start_modem,
+    start_firmware,
+    start_agc
+};
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* run the current phase of the start, the registers are held by the caller */
+static int start_step(uint32_t *wait_ms) {
+    uint8_t phase;
+    int stat;
+
+    if (wait_ms != NULL) {
+        *wait_ms = 0;
+    }
+    if (ctx->start_running == false) {
+        /* first step of a new start */
+        if (ctx->is_started == true) {
+            DEBUG_MSG("Note: LoRa concentrator already started, restarting it now\n");
         }
+        ctx->is_started = false;
+        ctx->start_cal_wait = false;
+        memset(&ctx->boot_timing, 0, sizeof ctx->boot_timing);
+        ctx->start_t0 = micros();
+        ctx->start_phase_t0 = ctx->start_t0;
+        ctx->start_next = LGW_BOOT_CONNECT;
+        ctx->start_running = true;
+    } else if (ctx->start_cal_wait == false) {
+        ctx->start_phase_t0 = micros(); /* a phase is timed from its first step */
+    }
+
+    phase = ctx->start_next;
+    ctx->boot_timing.reached = phase;
+    stat = start_phases[phase]();
+    if (stat == LGW_START_IN_PROGRESS) {
+        if (wait_ms != NULL) {
+            *wait_ms = CAL_POLL_MS; /* only the calibration phase spans several steps */
+        }
+        return LGW_START_IN_PROGRESS;
     }
-    /* As the AGC fw is waiting for 16 entries, we need to abort the transaction if we get less entries */
-    if (txgain_lut.size < TX_GAIN_LUT_SIZE_MAX) {
-        lgw_reg_w(LGW_RADIO_SELECT, AGC_CMD_WAIT);
-        wait_ms(1);
-        load_val = AGC_CMD_ABORT;
-        lgw_reg_w(LGW_RADIO_SELECT, load_val);
-        wait_ms(1);
-        lgw_reg_r(LGW_MCU_AGC_STATUS, &read_val);
-        if (read_val != 0x30) {
-            DEBUG_PRINTF("ERROR: AGC FIRMWARE INITIALIZATION FAILURE, STATUS 0x%02X\n", (uint8_t)read_val);
+
+    ctx->boot_timing.phase[phase] = (uint32_t)(micros() - ctx->start_phase_t0);
+    if ((stat != LGW_HAL_SUCCESS) || (phase == (LGW_BOOT_PHASE_NB - 1))) {
+        ctx->boot_timing.total = (uint32_t)(micros() - ctx->start_t0);
+        ctx->start_running = false;
+        if (stat != LGW_HAL_SUCCESS) {
             return LGW_HAL_ERROR;
         }
+        ctx->is_started = true;
+        return LGW_START_DONE;
     }
+    ctx->start_next = phase + 1;
+    return LGW_START_IN_PROGRESS;
+}
 
-    /* Load Tx freq MSBs (always 3 if f > 768 for SX1257 or f > 384 for SX1255 */
-    lgw_reg_w(LGW_RADIO_SELECT, AGC_CMD_WAIT);
-    wait_ms(1);
-    lgw_reg_w(LGW_RADIO_SELECT, 3);
-    wait_ms(1);
-    lgw_reg_r(LGW_MCU_AGC_STATUS, &read_val);
-    if (read_val != 0x33) {
-        DEBUG_PRINTF("ERROR: AGC FIRMWARE INITIALIZATION FAILURE, STATUS 0x%02X\n", (uint8_t)read_val);
-        return LGW_HAL_ERROR;
-    }
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    /* Load chan_select firmware option */
-    lgw_reg_w(LGW_RADIO_SELECT, AGC_CMD_WAIT);
-    wait_ms(1);
-    lgw_reg_w(LGW_RADIO_SELECT, 0);
-    wait_ms(1);
-    lgw_reg_r(LGW_MCU_AGC_STATUS, &read_val);
-    if (read_val != 0x30) {
-        DEBUG_PRINTF("ERROR: AGC FIRMWARE INITIALIZATION FAILURE, STATUS 0x%02X\n", (uint8_t)read_val);
-        return LGW_HAL_ERROR;
-    }
+int lgw_start(void) {
+    int stat;
+    uint32_t wait;
+    uint32_t t0;
+
+    /* the start sequence runs with the SPI bus and the registers held, but for the calibration waits */
+    lgw_reg_lock();
+    ctx->start_running = false; /* a start left halfway is started over */
+    lgw_spi_session_begin(LGW_SPI_OP_START);
+    do {
+        stat = start_step(&wait);
+        if (wait > 0) {
+            /* the calibration MCU owns the registers of this board, the other boards may go on */
+            t0 = ctx->start_t0;
+            lgw_spi_session_end();
+            ctx_sleep(wait);
+            lgw_spi_session_begin(LGW_SPI_OP_START);
+            if ((ctx->start_running == false) || (ctx->start_t0 != t0)) {
+                DEBUG_MSG("ERROR: START STOPPED OR RESTARTED BY ANOTHER TASK\n");
+                stat = LGW_HAL_ERROR;
+            }
+        }
+    } while (stat == LGW_START_IN_PROGRESS);
+    lgw_spi_session_end();
+    lgw_reg_unlock();
 
-    /* End AGC firmware init and check status */
-    lgw_reg_w(LGW_RADIO_SELECT, AGC_CMD_WAIT);
-    wait_ms(1);
-    lgw_reg_w(LGW_RADIO_SELECT, radio_select); /* Load intended value of RADIO_SELECT */
-    wait_ms(1);
-    DEBUG_MSG("Info: putting back original RADIO_SELECT value\n");
-    lgw_reg_r(LGW_MCU_AGC_STATUS, &read_val);
-    if (read_val != 0x40) {
-        DEBUG_PRINTF("ERROR: AGC FIRMWARE INITIALIZATION FAILURE, STATUS 0x%02X\n", (uint8_t)read_val);
-        return LGW_HAL_ERROR;
-    }
+    return stat;
+}
 
-    /* enable GPS event capture */
-    lgw_reg_w(LGW_GPS_EN, 1);
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    /* */
+int lgw_start_step(uint32_t *wait_ms) {
+    int stat;
 
-    lgw_is_started = true;
-    return LGW_HAL_SUCCESS;
+    lgw_reg_lock();
+    lgw_spi_session_begin(LGW_SPI_OP_START);
+    stat = start_step(wait_ms);
+    lgw_spi_session_end();
+    lgw_reg_unlock();
+
+    return stat;
 }
 
+
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int lgw_stop(void) {
+    lgw_reg_lock();
     lgw_soft_reset();
     lgw_disconnect();
 
-    lgw_is_started = false;
+    ctx->is_started = false;
+    ctx->start_running = false; /* also aborts a start run by steps */
+    ctx->start_cal_wait = false;
+    lgw_reg_unlock();
     return LGW_HAL_SUCCESS;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
+int receive_packets(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
     int nb_pkt_fetch; /* loop variable and return value */
     struct lgw_pkt_rx_s *p; /* pointer to the current structure in the struct array */
     uint8_t buff[255+RX_METADATA_NB]; /* buffer to store the result of SPI read bursts */
@@ -1082,7 +2112,7 @@ int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
     uint32_t sf, cr, bw_pow, crc_en, ppm; /* used to calculate timestamp correction */
 
     /* check if the concentrator is running */
-    if (lgw_is_started == false) {
+    if (ctx->is_started == false) {
         DEBUG_MSG("ERROR: CONCENTRATOR IS NOT RUNNING, START IT BEFORE RECEIVING\n");
         return LGW_HAL_ERROR;
     }
@@ -1146,9 +2176,9 @@ int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
         DEBUG_PRINTF("- Canal por el cual fue recibido el paquete: %d\n", p->if_chain);
         DEBUG_PRINTF("- Tipo de recepción (17 para canales de 125KHz, 16 para canal lora de BW variable): %d\n",ifmod);
 
-        p->rf_chain = (uint8_t)if_rf_chain[p->if_chain];
-        p->freq_hz = (uint32_t)((int32_t)rf_rx_freq[p->rf_chain] + if_freq[p->if_chain]);
-        p->rssi = (float)buff[sz+5] + rf_rssi_offset[p->rf_chain];
+        p->rf_chain = (uint8_t)ctx->if_rf_chain[p->if_chain];
+        p->freq_hz = (uint32_t)((int32_t)ctx->rf_rx_freq[p->rf_chain] + ctx->if_freq[p->if_chain]);
+        p->rssi = (float)buff[sz+5] + ctx->rf_rssi_offset[p->rf_chain];
 
         if ((ifmod == IF_LORA_MULTI) || (ifmod == IF_LORA_STD)) {
             DEBUG_MSG("Note: LoRa packet\n");
@@ -1176,7 +2206,7 @@ int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
             if (ifmod == IF_LORA_MULTI) {
                 p->bandwidth = BW_125KHZ; /* fixed in hardware */
             } else {
-                p->bandwidth = lora_rx_bw; /* get the parameter from the config variable */
+                p->bandwidth = ctx->lora_rx_bw; /* get the parameter from the config variable */
             }
             sf = (buff[sz+1] >> 4) & 0x0F;
             switch (sf) {
@@ -1206,7 +2236,7 @@ int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
 
             /* timestamp correction code, base delay */
             if (ifmod == IF_LORA_STD) { /* if packet was received on the stand-alone LoRa modem */
-                switch (lora_rx_bw) {
+                switch (ctx->lora_rx_bw) {
                     case BW_125KHZ:
                         delay_x = 64;
                         bw_pow = 1;
@@ -1269,10 +2299,10 @@ int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
             p->snr = -128.0;
             p->snr_min = -128.0;
             p->snr_max = -128.0;
-            p->bandwidth = fsk_rx_bw;
-            p->datarate = fsk_rx_dr;
+            p->bandwidth = ctx->fsk_rx_bw;
+            p->datarate = ctx->fsk_rx_dr;
             p->coderate = CR_UNDEFINED;
-            timestamp_correction = ((uint32_t)680000 / fsk_rx_dr) - 20;
+            timestamp_correction = ((uint32_t)680000 / ctx->fsk_rx_dr) - 20;
 
             /* RSSI correction */
             p->rssi = RSSI_FSK_POLY_0 + RSSI_FSK_POLY_1 * p->rssi + RSSI_FSK_POLY_2 * pow(p->rssi, 2);
@@ -1295,7 +2325,14 @@ int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
         p->crc = (uint16_t)buff[sz+10] + ((uint16_t)buff[sz+11] << 8);
 
         /* advance packet FIFO */
-        lgw_reg_w(LGW_RX_PACKET_DATA_FIFO_NUM_STORED, 0);
+        lgw_reg_write<LGW_RX_PACKET_DATA_FIFO_NUM_STORED>(0);
+
+        /* a waiting TX load gets the registers between two packets */
+        if (lgw_reg_prio_pending() == true) {
+            lgw_spi_session_end();
+            ctx_yield();
+            lgw_spi_session_begin(LGW_SPI_OP_RECEIVE);
+        }
     }
 
     return nb_pkt_fetch;
@@ -1303,7 +2340,21 @@ int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_send(struct lgw_pkt_tx_s pkt_data) {
+int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
+    int nb_pkt;
+
+    lgw_reg_lock();
+    lgw_spi_session_begin(LGW_SPI_OP_RECEIVE);
+    nb_pkt = receive_packets(max_pkt, pkt_data);
+    lgw_spi_session_end();
+    lgw_reg_unlock();
+
+    return nb_pkt;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int send_packet(struct lgw_pkt_tx_s pkt_data) {
     int i;
     uint8_t buff[256+TX_METADATA_NB]; /* buffer to prepare the packet to send + metadata before SPI write burst */
     uint32_t part_int = 0; /* integer part for PLL register value calculation */
@@ -1317,7 +2368,7 @@ int lgw_send(struct lgw_pkt_tx_s pkt_data) {
     uint16_t tx_start_delay;
 
     /* check if the concentrator is running */
-    if (lgw_is_started == false) {
+    if (ctx->is_started == false) {
         DEBUG_MSG("ERROR: CONCENTRATOR IS NOT RUNNING, START IT BEFORE SENDING\n");
         return LGW_HAL_ERROR;
     }
@@ -1329,11 +2380,11 @@ int lgw_send(struct lgw_pkt_tx_s pkt_data) {
     }
 
     /* check input variables */
-    if (rf_tx_enable[pkt_data.rf_chain] == false) {
+    if (ctx->rf_tx_enable[pkt_data.rf_chain] == false) {
         DEBUG_MSG("ERROR: SELECTED RF_CHAIN IS DISABLED FOR TX ON SELECTED BOARD\n");
         return LGW_HAL_ERROR;
     }
-    if (rf_enable[pkt_data.rf_chain] == false) {
+    if (ctx->rf_enable[pkt_data.rf_chain] == false) {
         DEBUG_MSG("ERROR: SELECTED RF_CHAIN IS DISABLED\n");
         return LGW_HAL_ERROR;
     }
@@ -1381,31 +2432,34 @@ int lgw_send(struct lgw_pkt_tx_s pkt_data) {
     tx_start_delay = lgw_get_tx_start_delay(pkt_data.bandwidth);
 
     /* interpretation of TX power */
-    for (pow_index = txgain_lut.size-1; pow_index > 0; pow_index--) {
-        if (txgain_lut.lut[pow_index].rf_power <= pkt_data.rf_power) {
+    for (pow_index = ctx->txgain_lut.size-1; pow_index > 0; pow_index--) {
+        if (ctx->txgain_lut.lut[pow_index].rf_power <= pkt_data.rf_power) {
             break;
         }
     }
 
+    /* TX settings are written together, before the TX buffer is loaded */
+    lgw_reg_defer(true);
+
     /* loading TX imbalance correction */
-    target_mix_gain = txgain_lut.lut[pow_index].mix_gain;
+    target_mix_gain = ctx->txgain_lut.lut[pow_index].mix_gain;
     if (pkt_data.rf_chain == 0) { /* use radio A calibration table */
-        lgw_reg_w(LGW_TX_OFFSET_I, cal_offset_a_i[target_mix_gain - 8]);
-        lgw_reg_w(LGW_TX_OFFSET_Q, cal_offset_a_q[target_mix_gain - 8]);
+        lgw_reg_write<LGW_TX_OFFSET_I>(ctx->cal_offset_a_i[target_mix_gain - 8]);
+        lgw_reg_write<LGW_TX_OFFSET_Q>(ctx->cal_offset_a_q[target_mix_gain - 8]);
     } else { /* use radio B calibration table */
-        lgw_reg_w(LGW_TX_OFFSET_I, cal_offset_b_i[target_mix_gain - 8]);
-        lgw_reg_w(LGW_TX_OFFSET_Q, cal_offset_b_q[target_mix_gain - 8]);
+        lgw_reg_write<LGW_TX_OFFSET_I>(ctx->cal_offset_b_i[target_mix_gain - 8]);
+        lgw_reg_write<LGW_TX_OFFSET_Q>(ctx->cal_offset_b_q[target_mix_gain - 8]);
     }
 
     /* Set digital gain from LUT */
-    lgw_reg_w(LGW_TX_GAIN, txgain_lut.lut[pow_index].dig_gain);
+    lgw_reg_write<LGW_TX_GAIN>(ctx->txgain_lut.lut[pow_index].dig_gain);
 
     /* fixed metadata, useful payload and misc metadata compositing */
     transfer_size = TX_METADATA_NB + pkt_data.size; /*  */
     payload_offset = TX_METADATA_NB; /* start the payload just after the metadata */
 
     /* metadata 0 to 2, TX PLL frequency */
-    switch (rf_radio_type[0]) { /* we assume that there is only one radio type on the board */
+    switch (ctx->rf_radio_type[0]) { /* we assume that there is only one radio type on the board */
         case LGW_RADIO_TYPE_SX1255:
             part_int = pkt_data.freq_hz / (SX125x_32MHz_FRAC << 7); /* integer part, gives the MSB */
             part_frac = ((pkt_data.freq_hz % (SX125x_32MHz_FRAC << 7)) << 9) / SX125x_32MHz_FRAC; /* fractional part, gives middle part and LSB */
@@ -1415,7 +2469,7 @@ int lgw_send(struct lgw_pkt_tx_s pkt_data) {
             part_frac = ((pkt_data.freq_hz % (SX125x_32MHz_FRAC << 8)) << 8) / SX125x_32MHz_FRAC; /* fractional part, gives middle part and LSB */
             break;
         default:
-            DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d FOR RADIO TYPE\n", rf_radio_type[0]);
+            DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d FOR RADIO TYPE\n", ctx->rf_radio_type[0]);
             break;
     }
 
@@ -1546,11 +2600,13 @@ int lgw_send(struct lgw_pkt_tx_s pkt_data) {
 
     } else {
         DEBUG_MSG("ERROR: INVALID TX MODULATION..\n");
+        lgw_reg_defer(false);
         return LGW_HAL_ERROR;
     }
 
     /* Configure TX start delay based on TX notch filter */
-    lgw_reg_w(LGW_TX_START_DELAY, tx_start_delay);
+    lgw_reg_write<LGW_TX_START_DELAY>(tx_start_delay);
+    lgw_reg_defer(false);
 
     /* copy payload from user struct to buffer containing metadata */
     memcpy((void *)(buff + payload_offset), (void *)(pkt_data.payload), pkt_data.size);
@@ -1559,7 +2615,7 @@ int lgw_send(struct lgw_pkt_tx_s pkt_data) {
     lgw_abort_tx();
 
     /* put metadata + pasyload in the TX data buffer */
-    lgw_reg_w(LGW_TX_DATA_BUF_ADDR, 0);
+    lgw_reg_write<LGW_TX_DATA_BUF_ADDR>(0);
     lgw_reg_wb(LGW_TX_DATA_BUF_DATA, buff, transfer_size);
     DEBUG_MSG("Data a escribirse en el buffer de envío:\n");
     DEBUG_ARRAY(i, transfer_size, buff);
@@ -1567,15 +2623,15 @@ int lgw_send(struct lgw_pkt_tx_s pkt_data) {
  
     switch(pkt_data.tx_mode) {
         case IMMEDIATE:
-            lgw_reg_w(LGW_TX_TRIG_IMMEDIATE, 1);
+            lgw_reg_write<LGW_TX_TRIG_IMMEDIATE>(1);
             break;
 
         case TIMESTAMPED:
-            lgw_reg_w(LGW_TX_TRIG_DELAYED, 1);
+            lgw_reg_write<LGW_TX_TRIG_DELAYED>(1);
             break;
 
         case ON_GPS:
-            lgw_reg_w(LGW_TX_TRIG_GPS, 1);
+            lgw_reg_write<LGW_TX_TRIG_GPS>(1);
             break;
 
         default:
@@ -1589,15 +2645,41 @@ int lgw_send(struct lgw_pkt_tx_s pkt_data) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int lgw_send(struct lgw_pkt_tx_s pkt_data) {
+    int stat;
+
+    /* a TX load goes ahead of RX drains, its deadline is the RX1/RX2 window */
+    lgw_reg_lock_prio();
+    lgw_spi_session_begin(LGW_SPI_OP_SEND);
+    stat = send_packet(pkt_data);
+    lgw_spi_session_end();
+    lgw_reg_unlock_prio();
+
+    return stat;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_status(uint8_t select, uint8_t *code) {
     int32_t read_value;
+    bool started;
 
     /* check input variables */
     CHECK_NULL(code);
 
     if (select == TX_STATUS) {
-        lgw_reg_r(LGW_TX_STATUS, &read_value);
-        if (lgw_is_started == false) {
+        lgw_reg_lock();
+        if (ctx->start_cal_wait == true) {
+            lgw_reg_unlock();
+            DEBUG_MSG("ERROR: CALIBRATION RUNNING, NO STATUS TO RETURN\n");
+            return LGW_HAL_ERROR;
+        }
+        lgw_spi_session_begin(LGW_SPI_OP_STATUS);
+        lgw_reg_read<LGW_TX_STATUS>(&read_value);
+        lgw_spi_session_end();
+        started = ctx->is_started;
+        lgw_reg_unlock();
+        if (started == false) {
             *code = TX_OFF;
         } else if ((read_value & 0x10) == 0) { /* bit 4 @1: TX programmed */
             *code = TX_FREE;
@@ -1624,7 +2706,14 @@ int lgw_status(uint8_t select, uint8_t *code) {
 int lgw_abort_tx(void) {
     int i;
 
-    i = lgw_reg_w(LGW_TX_TRIG_ALL, 0);
+    lgw_reg_lock();
+    if (ctx->start_cal_wait == true) {
+        lgw_reg_unlock();
+        DEBUG_MSG("ERROR: CALIBRATION RUNNING, NO TX TO ABORT\n");
+        return LGW_HAL_ERROR;
+    }
+    i = lgw_reg_write<LGW_TX_TRIG_ALL>(0);
+    lgw_reg_unlock();
 
     if (i == LGW_REG_SUCCESS) return LGW_HAL_SUCCESS;
     else return LGW_HAL_ERROR;
@@ -1636,7 +2725,15 @@ int lgw_get_trigcnt(uint32_t* trig_cnt_us) {
     int i;
     int32_t val;
 
-    i = lgw_reg_r(LGW_TIMESTAMP, &val);
+    CHECK_NULL(trig_cnt_us);
+    lgw_reg_lock();
+    if (ctx->start_cal_wait == true) {
+        lgw_reg_unlock();
+        DEBUG_MSG("ERROR: CALIBRATION RUNNING, NO COUNTER TO READ\n");
+        return LGW_HAL_ERROR;
+    }
+    i = lgw_reg_read<LGW_TIMESTAMP>(&val);
+    lgw_reg_unlock();
     if (i == LGW_REG_SUCCESS) {
         *trig_cnt_us = (uint32_t)val;
         return LGW_HAL_SUCCESS;
@@ -1646,6 +2743,400 @@ int lgw_get_trigcnt(uint32_t* trig_cnt_us) {
 }
 
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_bus_stats(struct lgw_spi_bus_stats_s *stats, bool clear) {
+    int x = LGW_SPI_SUCCESS;
+    int i;
+
+    CHECK_NULL(stats);
+    lgw_reg_lock(); /* counters are updated by the accesses */
+    for (i = 0; i < LGW_SPI_OP_NB; ++i) {
+        x |= lgw_spi_get_target_bus_stats(ctx->reg.spi_target, i, &stats[i], clear);
+    }
+    lgw_reg_unlock();
+    if (x != LGW_SPI_SUCCESS) {
+        DEBUG_MSG("ERROR: CONCENTRATOR IS NOT CONNECTED, NO BUS COUNTERS\n");
+        return LGW_HAL_ERROR;
+    }
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_board_setconf(lgw_ctx_t *c, struct lgw_conf_board_s conf) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_board_setconf(conf);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_cal_setconf(lgw_ctx_t *c, struct lgw_conf_cal_s conf) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_cal_setconf(conf);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_rxrf_setconf(lgw_ctx_t *c, uint8_t rf_chain, struct lgw_conf_rxrf_s conf) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_rxrf_setconf(rf_chain, conf);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_rxrf_retune(lgw_ctx_t *c, uint8_t rf_chain, uint32_t freq_hz) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_rxrf_retune(rf_chain, freq_hz);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_reconfigure(lgw_ctx_t *c, const struct lgw_conf_rxrf_s *rfconf, const struct lgw_conf_rxif_s *ifconf) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_reconfigure(rfconf, ifconf);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_rxif_setconf(lgw_ctx_t *c, uint8_t if_chain, struct lgw_conf_rxif_s conf) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_rxif_setconf(if_chain, conf);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_txgain_setconf(lgw_ctx_t *c, struct lgw_tx_gain_lut_s *conf) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_txgain_setconf(conf);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_txgain_update(lgw_ctx_t *c, struct lgw_tx_gain_lut_s *conf) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_txgain_update(conf);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_start(lgw_ctx_t *c) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_start();
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_start_step(lgw_ctx_t *c, uint32_t *wait_ms) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_start_step(wait_ms);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_stop(lgw_ctx_t *c) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_stop();
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_receive(lgw_ctx_t *c, uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_receive(max_pkt, pkt_data);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_send(lgw_ctx_t *c, struct lgw_pkt_tx_s pkt_data) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock_prio(); /* the selected context is shared by all tasks, TX goes first */
+    prev = ctx_select(c);
+    x = lgw_send(pkt_data);
+    ctx_select(prev);
+    lgw_reg_unlock_prio();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_scrub(lgw_ctx_t *c, uint32_t *wait_ms) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_scrub(wait_ms);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_status(lgw_ctx_t *c, uint8_t select, uint8_t *code) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_status(select, code);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_cal_invalidate(lgw_ctx_t *c) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_cal_invalidate();
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_spi_tune_setconf(lgw_ctx_t *c, bool enable, uint32_t max_speed) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_spi_tune_setconf(enable, max_speed);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_fw_setconf(lgw_ctx_t *c, bool trusted) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_fw_setconf(trusted);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_get_spi_tune(lgw_ctx_t *c, struct lgw_spi_tune_s *report) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_get_spi_tune(report);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_get_boot_timing(lgw_ctx_t *c, struct lgw_boot_timing_s *timing) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_get_boot_timing(timing);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_get_agc_timing(lgw_ctx_t *c, struct lgw_agc_timing_s *timing) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_get_agc_timing(timing);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_scrub_setconf(lgw_ctx_t *c, uint8_t bw_share) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_scrub_setconf(bw_share);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_abort_tx(lgw_ctx_t *c) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_abort_tx();
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_get_trigcnt(lgw_ctx_t *c, uint32_t *trig_cnt_us) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_get_trigcnt(trig_cnt_us);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_ctx_get_bus_stats(lgw_ctx_t *c, struct lgw_spi_bus_stats_s *stats, bool clear) {
+    lgw_ctx_t *prev;
+    int x;
+
+    CHECK_NULL(c);
+    lgw_reg_lock(); /* the selected context is shared by all tasks */
+    prev = ctx_select(c);
+    x = lgw_get_bus_stats(stats, clear);
+    ctx_select(prev);
+    lgw_reg_unlock();
+    return x;
+}
+
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 uint32_t lgw_time_on_air(struct lgw_pkt_tx_s *packet) {
@@ -1703,7 +3194,7 @@ uint32_t lgw_time_on_air(struct lgw_pkt_tx_s *packet) {
                 PKT_PAYLOAD: x bytes
                 CRC: 0 or 2 bytes
         */
-        Tfsk = (8 * (double)(packet->preamble + fsk_sync_word_size + 1 + packet->size + ((packet->no_crc == true) ? 0 : 2)) / (double)packet->datarate) * 1E3;
+        Tfsk = (8 * (double)(packet->preamble + ctx->fsk_sync_word_size + 1 + packet->size + ((packet->no_crc == true) ? 0 : 2)) / (double)packet->datarate) * 1E3;
 
         /* Duration of packet */
         Tpacket = (uint32_t)Tfsk + 1; /* add margin for rounding */
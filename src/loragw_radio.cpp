@@ -19,6 +19,7 @@ Maintainer: Michael Coracin
 #include <stdint.h>     /* C99 types */
 #include <stdbool.h>    /* bool type */
 #include <stdio.h>      /* printf fprintf */
+#include <string.h>     /* memset */
 
 
 #include "loragw_sx125x.h"
@@ -38,13 +39,13 @@ Maintainer: Michael Coracin
     #define DEBUG_MSG(str)                Serial.print(str)
     #define DEBUG_PRINTF(fmt, args...)    {\
                                             memset(debug_msg, 0, sizeof(debug_msg));\
-                                            sprintf(debug_msg,"%s:%d: " fmt, __func__, __LINE__, args);\
+                                            snprintf(debug_msg, sizeof(debug_msg),"%s:%d: " fmt, __func__, __LINE__, args);\
                                             Serial.print(debug_msg);\
                                             }
     #define CHECK_NULL(a)                 {\
                                             if(a==NULL){\
                                                 memset(debug_msg, 0, sizeof(debug_msg));\
-                                                sprintf(debug_msg,"%s:%d: ERROR: NULL POINTER AS ARGUMENT\n", __FUNCTION__, __LINE__);\
+                                                snprintf(debug_msg, sizeof(debug_msg),"%s:%d: ERROR: NULL POINTER AS ARGUMENT\n", __FUNCTION__, __LINE__);\
                                                 Serial.print(debug_msg);\
                                                 return LGW_REG_ERROR;}\
                                           }
@@ -82,6 +83,20 @@ struct lgw_radio_type_version_s {
 
 #define PLL_LOCK_MAX_ATTEMPTS 5
 
+/* SPI master of a radio: DATA, DATA_READBACK (read-only, write ignored), ADDR
+written in one burst, then a CS pulse starts the radio transfer */
+#define SX125x_MASTER_BURST 3
+static_assert(lgw_reg_desc<LGW_SPI_RADIO_A__ADDR>::addr == (lgw_reg_desc<LGW_SPI_RADIO_A__DATA>::addr + SX125x_MASTER_BURST - 1), "radio A SPI master layout");
+static_assert(lgw_reg_desc<LGW_SPI_RADIO_B__ADDR>::addr == (lgw_reg_desc<LGW_SPI_RADIO_B__DATA>::addr + SX125x_MASTER_BURST - 1), "radio B SPI master layout");
+static_assert(LGW_REG_RADIO_NB == LGW_RF_CHAIN_NB, "one radio register image per RF chain");
+
+/* SX125x registers */
+#define SX125x_REG_MODE         0x00    /* oscillator, PLL and front-end enables */
+#define SX125x_REG_FRF_RX_MSB   0x01    /* RX PLL frequency, 3 bytes */
+#define SX125x_REG_RX_ANA_GAIN  0x0C    /* LNA impedance, baseband and LNA gains */
+#define SX125x_REG_VERSION      0x07
+#define SX125x_REG_STATUS       0x11    /* bit 1: RX PLL locked */
+
 const struct lgw_sx127x_FSK_bandwidth_s sx127x_FskBandwidths[] =
 {
     { 2600  , 2, 7 },   /* LGW_SX127X_RXBW_2K6_HZ */
@@ -110,55 +125,162 @@ const struct lgw_sx127x_FSK_bandwidth_s sx127x_FskBandwidths[] =
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
-extern void *lgw_spi_target; /*! generic pointer to the SPI device */
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS ---------------------------------------------------- */
 
+static bool sx125x_is_volatile(uint8_t addr);
+static int sx125x_rx_pll(uint8_t rf_radio_type, uint32_t freq_hz, struct lgw_sx125x_reg_s *pll);
+static int sx125x_pll_lock(uint8_t channel);
+static int32_t sx125x_host_take(void);
+static void sx125x_host_give(int32_t host_ctrl);
+
 void sx125x_write(uint8_t channel, uint8_t addr, uint8_t data);
 uint8_t sx125x_read(uint8_t channel, uint8_t addr);
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
-void sx125x_write(uint8_t channel, uint8_t addr, uint8_t data) {
-    int reg_add, reg_dat, reg_cs;
+/* SPI master procedures of one radio, its registers known at compile time.
+CS is left low by every procedure, so it is only pulsed once data and address are set */
+template <uint16_t reg_dat, uint16_t reg_cs>
+static int sx125x_master_w(uint8_t addr, uint8_t data) {
+    uint8_t buf[SX125x_MASTER_BURST] = {data, 0, (uint8_t)(0x80 | addr)}; /* MSB at 1 for write operation */
+    int reg_stat = LGW_REG_SUCCESS;
+
+    reg_stat |= lgw_reg_wb(reg_dat, buf, SX125x_MASTER_BURST);
+    reg_stat |= lgw_reg_write<reg_cs>(1);
+    reg_stat |= lgw_reg_write<reg_cs>(0);
+    return reg_stat;
+}
 
-    /* checking input parameters */
-    if (channel >= LGW_RF_CHAIN_NB) {
-        DEBUG_MSG("ERROR: INVALID RF_CHAIN\n");
-        return;
-    }
-    if (addr >= 0x7F) {
-        DEBUG_MSG("ERROR: ADDRESS OUT OF RANGE\n");
-        return;
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+template <uint16_t reg_dat, uint16_t reg_cs, uint16_t reg_rb>
+static uint8_t sx125x_master_r(uint8_t addr) {
+    uint8_t buf[SX125x_MASTER_BURST] = {0, 0, addr}; /* MSB at 0 for read operation */
+    int32_t read_value = 0;
+
+    lgw_reg_wb(reg_dat, buf, SX125x_MASTER_BURST);
+    lgw_reg_write<reg_cs>(1);
+    lgw_reg_write<reg_cs>(0);
+    lgw_reg_read<reg_rb>(&read_value);
+    return (uint8_t)read_value;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int sx125x_master_w_channel(uint8_t channel, uint8_t addr, uint8_t data) {
+    switch (channel) {
+        case 0:
+            return sx125x_master_w<LGW_SPI_RADIO_A__DATA, LGW_SPI_RADIO_A__CS>(addr, data);
+
+        case 1:
+            return sx125x_master_w<LGW_SPI_RADIO_B__DATA, LGW_SPI_RADIO_B__CS>(addr, data);
+
+        default:
+            DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\n", channel);
+            return LGW_REG_ERROR;
     }
+}
 
-    /* selecting the target radio */
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint8_t sx125x_master_r_channel(uint8_t channel, uint8_t addr) {
     switch (channel) {
         case 0:
-            reg_add = LGW_SPI_RADIO_A__ADDR;
-            reg_dat = LGW_SPI_RADIO_A__DATA;
-            reg_cs  = LGW_SPI_RADIO_A__CS;
-            break;
+            return sx125x_master_r<LGW_SPI_RADIO_A__DATA, LGW_SPI_RADIO_A__CS, LGW_SPI_RADIO_A__DATA_READBACK>(addr);
 
         case 1:
-            reg_add = LGW_SPI_RADIO_B__ADDR;
-            reg_dat = LGW_SPI_RADIO_B__DATA;
-            reg_cs  = LGW_SPI_RADIO_B__CS;
-            break;
+            return sx125x_master_r<LGW_SPI_RADIO_B__DATA, LGW_SPI_RADIO_B__CS, LGW_SPI_RADIO_B__DATA_READBACK>(addr);
 
         default:
             DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\n", channel);
-            return;
+            return 0;
     }
+}
 
-    /* SPI master data write procedure */
-    lgw_reg_w(reg_cs, 0);
-    lgw_reg_w(reg_add, 0x80 | addr); /* MSB at 1 for write operation */
-    lgw_reg_w(reg_dat, data);
-    lgw_reg_w(reg_cs, 1);
-    lgw_reg_w(reg_cs, 0);
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* once the concentrator runs the AGC MCU drives the radios, the host takes
+them back for the access; returns the control found, for sx125x_host_give */
+static int32_t sx125x_host_take(void) {
+    int32_t host_ctrl = 1;
+
+    lgw_reg_read<LGW_FORCE_HOST_RADIO_CTRL>(&host_ctrl);
+    if (host_ctrl == 0) {
+        lgw_reg_write<LGW_FORCE_HOST_RADIO_CTRL>(1);
+    }
+    return host_ctrl;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void sx125x_host_give(int32_t host_ctrl) {
+    if (host_ctrl == 0) {
+        lgw_reg_write<LGW_FORCE_HOST_RADIO_CTRL>(0); /* back to the AGC MCU */
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* registers the image does not follow: writes to the mode register start
+sequences, and the AGC firmware reprograms the TX PLL and TX gains */
+static bool sx125x_is_volatile(uint8_t addr) {
+    switch (addr) {
+        case SX125x_REG_MODE:
+        case 0x04: /* TX PLL frequency */
+        case 0x05:
+        case 0x06:
+        case 0x08: /* TX mixer and DAC gains */
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* radio write going through the register image, false if the radio already holds the value */
+static bool sx125x_image_w(uint8_t channel, uint8_t addr, uint8_t data, int *reg_stat) {
+    struct lgw_reg_radio_s *img = lgw_reg_radio(channel);
+    bool known = ((img->valid[addr >> 3] & (1 << (addr & 7))) != 0);
+
+    if (known && (img->val[addr] == data)) {
+        ++img->nb_skipped;
+        return false;
+    }
+    *reg_stat |= sx125x_master_w_channel(channel, addr, data);
+    ++img->nb_written;
+    if (sx125x_is_volatile(addr) == false) {
+        img->val[addr] = data;
+        img->valid[addr >> 3] |= 1 << (addr & 7);
+    }
+    return true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void sx125x_write(uint8_t channel, uint8_t addr, uint8_t data) {
+    int reg_stat = LGW_REG_SUCCESS;
+
+
+    /* checking input parameters */
+    if (channel >= LGW_RF_CHAIN_NB) {
+        DEBUG_MSG("ERROR: INVALID RF_CHAIN\n");
+        return;
+    }
+    if (addr >= 0x7F) {
+        DEBUG_MSG("ERROR: ADDRESS OUT OF RANGE\n");
+        return;
+    }
+
+    /* SPI master data write procedure, on the target radio */
+    lgw_reg_lock();
+    lgw_spi_session_begin(LGW_SPI_OP_RADIO);
+    sx125x_image_w(channel, addr, data, &reg_stat);
+    lgw_spi_session_end();
+    lgw_reg_unlock();
 
     return;
 }
@@ -166,8 +288,7 @@ void sx125x_write(uint8_t channel, uint8_t addr, uint8_t data) {
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 uint8_t sx125x_read(uint8_t channel, uint8_t addr) {
-    int reg_add, reg_dat, reg_cs, reg_rb;
-    int32_t read_value;
+    uint8_t read_value = 0;
 
     /* checking input parameters */
     if (channel >= LGW_RF_CHAIN_NB) {
@@ -179,70 +300,129 @@ uint8_t sx125x_read(uint8_t channel, uint8_t addr) {
         return 0;
     }
 
-    /* selecting the target radio */
-    switch (channel) {
-        case 0:
-            reg_add = LGW_SPI_RADIO_A__ADDR;
-            reg_dat = LGW_SPI_RADIO_A__DATA;
-            reg_cs  = LGW_SPI_RADIO_A__CS;
-            reg_rb  = LGW_SPI_RADIO_A__DATA_READBACK;
-            break;
+    /* SPI master data read procedure, on the target radio */
+    lgw_reg_lock();
+    lgw_spi_session_begin(LGW_SPI_OP_RADIO);
+    read_value = sx125x_master_r_channel(channel, addr);
+    lgw_spi_session_end();
+    lgw_reg_unlock();
 
-        case 1:
-            reg_add = LGW_SPI_RADIO_B__ADDR;
-            reg_dat = LGW_SPI_RADIO_B__DATA;
-            reg_cs  = LGW_SPI_RADIO_B__CS;
-            reg_rb  = LGW_SPI_RADIO_B__DATA_READBACK;
-            break;
+    return read_value;
+}
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* RX PLL registers for a frequency, 3 entries */
+static int sx125x_rx_pll(uint8_t rf_radio_type, uint32_t freq_hz, struct lgw_sx125x_reg_s *pll) {
+    uint32_t part_int = 0;
+    uint32_t part_frac = 0;
+
+    switch (rf_radio_type) {
+        case LGW_RADIO_TYPE_SX1255:
+            part_int = freq_hz / (SX125x_32MHz_FRAC << 7); /* integer part, gives the MSB */
+            part_frac = ((freq_hz % (SX125x_32MHz_FRAC << 7)) << 9) / SX125x_32MHz_FRAC; /* fractional part, gives middle part and LSB */
+            break;
+        case LGW_RADIO_TYPE_SX1257:
+            part_int = freq_hz / (SX125x_32MHz_FRAC << 8); /* integer part, gives the MSB */
+            part_frac = ((freq_hz % (SX125x_32MHz_FRAC << 8)) << 8) / SX125x_32MHz_FRAC; /* fractional part, gives middle part and LSB */
+            break;
         default:
-            DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\n", channel);
-            return 0;
+            DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d FOR RADIO TYPE\n", rf_radio_type);
+            return LGW_REG_ERROR;
     }
 
-    /* SPI master data read procedure */
-    lgw_reg_w(reg_cs, 0);
-    lgw_reg_w(reg_add, addr); /* MSB at 0 for read operation */
-    lgw_reg_w(reg_dat, 0);
-    lgw_reg_w(reg_cs, 1);
-    lgw_reg_w(reg_cs, 0);
-    lgw_reg_r(reg_rb, &read_value);
+    pll[0] = {SX125x_REG_FRF_RX_MSB, (uint8_t)(0xFF & part_int)}; /* Most Significant Byte */
+    pll[1] = {SX125x_REG_FRF_RX_MSB + 1, (uint8_t)(0xFF & (part_frac >> 8))}; /* middle byte */
+    pll[2] = {SX125x_REG_FRF_RX_MSB + 2, (uint8_t)(0xFF & part_frac)}; /* Least Significant Byte */
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    return (uint8_t)read_value;
+/* start the oscillator and RX PLL, wait for the lock */
+static int sx125x_pll_lock(uint8_t channel) {
+    int cpt_attempts = 0;
+
+    do {
+        if (cpt_attempts >= PLL_LOCK_MAX_ATTEMPTS) {
+            DEBUG_MSG("ERROR: FAIL TO LOCK PLL\n");
+            return LGW_REG_ERROR;
+        }
+        sx125x_write(channel, SX125x_REG_MODE, 1); /* enable Xtal oscillator */
+        sx125x_write(channel, SX125x_REG_MODE, 3); /* Enable RX (PLL+FE) */
+        ++cpt_attempts;
+        DEBUG_PRINTF("Note: SX125x #%d PLL start (attempt %d)\n", channel, cpt_attempts);
+        wait_ms(1);
+    } while((sx125x_read(channel, SX125x_REG_STATUS) & 0x02) == 0);
+
+    return LGW_REG_SUCCESS;
 }
 
 
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
+int sx125x_write_table(uint8_t channel, const struct lgw_sx125x_reg_s *table, uint8_t nb) {
+    int reg_stat = LGW_REG_SUCCESS;
+    int i;
+
+    /* checking input parameters */
+    CHECK_NULL(table);
+    if (channel >= LGW_RF_CHAIN_NB) {
+        DEBUG_MSG("ERROR: INVALID RF_CHAIN\n");
+        return LGW_REG_ERROR;
+    }
+    for (i = 0; i < nb; ++i) {
+        if (table[i].addr >= 0x7F) {
+            DEBUG_MSG("ERROR: ADDRESS OUT OF RANGE\n");
+            return LGW_REG_ERROR;
+        }
+    }
+
+    /* one bus session, in the order of the table, values the radio holds are not sent again */
+    lgw_reg_lock();
+    lgw_spi_session_begin(LGW_SPI_OP_RADIO);
+    for (i = 0; i < nb; ++i) {
+        sx125x_image_w(channel, table[i].addr, table[i].data, &reg_stat);
+    }
+    lgw_spi_session_end();
+    lgw_reg_unlock();
+
+    return (reg_stat == LGW_REG_SUCCESS) ? LGW_REG_SUCCESS : LGW_REG_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_setup_sx125x(uint8_t rf_chain, uint8_t rf_clkout, bool rf_enable, uint8_t rf_radio_type, uint32_t freq_hz) {
-    uint32_t part_int = 0;
-    uint32_t part_frac = 0;
-    int cpt_attempts = 0;
+    struct lgw_sx125x_reg_s setup[12]; /* startup register list, written in one session */
+    uint8_t nb = 0;
 
     if (rf_chain >= LGW_RF_CHAIN_NB) {
         DEBUG_MSG("ERROR: INVALID RF_CHAIN\n");
         return -1;
     }
 
+    /* the radio was just reset, nothing of the register image holds anymore */
+    memset(lgw_reg_radio(rf_chain)->valid, 0, sizeof lgw_reg_radio(rf_chain)->valid);
+
     /* Get version to identify SX1255/57 silicon revision */
-    DEBUG_PRINTF("Note: SX125x #%d version register returned 0x%02x\n", rf_chain, sx125x_read(rf_chain, 0x07));
+    DEBUG_PRINTF("Note: SX125x #%d version register returned 0x%02x\n", rf_chain, sx125x_read(rf_chain, SX125x_REG_VERSION));
 
     /* General radio setup */
     if (rf_clkout == rf_chain) {
-        sx125x_write(rf_chain, 0x10, SX125x_TX_DAC_CLK_SEL + 2);
+        setup[nb++] = {0x10, SX125x_TX_DAC_CLK_SEL + 2};
         DEBUG_PRINTF("Note: SX125x #%d clock output enabled\n", rf_chain);
     } else {
-        sx125x_write(rf_chain, 0x10, SX125x_TX_DAC_CLK_SEL);
+        setup[nb++] = {0x10, SX125x_TX_DAC_CLK_SEL};
         DEBUG_PRINTF("Note: SX125x #%d clock output disabled\n", rf_chain);
     }
 
     switch (rf_radio_type) {
         case LGW_RADIO_TYPE_SX1255:
-            sx125x_write(rf_chain, 0x28, SX125x_XOSC_GM_STARTUP + SX125x_XOSC_DISABLE*16);
+            setup[nb++] = {0x28, SX125x_XOSC_GM_STARTUP + SX125x_XOSC_DISABLE*16};
             break;
         case LGW_RADIO_TYPE_SX1257:
-            sx125x_write(rf_chain, 0x26, SX125x_XOSC_GM_STARTUP + SX125x_XOSC_DISABLE*16);
+            setup[nb++] = {0x26, SX125x_XOSC_GM_STARTUP + SX125x_XOSC_DISABLE*16};
             break;
         default:
             DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d FOR RADIO TYPE\n", rf_radio_type);
@@ -251,53 +431,182 @@ int lgw_setup_sx125x(uint8_t rf_chain, uint8_t rf_clkout, bool rf_enable, uint8_
 
     if (rf_enable == true) {
         /* Tx gain and trim */
-        sx125x_write(rf_chain, 0x08, SX125x_TX_MIX_GAIN + SX125x_TX_DAC_GAIN*16);
-        sx125x_write(rf_chain, 0x0A, SX125x_TX_ANA_BW + SX125x_TX_PLL_BW*32);
-        sx125x_write(rf_chain, 0x0B, SX125x_TX_DAC_BW);
+        setup[nb++] = {0x08, SX125x_TX_MIX_GAIN + SX125x_TX_DAC_GAIN*16};
+        setup[nb++] = {0x0A, SX125x_TX_ANA_BW + SX125x_TX_PLL_BW*32};
+        setup[nb++] = {0x0B, SX125x_TX_DAC_BW};
 
         /* Rx gain and trim */
-        sx125x_write(rf_chain, 0x0C, SX125x_LNA_ZIN + SX125x_RX_BB_GAIN*2 + SX125x_RX_LNA_GAIN*32);
-        sx125x_write(rf_chain, 0x0D, SX125x_RX_BB_BW + SX125x_RX_ADC_TRIM*4 + SX125x_RX_ADC_BW*32);
-        sx125x_write(rf_chain, 0x0E, SX125x_ADC_TEMP + SX125x_RX_PLL_BW*2);
+        setup[nb++] = {SX125x_REG_RX_ANA_GAIN, SX125x_LNA_ZIN + SX125x_RX_BB_GAIN*2 + SX125x_RX_LNA_GAIN*32};
+        setup[nb++] = {0x0D, SX125x_RX_BB_BW + SX125x_RX_ADC_TRIM*4 + SX125x_RX_ADC_BW*32};
+        setup[nb++] = {0x0E, SX125x_ADC_TEMP + SX125x_RX_PLL_BW*2};
 
         /* set RX PLL frequency */
-        switch (rf_radio_type) {
-            case LGW_RADIO_TYPE_SX1255:
-                part_int = freq_hz / (SX125x_32MHz_FRAC << 7); /* integer part, gives the MSB */
-                part_frac = ((freq_hz % (SX125x_32MHz_FRAC << 7)) << 9) / SX125x_32MHz_FRAC; /* fractional part, gives middle part and LSB */
-                break;
-            case LGW_RADIO_TYPE_SX1257:
-                part_int = freq_hz / (SX125x_32MHz_FRAC << 8); /* integer part, gives the MSB */
-                part_frac = ((freq_hz % (SX125x_32MHz_FRAC << 8)) << 8) / SX125x_32MHz_FRAC; /* fractional part, gives middle part and LSB */
-                break;
-            default:
-                DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d FOR RADIO TYPE\n", rf_radio_type);
-                break;
-        }
-
-        sx125x_write(rf_chain, 0x01,0xFF & part_int); /* Most Significant Byte */
-        sx125x_write(rf_chain, 0x02,0xFF & (part_frac >> 8)); /* middle byte */
-        sx125x_write(rf_chain, 0x03,0xFF & part_frac); /* Least Significant Byte */
+        sx125x_rx_pll(rf_radio_type, freq_hz, &setup[nb]);
+        nb += 3;
+        sx125x_write_table(rf_chain, setup, nb);
 
         /* start and PLL lock */
-        do {
-            if (cpt_attempts >= PLL_LOCK_MAX_ATTEMPTS) {
-                DEBUG_MSG("ERROR: FAIL TO LOCK PLL\n");
-                return -1;
-            }
-            sx125x_write(rf_chain, 0x00, 1); /* enable Xtal oscillator */
-            sx125x_write(rf_chain, 0x00, 3); /* Enable RX (PLL+FE) */
-            ++cpt_attempts;
-            DEBUG_PRINTF("Note: SX125x #%d PLL start (attempt %d)\n", rf_chain, cpt_attempts);
-            wait_ms(1);
-        } while((sx125x_read(rf_chain, 0x11) & 0x02) == 0);
+        if (sx125x_pll_lock(rf_chain) != LGW_REG_SUCCESS) {
+            return -1;
+        }
     } else {
+        sx125x_write_table(rf_chain, setup, nb);
         DEBUG_PRINTF("Note: SX125x #%d kept in standby mode\n", rf_chain);
     }
 
     return 0;
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx125x_set_rx_freq(uint8_t channel, uint8_t rf_radio_type, uint32_t freq_hz) {
+    struct lgw_sx125x_reg_s pll[3];
+    int reg_stat = LGW_REG_SUCCESS;
+    int32_t host_ctrl;
+    bool changed = false;
+    int i;
+
+    /* checking input parameters */
+    if (channel >= LGW_RF_CHAIN_NB) {
+        DEBUG_MSG("ERROR: INVALID RF_CHAIN\n");
+        return LGW_REG_ERROR;
+    }
+    if (sx125x_rx_pll(rf_radio_type, freq_hz, pll) != LGW_REG_SUCCESS) {
+        return LGW_REG_ERROR;
+    }
+
+    /* only the bytes that differ, the PLL is relocked if any did */
+    lgw_reg_lock();
+    host_ctrl = sx125x_host_take();
+    lgw_spi_session_begin(LGW_SPI_OP_RADIO);
+    for (i = 0; i < 3; ++i) {
+        changed |= sx125x_image_w(channel, pll[i].addr, pll[i].data, &reg_stat);
+    }
+    lgw_spi_session_end();
+    if ((changed == true) && (reg_stat == LGW_REG_SUCCESS)) {
+        reg_stat = sx125x_pll_lock(channel);
+    }
+    sx125x_host_give(host_ctrl);
+    lgw_reg_unlock();
+
+    return (reg_stat == LGW_REG_SUCCESS) ? LGW_REG_SUCCESS : LGW_REG_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx125x_set_rx_gain(uint8_t channel, uint8_t lna_gain, uint8_t bb_gain) {
+    int reg_stat = LGW_REG_SUCCESS;
+    int32_t host_ctrl;
+
+    /* checking input parameters */
+    if (channel >= LGW_RF_CHAIN_NB) {
+        DEBUG_MSG("ERROR: INVALID RF_CHAIN\n");
+        return LGW_REG_ERROR;
+    }
+    if ((lna_gain < 1) || (lna_gain > 6) || (bb_gain > 15)) {
+        DEBUG_MSG("ERROR: RX GAIN OUT OF RANGE\n");
+        return LGW_REG_ERROR;
+    }
+
+    lgw_reg_lock();
+    host_ctrl = sx125x_host_take();
+    lgw_spi_session_begin(LGW_SPI_OP_RADIO);
+    sx125x_image_w(channel, SX125x_REG_RX_ANA_GAIN, SX125x_LNA_ZIN + bb_gain*2 + lna_gain*32, &reg_stat);
+    lgw_spi_session_end();
+    sx125x_host_give(host_ctrl);
+    lgw_reg_unlock();
+
+    return (reg_stat == LGW_REG_SUCCESS) ? LGW_REG_SUCCESS : LGW_REG_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx125x_verify(uint8_t channel, bool repair, uint8_t *nb_mismatch) {
+    struct lgw_reg_radio_s *img;
+    int reg_stat = LGW_REG_SUCCESS;
+    int32_t host_ctrl;
+    uint8_t addr;
+
+    /* checking input parameters */
+    CHECK_NULL(nb_mismatch);
+    if (channel >= LGW_RF_CHAIN_NB) {
+        DEBUG_MSG("ERROR: INVALID RF_CHAIN\n");
+        return LGW_REG_ERROR;
+    }
+    img = lgw_reg_radio(channel);
+    *nb_mismatch = 0;
+
+    /* read back every register of the image */
+    lgw_reg_lock();
+    host_ctrl = sx125x_host_take();
+    lgw_spi_session_begin(LGW_SPI_OP_RADIO);
+    for (addr = 0; addr < 0x7F; ++addr) {
+        if ((img->valid[addr >> 3] & (1 << (addr & 7))) == 0) {
+            continue;
+        }
+        if (sx125x_master_r_channel(channel, addr) == img->val[addr]) {
+            continue;
+        }
+        ++(*nb_mismatch);
+        DEBUG_PRINTF("WARNING: SX125x #%d register 0x%02x differs from its image\n", channel, addr);
+        if (repair == true) {
+            reg_stat |= sx125x_master_w_channel(channel, addr, img->val[addr]);
+            ++img->nb_written;
+        } else {
+            img->valid[addr >> 3] &= ~(1 << (addr & 7)); /* next write goes through */
+        }
+    }
+    lgw_spi_session_end();
+    sx125x_host_give(host_ctrl);
+    lgw_reg_unlock();
+
+    return (reg_stat == LGW_REG_SUCCESS) ? LGW_REG_SUCCESS : LGW_REG_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx125x_get_stats(uint8_t channel, struct lgw_sx125x_stats_s *stats, bool clear) {
+    struct lgw_reg_radio_s *img;
+
+    CHECK_NULL(stats);
+    if (channel >= LGW_RF_CHAIN_NB) {
+        DEBUG_MSG("ERROR: INVALID RF_CHAIN\n");
+        return LGW_REG_ERROR;
+    }
+    img = lgw_reg_radio(channel);
+    stats->nb_written = img->nb_written;
+    stats->nb_skipped = img->nb_skipped;
+    if (clear == true) {
+        img->nb_written = 0;
+        img->nb_skipped = 0;
+    }
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx125x_wait_ready(uint8_t channel, uint32_t timeout_ms) {
+    unsigned long t0 = millis();
+    uint8_t version;
+
+    if (channel >= LGW_RF_CHAIN_NB) {
+        DEBUG_MSG("ERROR: INVALID RF_CHAIN\n");
+        return LGW_REG_ERROR;
+    }
+
+    /* an unpowered radio leaves the SPI master data line stuck low or high */
+    for (;;) {
+        version = sx125x_read(channel, SX125x_REG_VERSION);
+        if ((version != 0x00) && (version != 0xFF)) {
+            DEBUG_PRINTF("Note: SX125x #%d ready after %lu ms\n", channel, millis() - t0);
+            return LGW_REG_SUCCESS;
+        }
+        if ((millis() - t0) >= timeout_ms) {
+            return LGW_REG_ERROR;
+        }
+        wait_ms(1);
+    }
+}
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
@@ -23,7 +23,9 @@ Maintainer: Sylvain Miermont
 #include <stdint.h>     /* C99 types */
 #include <stdbool.h>    /* bool type */
 #include <stdio.h>      /* printf fprintf */
+#include <string.h>     /* memset */
 
+#include "loragw_aux.h"    /* wait_ms */
 #include "loragw_spi.h"
 #include "loragw_reg.h"
 #include "loragw_debug.h"   /* Activar mensajes seriales */
@@ -36,13 +38,13 @@ Maintainer: Sylvain Miermont
     #define DEBUG_MSG(str)                Serial.print(str)
     #define DEBUG_PRINTF(fmt, args...)    {\
                                             memset(debug_msg, 0, sizeof(debug_msg));\
-                                            sprintf(debug_msg,"%s:%d: " fmt, __func__, __LINE__, args);\
+                                            snprintf(debug_msg, sizeof(debug_msg),"%s:%d: " fmt, __func__, __LINE__, args);\
                                             Serial.print(debug_msg);\
                                             }
     #define CHECK_NULL(a)                 {\
                                             if(a==NULL){\
                                                 memset(debug_msg, 0, sizeof(debug_msg));\
-                                                sprintf(debug_msg,"%s:%d: ERROR: NULL POINTER AS ARGUMENT\n", __FUNCTION__, __LINE__);\
+                                                snprintf(debug_msg, sizeof(debug_msg),"%s:%d: ERROR: NULL POINTER AS ARGUMENT\n", __FUNCTION__, __LINE__);\
                                                 Serial.print(debug_msg);\
                                                 return LGW_REG_ERROR;}\
                                           }
@@ -52,371 +54,111 @@ Maintainer: Sylvain Miermont
     #define CHECK_NULL(a)               if(a==NULL){return LGW_REG_ERROR;}
 #endif
 
+/* register lock held until the end of the enclosing scope */
+#define REG_LOCK_SCOPE()    struct reg_lock_scope_s reg_lock_scope
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct reg_lock_scope_s {
+    reg_lock_scope_s() { lgw_reg_lock(); }
+    ~reg_lock_scope_s() { lgw_reg_unlock(); }
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE CONSTANTS ---------------------------------------------------- */
 
 #define PAGE_ADDR        0x00
 #define PAGE_MASK        0x03
 
-/*
-auto generated register mapping for C code : 11-Jul-2013 13:20:40
-this file contains autogenerated C struct used to access the LoRa register from the Primer firmware
-this file is autogenerated from registers description
-293 registers are defined
-*/
-const struct lgw_reg_s loregs[LGW_TOTALREGS] = {
-    {-1,0,0,0,2,0,0},         /* PAGE_REG */
-    {-1,0,7,0,1,0,0},         /* SOFT_RESET */
-    {-1,1,0,0,8,1,103},       /* VERSION */
-    {-1,2,0,0,16,0,0},        /* RX_DATA_BUF_ADDR */
-    {-1,4,0,0,8,0,0},         /* RX_DATA_BUF_DATA */
-    {-1,5,0,0,8,0,0},         /* TX_DATA_BUF_ADDR */
-    {-1,6,0,0,8,0,0},         /* TX_DATA_BUF_DATA */
-    {-1,7,0,0,8,0,0},         /* CAPTURE_RAM_ADDR */
-    {-1,8,0,0,8,1,0},         /* CAPTURE_RAM_DATA */
-    {-1,9,0,0,8,0,0},         /* MCU_PROM_ADDR */
-    {-1,10,0,0,8,0,0},        /* MCU_PROM_DATA */
-    {-1,11,0,0,8,0,0},        /* RX_PACKET_DATA_FIFO_NUM_STORED */
-    {-1,12,0,0,16,1,0},       /* RX_PACKET_DATA_FIFO_ADDR_POINTER */
-    {-1,14,0,0,8,1,0},        /* RX_PACKET_DATA_FIFO_STATUS */
-    {-1,15,0,0,8,1,0},        /* RX_PACKET_DATA_FIFO_PAYLOAD_SIZE */
-    {-1,16,0,0,1,0,0},        /* MBWSSF_MODEM_ENABLE */
-    {-1,16,1,0,1,0,0},        /* CONCENTRATOR_MODEM_ENABLE */
-    {-1,16,2,0,1,0,0},        /* FSK_MODEM_ENABLE */
-    {-1,16,3,0,1,0,0},        /* GLOBAL_EN */
-    {-1,17,0,0,1,0,1},        /* CLK32M_EN */
-    {-1,17,1,0,1,0,1},        /* CLKHS_EN */
-    {-1,18,0,0,1,0,0},        /* START_BIST0 */
-    {-1,18,1,0,1,0,0},        /* START_BIST1 */
-    {-1,18,2,0,1,0,0},        /* CLEAR_BIST0 */
-    {-1,18,3,0,1,0,0},        /* CLEAR_BIST1 */
-    {-1,19,0,0,1,1,0},        /* BIST0_FINISHED */
-    {-1,19,1,0,1,1,0},        /* BIST1_FINISHED */
-    {-1,20,0,0,1,1,0},        /* MCU_AGC_PROG_RAM_BIST_STATUS */
-    {-1,20,1,0,1,1,0},        /* MCU_ARB_PROG_RAM_BIST_STATUS */
-    {-1,20,2,0,1,1,0},        /* CAPTURE_RAM_BIST_STATUS */
-    {-1,20,3,0,1,1,0},        /* CHAN_FIR_RAM0_BIST_STATUS */
-    {-1,20,4,0,1,1,0},        /* CHAN_FIR_RAM1_BIST_STATUS */
-    {-1,21,0,0,1,1,0},        /* CORR0_RAM_BIST_STATUS */
-    {-1,21,1,0,1,1,0},        /* CORR1_RAM_BIST_STATUS */
-    {-1,21,2,0,1,1,0},        /* CORR2_RAM_BIST_STATUS */
-    {-1,21,3,0,1,1,0},        /* CORR3_RAM_BIST_STATUS */
-    {-1,21,4,0,1,1,0},        /* CORR4_RAM_BIST_STATUS */
-    {-1,21,5,0,1,1,0},        /* CORR5_RAM_BIST_STATUS */
-    {-1,21,6,0,1,1,0},        /* CORR6_RAM_BIST_STATUS */
-    {-1,21,7,0,1,1,0},        /* CORR7_RAM_BIST_STATUS */
-    {-1,22,0,0,1,1,0},        /* MODEM0_RAM0_BIST_STATUS */
-    {-1,22,1,0,1,1,0},        /* MODEM1_RAM0_BIST_STATUS */
-    {-1,22,2,0,1,1,0},        /* MODEM2_RAM0_BIST_STATUS */
-    {-1,22,3,0,1,1,0},        /* MODEM3_RAM0_BIST_STATUS */
-    {-1,22,4,0,1,1,0},        /* MODEM4_RAM0_BIST_STATUS */
-    {-1,22,5,0,1,1,0},        /* MODEM5_RAM0_BIST_STATUS */
-    {-1,22,6,0,1,1,0},        /* MODEM6_RAM0_BIST_STATUS */
-    {-1,22,7,0,1,1,0},        /* MODEM7_RAM0_BIST_STATUS */
-    {-1,23,0,0,1,1,0},        /* MODEM0_RAM1_BIST_STATUS */
-    {-1,23,1,0,1,1,0},        /* MODEM1_RAM1_BIST_STATUS */
-    {-1,23,2,0,1,1,0},        /* MODEM2_RAM1_BIST_STATUS */
-    {-1,23,3,0,1,1,0},        /* MODEM3_RAM1_BIST_STATUS */
-    {-1,23,4,0,1,1,0},        /* MODEM4_RAM1_BIST_STATUS */
-    {-1,23,5,0,1,1,0},        /* MODEM5_RAM1_BIST_STATUS */
-    {-1,23,6,0,1,1,0},        /* MODEM6_RAM1_BIST_STATUS */
-    {-1,23,7,0,1,1,0},        /* MODEM7_RAM1_BIST_STATUS */
-    {-1,24,0,0,1,1,0},        /* MODEM0_RAM2_BIST_STATUS */
-    {-1,24,1,0,1,1,0},        /* MODEM1_RAM2_BIST_STATUS */
-    {-1,24,2,0,1,1,0},        /* MODEM2_RAM2_BIST_STATUS */
-    {-1,24,3,0,1,1,0},        /* MODEM3_RAM2_BIST_STATUS */
-    {-1,24,4,0,1,1,0},        /* MODEM4_RAM2_BIST_STATUS */
-    {-1,24,5,0,1,1,0},        /* MODEM5_RAM2_BIST_STATUS */
-    {-1,24,6,0,1,1,0},        /* MODEM6_RAM2_BIST_STATUS */
-    {-1,24,7,0,1,1,0},        /* MODEM7_RAM2_BIST_STATUS */
-    {-1,25,0,0,1,1,0},        /* MODEM_MBWSSF_RAM0_BIST_STATUS */
-    {-1,25,1,0,1,1,0},        /* MODEM_MBWSSF_RAM1_BIST_STATUS */
-    {-1,25,2,0,1,1,0},        /* MODEM_MBWSSF_RAM2_BIST_STATUS */
-    {-1,26,0,0,1,1,0},        /* MCU_AGC_DATA_RAM_BIST0_STATUS */
-    {-1,26,1,0,1,1,0},        /* MCU_AGC_DATA_RAM_BIST1_STATUS */
-    {-1,26,2,0,1,1,0},        /* MCU_ARB_DATA_RAM_BIST0_STATUS */
-    {-1,26,3,0,1,1,0},        /* MCU_ARB_DATA_RAM_BIST1_STATUS */
-    {-1,26,4,0,1,1,0},        /* TX_TOP_RAM_BIST0_STATUS */
-    {-1,26,5,0,1,1,0},        /* TX_TOP_RAM_BIST1_STATUS */
-    {-1,26,6,0,1,1,0},        /* DATA_MNGT_RAM_BIST0_STATUS */
-    {-1,26,7,0,1,1,0},        /* DATA_MNGT_RAM_BIST1_STATUS */
-    {-1,27,0,0,4,0,0},        /* GPIO_SELECT_INPUT */
-    {-1,28,0,0,4,0,0},        /* GPIO_SELECT_OUTPUT */
-    {-1,29,0,0,5,0,0},        /* GPIO_MODE */
-    {-1,30,0,0,5,1,0},        /* GPIO_PIN_REG_IN */
-    {-1,31,0,0,5,0,0},        /* GPIO_PIN_REG_OUT */
-    {-1,32,0,0,8,1,0},        /* MCU_AGC_STATUS */
-    {-1,125,0,0,8,1,0},       /* MCU_ARB_STATUS */
-    {-1,126,0,0,8,1,1},       /* CHIP_ID */
-    {-1,127,0,0,1,0,1},       /* EMERGENCY_FORCE_HOST_CTRL */
-    {0,33,0,0,1,0,0},         /* RX_INVERT_IQ */
-    {0,33,1,0,1,0,1},         /* MODEM_INVERT_IQ */
-    {0,33,2,0,1,0,0},         /* MBWSSF_MODEM_INVERT_IQ */
-    {0,33,3,0,1,0,0},         /* RX_EDGE_SELECT */
-    {0,33,4,0,1,0,0},         /* MISC_RADIO_EN */
-    {0,33,5,0,1,0,0},         /* FSK_MODEM_INVERT_IQ */
-    {0,34,0,0,4,0,7},         /* FILTER_GAIN */
-    {0,35,0,0,8,0,240},       /* RADIO_SELECT */
-    {0,36,0,1,13,0,-384},     /* IF_FREQ_0 */
-    {0,38,0,1,13,0,-128},     /* IF_FREQ_1 */
-    {0,40,0,1,13,0,128},      /* IF_FREQ_2 */
-    {0,42,0,1,13,0,384},      /* IF_FREQ_3 */
-    {0,44,0,1,13,0,-384},     /* IF_FREQ_4 */
-    {0,46,0,1,13,0,-128},     /* IF_FREQ_5 */
-    {0,48,0,1,13,0,128},      /* IF_FREQ_6 */
-    {0,50,0,1,13,0,384},      /* IF_FREQ_7 */
-    {0,52,0,1,13,0,0},        /* IF_FREQ_8 */
-    {0,54,0,1,13,0,0},        /* IF_FREQ_9 */
-    {0,64,0,0,1,0,0},        /* CHANN_OVERRIDE_AGC_GAIN */
-    {0,64,1,0,4,0,7},        /* CHANN_AGC_GAIN */
-    {0,65,0,0,7,0,0},        /* CORR0_DETECT_EN */
-    {0,66,0,0,7,0,0},        /* CORR1_DETECT_EN */
-    {0,67,0,0,7,0,0},        /* CORR2_DETECT_EN */
-    {0,68,0,0,7,0,0},        /* CORR3_DETECT_EN */
-    {0,69,0,0,7,0,0},        /* CORR4_DETECT_EN */
-    {0,70,0,0,7,0,0},        /* CORR5_DETECT_EN */
-    {0,71,0,0,7,0,0},        /* CORR6_DETECT_EN */
-    {0,72,0,0,7,0,0},        /* CORR7_DETECT_EN */
-    {0,73,0,0,1,0,0},        /* CORR_SAME_PEAKS_OPTION_SF6 */
-    {0,73,1,0,1,0,1},        /* CORR_SAME_PEAKS_OPTION_SF7 */
-    {0,73,2,0,1,0,1},        /* CORR_SAME_PEAKS_OPTION_SF8 */
-    {0,73,3,0,1,0,1},        /* CORR_SAME_PEAKS_OPTION_SF9 */
-    {0,73,4,0,1,0,1},        /* CORR_SAME_PEAKS_OPTION_SF10 */
-    {0,73,5,0,1,0,1},        /* CORR_SAME_PEAKS_OPTION_SF11 */
-    {0,73,6,0,1,0,1},        /* CORR_SAME_PEAKS_OPTION_SF12 */
-    {0,74,0,0,4,0,4},        /* CORR_SIG_NOISE_RATIO_SF6 */
-    {0,74,4,0,4,0,4},        /* CORR_SIG_NOISE_RATIO_SF7 */
-    {0,75,0,0,4,0,4},        /* CORR_SIG_NOISE_RATIO_SF8 */
-    {0,75,4,0,4,0,4},        /* CORR_SIG_NOISE_RATIO_SF9 */
-    {0,76,0,0,4,0,4},        /* CORR_SIG_NOISE_RATIO_SF10 */
-    {0,76,4,0,4,0,4},        /* CORR_SIG_NOISE_RATIO_SF11 */
-    {0,77,0,0,4,0,4},        /* CORR_SIG_NOISE_RATIO_SF12 */
-    {0,78,0,0,4,0,4},        /* CORR_NUM_SAME_PEAK */
-    {0,78,4,0,3,0,5},        /* CORR_MAC_GAIN */
-    {0,81,0,0,12,0,0},       /* ADJUST_MODEM_START_OFFSET_RDX4 */
-    {0,83,0,0,12,0,4092},    /* ADJUST_MODEM_START_OFFSET_SF12_RDX4 */
-    {0,85,0,0,8,0,7},        /* DBG_CORR_SELECT_SF */
-    {0,86,0,0,8,0,0},        /* DBG_CORR_SELECT_CHANNEL */
-    {0,87,0,0,8,1,0},        /* DBG_DETECT_CPT */
-    {0,88,0,0,8,1,0},        /* DBG_SYMB_CPT */
-    {0,89,0,0,1,0,1},        /* CHIRP_INVERT_RX */
-    {0,89,1,0,1,0,1},        /* DC_NOTCH_EN */
-    {0,90,0,0,1,0,0},        /* IMPLICIT_CRC_EN */
-    {0,90,1,0,3,0,0},        /* IMPLICIT_CODING_RATE */
-    {0,91,0,0,8,0,0},        /* IMPLICIT_PAYLOAD_LENGHT */
-    {0,92,0,0,8,0,29},       /* FREQ_TO_TIME_INVERT */
-    {0,93,0,0,6,0,9},        /* FREQ_TO_TIME_DRIFT */
-    {0,94,0,0,2,0,2},        /* PAYLOAD_FINE_TIMING_GAIN */
-    {0,94,2,0,2,0,1},        /* PREAMBLE_FINE_TIMING_GAIN */
-    {0,94,4,0,2,0,0},        /* TRACKING_INTEGRAL */
-    {0,95,0,0,4,0,1},        /* FRAME_SYNCH_PEAK1_POS */
-    {0,95,4,0,4,0,2},        /* FRAME_SYNCH_PEAK2_POS */
-    {0,96,0,0,16,0,10},      /* PREAMBLE_SYMB1_NB */
-    {0,98,0,0,1,0,1},        /* FRAME_SYNCH_GAIN */
-    {0,98,1,0,1,0,1},        /* SYNCH_DETECT_TH */
-    {0,99,0,0,4,0,8},        /* LLR_SCALE */
-    {0,99,4,0,2,0,2},        /* SNR_AVG_CST */
-    {0,100,0,0,7,0,0},       /* PPM_OFFSET */
-    {0,101,0,0,8,0,255},     /* MAX_PAYLOAD_LEN */
-    {0,102,0,0,1,0,1},        /* ONLY_CRC_EN */
-    {0,103,0,0,8,0,0},        /* ZERO_PAD */
-    {0,104,0,0,4,0,8},        /* DEC_GAIN_OFFSET */
-    {0,104,4,0,4,0,7},        /* CHAN_GAIN_OFFSET */
-    {0,105,1,0,1,0,1},        /* FORCE_HOST_RADIO_CTRL */
-    {0,105,2,0,1,0,1},        /* FORCE_HOST_FE_CTRL */
-    {0,105,3,0,1,0,1},        /* FORCE_DEC_FILTER_GAIN */
-    {0,106,0,0,1,0,1},        /* MCU_RST_0 */
-    {0,106,1,0,1,0,1},        /* MCU_RST_1 */
-    {0,106,2,0,1,0,0},        /* MCU_SELECT_MUX_0 */
-    {0,106,3,0,1,0,0},        /* MCU_SELECT_MUX_1 */
-    {0,106,4,0,1,1,0},        /* MCU_CORRUPTION_DETECTED_0 */
-    {0,106,5,0,1,1,0},        /* MCU_CORRUPTION_DETECTED_1 */
-    {0,106,6,0,1,0,0},        /* MCU_SELECT_EDGE_0 */
-    {0,106,7,0,1,0,0},        /* MCU_SELECT_EDGE_1 */
-    {0,107,0,0,8,0,1},        /* CHANN_SELECT_RSSI */
-    {0,108,0,0,8,0,32},       /* RSSI_BB_DEFAULT_VALUE */
-    {0,109,0,0,8,0,100},      /* RSSI_DEC_DEFAULT_VALUE */
-    {0,110,0,0,8,0,100},      /* RSSI_CHANN_DEFAULT_VALUE */
-    {0,111,0,0,5,0,7},        /* RSSI_BB_FILTER_ALPHA */
-    {0,112,0,0,5,0,5},        /* RSSI_DEC_FILTER_ALPHA */
-    {0,113,0,0,5,0,8},        /* RSSI_CHANN_FILTER_ALPHA */
-    {0,114,0,0,6,0,0},        /* IQ_MISMATCH_A_AMP_COEFF */
-    {0,115,0,0,6,0,0},        /* IQ_MISMATCH_A_PHI_COEFF */
-    {0,116,0,0,6,0,0},        /* IQ_MISMATCH_B_AMP_COEFF */
-    {0,116,6,0,1,0,0},        /* IQ_MISMATCH_B_SEL_I */
-    {0,117,0,0,6,0,0},        /* IQ_MISMATCH_B_PHI_COEFF */
-    {1,33,0,0,1,0,0},         /* TX_TRIG_IMMEDIATE */
-    {1,33,1,0,1,0,0},         /* TX_TRIG_DELAYED */
-    {1,33,2,0,1,0,0},         /* TX_TRIG_GPS */
-    {1,34,0,0,16,0,0},        /* TX_START_DELAY */
-    {1,36,0,0,4,0,1},        /* TX_FRAME_SYNCH_PEAK1_POS */
-    {1,36,4,0,4,0,2},        /* TX_FRAME_SYNCH_PEAK2_POS */
-    {1,37,0,0,3,0,0},        /* TX_RAMP_DURATION */
-    {1,39,0,1,8,0,0},        /* TX_OFFSET_I */
-    {1,40,0,1,8,0,0},        /* TX_OFFSET_Q */
-    {1,41,0,0,1,0,0},        /* TX_MODE */
-    {1,41,1,0,4,0,0},        /* TX_ZERO_PAD */
-    {1,41,5,0,1,0,0},        /* TX_EDGE_SELECT */
-    {1,41,6,0,1,0,0},        /* TX_EDGE_SELECT_TOP */
-    {1,42,0,0,2,0,0},        /* TX_GAIN */
-    {1,42,2,0,3,0,5},        /* TX_CHIRP_LOW_PASS */
-    {1,42,5,0,2,0,0},        /* TX_FCC_WIDEBAND */
-    {1,42,7,0,1,0,1},        /* TX_SWAP_IQ */
-    {1,43,0,0,1,0,0},        /* MBWSSF_IMPLICIT_HEADER */
-    {1,43,1,0,1,0,0},        /* MBWSSF_IMPLICIT_CRC_EN */
-    {1,43,2,0,3,0,0},        /* MBWSSF_IMPLICIT_CODING_RATE */
-    {1,44,0,0,8,0,0},        /* MBWSSF_IMPLICIT_PAYLOAD_LENGHT */
-    {1,45,0,0,1,0,1},        /* MBWSSF_AGC_FREEZE_ON_DETECT */
-    {1,46,0,0,4,0,1},        /* MBWSSF_FRAME_SYNCH_PEAK1_POS */
-    {1,46,4,0,4,0,2},        /* MBWSSF_FRAME_SYNCH_PEAK2_POS */
-    {1,47,0,0,16,0,10},      /* MBWSSF_PREAMBLE_SYMB1_NB */
-    {1,49,0,0,1,0,1},        /* MBWSSF_FRAME_SYNCH_GAIN */
-    {1,49,1,0,1,0,1},        /* MBWSSF_SYNCH_DETECT_TH */
-    {1,50,0,0,8,0,10},       /* MBWSSF_DETECT_MIN_SINGLE_PEAK */
-    {1,51,0,0,3,0,3},        /* MBWSSF_DETECT_TRIG_SAME_PEAK_NB */
-    {1,52,0,0,8,0,29},       /* MBWSSF_FREQ_TO_TIME_INVERT */
-    {1,53,0,0,6,0,36},       /* MBWSSF_FREQ_TO_TIME_DRIFT */
-    {1,54,0,0,12,0,0},       /* MBWSSF_PPM_CORRECTION */
-    {1,56,0,0,2,0,2},        /* MBWSSF_PAYLOAD_FINE_TIMING_GAIN */
-    {1,56,2,0,2,0,1},        /* MBWSSF_PREAMBLE_FINE_TIMING_GAIN */
-    {1,56,4,0,2,0,0},        /* MBWSSF_TRACKING_INTEGRAL */
-    {1,57,0,0,8,0,0},        /* MBWSSF_ZERO_PAD */
-    {1,58,0,0,2,0,0},        /* MBWSSF_MODEM_BW */
-    {1,58,2,0,1,0,0},        /* MBWSSF_RADIO_SELECT */
-    {1,58,3,0,1,0,1},        /* MBWSSF_RX_CHIRP_INVERT */
-    {1,59,0,0,4,0,8},        /* MBWSSF_LLR_SCALE */
-    {1,59,4,0,2,0,3},        /* MBWSSF_SNR_AVG_CST */
-    {1,59,6,0,1,0,0},        /* MBWSSF_PPM_OFFSET */
-    {1,60,0,0,4,0,7},        /* MBWSSF_RATE_SF */
-    {1,60,4,0,1,0,1},        /* MBWSSF_ONLY_CRC_EN */
-    {1,61,0,0,8,0,255},      /* MBWSSF_MAX_PAYLOAD_LEN */
-    {1,62,0,0,8,1,128},      /* TX_STATUS */
-    {1,63,0,0,3,0,0},        /* FSK_CH_BW_EXPO */
-    {1,63,3,0,3,0,0},        /* FSK_RSSI_LENGTH */
-    {1,63,6,0,1,0,0},        /* FSK_RX_INVERT */
-    {1,63,7,0,1,0,0},        /* FSK_PKT_MODE */
-    {1,64,0,0,3,0,0},        /* FSK_PSIZE */
-    {1,64,3,0,1,0,0},        /* FSK_CRC_EN */
-    {1,64,4,0,2,0,0},        /* FSK_DCFREE_ENC */
-    {1,64,6,0,1,0,0},        /* FSK_CRC_IBM */
-    {1,65,0,0,5,0,0},        /* FSK_ERROR_OSR_TOL */
-    {1,65,7,0,1,0,0},        /* FSK_RADIO_SELECT */
-    {1,66,0,0,16,0,0},       /* FSK_BR_RATIO */
-    {1,68,0,0,32,0,0},       /* FSK_REF_PATTERN_LSB */
-    {1,72,0,0,32,0,0},       /* FSK_REF_PATTERN_MSB */
-    {1,76,0,0,8,0,0},        /* FSK_PKT_LENGTH */
-    {1,77,0,0,1,0,1},        /* FSK_TX_GAUSSIAN_EN */
-    {1,77,1,0,2,0,0},        /* FSK_TX_GAUSSIAN_SELECT_BT */
-    {1,77,3,0,1,0,1},        /* FSK_TX_PATTERN_EN */
-    {1,77,4,0,1,0,0},        /* FSK_TX_PREAMBLE_SEQ */
-    {1,77,5,0,3,0,0},        /* FSK_TX_PSIZE */
-    {1,80,0,0,8,0,0},        /* FSK_NODE_ADRS */
-    {1,81,0,0,8,0,0},        /* FSK_BROADCAST */
-    {1,82,0,0,1,0,1},        /* FSK_AUTO_AFC_ON */
-    {1,83,0,0,10,0,0},       /* FSK_PATTERN_TIMEOUT_CFG */
-    {2,33,0,0,8,0,0},        /* SPI_RADIO_A__DATA */
-    {2,34,0,0,8,1,0},        /* SPI_RADIO_A__DATA_READBACK */
-    {2,35,0,0,8,0,0},        /* SPI_RADIO_A__ADDR */
-    {2,37,0,0,1,0,0},        /* SPI_RADIO_A__CS */
-    {2,38,0,0,8,0,0},        /* SPI_RADIO_B__DATA */
-    {2,39,0,0,8,1,0},        /* SPI_RADIO_B__DATA_READBACK */
-    {2,40,0,0,8,0,0},        /* SPI_RADIO_B__ADDR */
-    {2,42,0,0,1,0,0},        /* SPI_RADIO_B__CS */
-    {2,43,0,0,1,0,0},        /* RADIO_A_EN */
-    {2,43,1,0,1,0,0},        /* RADIO_B_EN */
-    {2,43,2,0,1,0,1},        /* RADIO_RST */
-    {2,43,3,0,1,0,0},        /* LNA_A_EN */
-    {2,43,4,0,1,0,0},        /* PA_A_EN */
-    {2,43,5,0,1,0,0},        /* LNA_B_EN */
-    {2,43,6,0,1,0,0},        /* PA_B_EN */
-    {2,44,0,0,2,0,0},        /* PA_GAIN */
-    {2,45,0,0,4,0,2},        /* LNA_A_CTRL_LUT */
-    {2,45,4,0,4,0,4},        /* PA_A_CTRL_LUT */
-    {2,46,0,0,4,0,2},        /* LNA_B_CTRL_LUT */
-    {2,46,4,0,4,0,4},        /* PA_B_CTRL_LUT */
-    {2,47,0,0,5,0,0},        /* CAPTURE_SOURCE */
-    {2,47,5,0,1,0,0},        /* CAPTURE_START */
-    {2,47,6,0,1,0,0},        /* CAPTURE_FORCE_TRIGGER */
-    {2,47,7,0,1,0,0},        /* CAPTURE_WRAP */
-    {2,48,0,0,16,0,0},       /* CAPTURE_PERIOD */
-    {2,51,0,0,8,1,0},        /* MODEM_STATUS */
-    {2,52,0,0,8,1,0},        /* VALID_HEADER_COUNTER_0 */
-    {2,54,0,0,8,1,0},        /* VALID_PACKET_COUNTER_0 */
-    {2,56,0,0,8,1,0},        /* VALID_HEADER_COUNTER_MBWSSF */
-    {2,57,0,0,8,1,0},        /* VALID_HEADER_COUNTER_FSK */
-    {2,58,0,0,8,1,0},        /* VALID_PACKET_COUNTER_MBWSSF */
-    {2,59,0,0,8,1,0},        /* VALID_PACKET_COUNTER_FSK */
-    {2,60,0,0,8,1,0},        /* CHANN_RSSI */
-    {2,61,0,0,8,1,0},        /* BB_RSSI */
-    {2,62,0,0,8,1,0},        /* DEC_RSSI */
-    {2,63,0,0,8,1,0},        /* DBG_MCU_DATA */
-    {2,64,0,0,8,1,0},        /* DBG_ARB_MCU_RAM_DATA */
-    {2,65,0,0,8,1,0},        /* DBG_AGC_MCU_RAM_DATA */
-    {2,66,0,0,16,1,0},       /* NEXT_PACKET_CNT */
-    {2,68,0,0,16,1,0},       /* ADDR_CAPTURE_COUNT */
-    {2,70,0,0,32,1,0},       /* TIMESTAMP */
-    {2,74,0,0,4,1,0},        /* DBG_CHANN0_GAIN */
-    {2,74,4,0,4,1,0},        /* DBG_CHANN1_GAIN */
-    {2,75,0,0,4,1,0},        /* DBG_CHANN2_GAIN */
-    {2,75,4,0,4,1,0},        /* DBG_CHANN3_GAIN */
-    {2,76,0,0,4,1,0},        /* DBG_CHANN4_GAIN */
-    {2,76,4,0,4,1,0},        /* DBG_CHANN5_GAIN */
-    {2,77,0,0,4,1,0},        /* DBG_CHANN6_GAIN */
-    {2,77,4,0,4,1,0},        /* DBG_CHANN7_GAIN */
-    {2,78,0,0,4,1,0},        /* DBG_DEC_FILT_GAIN */
-    {2,79,0,0,3,1,0},        /* SPI_DATA_FIFO_PTR */
-    {2,79,3,0,3,1,0},        /* PACKET_DATA_FIFO_PTR */
-    {2,80,0,0,8,0,0},        /* DBG_ARB_MCU_RAM_ADDR */
-    {2,81,0,0,8,0,0},        /* DBG_AGC_MCU_RAM_ADDR */
-    {2,82,0,0,1,0,0},        /* SPI_MASTER_CHIP_SELECT_POLARITY */
-    {2,82,1,0,1,0,0},        /* SPI_MASTER_CPOL */
-    {2,82,2,0,1,0,0},        /* SPI_MASTER_CPHA */
-    {2,83,0,0,1,0,0},        /* SIG_GEN_ANALYSER_MUX_SEL */
-    {2,84,0,0,1,0,0},        /* SIG_GEN_EN */
-    {2,84,1,0,1,0,0},        /* SIG_ANALYSER_EN */
-    {2,84,2,0,2,0,0},        /* SIG_ANALYSER_AVG_LEN */
-    {2,84,4,0,3,0,0},        /* SIG_ANALYSER_PRECISION */
-    {2,84,7,0,1,1,0},        /* SIG_ANALYSER_VALID_OUT */
-    {2,85,0,0,8,0,0},        /* SIG_GEN_FREQ */
-    {2,86,0,0,8,0,0},        /* SIG_ANALYSER_FREQ */
-    {2,87,0,0,8,1,0},        /* SIG_ANALYSER_I_OUT */
-    {2,88,0,0,8,1,0},        /* SIG_ANALYSER_Q_OUT */
-    {2,89,0,0,1,0,0},        /* GPS_EN */
-    {2,89,1,0,1,0,1},        /* GPS_POL */
-    {2,90,0,1,8,0,0},        /* SW_TEST_REG1 */
-    {2,91,2,1,6,0,0},        /* SW_TEST_REG2 */
-    {2,92,0,1,16,0,0},       /* SW_TEST_REG3 */
-    {2,94,0,0,4,1,0},        /* DATA_MNGT_STATUS */
-    {2,95,0,0,5,1,0},        /* DATA_MNGT_CPT_FRAME_ALLOCATED */
-    {2,96,0,0,5,1,0},        /* DATA_MNGT_CPT_FRAME_FINISHED */
-    {2,97,0,0,5,1,0},        /* DATA_MNGT_CPT_FRAME_READEN */
-    {1,33,0,0,8,0,0}         /* TX_TRIG_ALL (alias) */
+#define SPI_TUNE_ROUNDS  16     /* patterns written through the test registers at each clock rate */
+#define SPI_TUNE_BITS    (8 + 6 + 16) /* SW_TEST_REG1 + SW_TEST_REG2 + SW_TEST_REG3 */
+
+/* clock rates tried by lgw_reg_spi_tune, exact dividers of the ESP32 80 MHz SPI clock */
+static const uint32_t spi_tune_rates[LGW_SPI_TUNE_RATE_NB] = {1000000, 2000000, 4000000, 8000000, 10000000, 13333333, 16000000, 20000000, 26666666};
+
+/* snapshot reads, skipping the data ports whose pointer moves on each access */
+#define SNAP_COMMON_ADDR    11  /* first address of the burst done on every page */
+static const struct {
+    uint8_t addr;
+    uint8_t size;
+} snap_common_reads[] = {
+    {0, 4},         /* page/reset, version, RX data buffer pointer */
+    {5, 1},         /* TX data buffer pointer */
+    {7, 1},         /* capture RAM pointer */
+    {9, 1}          /* MCU program RAM pointer */
+};
+
+/* scrubbed range of each page, page 0 also holds the common registers */
+#define SCRUB_PAGED_FIRST   33
+#define SCRUB_PAGED_END     125
+
+/* shadowed bytes the scrubber does not check: pointers moved by reading their debug port */
+static const struct {
+    uint8_t page;
+    uint8_t first;
+    uint8_t last;
+} scrub_skip[] = {
+    {2, 80, 81}     /* ARB and AGC MCU RAM debug pointers */
+};
+
+/* writable bytes the chip or its MCUs may change, never served from the shadow */
+static const struct {
+    uint8_t page;   /* shadow page, common registers are on page 0 */
+    uint8_t first;
+    uint8_t last;
+} shadow_volatile[] = {
+    {0, 0, 11},     /* page/reset, data ports and their auto-incremented pointers */
+    {0, 18, 18},    /* BIST start/clear */
+    {1, 33, 33},    /* TX trigger, cleared by the TX state machine */
+    {2, 33, 42},    /* SPI master of the radios */
+    {2, 47, 47}     /* capture start */
 };
 
+/* register descriptors, the table itself is in loragw_reg.h */
+constexpr struct lgw_reg_s lgw_reg_map::table[LGW_TOTALREGS];
+const struct lgw_reg_s *const loregs = lgw_reg_map::table;
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
-static int lgw_regpage = -1; /*! keep the value of the register page selected */
+static struct lgw_reg_ctx_s reg_ctx_default = {NULL, 0, -1, false}; /*! link used when no context is selected */
+static struct lgw_reg_ctx_s *reg_ctx = &reg_ctx_default; /*! link of the selected concentrator */
 
-/* -------------------------------------------------------------------------- */
-/* --- INTERNAL SHARED VARIABLES -------------------------------------------- */
+static int reg_lock_depth = 0; /*! recursion count of the lock holder */
+static uint32_t prio_waiting = 0; /*! tasks waiting in lgw_reg_lock_prio, atomic */
+static unsigned long prio_request; /*! request time of the priority holder, us */
+static struct lgw_reg_arbiter_stats_s arbiter_stats;
 
-SPIClass* lgw_spi_target=NULL; /*! generic pointer to the SPI device */
-uint8_t lgw_spi_mux_mode = 0; /*! current SPI mux mode used */
+static bool shadow_enabled = true;
+static bool shadow_mask_ready = false;
+static uint8_t shadow_mask[LGW_REG_PAGE_NB][128]; /*! bits of each byte held in the shadow */
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS ---------------------------------------------------- */
 
+/* lock held around each page switch and access, recursive so sequences can hold it;
+   created on first use, the HAL default context is selected during static initialization */
+static lgw_port_mutex_t *reg_mutex(void) {
+    static lgw_port_mutex_t m;
+    static bool ready = lgw_port_mutex_init(&m);
+
+    return (ready == true) ? &m : NULL;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int page_switch(uint8_t target) {
-    lgw_regpage = PAGE_MASK & target;
-    lgw_spi_w(lgw_spi_target, lgw_spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, PAGE_ADDR, (uint8_t)lgw_regpage);
+    reg_ctx->regpage = PAGE_MASK & target;
+    lgw_spi_count_page_switch(reg_ctx->spi_target);
+    lgw_spi_w(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, PAGE_ADDR, (uint8_t)reg_ctx->regpage);
     return LGW_REG_SUCCESS;
 }
 
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int reg_w_align32(SPIClass* spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, struct lgw_reg_s r, int32_t reg_value) {
+int reg_w_align32(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, struct lgw_reg_s r, int32_t reg_value) {
     int spi_stat = LGW_REG_SUCCESS;
     int i, size_byte;
     uint8_t buf[4] = {0,0,0,0};
@@ -452,37 +194,51 @@ int reg_w_align32(SPIClass* spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_ta
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int reg_r_align32(SPIClass* spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, struct lgw_reg_s r, int32_t *reg_value) {
-    int spi_stat = LGW_SPI_SUCCESS;
-    uint8_t bufu[4] ={0,0,0,0};
-    int8_t *bufs = (int8_t *)bufu;
+/* register value from its bytes, least significant first */
+static int32_t reg_decode(struct lgw_reg_s r, const uint8_t *bufu) {
+    uint8_t b[3];
+    int8_t *bs = (int8_t *)b;
     int i, size_byte;
     uint32_t u = 0;
 
     if ((r.offs + r.leng) <= 8) {
-        /* read one byte, then shift and mask bits to get reg value with sign extension if needed */
-        spi_stat += lgw_spi_r(spi_target, spi_mux_mode, spi_mux_target, r.addr, &bufu[0]);
-        bufu[1] = bufu[0] << (8 - r.leng - r.offs); /* left-align the data */
+        /* shift and mask bits to get reg value with sign extension if needed */
+        b[1] = bufu[0] << (8 - r.leng - r.offs); /* left-align the data */
         if (r.sign == true) {
-            bufs[2] = bufs[1] >> (8 - r.leng); /* right align the data with sign extension (ARITHMETIC right shift) */
-            *reg_value = (int32_t)bufs[2]; /* signed pointer -> 32b sign extension */
+            bs[2] = bs[1] >> (8 - r.leng); /* right align the data with sign extension (ARITHMETIC right shift) */
+            return (int32_t)bs[2]; /* signed pointer -> 32b sign extension */
         } else {
-            bufu[2] = bufu[1] >> (8 - r.leng); /* right align the data, no sign extension */
-            *reg_value = (int32_t)bufu[2]; /* unsigned pointer -> no sign extension */
+            b[2] = b[1] >> (8 - r.leng); /* right align the data, no sign extension */
+            return (int32_t)b[2]; /* unsigned pointer -> no sign extension */
         }
+    }
+    size_byte = (r.leng + 7) / 8; /* add a byte if it's not an exact multiple of 8 */
+    for (i=(size_byte-1); i>=0; --i) {
+        u = (uint32_t)bufu[i] + (u << 8); /* transform a 4-byte array into a 32 bit word */
+    }
+    if (r.sign == true) {
+        u = u << (32 - r.leng); /* left-align the data */
+        return (int32_t)u >> (32 - r.leng); /* right-align the data with sign extension (ARITHMETIC right shift) */
+    } else {
+        return (int32_t)u; /* unsigned value -> return 'as is' */
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int reg_r_align32(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, struct lgw_reg_s r, int32_t *reg_value) {
+    int spi_stat = LGW_SPI_SUCCESS;
+    uint8_t bufu[4] ={0,0,0,0};
+    int size_byte;
+
+    if ((r.offs + r.leng) <= 8) {
+        /* read one byte, then shift and mask bits to get reg value with sign extension if needed */
+        spi_stat += lgw_spi_r(spi_target, spi_mux_mode, spi_mux_target, r.addr, &bufu[0]);
+        *reg_value = reg_decode(r, bufu);
     } else if ((r.offs == 0) && (r.leng > 0) && (r.leng <= 32)) {
         size_byte = (r.leng + 7) / 8; /* add a byte if it's not an exact multiple of 8 */
         spi_stat += lgw_spi_rb(spi_target, spi_mux_mode, spi_mux_target, r.addr, bufu, size_byte);
-        u = 0;
-        for (i=(size_byte-1); i>=0; --i) {
-            u = (uint32_t)bufu[i] + (u << 8); /* transform a 4-byte array into a 32 bit word */
-        }
-        if (r.sign == true) {
-            u = u << (32 - r.leng); /* left-align the data */
-            *reg_value = (int32_t)u >> (32 - r.leng); /* right-align the data with sign extension (ARITHMETIC right shift) */
-        } else {
-            *reg_value = (int32_t)u; /* unsigned value -> return 'as is' */
-        }
+        *reg_value = reg_decode(r, bufu);
     } else {
         /* register spanning multiple memory bytes but with an offset */
         DEBUG_MSG("ERROR: REGISTER SIZE AND OFFSET ARE NOT SUPPORTED\n");
@@ -492,23 +248,541 @@ int reg_r_align32(SPIClass* spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_ta
     return spi_stat;
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* shadow page of a register, common registers are kept with page 0 */
+#define SHADOW_PAGE(r)      (((r).page < 0) ? 0 : (r).page)
+#define SHADOW_VALID(p, a)  ((reg_ctx->shadow_valid[p][(a) >> 3] & (1 << ((a) & 7))) != 0)
+
+/* bits written by the host only, from the register table */
+static void shadow_mask_setup(void) {
+    struct lgw_reg_s r;
+    int i, j, n, bits, p;
+
+    memset(shadow_mask, 0, sizeof shadow_mask);
+    for (i = 0; i < LGW_TOTALREGS; ++i) {
+        r = loregs[i];
+        if ((r.rdon == 1) || (i == LGW_PAGE_REG) || (i == LGW_SOFT_RESET)) {
+            continue;
+        }
+        p = SHADOW_PAGE(r);
+        if ((r.offs + r.leng) <= 8) {
+            shadow_mask[p][r.addr] |= ((1 << r.leng) - 1) << r.offs;
+        } else {
+            n = (r.leng + 7) / 8;
+            for (j = 0; (j < n) && ((r.addr + j) < 128); ++j) {
+                bits = r.leng - 8 * j;
+                shadow_mask[p][r.addr + j] |= (bits >= 8) ? 0xFF : ((1 << bits) - 1);
+            }
+        }
+    }
+    for (i = 0; i < (int)(sizeof shadow_volatile / sizeof shadow_volatile[0]); ++i) {
+        for (j = shadow_volatile[i].first; j <= shadow_volatile[i].last; ++j) {
+            shadow_mask[shadow_volatile[i].page][j] = 0;
+        }
+    }
+    shadow_mask_ready = true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void shadow_invalidate(int page, int addr, int size) {
+    int a;
+
+    for (a = addr; (a < (addr + size)) && (a < 128); ++a) {
+        reg_ctx->shadow_valid[page][a >> 3] &= ~(1 << (a & 7));
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* record a byte known to be in the chip, bits outside of the mask included */
+static void shadow_store(int page, int addr, uint8_t value) {
+    if ((addr >= 128) || (shadow_mask[page][addr] == 0)) {
+        return;
+    }
+    reg_ctx->shadow[page][addr] = value;
+    reg_ctx->shadow_valid[page][addr >> 3] |= 1 << (addr & 7);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* after a soft reset, every held byte is back to its default value */
+/* a byte only partly described by the table is read once before it is trusted */
+static void shadow_seed_defaults(void) {
+    struct lgw_reg_s r;
+    int i, j, n, p;
+    uint32_t v;
+
+    if (shadow_mask_ready == false) {
+        shadow_mask_setup();
+    }
+    memset(reg_ctx->shadow, 0, sizeof reg_ctx->shadow);
+    for (i = 0; i < LGW_TOTALREGS; ++i) {
+        r = loregs[i];
+        p = SHADOW_PAGE(r);
+        if ((r.offs + r.leng) <= 8) {
+            reg_ctx->shadow[p][r.addr] |= ((uint8_t)r.dflt << r.offs) & (((1 << r.leng) - 1) << r.offs);
+        } else {
+            n = (r.leng + 7) / 8;
+            v = (uint32_t)r.dflt;
+            for (j = 0; (j < n) && ((r.addr + j) < 128); ++j) {
+                reg_ctx->shadow[p][r.addr + j] |= (uint8_t)(v >> (8 * j));
+            }
+        }
+    }
+    for (p = 0; p < LGW_REG_PAGE_NB; ++p) {
+        for (i = 0; i < 128; ++i) {
+            if (shadow_mask[p][i] == 0xFF) {
+                shadow_store(p, i, reg_ctx->shadow[p][i]);
+            } else {
+                shadow_invalidate(p, i, 1);
+            }
+        }
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool scrub_skipped(int page, int addr) {
+    int i;
+
+    for (i = 0; i < (int)(sizeof scrub_skip / sizeof scrub_skip[0]); ++i) {
+        if ((scrub_skip[i].page == page) && (addr >= scrub_skip[i].first) && (addr <= scrub_skip[i].last)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* the radios lost their registers, after a reset or a power down */
+static void radio_invalidate(void) {
+    int i;
+
+    for (i = 0; i < LGW_REG_RADIO_NB; ++i) {
+        memset(reg_ctx->radio[i].valid, 0, sizeof reg_ctx->radio[i].valid);
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* bit field write taking the rest of the byte from the shadow when it is known */
+static int reg_w_shadow(int p, uint8_t addr, uint8_t mask, uint8_t bits) {
+    int spi_stat = LGW_SPI_SUCCESS;
+    uint8_t old, val;
+
+    if (SHADOW_VALID(p, addr)) {
+        old = reg_ctx->shadow[p][addr];
+        ++reg_ctx->shadow_stats.nb_avoided;
+    } else {
+        spi_stat += lgw_spi_r(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, addr, &old);
+        ++reg_ctx->shadow_stats.nb_read;
+    }
+    val = (~mask & old) | (mask & bits);
+    spi_stat += lgw_spi_w(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, addr, val);
+    if (spi_stat == LGW_SPI_SUCCESS) {
+        shadow_store(p, addr, val);
+    } else {
+        shadow_invalidate(p, addr, 1);
+    }
+    return spi_stat;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* keep the shadow in step with a register written by reg_w_align32 */
+static void shadow_write_through(struct lgw_reg_s r, int32_t reg_value, bool ok) {
+    int p = SHADOW_PAGE(r);
+    int j, n;
+
+    if ((r.offs + r.leng) <= 8) {
+        n = 1;
+    } else {
+        n = (r.leng + 7) / 8;
+    }
+    if (ok == false) {
+        shadow_invalidate(p, r.addr, n);
+        return;
+    }
+    if ((r.leng == 8) && (r.offs == 0)) {
+        shadow_store(p, r.addr, (uint8_t)reg_value);
+    } else if ((r.offs + r.leng) <= 8) {
+        shadow_invalidate(p, r.addr, 1); /* rest of the byte was read, not kept */
+    } else {
+        for (j = 0; j < n; ++j) {
+            shadow_store(p, r.addr + j, (uint8_t)(reg_value >> (8 * j)));
+        }
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* only registers the host alone writes can be held and reordered */
+static bool defer_allowed(struct lgw_reg_s r) {
+    if (shadow_mask[SHADOW_PAGE(r)][r.addr] == 0) {
+        return false;
+    }
+    return ((r.offs + r.leng) <= 8) || (r.offs == 0);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* hold bits of one byte until the next barrier */
+static void defer_merge(int g, uint8_t addr, uint8_t mask, uint8_t bits) {
+    if (reg_ctx->defer_set[g][addr] == 0) {
+        ++reg_ctx->defer_nb;
+    }
+    reg_ctx->defer_val[g][addr] = (~mask & reg_ctx->defer_val[g][addr]) | (mask & bits);
+    reg_ctx->defer_set[g][addr] |= mask;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void defer_register(struct lgw_reg_s r, int32_t reg_value) {
+    int g = (r.page < 0) ? LGW_REG_PAGE_NB : r.page;
+    uint32_t v = (uint32_t)reg_value;
+    int j;
+
+    if ((r.offs + r.leng) <= 8) {
+        defer_merge(g, r.addr, ((1 << r.leng) - 1) << r.offs, ((uint8_t)reg_value) << r.offs);
+    } else {
+        /* whole bytes, as reg_w_align32 does */
+        for (j = 0; j < ((r.leng + 7) / 8); ++j) {
+            defer_merge(g, r.addr + j, 0xFF, (uint8_t)(v >> (8 * j)));
+        }
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* send the held bytes, current page first, common registers last */
+static int defer_flush(void) {
+    int spi_stat = LGW_SPI_SUCCESS;
+    int order[LGW_REG_PAGE_NB + 1];
+    uint8_t *val, *set;
+    uint8_t old;
+    int i, j, n, g, p, a;
+    int run = 0;
+
+    order[0] = reg_ctx->regpage;
+    for (i = 0, n = 1; i < LGW_REG_PAGE_NB; ++i) {
+        if (i != reg_ctx->regpage) {
+            order[n++] = i;
+        }
+    }
+    order[n] = LGW_REG_PAGE_NB;
+
+    for (i = 0; i < (LGW_REG_PAGE_NB + 1); ++i) {
+        g = order[i];
+        p = (g == LGW_REG_PAGE_NB) ? 0 : g; /* shadow page */
+        val = reg_ctx->defer_val[g];
+        set = reg_ctx->defer_set[g];
+        for (a = 0; a < 128; a += (run > 0) ? run : 1) {
+            for (run = 0; ((a + run) < 128) && (set[a + run] != 0); ++run) {
+                /* complete the bytes only partly written */
+                j = a + run;
+                if (set[j] == 0xFF) {
+                    continue;
+                }
+                if ((shadow_enabled == true) && SHADOW_VALID(p, j)) {
+                    old = reg_ctx->shadow[p][j];
+                    ++reg_ctx->shadow_stats.nb_avoided;
+                } else {
+                    if ((g != LGW_REG_PAGE_NB) && (g != reg_ctx->regpage)) {
+                        spi_stat += page_switch(g);
+                    }
+                    spi_stat += lgw_spi_r(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, j, &old);
+                    ++reg_ctx->shadow_stats.nb_read;
+                }
+                val[j] = (~set[j] & old) | (set[j] & val[j]);
+            }
+            if (run == 0) {
+                continue;
+            }
+            if ((g != LGW_REG_PAGE_NB) && (g != reg_ctx->regpage)) {
+                spi_stat += page_switch(g);
+            }
+            if (run == 1) {
+                spi_stat += lgw_spi_w(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, a, val[a]);
+            } else {
+                spi_stat += lgw_spi_wb(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, a, &val[a], run);
+            }
+            for (j = a; j < (a + run); ++j) {
+                if (spi_stat == LGW_SPI_SUCCESS) {
+                    shadow_store(p, j, val[j]);
+                } else {
+                    shadow_invalidate(p, j, 1);
+                }
+            }
+        }
+    }
+
+    memset(reg_ctx->defer_set, 0, sizeof reg_ctx->defer_set);
+    reg_ctx->defer_nb = 0;
+    return spi_stat;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* keep the order of an access with the writes held before it */
+static int reg_barrier(void) {
+    return (reg_ctx->defer_nb == 0) ? LGW_SPI_SUCCESS : defer_flush();
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* registers left out of the snapshots */
+static bool snap_is_port(struct lgw_reg_s r) {
+    int i;
+
+    if ((r.page != -1) || (r.addr >= SNAP_COMMON_ADDR)) {
+        return false;
+    }
+    for (i = 0; i < (int)(sizeof snap_common_reads / sizeof snap_common_reads[0]); ++i) {
+        if ((r.addr >= snap_common_reads[i].addr) && (r.addr < (snap_common_reads[i].addr + snap_common_reads[i].size))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint32_t count_bits(uint32_t x) {
+    uint32_t n = 0;
+    while (x != 0) {
+        x &= x - 1;
+        ++n;
+    }
+    return n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* write patterns to the test registers and count the bits read back wrong */
+static uint32_t spi_tune_errors(void) {
+    uint32_t errors = 0;
+    uint16_t lfsr = 0xACE1;
+    uint16_t pat;
+    int32_t r1, r2, r3;
+    int k;
+
+    for (k = 0; k < SPI_TUNE_ROUNDS; ++k) {
+        switch (k) {
+            case 0: pat = 0x0000; break;
+            case 1: pat = 0xFFFF; break;
+            case 2: pat = 0x5555; break;
+            case 3: pat = 0xAAAA; break;
+            default: /* 16-bit Galois LFSR, taps 16 14 13 11 */
+                lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+                pat = lfsr;
+                break;
+        }
+        lgw_reg_write<LGW_SW_TEST_REG1>(pat & 0xFF);
+        lgw_reg_write<LGW_SW_TEST_REG2>((pat >> 8) & 0x3F);
+        lgw_reg_write<LGW_SW_TEST_REG3>((uint16_t)~pat);
+        if ((lgw_reg_read<LGW_SW_TEST_REG1>(&r1) != LGW_REG_SUCCESS) || (lgw_reg_read<LGW_SW_TEST_REG2>(&r2) != LGW_REG_SUCCESS) || (lgw_reg_read<LGW_SW_TEST_REG3>(&r3) != LGW_REG_SUCCESS)) {
+            errors += SPI_TUNE_BITS;
+            continue;
+        }
+        errors += count_bits((r1 ^ pat) & 0xFF);
+        errors += count_bits((r2 ^ (pat >> 8)) & 0x3F);
+        errors += count_bits((r3 ^ ~pat) & 0xFFFF);
+    }
+    return errors;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
+void lgw_reg_ctx_init(struct lgw_reg_ctx_s *ctx, const struct lgw_spi_port_s *port) {
+    memset(ctx, 0, sizeof(struct lgw_reg_ctx_s));
+    ctx->regpage = -1;
+    if (port != NULL) {
+        ctx->port = *port;
+        ctx->has_port = true;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+struct lgw_reg_ctx_s *lgw_reg_select(struct lgw_reg_ctx_s *ctx) {
+    REG_LOCK_SCOPE();
+    struct lgw_reg_ctx_s *prev = reg_ctx;
+
+    /* held writes belong to the concentrator they were made on */
+    if ((reg_ctx->spi_target != NULL) && (reg_ctx->regpage >= 0)) {
+        reg_barrier();
+    }
+    reg_ctx = (ctx != NULL) ? ctx : &reg_ctx_default;
+    return prev;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_reg_lock(void) {
+    if (reg_mutex() == NULL) {
+        DEBUG_MSG("ERROR: NO REGISTER LOCK\n");
+        return LGW_REG_ERROR;
+    }
+    lgw_port_mutex_lock(reg_mutex());
+    ++reg_lock_depth;
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_reg_unlock(void) {
+    if (reg_mutex() == NULL) {
+        return LGW_REG_ERROR;
+    }
+    --reg_lock_depth;
+    lgw_port_mutex_unlock(reg_mutex());
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_reg_lock_prio(void) {
+    unsigned long t0 = micros();
+    uint32_t wait;
+    int x;
+
+    __atomic_add_fetch(&prio_waiting, 1, __ATOMIC_SEQ_CST);
+    x = lgw_reg_lock();
+    __atomic_sub_fetch(&prio_waiting, 1, __ATOMIC_SEQ_CST);
+    if (x != LGW_REG_SUCCESS) {
+        return x;
+    }
+
+    if (reg_lock_depth > 1) {
+        return LGW_REG_SUCCESS; /* nested, accounted to the outermost hold */
+    }
+    wait = (uint32_t)(micros() - t0);
+    prio_request = t0;
+    ++arbiter_stats.nb_prio;
+    if (wait > arbiter_stats.wait_max) {
+        arbiter_stats.wait_max = wait;
+    }
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_reg_unlock_prio(void) {
+    uint32_t latency;
+
+    if (reg_lock_depth == 1) {
+        latency = (uint32_t)(micros() - prio_request);
+        arbiter_stats.latency_last = latency;
+        if (latency > arbiter_stats.latency_max) {
+            arbiter_stats.latency_max = latency;
+        }
+    }
+    return lgw_reg_unlock();
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+bool lgw_reg_prio_pending(void) {
+    return (__atomic_load_n(&prio_waiting, __ATOMIC_SEQ_CST) != 0);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* release every level of the lock for ms, let the priority holders through, take them back */
+static void reg_handover(unsigned long ms) {
+    struct lgw_reg_ctx_s *sel = reg_ctx;
+    int depth;
+    int i;
+
+    /* held writes are sent before the registers change hands */
+    if ((reg_ctx->spi_target != NULL) && (reg_ctx->regpage >= 0)) {
+        reg_barrier();
+    }
+
+    depth = reg_lock_depth;
+    reg_lock_depth = 0;
+    for (i = 0; i < depth; ++i) {
+        lgw_port_mutex_unlock(reg_mutex());
+    }
+    if (ms > 0) {
+        wait_ms(ms);
+    }
+    while (lgw_reg_prio_pending() == true) {
+        lgw_port_yield();
+    }
+    for (i = 0; i < depth; ++i) {
+        lgw_port_mutex_lock(reg_mutex());
+    }
+    reg_lock_depth = depth;
+    reg_ctx = sel; /* the holder gets back the link it worked on */
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+bool lgw_reg_yield(void) {
+    if ((reg_mutex() == NULL) || (lgw_reg_prio_pending() == false)) {
+        return false;
+    }
+    ++arbiter_stats.nb_yield;
+    reg_handover(0);
+    return true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_reg_sleep(uint32_t ms) {
+    if (reg_mutex() == NULL) {
+        wait_ms(ms);
+        return;
+    }
+    reg_handover(ms);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_reg_get_arbiter_stats(struct lgw_reg_arbiter_stats_s *stats, bool clear) {
+    REG_LOCK_SCOPE();
+
+    CHECK_NULL(stats);
+    *stats = arbiter_stats;
+    if (clear == true) {
+        memset(&arbiter_stats, 0, sizeof arbiter_stats);
+    }
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+struct lgw_reg_radio_s *lgw_reg_radio(uint8_t channel) {
+    return (channel < LGW_REG_RADIO_NB) ? &reg_ctx->radio[channel] : NULL;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 /* Concentrator connect */
 int lgw_connect(bool spi_only) {
+    REG_LOCK_SCOPE();
     int spi_stat = LGW_SPI_SUCCESS;
     uint8_t u = 0; 
 
     /* check SPI link status */
-    if (lgw_spi_target != NULL) {
+    if (reg_ctx->spi_target != NULL) {
         DEBUG_MSG("WARNING: concentrator was already connected\n");
-        lgw_spi_close(lgw_spi_target);
+        lgw_spi_close(reg_ctx->spi_target);
     }
+    memset(reg_ctx->shadow_valid, 0, sizeof reg_ctx->shadow_valid);
+    memset(reg_ctx->defer_set, 0, sizeof reg_ctx->defer_set);
+    reg_ctx->defer_nb = 0;
+    reg_ctx->defer = false;
+    radio_invalidate();
 
 
     /* open the SPI link */
-    spi_stat = lgw_spi_open(&lgw_spi_target);
+    spi_stat = lgw_spi_open_port(&reg_ctx->spi_target, (reg_ctx->has_port == true) ? &reg_ctx->port : NULL);
     if (spi_stat != LGW_SPI_SUCCESS) {
         DEBUG_MSG("ERROR CONNECTING CONCENTRATOR\n");
         return LGW_REG_ERROR;
@@ -517,57 +791,238 @@ int lgw_connect(bool spi_only) {
 
     if (spi_only == false ) {
         /* check SX1301 version */
-        spi_stat = lgw_spi_r(lgw_spi_target, lgw_spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, loregs[LGW_VERSION].addr, &u);
+        spi_stat = lgw_spi_r(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, loregs[LGW_VERSION].addr, &u);
         if (spi_stat != LGW_SPI_SUCCESS) {
             DEBUG_MSG("ERROR READING CHIP VERSION REGISTER\n");
             return LGW_REG_ERROR;
         }
-        //Serial.println(u);
-        if (u != loregs[LGW_VERSION].dflt && u != 35) {
-            DEBUG_PRINTF("ERROR: NOT EXPECTED CHIP VERSION (v%u)\n", u);
-            return LGW_REG_ERROR;
+        //Serial.println(u);
+        if (u != loregs[LGW_VERSION].dflt && u != 35) {
+            DEBUG_PRINTF("ERROR: NOT EXPECTED CHIP VERSION (v%u)\n", u);
+            return LGW_REG_ERROR;
+        }
+
+        /* write 0 to the page/reset register */
+        spi_stat = lgw_spi_w(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, loregs[LGW_PAGE_REG].addr, 0);
+        if (spi_stat != LGW_SPI_SUCCESS) {
+            DEBUG_MSG("ERROR WRITING PAGE REGISTER\n");
+            return LGW_REG_ERROR;
+        } else {
+            reg_ctx->regpage = 0;
+        }
+    }
+
+    DEBUG_MSG("Note: success connecting the concentrator\n");
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* SPI link qualification and clock selection */
+int lgw_reg_spi_tune(uint32_t max_speed, uint8_t margin, struct lgw_spi_tune_s *report) {
+    REG_LOCK_SCOPE();
+    int i;
+    int best = -1; /* last rate of the error-free run starting at the slowest rate */
+
+    CHECK_NULL(report);
+    if ((reg_ctx->spi_target == NULL) || (reg_ctx->regpage < 0)) {
+        DEBUG_MSG("ERROR: CONCENTRATOR UNCONNECTED\n");
+        return LGW_REG_ERROR;
+    }
+    reg_barrier();
+    memset(report, 0, sizeof(struct lgw_spi_tune_s));
+    report->bits_tested = SPI_TUNE_ROUNDS * SPI_TUNE_BITS;
+
+    for (i = 0; (i < LGW_SPI_TUNE_RATE_NB) && (spi_tune_rates[i] <= max_speed); ++i) {
+        if (lgw_spi_set_speed(reg_ctx->spi_target, spi_tune_rates[i]) != LGW_SPI_SUCCESS) {
+            DEBUG_MSG("ERROR: SPI CLOCK CANNOT BE CHANGED\n");
+            return LGW_REG_ERROR;
+        }
+        report->speed[i] = spi_tune_rates[i];
+        report->bit_errors[i] = spi_tune_errors();
+        report->nb_rate = i + 1;
+        if ((report->bit_errors[i] == 0) && (best == (i - 1))) {
+            best = i;
+        }
+        DEBUG_PRINTF("Note: SPI %u Hz, %u bit errors\n", report->speed[i], report->bit_errors[i]);
+    }
+
+    if (best < 0) {
+        DEBUG_MSG("ERROR: NO ERROR-FREE SPI CLOCK\n");
+        lgw_spi_set_speed(reg_ctx->spi_target, LORA_DEFAULT_SPI_FREQUENCY);
+        page_switch(reg_ctx->regpage);
+        return LGW_REG_ERROR;
+    }
+    best = (best > margin) ? (best - margin) : 0;
+    report->selected = spi_tune_rates[best];
+    lgw_spi_set_speed(reg_ctx->spi_target, report->selected);
+
+    /* a corrupted transfer may have moved the page, restore it at the safe clock */
+    page_switch(reg_ctx->regpage);
+    memset(reg_ctx->shadow_valid, 0, sizeof reg_ctx->shadow_valid);
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Concentrator disconnect */
+int lgw_disconnect(void) {
+    REG_LOCK_SCOPE();
+    if (reg_ctx->spi_target != NULL) {
+        if (reg_ctx->regpage >= 0) {
+            reg_barrier();
+        }
+        lgw_spi_close(reg_ctx->spi_target);
+        reg_ctx->spi_target = NULL;
+        DEBUG_MSG("Note: success disconnecting the concentrator\n");
+        return LGW_REG_SUCCESS;
+    } else {
+        DEBUG_MSG("WARNING: concentrator was already disconnected\n");
+        return LGW_REG_ERROR;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* soft-reset function */
+int lgw_soft_reset(void) {
+    REG_LOCK_SCOPE();
+    /* check if SPI is initialised */
+    if ((reg_ctx->spi_target == NULL) || (reg_ctx->regpage < 0)) {
+        DEBUG_MSG("ERROR: CONCENTRATOR UNCONNECTED\n");
+        return LGW_REG_ERROR;
+    }
+    reg_barrier();
+    lgw_spi_w(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, 0, 0x80); /* 1 -> SOFT_RESET bit */
+    reg_ctx->regpage = 0; /* reset the paging static variable */
+    shadow_seed_defaults(); /* every register is back to its default value */
+    radio_invalidate(); /* radios are shut down */
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_reg_shadow_setconf(bool enable) {
+    shadow_enabled = enable;
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_reg_shadow_invalidate(void) {
+    REG_LOCK_SCOPE();
+    reg_barrier();
+    memset(reg_ctx->shadow_valid, 0, sizeof reg_ctx->shadow_valid);
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_reg_get_shadow_stats(struct lgw_reg_shadow_stats_s *stats, bool clear) {
+    REG_LOCK_SCOPE();
+    CHECK_NULL(stats);
+    *stats = reg_ctx->shadow_stats;
+    if (clear == true) {
+        memset(&reg_ctx->shadow_stats, 0, sizeof reg_ctx->shadow_stats);
+    }
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_reg_scrub(uint8_t size, uint16_t *nb_drift) {
+    REG_LOCK_SCOPE();
+    int spi_stat = LGW_SPI_SUCCESS;
+    unsigned long t0 = micros();
+    uint8_t buf[128];
+    uint8_t mask, fixed;
+    uint16_t drift = 0;
+    int p, first, end, n, a, i;
+
+    /* check input parameters */
+    if ((size == 0) || (size > 128)) {
+        DEBUG_MSG("ERROR: INVALID SCRUB SIZE\n");
+        return LGW_REG_ERROR;
+    }
+
+    /* check if SPI is initialised */
+    if ((reg_ctx->spi_target == NULL) || (reg_ctx->regpage < 0)) {
+        DEBUG_MSG("ERROR: CONCENTRATOR UNCONNECTED\n");
+        return LGW_REG_ERROR;
+    }
+    if (shadow_mask_ready == false) {
+        shadow_mask_setup();
+    }
+    spi_stat += reg_barrier();
+
+    /* next run of addresses, within the scrubbed range of the page */
+    p = reg_ctx->scrub_page % LGW_REG_PAGE_NB;
+    first = (p == 0) ? SNAP_COMMON_ADDR : SCRUB_PAGED_FIRST;
+    end = (p == 0) ? 128 : SCRUB_PAGED_END;
+    a = (reg_ctx->scrub_addr < first) ? first : reg_ctx->scrub_addr;
+    n = ((a + size) > end) ? (end - a) : size;
+
+    if (p != reg_ctx->regpage) {
+        spi_stat += page_switch(p);
+    }
+    spi_stat += lgw_spi_rb(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, a, buf, n);
+
+    /* compare the bits known from the shadow, write back only the bytes that moved */
+    for (i = 0; (i < n) && (spi_stat == LGW_SPI_SUCCESS); ++i) {
+        mask = (SHADOW_VALID(p, a + i) && !scrub_skipped(p, a + i)) ? shadow_mask[p][a + i] : 0;
+        if (mask == 0) {
+            continue;
+        }
+        ++reg_ctx->scrub_stats.nb_checked;
+        if (((buf[i] ^ reg_ctx->shadow[p][a + i]) & mask) == 0) {
+            continue;
         }
-
-        /* write 0 to the page/reset register */
-        spi_stat = lgw_spi_w(lgw_spi_target, lgw_spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, loregs[LGW_PAGE_REG].addr, 0);
-        if (spi_stat != LGW_SPI_SUCCESS) {
-            DEBUG_MSG("ERROR WRITING PAGE REGISTER\n");
-            return LGW_REG_ERROR;
-        } else {
-            lgw_regpage = 0;
+        ++drift;
+        ++reg_ctx->scrub_stats.nb_drift;
+        reg_ctx->scrub_stats.last_page = p;
+        reg_ctx->scrub_stats.last_addr = a + i;
+        DEBUG_PRINTF("WARNING: page %d address %d drifted, 0x%02X instead of 0x%02X\n", p, a + i, buf[i] & mask, reg_ctx->shadow[p][a + i] & mask);
+        fixed = (buf[i] & ~mask) | (reg_ctx->shadow[p][a + i] & mask);
+        spi_stat += lgw_spi_w(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, a + i, fixed);
+        if (spi_stat == LGW_SPI_SUCCESS) {
+            ++reg_ctx->scrub_stats.nb_repaired;
         }
     }
 
-    DEBUG_MSG("Note: success connecting the concentrator\n");
-    return LGW_REG_SUCCESS;
-}
-
-/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
-
-/* Concentrator disconnect */
-int lgw_disconnect(void) {
-    if (lgw_spi_target != NULL) {
-        lgw_spi_close(lgw_spi_target);
-        lgw_spi_target = NULL;
-        DEBUG_MSG("Note: success disconnecting the concentrator\n");
-        return LGW_REG_SUCCESS;
+    /* move the cursor, next page at the end of this one */
+    if ((a + n) >= end) {
+        reg_ctx->scrub_page = (p + 1) % LGW_REG_PAGE_NB;
+        reg_ctx->scrub_addr = 0;
+        if (reg_ctx->scrub_page == 0) {
+            ++reg_ctx->scrub_stats.nb_round;
+        }
     } else {
-        DEBUG_MSG("WARNING: concentrator was already disconnected\n");
+        reg_ctx->scrub_addr = a + n;
+    }
+    reg_ctx->scrub_stats.bus_time += (uint32_t)(micros() - t0);
+
+    if (nb_drift != NULL) {
+        *nb_drift = drift;
+    }
+    if (spi_stat != LGW_SPI_SUCCESS) {
+        DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER SCRUB\n");
         return LGW_REG_ERROR;
+    } else {
+        return LGW_REG_SUCCESS;
     }
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-/* soft-reset function */
-int lgw_soft_reset(void) {
-    /* check if SPI is initialised */
-    if ((lgw_spi_target == NULL) || (lgw_regpage < 0)) {
-        DEBUG_MSG("ERROR: CONCENTRATOR UNCONNECTED\n");
-        return LGW_REG_ERROR;
+int lgw_reg_get_scrub_stats(struct lgw_reg_scrub_stats_s *stats, bool clear) {
+    REG_LOCK_SCOPE();
+
+    CHECK_NULL(stats);
+    *stats = reg_ctx->scrub_stats;
+    if (clear == true) {
+        memset(&reg_ctx->scrub_stats, 0, sizeof reg_ctx->scrub_stats);
     }
-    lgw_spi_w(lgw_spi_target, lgw_spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, 0, 0x80); /* 1 -> SOFT_RESET bit */
-    lgw_regpage = 0; /* reset the paging static variable */
     return LGW_REG_SUCCESS;
 }
 
@@ -575,7 +1030,9 @@ int lgw_soft_reset(void) {
 
 /* register verification */
 int lgw_reg_check(FILE *f) {
+    REG_LOCK_SCOPE();
     struct lgw_reg_s r;
+    struct lgw_reg_snapshot_s snap;
     int32_t read_value;
     char ok_msg[] = "+++MATCH+++";
     char notok_msg[] = "###MISMATCH###";
@@ -583,16 +1040,26 @@ int lgw_reg_check(FILE *f) {
     int i;
 
     /* check if SPI is initialised */
-    if ((lgw_spi_target == NULL) || (lgw_regpage < 0)) {
+    if ((reg_ctx->spi_target == NULL) || (reg_ctx->regpage < 0)) {
         DEBUG_MSG("ERROR: CONCENTRATOR UNCONNECTED\n");
         fprintf(f, "ERROR: CONCENTRATOR UNCONNECTED\n");
         return LGW_REG_ERROR;
     }
 
+    /* all the pages in a few bursts, then decode from memory */
+    if (lgw_reg_snapshot(&snap) != LGW_REG_SUCCESS) {
+        fprintf(f, "ERROR: SPI ERROR DURING REGISTER SNAPSHOT\n");
+        return LGW_REG_ERROR;
+    }
+
     fprintf(f, "Start of register verification\n");
     for (i=0; i<LGW_TOTALREGS; ++i) {
         r = loregs[i];
-        lgw_reg_r(i, &read_value);
+        if (snap_is_port(r)) {
+            fprintf(f, "---SKIPPED--- reg number %d (data port)\n", i);
+            continue;
+        }
+        lgw_reg_snapshot_get(&snap, i, &read_value);
         ptr = (read_value == r.dflt) ? ok_msg : notok_msg;
         if (r.sign == true)
             fprintf(f, "%s reg number %d read: %d (%x) default: %d (%x)\n", ptr, i, read_value, read_value, r.dflt, r.dflt);
@@ -606,8 +1073,112 @@ int lgw_reg_check(FILE *f) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+/* Read all the register pages */
+int lgw_reg_snapshot(struct lgw_reg_snapshot_s *snap) {
+    REG_LOCK_SCOPE();
+    int spi_stat = LGW_SPI_SUCCESS;
+    int i, p, first;
+
+    /* check input parameters */
+    CHECK_NULL(snap);
+
+    /* check if SPI is initialised */
+    if ((reg_ctx->spi_target == NULL) || (reg_ctx->regpage < 0)) {
+        DEBUG_MSG("ERROR: CONCENTRATOR UNCONNECTED\n");
+        return LGW_REG_ERROR;
+    }
+
+    spi_stat += reg_barrier();
+    memset(snap, 0, sizeof(struct lgw_reg_snapshot_s));
+
+    /* common registers below the first burst, around the data ports */
+    for (i = 0; i < (int)(sizeof snap_common_reads / sizeof snap_common_reads[0]); ++i) {
+        if (snap_common_reads[i].size == 1) {
+            spi_stat += lgw_spi_r(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, snap_common_reads[i].addr, &snap->page[0][snap_common_reads[i].addr]);
+        } else {
+            spi_stat += lgw_spi_rb(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, snap_common_reads[i].addr, &snap->page[0][snap_common_reads[i].addr], snap_common_reads[i].size);
+        }
+    }
+
+    /* one burst per page, current page first */
+    first = reg_ctx->regpage;
+    for (i = 0; i < LGW_REG_PAGE_NB; ++i) {
+        p = (first + i) % LGW_REG_PAGE_NB;
+        if (p != reg_ctx->regpage) {
+            spi_stat += page_switch(p);
+        }
+        spi_stat += lgw_spi_rb(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, SNAP_COMMON_ADDR, &snap->page[p][SNAP_COMMON_ADDR], 128 - SNAP_COMMON_ADDR);
+    }
+
+    if (spi_stat != LGW_SPI_SUCCESS) {
+        DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER SNAPSHOT\n");
+        return LGW_REG_ERROR;
+    } else {
+        return LGW_REG_SUCCESS;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Decode a register from a snapshot */
+int lgw_reg_snapshot_get(const struct lgw_reg_snapshot_s *snap, uint16_t register_id, int32_t *reg_value) {
+    struct lgw_reg_s r;
+
+    /* check input parameters */
+    CHECK_NULL(snap);
+    CHECK_NULL(reg_value);
+    if (register_id >= LGW_TOTALREGS) {
+        DEBUG_MSG("ERROR: REGISTER NUMBER OUT OF DEFINED RANGE\n");
+        return LGW_REG_ERROR;
+    }
+
+    r = loregs[register_id];
+    *reg_value = reg_decode(r, &snap->page[SHADOW_PAGE(r)][r.addr]);
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* List the registers that differ between two snapshots, or from their defaults */
+int lgw_reg_snapshot_diff(const struct lgw_reg_snapshot_s *snap, const struct lgw_reg_snapshot_s *ref, bool config_only, uint16_t *diff, uint16_t max_diff, uint16_t *nb_diff) {
+    struct lgw_reg_s r;
+    int32_t v, w;
+    int i;
+
+    /* check input parameters */
+    CHECK_NULL(snap);
+    CHECK_NULL(nb_diff);
+    if (shadow_mask_ready == false) {
+        shadow_mask_setup();
+    }
+
+    *nb_diff = 0;
+    for (i = 0; i < LGW_TOTALREGS; ++i) {
+        r = loregs[i];
+        if (snap_is_port(r) || (i == LGW_PAGE_REG)) {
+            continue; /* the page register only shows where the snapshot ended */
+        }
+        if ((config_only == true) && ((r.rdon == 1) || (shadow_mask[SHADOW_PAGE(r)][r.addr] == 0))) {
+            continue;
+        }
+        v = reg_decode(r, &snap->page[SHADOW_PAGE(r)][r.addr]);
+        w = (ref != NULL) ? reg_decode(r, &ref->page[SHADOW_PAGE(r)][r.addr]) : r.dflt;
+        if (v != w) {
+            if ((diff != NULL) && (*nb_diff < max_diff)) {
+                diff[*nb_diff] = i;
+            }
+            ++(*nb_diff);
+        }
+    }
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 /* Write to a register addressed by name */
 int lgw_reg_w(uint16_t register_id, int32_t reg_value) {
+    REG_LOCK_SCOPE();
     int spi_stat = LGW_SPI_SUCCESS;
     struct lgw_reg_s r;
 
@@ -618,13 +1189,14 @@ int lgw_reg_w(uint16_t register_id, int32_t reg_value) {
     }
 
     /* check if SPI is initialised */
-    if ((lgw_spi_target == NULL) || (lgw_regpage < 0)) {
+    if ((reg_ctx->spi_target == NULL) || (reg_ctx->regpage < 0)) {
         DEBUG_MSG("ERROR: CONCENTRATOR UNCONNECTED\n");
         return LGW_REG_ERROR;
     }
 
     /* intercept direct access to PAGE_REG & SOFT_RESET */
     if (register_id == LGW_PAGE_REG) {
+        reg_barrier();
         page_switch(reg_value);
         return LGW_REG_SUCCESS;
     } else if (register_id == LGW_SOFT_RESET) {
@@ -643,12 +1215,29 @@ int lgw_reg_w(uint16_t register_id, int32_t reg_value) {
         return LGW_REG_ERROR;
     }
 
+    if (shadow_mask_ready == false) {
+        shadow_mask_setup();
+    }
+
+    /* hold the write, or send the held ones first */
+    if ((reg_ctx->defer == true) && defer_allowed(r)) {
+        defer_register(r, reg_value);
+        return LGW_REG_SUCCESS;
+    }
+    spi_stat += reg_barrier();
+
     /* select proper register page if needed */
-    if ((r.page != -1) && (r.page != lgw_regpage)) {
+    if ((r.page != -1) && (r.page != reg_ctx->regpage)) {
         spi_stat += page_switch(r.page);
     }
 
-    spi_stat += reg_w_align32(lgw_spi_target, lgw_spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, r, reg_value);
+    if ((shadow_enabled == true) && ((r.offs + r.leng) <= 8) && (r.leng < 8) && (shadow_mask[SHADOW_PAGE(r)][r.addr] != 0)) {
+        /* bit field, no read needed when the rest of the byte is known */
+        spi_stat += reg_w_shadow(SHADOW_PAGE(r), r.addr, ((1 << r.leng) - 1) << r.offs, ((uint8_t)reg_value) << r.offs);
+    } else {
+        spi_stat += reg_w_align32(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, r, reg_value);
+        shadow_write_through(r, reg_value, (spi_stat == LGW_SPI_SUCCESS));
+    }
 
     if (spi_stat != LGW_SPI_SUCCESS) {
         DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER WRITE\n");
@@ -660,8 +1249,91 @@ int lgw_reg_w(uint16_t register_id, int32_t reg_value) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+/* Write a list of registers, one burst per run of contiguous bytes */
+int lgw_reg_w_batch(const struct lgw_reg_pair_s *list, uint16_t nb) {
+    REG_LOCK_SCOPE();
+    struct lgw_reg_s r;
+    int i;
+
+    /* check input parameters */
+    CHECK_NULL(list);
+
+    /* check if SPI is initialised */
+    if ((reg_ctx->spi_target == NULL) || (reg_ctx->regpage < 0)) {
+        DEBUG_MSG("ERROR: CONCENTRATOR UNCONNECTED\n");
+        return LGW_REG_ERROR;
+    }
+    if (shadow_mask_ready == false) {
+        shadow_mask_setup();
+    }
+
+    /* check the whole list before holding anything */
+    for (i = 0; i < nb; ++i) {
+        if (list[i].register_id >= LGW_TOTALREGS) {
+            DEBUG_MSG("ERROR: REGISTER NUMBER OUT OF DEFINED RANGE\n");
+            return LGW_REG_ERROR;
+        }
+        r = loregs[list[i].register_id];
+        if (r.rdon == 1) {
+            DEBUG_MSG("ERROR: TRYING TO WRITE A READ-ONLY REGISTER\n");
+            return LGW_REG_ERROR;
+        }
+        if (defer_allowed(r) == false) {
+            DEBUG_MSG("ERROR: REGISTER CANNOT BE WRITTEN IN A BATCH\n");
+            return LGW_REG_ERROR;
+        }
+    }
+
+    for (i = 0; i < nb; ++i) {
+        defer_register(loregs[list[i].register_id], list[i].value);
+    }
+    if (reg_ctx->defer == true) {
+        return LGW_REG_SUCCESS; /* sent with the other held writes */
+    }
+
+    if (defer_flush() != LGW_SPI_SUCCESS) {
+        DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER BATCH WRITE\n");
+        return LGW_REG_ERROR;
+    } else {
+        return LGW_REG_SUCCESS;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_reg_defer(bool enable) {
+    REG_LOCK_SCOPE();
+    int spi_stat;
+
+    /* check if SPI is initialised */
+    if ((reg_ctx->spi_target == NULL) || (reg_ctx->regpage < 0)) {
+        DEBUG_MSG("ERROR: CONCENTRATOR UNCONNECTED\n");
+        return LGW_REG_ERROR;
+    }
+
+    spi_stat = reg_barrier();
+    reg_ctx->defer = enable;
+    return (spi_stat == LGW_SPI_SUCCESS) ? LGW_REG_SUCCESS : LGW_REG_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_reg_barrier(void) {
+    REG_LOCK_SCOPE();
+    /* check if SPI is initialised */
+    if ((reg_ctx->spi_target == NULL) || (reg_ctx->regpage < 0)) {
+        DEBUG_MSG("ERROR: CONCENTRATOR UNCONNECTED\n");
+        return LGW_REG_ERROR;
+    }
+
+    return (reg_barrier() == LGW_SPI_SUCCESS) ? LGW_REG_SUCCESS : LGW_REG_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 /* Read to a register addressed by name */
 int lgw_reg_r(uint16_t register_id, int32_t *reg_value) {
+    REG_LOCK_SCOPE();
     int spi_stat = LGW_SPI_SUCCESS;
     struct lgw_reg_s r;
 
@@ -673,7 +1345,7 @@ int lgw_reg_r(uint16_t register_id, int32_t *reg_value) {
     }
 
     /* check if SPI is initialised */
-    if ((lgw_spi_target == NULL) || (lgw_regpage < 0)) {
+    if ((reg_ctx->spi_target == NULL) || (reg_ctx->regpage < 0)) {
         DEBUG_MSG("ERROR: CONCENTRATOR UNCONNECTED\n");
         return LGW_REG_ERROR;
     }
@@ -681,12 +1353,130 @@ int lgw_reg_r(uint16_t register_id, int32_t *reg_value) {
     /* get register struct from the struct array */
     r = loregs[register_id];
 
+    spi_stat += reg_barrier();
+
     /* select proper register page if needed */
-    if ((r.page != -1) && (r.page != lgw_regpage)) {
+    if ((r.page != -1) && (r.page != reg_ctx->regpage)) {
         spi_stat += page_switch(r.page);
     }
 
-    spi_stat += reg_r_align32(lgw_spi_target, lgw_spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, r, reg_value);
+    spi_stat += reg_r_align32(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, r, reg_value);
+
+    if (spi_stat != LGW_SPI_SUCCESS) {
+        DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER WRITE\n");
+        return LGW_REG_ERROR;
+    } else {
+        return LGW_REG_SUCCESS;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Bit field write with the register descriptor known by the caller */
+int lgw_reg_w_field(int8_t page, uint8_t addr, uint8_t mask, uint8_t bits) {
+    REG_LOCK_SCOPE();
+    int spi_stat = LGW_SPI_SUCCESS;
+    int p = (page < 0) ? 0 : page;
+    uint8_t old;
+
+    /* check input parameters */
+    if ((page < -1) || (page >= LGW_REG_PAGE_NB) || (addr >= 128)) {
+        DEBUG_MSG("ERROR: REGISTER ADDRESS OUT OF DEFINED RANGE\n");
+        return LGW_REG_ERROR;
+    }
+
+    /* check if SPI is initialised */
+    if ((reg_ctx->spi_target == NULL) || (reg_ctx->regpage < 0)) {
+        DEBUG_MSG("ERROR: CONCENTRATOR UNCONNECTED\n");
+        return LGW_REG_ERROR;
+    }
+    if (shadow_mask_ready == false) {
+        shadow_mask_setup();
+    }
+
+    /* hold the write, or send the held ones first */
+    if ((reg_ctx->defer == true) && (shadow_mask[p][addr] != 0)) {
+        defer_merge((page < 0) ? LGW_REG_PAGE_NB : page, addr, mask, bits);
+        return LGW_REG_SUCCESS;
+    }
+    spi_stat += reg_barrier();
+
+    /* select proper register page if needed */
+    if ((page != -1) && (page != reg_ctx->regpage)) {
+        spi_stat += page_switch(page);
+    }
+
+    if ((shadow_enabled == true) && (shadow_mask[p][addr] != 0)) {
+        spi_stat += reg_w_shadow(p, addr, mask, bits);
+    } else {
+        spi_stat += lgw_spi_r(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, addr, &old);
+        spi_stat += lgw_spi_w(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, addr, (~mask & old) | (mask & bits));
+        shadow_invalidate(p, addr, 1);
+    }
+
+    if (spi_stat != LGW_SPI_SUCCESS) {
+        DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER WRITE\n");
+        return LGW_REG_ERROR;
+    } else {
+        return LGW_REG_SUCCESS;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Whole bytes write with the register descriptor known by the caller */
+int lgw_reg_w_bytes(int8_t page, uint8_t addr, uint8_t size, uint32_t value) {
+    REG_LOCK_SCOPE();
+    int spi_stat = LGW_SPI_SUCCESS;
+    int p = (page < 0) ? 0 : page;
+    uint8_t buf[4];
+    int i;
+
+    /* check input parameters */
+    if ((page < -1) || (page >= LGW_REG_PAGE_NB) || (size < 1) || (size > 4) || ((addr + size) > 128)) {
+        DEBUG_MSG("ERROR: REGISTER ADDRESS OUT OF DEFINED RANGE\n");
+        return LGW_REG_ERROR;
+    }
+
+    /* check if SPI is initialised */
+    if ((reg_ctx->spi_target == NULL) || (reg_ctx->regpage < 0)) {
+        DEBUG_MSG("ERROR: CONCENTRATOR UNCONNECTED\n");
+        return LGW_REG_ERROR;
+    }
+    if (shadow_mask_ready == false) {
+        shadow_mask_setup();
+    }
+
+    /* hold the write, or send the held ones first */
+    if ((reg_ctx->defer == true) && (shadow_mask[p][addr] != 0)) {
+        for (i = 0; i < size; ++i) {
+            defer_merge((page < 0) ? LGW_REG_PAGE_NB : page, addr + i, 0xFF, (uint8_t)(value >> (8 * i)));
+        }
+        return LGW_REG_SUCCESS;
+    }
+    spi_stat += reg_barrier();
+
+    /* select proper register page if needed */
+    if ((page != -1) && (page != reg_ctx->regpage)) {
+        spi_stat += page_switch(page);
+    }
+
+    if (size == 1) {
+        buf[0] = (uint8_t)value;
+        spi_stat += lgw_spi_w(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, addr, buf[0]);
+    } else {
+        for (i = 0; i < size; ++i) {
+            buf[i] = (uint8_t)(value >> (8 * i)); /* least significant byte first */
+        }
+        spi_stat += lgw_spi_wb(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, addr, buf, size);
+    }
+    for (i = 0; i < size; ++i) {
+        if (spi_stat == LGW_SPI_SUCCESS) {
+            shadow_store(p, addr + i, buf[i]);
+        } else {
+            shadow_invalidate(p, addr + i, 1);
+        }
+    }
 
     if (spi_stat != LGW_SPI_SUCCESS) {
         DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER WRITE\n");
@@ -698,8 +1488,56 @@ int lgw_reg_r(uint16_t register_id, int32_t *reg_value) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+/* Bytes read with the register descriptor known by the caller */
+int lgw_reg_r_bytes(int8_t page, uint8_t addr, uint8_t size, uint32_t *value) {
+    REG_LOCK_SCOPE();
+    int spi_stat = LGW_SPI_SUCCESS;
+    uint8_t buf[4] = {0,0,0,0};
+    int i;
+
+    /* check input parameters */
+    CHECK_NULL(value);
+    if ((page < -1) || (page >= LGW_REG_PAGE_NB) || (size < 1) || (size > 4) || ((addr + size) > 128)) {
+        DEBUG_MSG("ERROR: REGISTER ADDRESS OUT OF DEFINED RANGE\n");
+        return LGW_REG_ERROR;
+    }
+
+    /* check if SPI is initialised */
+    if ((reg_ctx->spi_target == NULL) || (reg_ctx->regpage < 0)) {
+        DEBUG_MSG("ERROR: CONCENTRATOR UNCONNECTED\n");
+        return LGW_REG_ERROR;
+    }
+
+    spi_stat += reg_barrier();
+
+    /* select proper register page if needed */
+    if ((page != -1) && (page != reg_ctx->regpage)) {
+        spi_stat += page_switch(page);
+    }
+
+    if (size == 1) {
+        spi_stat += lgw_spi_r(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, addr, &buf[0]);
+    } else {
+        spi_stat += lgw_spi_rb(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, addr, buf, size);
+    }
+    *value = 0;
+    for (i = (size - 1); i >= 0; --i) {
+        *value = (uint32_t)buf[i] + (*value << 8); /* transform a 4-byte array into a 32 bit word */
+    }
+
+    if (spi_stat != LGW_SPI_SUCCESS) {
+        DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER READ\n");
+        return LGW_REG_ERROR;
+    } else {
+        return LGW_REG_SUCCESS;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 /* Point to a register by name and do a burst write */
 int lgw_reg_wb(uint16_t register_id, uint8_t *data, uint16_t size) {
+    REG_LOCK_SCOPE();
     int spi_stat = LGW_SPI_SUCCESS;
     struct lgw_reg_s r;
 
@@ -715,7 +1553,7 @@ int lgw_reg_wb(uint16_t register_id, uint8_t *data, uint16_t size) {
     }
 
     /* check if SPI is initialised */
-    if ((lgw_spi_target == NULL) || (lgw_regpage < 0)) {
+    if ((reg_ctx->spi_target == NULL) || (reg_ctx->regpage < 0)) {
         DEBUG_MSG("ERROR: CONCENTRATOR UNCONNECTED\n");
         return LGW_REG_ERROR;
     }
@@ -729,13 +1567,20 @@ int lgw_reg_wb(uint16_t register_id, uint8_t *data, uint16_t size) {
         return LGW_REG_ERROR;
     }
 
+    spi_stat += reg_barrier();
+
     /* select proper register page if needed */
-    if ((r.page != -1) && (r.page != lgw_regpage)) {
+    if ((r.page != -1) && (r.page != reg_ctx->regpage)) {
         spi_stat += page_switch(r.page);
     }
 
     /* do the burst write */
-    spi_stat += lgw_spi_wb(lgw_spi_target, lgw_spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, r.addr, data, size);
+    spi_stat += lgw_spi_wb(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, r.addr, data, size);
+
+    /* data ports keep their address, other bursts overwrite the following registers */
+    if (shadow_mask[SHADOW_PAGE(r)][r.addr] != 0) {
+        shadow_invalidate(SHADOW_PAGE(r), r.addr, size);
+    }
 
     if (spi_stat != LGW_SPI_SUCCESS) {
         DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER BURST WRITE\n");
@@ -749,6 +1594,7 @@ int lgw_reg_wb(uint16_t register_id, uint8_t *data, uint16_t size) {
 
 /* Point to a register by name and do a burst read */
 int lgw_reg_rb(uint16_t register_id, uint8_t *data, uint16_t size) {
+    REG_LOCK_SCOPE();
     int spi_stat = LGW_SPI_SUCCESS;
     struct lgw_reg_s r;
 
@@ -764,7 +1610,7 @@ int lgw_reg_rb(uint16_t register_id, uint8_t *data, uint16_t size) {
     }
 
     /* check if SPI is initialised */
-    if ((lgw_spi_target == NULL) || (lgw_regpage < 0)) {
+    if ((reg_ctx->spi_target == NULL) || (reg_ctx->regpage < 0)) {
         DEBUG_MSG("ERROR: CONCENTRATOR UNCONNECTED\n");
         return LGW_REG_ERROR;
     }
@@ -772,13 +1618,15 @@ int lgw_reg_rb(uint16_t register_id, uint8_t *data, uint16_t size) {
     /* get register struct from the struct array */
     r = loregs[register_id];
 
+    spi_stat += reg_barrier();
+
     /* select proper register page if needed */
-    if ((r.page != -1) && (r.page != lgw_regpage)) {
+    if ((r.page != -1) && (r.page != reg_ctx->regpage)) {
         spi_stat += page_switch(r.page);
     }
 
     /* do the burst read */
-    spi_stat += lgw_spi_rb(lgw_spi_target, lgw_spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, r.addr, data, size);
+    spi_stat += lgw_spi_rb(reg_ctx->spi_target, reg_ctx->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, r.addr, data, size);
 
     if (spi_stat != LGW_SPI_SUCCESS) {
         DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER BURST READ\n");
@@ -0,0 +1,587 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Backend-independent part of the SPI layer.
+    Forwards the lgw_spi_* calls to the selected backend.
+    Handles bus sessions: during a HAL operation the bus is acquired once
+    instead of once per transaction.
+    Counts bus usage per HAL operation.
+    Optionally records every transaction in a ring buffer.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>        /* C99 types */
+#include <stdbool.h>       /* bool type */
+#include <stdio.h>        /* printf fprintf */
+#include <string.h>       /* memset */
+
+#include "loragw_spi.h"
+#include "loragw_debug.h"   /* Activar mensajes seriales */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#if DEBUG_SPI == 1
+    #define DEBUG_MSG(str)                Serial.print(str)
+    #define DEBUG_PRINTF(fmt, args...)    {\
+                                            memset(debug_msg, 0, sizeof(debug_msg));\
+                                            snprintf(debug_msg, sizeof(debug_msg),"%s:%d: " fmt, __func__, __LINE__, args);\
+                                            Serial.print(debug_msg);\
+                                            }
+    #define CHECK_NULL(a)                 {\
+                                            if(a==NULL){\
+                                                memset(debug_msg, 0, sizeof(debug_msg));\
+                                                snprintf(debug_msg, sizeof(debug_msg),"%s:%d: ERROR: NULL POINTER AS ARGUMENT\n", __FUNCTION__, __LINE__);\
+                                                Serial.print(debug_msg);\
+                                                return LGW_SPI_ERROR;}\
+                                          }
+#else
+    #define DEBUG_MSG(str)
+    #define DEBUG_PRINTF(fmt, args...)
+    #define CHECK_NULL(a)                if(a==NULL){return LGW_SPI_ERROR;}
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define SESSION_CAL_LOOPS   16  /* acquire/release pairs timed to estimate their cost */
+#define SESSION_DEPTH_MAX   4   /* nesting levels tracked for bus counters */
+#define BUS_TARGET_NB       4   /* opened targets with their own bus counters */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+#ifdef ARDUINO
+static const struct lgw_spi_backend_s *lgw_spi_backend = &lgw_spi_backend_native;
+#else
+static const struct lgw_spi_backend_s *lgw_spi_backend = &lgw_spi_backend_sim;
+#endif
+
+static int lgw_spi_open_cnt = 0; /*! number of targets currently opened */
+
+static bool session_enabled = true;     /*! hold the bus during HAL operations */
+static uint8_t session_depth = 0;       /*! nesting level of lgw_spi_session_begin calls */
+static uint8_t session_op = LGW_SPI_OP_NONE; /*! operation of the outermost session */
+static uint8_t session_stack[SESSION_DEPTH_MAX]; /*! operations of the nested sessions */
+static void *session_target = NULL;     /*! target holding the bus, NULL if not acquired yet */
+static unsigned long session_start;     /*! micros() when the outermost session began */
+static uint32_t session_txn;            /*! transactions issued in the current session */
+static uint32_t session_cost_ns = 0;    /*! measured cost of one bus acquire/release pair */
+static bool session_cost_ok = false;
+
+static struct lgw_spi_session_stats_s session_stats[LGW_SPI_OP_NB];
+
+static uint8_t bus_op = LGW_SPI_OP_NONE; /*! bucket of the current transactions, innermost session */
+static struct lgw_spi_bus_stats_s bus_stats[LGW_SPI_OP_NB]; /*! all targets */
+
+static struct {
+    void                        *target;                /*! opened target, NULL for a free slot */
+    struct lgw_spi_bus_stats_s  stats[LGW_SPI_OP_NB];
+} bus_target[BUS_TARGET_NB];
+
+static uint8_t *rec_buf = NULL;     /*! recorder ring buffer, NULL when not recording */
+static uint8_t *rec_mem = NULL;     /*! ring buffer memory, kept after stop for dumping */
+static uint32_t rec_size = 0;       /*! size of the ring buffer */
+static uint32_t rec_tail = 0;       /*! position of the oldest record */
+static uint32_t rec_used = 0;       /*! bytes used by records */
+static uint32_t rec_dropped = 0;    /*! records dropped to make room */
+
+/* -------------------------------------------------------------------------- */
+/* --- INTERNAL SHARED VARIABLES -------------------------------------------- */
+
+uint8_t lgw_spi_burst_mode = LGW_SPI_BURST_BULK; /*! how burst payloads are clocked out */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* estimate what a transaction pays to acquire and release the bus on its own */
+static void session_measure_cost(void *spi_target) {
+    unsigned long t;
+    int i;
+
+    t = micros();
+    for (i = 0; i < SESSION_CAL_LOOPS; ++i) {
+        lgw_spi_backend->bus_acquire(spi_target);
+        lgw_spi_backend->bus_release(spi_target);
+    }
+    t = micros() - t;
+    session_cost_ns = (uint32_t)((t * 1000UL) / SESSION_CAL_LOOPS);
+    session_cost_ok = true;
+    DEBUG_PRINTF("Note: bus acquire/release cost %u ns\n", session_cost_ns);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void session_release(void) {
+    if (session_target != NULL) {
+        lgw_spi_backend->bus_release(session_target);
+        session_target = NULL;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* called before every transaction */
+static void session_transaction(void *spi_target) {
+    if (session_depth == 0) {
+        return;
+    }
+    ++session_txn;
+    if ((session_target != NULL) && (session_target != spi_target)) {
+        session_release(); /* another concentrator, give the bus back first */
+    }
+    if ((session_enabled == false) || (session_target != NULL) || (lgw_spi_backend->bus_acquire == NULL)) {
+        return;
+    }
+    if (session_cost_ok == false) {
+        session_measure_cost(spi_target);
+    }
+    if (lgw_spi_backend->bus_acquire(spi_target) == LGW_SPI_SUCCESS) {
+        session_target = spi_target;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* counters of one target, NULL if it has no slot */
+static struct lgw_spi_bus_stats_s *bus_target_stats(void *spi_target) {
+    int i;
+
+    for (i = 0; i < BUS_TARGET_NB; ++i) {
+        if ((bus_target[i].target != NULL) && (bus_target[i].target == spi_target)) {
+            return bus_target[i].stats;
+        }
+    }
+    return NULL;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* called after every transaction, t is micros() before the backend call */
+static void bus_account(void *spi_target, unsigned long t, uint16_t size) {
+    struct lgw_spi_bus_stats_s *st = &bus_stats[bus_op];
+    struct lgw_spi_bus_stats_s *ts = bus_target_stats(spi_target);
+    uint32_t dt = (uint32_t)(micros() - t);
+
+    ++st->nb_transaction;
+    st->bytes += size;
+    st->cs_low_time += dt;
+    if (ts != NULL) {
+        ++ts[bus_op].nb_transaction;
+        ts[bus_op].bytes += size;
+        ts[bus_op].cs_low_time += dt;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void rec_put(uint32_t pos, uint8_t b) {
+    rec_mem[pos % rec_size] = b;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint8_t rec_get(uint32_t pos) {
+    return rec_mem[pos % rec_size];
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* total length of the record starting at pos */
+static uint32_t rec_length(uint32_t pos) {
+    uint16_t size = rec_get(pos + 6) | ((uint16_t)rec_get(pos + 7) << 8);
+    if ((rec_get(pos + 4) & LGW_SPI_REC_TRUNC) != 0) {
+        size = LGW_SPI_REC_TRUNC_SIZE;
+    }
+    return LGW_SPI_REC_HEADER_SIZE + size;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void rec_append(unsigned long t, uint8_t flags, uint8_t mux_target, uint8_t address, const uint8_t *data, uint16_t size) {
+    uint32_t stored = size;
+    uint32_t pos, i;
+
+    if (stored > (rec_size / 4)) {
+        stored = LGW_SPI_REC_TRUNC_SIZE;
+        flags |= LGW_SPI_REC_TRUNC;
+    }
+    if ((LGW_SPI_REC_HEADER_SIZE + stored) > rec_size) {
+        ++rec_dropped;
+        return;
+    }
+    /* make room by dropping the oldest records */
+    while ((rec_size - rec_used) < (LGW_SPI_REC_HEADER_SIZE + stored)) {
+        i = rec_length(rec_tail);
+        rec_tail = (rec_tail + i) % rec_size;
+        rec_used -= i;
+        ++rec_dropped;
+    }
+    pos = rec_tail + rec_used;
+    rec_put(pos + 0, (uint8_t)t);
+    rec_put(pos + 1, (uint8_t)(t >> 8));
+    rec_put(pos + 2, (uint8_t)(t >> 16));
+    rec_put(pos + 3, (uint8_t)(t >> 24));
+    rec_put(pos + 4, flags | ((mux_target & 0x0F) << 4));
+    rec_put(pos + 5, address);
+    rec_put(pos + 6, (uint8_t)size);
+    rec_put(pos + 7, (uint8_t)(size >> 8));
+    for (i = 0; i < stored; ++i) {
+        rec_put(pos + LGW_SPI_REC_HEADER_SIZE + i, data[i]);
+    }
+    rec_used += LGW_SPI_REC_HEADER_SIZE + stored;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int lgw_spi_set_backend(const struct lgw_spi_backend_s *backend) {
+    CHECK_NULL(backend);
+    if (lgw_spi_open_cnt > 0) {
+        DEBUG_MSG("ERROR: CANNOT CHANGE SPI BACKEND WHILE A TARGET IS OPENED\n");
+        return LGW_SPI_ERROR;
+    }
+    lgw_spi_backend = backend;
+    DEBUG_PRINTF("Note: SPI backend set to %s\n", backend->name);
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Select how burst payloads are transferred */
+int lgw_spi_set_burst_mode(uint8_t mode) {
+    if ((mode != LGW_SPI_BURST_BYTEWISE) && (mode != LGW_SPI_BURST_BULK)) {
+        DEBUG_MSG("ERROR: INVALID BURST MODE\n");
+        return LGW_SPI_ERROR;
+    }
+    lgw_spi_burst_mode = mode;
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_set_session_mode(bool enable) {
+    if (session_depth > 0) {
+        DEBUG_MSG("ERROR: CANNOT CHANGE SESSION MODE INSIDE A SESSION\n");
+        return LGW_SPI_ERROR;
+    }
+    session_enabled = enable;
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_session_begin(uint8_t op) {
+    if (op >= LGW_SPI_OP_NB) {
+        DEBUG_MSG("ERROR: INVALID SESSION OPERATION\n");
+        return LGW_SPI_ERROR;
+    }
+    if (session_depth < SESSION_DEPTH_MAX) {
+        session_stack[session_depth] = op;
+        bus_op = op;
+    }
+    if (session_depth++ > 0) {
+        return LGW_SPI_SUCCESS; /* nested, accounted to the outermost session */
+    }
+    session_op = op;
+    session_txn = 0;
+    session_start = micros();
+    if (rec_buf != NULL) {
+        rec_append(session_start, LGW_SPI_REC_SESSION_BEGIN, 0, op, NULL, 0);
+    }
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_session_end(void) {
+    struct lgw_spi_session_stats_s *st;
+    bool held;
+
+    if (session_depth == 0) {
+        DEBUG_MSG("ERROR: NO SESSION OPENED\n");
+        return LGW_SPI_ERROR;
+    }
+    --session_depth;
+    if ((session_depth > 0) && (session_depth <= SESSION_DEPTH_MAX)) {
+        bus_op = session_stack[session_depth - 1];
+    }
+    if (session_depth > 0) {
+        return LGW_SPI_SUCCESS;
+    }
+    bus_op = LGW_SPI_OP_NONE;
+    held = (session_target != NULL);
+    session_release();
+    if (rec_buf != NULL) {
+        rec_append(micros(), LGW_SPI_REC_SESSION_END, 0, session_op, NULL, 0);
+    }
+
+    /* a held session saves one acquire/release pair per transaction but the first */
+    st = &session_stats[session_op];
+    ++st->nb_session;
+    st->nb_transaction += session_txn;
+    st->last_duration = (uint32_t)(micros() - session_start);
+    st->last_saved = ((held == true) && (session_txn > 1)) ? (uint32_t)(((uint64_t)(session_txn - 1) * session_cost_ns) / 1000) : 0;
+    st->total_saved += st->last_saved;
+    DEBUG_PRINTF("Note: session op %u, %u transactions in %u us, %u us saved\n", session_op, session_txn, st->last_duration, st->last_saved);
+
+    session_op = LGW_SPI_OP_NONE;
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_get_session_stats(uint8_t op, struct lgw_spi_session_stats_s *stats) {
+    CHECK_NULL(stats);
+    if (op >= LGW_SPI_OP_NB) {
+        DEBUG_MSG("ERROR: INVALID SESSION OPERATION\n");
+        return LGW_SPI_ERROR;
+    }
+    *stats = session_stats[op];
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_spi_count_page_switch(void *spi_target) {
+    struct lgw_spi_bus_stats_s *ts = bus_target_stats(spi_target);
+
+    ++bus_stats[bus_op].nb_page_switch;
+    if (ts != NULL) {
+        ++ts[bus_op].nb_page_switch;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_get_bus_stats(uint8_t op, struct lgw_spi_bus_stats_s *stats, bool clear) {
+    CHECK_NULL(stats);
+    if (op >= LGW_SPI_OP_NB) {
+        DEBUG_MSG("ERROR: INVALID SESSION OPERATION\n");
+        return LGW_SPI_ERROR;
+    }
+    *stats = bus_stats[op];
+    if (clear == true) {
+        memset(&bus_stats[op], 0, sizeof(struct lgw_spi_bus_stats_s));
+    }
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_get_target_bus_stats(void *spi_target, uint8_t op, struct lgw_spi_bus_stats_s *stats, bool clear) {
+    struct lgw_spi_bus_stats_s *ts;
+
+    CHECK_NULL(spi_target);
+    CHECK_NULL(stats);
+    if (op >= LGW_SPI_OP_NB) {
+        DEBUG_MSG("ERROR: INVALID SESSION OPERATION\n");
+        return LGW_SPI_ERROR;
+    }
+    ts = bus_target_stats(spi_target);
+    if (ts == NULL) {
+        DEBUG_MSG("ERROR: NO BUS COUNTERS FOR THAT TARGET\n");
+        return LGW_SPI_ERROR;
+    }
+    *stats = ts[op];
+    if (clear == true) {
+        memset(&ts[op], 0, sizeof(struct lgw_spi_bus_stats_s));
+    }
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_rec_start(uint8_t *buf, uint32_t size) {
+    CHECK_NULL(buf);
+    if (size < (LGW_SPI_REC_HEADER_SIZE + LGW_SPI_REC_TRUNC_SIZE) * 4) {
+        DEBUG_MSG("ERROR: RECORDER BUFFER TOO SMALL\n");
+        return LGW_SPI_ERROR;
+    }
+    rec_mem = buf;
+    rec_size = size;
+    rec_tail = 0;
+    rec_used = 0;
+    rec_dropped = 0;
+    rec_buf = buf;
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_rec_stop(void) {
+    rec_buf = NULL;
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_rec_dump(uint8_t *out, uint32_t size, uint32_t *len, uint32_t *nb_dropped) {
+    uint32_t pos, n, i;
+
+    CHECK_NULL(out);
+    CHECK_NULL(len);
+    *len = 0;
+    if (rec_mem == NULL) {
+        DEBUG_MSG("ERROR: NOTHING RECORDED\n");
+        return LGW_SPI_ERROR;
+    }
+    for (pos = 0; pos < rec_used; pos += n) {
+        n = rec_length(rec_tail + pos);
+        if ((*len + n) > size) {
+            break;
+        }
+        for (i = 0; i < n; ++i) {
+            out[*len + i] = rec_get(rec_tail + pos + i);
+        }
+        *len += n;
+    }
+    if (nb_dropped != NULL) {
+        *nb_dropped = rec_dropped;
+    }
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_open(void **spi_target_ptr) {
+    return lgw_spi_open_port(spi_target_ptr, NULL);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_open_port(void **spi_target_ptr, const struct lgw_spi_port_s *port) {
+    int spi_stat;
+    int i;
+
+    CHECK_NULL(spi_target_ptr);
+    spi_stat = lgw_spi_backend->open(spi_target_ptr, port);
+    if (spi_stat == LGW_SPI_SUCCESS) {
+        ++lgw_spi_open_cnt;
+        session_cost_ok = false; /* bus settings may differ, measure again */
+        for (i = 0; i < BUS_TARGET_NB; ++i) {
+            if (bus_target[i].target == NULL) {
+                bus_target[i].target = *spi_target_ptr;
+                memset(bus_target[i].stats, 0, sizeof bus_target[i].stats);
+                break;
+            }
+        }
+        if (i == BUS_TARGET_NB) {
+            DEBUG_MSG("WARNING: NO FREE BUS COUNTERS, TARGET ONLY COUNTED IN THE TOTALS\n");
+        }
+    }
+    return spi_stat;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_close(void *spi_target) {
+    int spi_stat;
+    int i;
+
+    CHECK_NULL(spi_target);
+    if (session_target == spi_target) {
+        session_release();
+    }
+    spi_stat = lgw_spi_backend->close(spi_target);
+    if ((spi_stat == LGW_SPI_SUCCESS) && (lgw_spi_open_cnt > 0)) {
+        --lgw_spi_open_cnt;
+    }
+    if (spi_stat == LGW_SPI_SUCCESS) {
+        for (i = 0; i < BUS_TARGET_NB; ++i) {
+            if (bus_target[i].target == spi_target) {
+                bus_target[i].target = NULL;
+            }
+        }
+    }
+    return spi_stat;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_set_speed(void *spi_target, uint32_t speed) {
+    CHECK_NULL(spi_target);
+    if (lgw_spi_backend->set_speed == NULL) {
+        DEBUG_MSG("ERROR: SPI BACKEND HAS A FIXED CLOCK\n");
+        return LGW_SPI_ERROR;
+    }
+    return lgw_spi_backend->set_speed(spi_target, speed);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_w(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t data) {
+    unsigned long t;
+    int spi_stat;
+
+    session_transaction(spi_target);
+    t = micros();
+    spi_stat = lgw_spi_backend->w(spi_target, spi_mux_mode, spi_mux_target, address, data);
+    bus_account(spi_target, t, 1);
+    if (rec_buf != NULL) {
+        rec_append(t, LGW_SPI_REC_WRITE, spi_mux_target, address, &data, 1);
+    }
+    return spi_stat;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_r(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data) {
+    unsigned long t;
+    int spi_stat;
+
+    session_transaction(spi_target);
+    t = micros();
+    spi_stat = lgw_spi_backend->r(spi_target, spi_mux_mode, spi_mux_target, address, data);
+    bus_account(spi_target, t, 1);
+    if ((rec_buf != NULL) && (spi_stat == LGW_SPI_SUCCESS)) {
+        rec_append(t, LGW_SPI_REC_READ, spi_mux_target, address, data, 1);
+    }
+    return spi_stat;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_wb(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size) {
+    unsigned long t;
+    int spi_stat;
+
+    session_transaction(spi_target);
+    t = micros();
+    spi_stat = lgw_spi_backend->wb(spi_target, spi_mux_mode, spi_mux_target, address, data, size);
+    bus_account(spi_target, t, size);
+    if ((rec_buf != NULL) && (data != NULL)) {
+        rec_append(t, LGW_SPI_REC_WRITE | LGW_SPI_REC_BURST, spi_mux_target, address, data, size);
+    }
+    return spi_stat;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spi_rb(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size) {
+    unsigned long t;
+    int spi_stat;
+
+    session_transaction(spi_target);
+    t = micros();
+    spi_stat = lgw_spi_backend->rb(spi_target, spi_mux_mode, spi_mux_target, address, data, size);
+    bus_account(spi_target, t, size);
+    if ((rec_buf != NULL) && (spi_stat == LGW_SPI_SUCCESS)) {
+        rec_append(t, LGW_SPI_REC_READ | LGW_SPI_REC_BURST, spi_mux_target, address, data, size);
+    }
+    return spi_stat;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
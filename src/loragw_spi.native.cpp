@@ -12,12 +12,19 @@ Description:
     Single-byte read/write and burst read/write.
     Does not handle pagination.
     Could be used with multiple SPI ports in parallel (explicit file descriptor)
+    ESP32 backend, using the Arduino SPIClass driver.
+    Each opened target carries its own chip select, reset pin, SPI host and
+    clock, so several concentrators can share a host or use both.
+    Inside a bus session the SPI transaction is opened once and the chip
+    select is driven through the GPIO set/clear registers.
 
 License: Revised BSD License, see LICENSE.TXT file include in the project
 Maintainer: Sylvain Miermont
 */
 
 
+#ifdef ARDUINO
+
 /* -------------------------------------------------------------------------- */
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
@@ -28,8 +35,8 @@ Maintainer: Sylvain Miermont
 #include <fcntl.h>        /* open */
 #include <string.h>        /* memset */
 
-#include <sys/ioctl.h>
 #include <SPI.h>
+#include <soc/gpio_struct.h>   /* GPIO.out_w1ts/out_w1tc */
 
 #include "loragw_spi.h"
 #include "loragw_hal.h"
@@ -40,17 +47,21 @@ Maintainer: Sylvain Miermont
 /* --- PRIVATE MACROS ------------------------------------------------------- */
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+/* chip select through the GPIO set/clear registers, one store instead of a digitalWrite call */
+#define SS_LOW_FAST(pin)    {if ((pin) < 32) {GPIO.out_w1tc = (1UL << (pin));} else {GPIO.out1_w1tc.val = (1UL << ((pin) - 32));}}
+#define SS_HIGH_FAST(pin)   {if ((pin) < 32) {GPIO.out_w1ts = (1UL << (pin));} else {GPIO.out1_w1ts.val = (1UL << ((pin) - 32));}}
 #if DEBUG_SPI == 1
    #define DEBUG_MSG(str)                Serial.print(str)
     #define DEBUG_PRINTF(fmt, args...)    {\
                                             memset(debug_msg, 0, sizeof(debug_msg));\
-                                            sprintf(debug_msg,"%s:%d: " fmt, __func__, __LINE__, args);\
+                                            snprintf(debug_msg, sizeof(debug_msg),"%s:%d: " fmt, __func__, __LINE__, args);\
                                             Serial.print(debug_msg);\
                                             }
     #define CHECK_NULL(a)                 {\
                                             if(a==NULL){\
                                                 memset(debug_msg, 0, sizeof(debug_msg));\
-                                                sprintf(debug_msg,"%s:%d: ERROR: NULL POINTER AS ARGUMENT\n", __FUNCTION__, __LINE__);\
+                                                snprintf(debug_msg, sizeof(debug_msg),"%s:%d: ERROR: NULL POINTER AS ARGUMENT\n", __FUNCTION__, __LINE__);\
                                                 Serial.print(debug_msg);\
                                                 return LGW_SPI_ERROR;}\
                                           }
@@ -66,64 +77,135 @@ Maintainer: Sylvain Miermont
 #define READ_ACCESS     0x00
 #define WRITE_ACCESS    0x80
 #define SPI_SPEED       8000000
-#define SPI_DEV_PATH    "/dev/spidev0.0"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
-SPISettings _spiSettings(LORA_DEFAULT_SPI_FREQUENCY, MSBFIRST, SPI_MODE0);
-int _ss=LORA_DEFAULT_SS_PIN;
-int _reset=LORA_DEFAULT_RESET_PIN;
+/* state of an opened concentrator, the target handed to the upper layers */
+struct native_port_s {
+    SPIClass    *spi;       /*! SPI host driver */
+    SPISettings settings;   /*! clock and mode of the transactions */
+    int         ss;         /*! chip select pin */
+    bool        bus_held;   /*! SPI transaction kept open by a bus session */
+};
+
 int _sck=LORA_DEFAULT_SCK_PIN;
 int _miso=LORA_DEFAULT_MISO_PIN;
 int _mosi=LORA_DEFAULT_MOSI_PIN;
 
+static SPIClass spi_alt(HSPI); /*! second SPI host, LGW_SPI_HOST_ALT */
+static uint8_t host_users[2] = {0, 0}; /*! opened targets on each host */
+
+extern uint8_t lgw_spi_burst_mode; /*! how burst payloads are clocked out */
+
 
 /* -------------------------------------------------------------------------- */
-/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* start of a transaction: take the bus unless a session holds it, assert CS */
+static inline void native_select(struct native_port_s *port) {
+    if (port->bus_held == true) {
+        SS_LOW_FAST(port->ss);
+    } else {
+        digitalWrite(port->ss, LOW);
+        port->spi->beginTransaction(port->settings);
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* end of a transaction: release CS, give the bus back unless a session holds it */
+static inline void native_deselect(struct native_port_s *port) {
+    if (port->bus_held == true) {
+        SS_HIGH_FAST(port->ss);
+    } else {
+        port->spi->endTransaction();
+        digitalWrite(port->ss, HIGH);
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 /* SPI initialization and configuration */
-int lgw_spi_open(SPIClass** spi_target_ptr) {
+static int native_spi_open(void **spi_target_ptr, const struct lgw_spi_port_s *port_conf) {
+    struct native_port_s *port;
+    uint8_t host = LGW_SPI_HOST_DEFAULT;
+    int ss = LORA_DEFAULT_SS_PIN;
+    int reset = LORA_DEFAULT_RESET_PIN;
+
+    if (port_conf != NULL) {
+        host = port_conf->host;
+        ss = port_conf->ss;
+        reset = port_conf->reset;
+    }
+    if (host > LGW_SPI_HOST_ALT) {
+        DEBUG_MSG("ERROR: INVALID SPI HOST\n");
+        return LGW_SPI_ERROR;
+    }
+    port = (struct native_port_s *)malloc(sizeof(struct native_port_s));
+    if (port == NULL) {
+        DEBUG_MSG("ERROR: failed to allocate SPI target\n");
+        return LGW_SPI_ERROR;
+    }
+    port->settings = SPISettings(LORA_DEFAULT_SPI_FREQUENCY, MSBFIRST, SPI_MODE0);
+    port->ss = ss;
+    port->bus_held = false;
+
     // setup pins
-    pinMode(_ss, OUTPUT);
-    digitalWrite(_ss, HIGH);
+    pinMode(ss, OUTPUT);
+    digitalWrite(ss, HIGH);
     
-    if (_reset!= -1) {
-        pinMode(_reset, OUTPUT);
+    if (reset != -1) {
+        pinMode(reset, OUTPUT);
         // perform reset
-        digitalWrite(_reset, HIGH);
+        digitalWrite(reset, HIGH);
         delay(100);
-        digitalWrite(_reset, LOW);
+        digitalWrite(reset, LOW);
         delay(1000);
-        pinMode(_reset, INPUT);
+        pinMode(reset, INPUT);
     }
     
     //puntero hacia el spi del sistema
-    *spi_target_ptr=&LORA_DEFAULT_SPI;
-
-    // start SPI
-    (*spi_target_ptr)->begin(_sck, _miso, _mosi);
-
+    if (host == LGW_SPI_HOST_DEFAULT) {
+        port->spi = &LORA_DEFAULT_SPI;
+    } else {
+        port->spi = &spi_alt;
+    }
 
-    if (*spi_target_ptr == NULL) {
-        DEBUG_PRINTF("ERROR: failed to open SPI device %s\n", SPI_DEV_PATH);
-        return LGW_SPI_ERROR;
+    // start SPI, once per host
+    if (host_users[host]++ == 0) {
+        if (host == LGW_SPI_HOST_DEFAULT) {
+            port->spi->begin(_sck, _miso, _mosi);
+        } else {
+            port->spi->begin();
+        }
     }
+    *spi_target_ptr = (void *)port;
 
-    DEBUG_MSG("Note: SPI port opened and configured ok\n");
+    DEBUG_PRINTF("Note: SPI port opened and configured ok, host %u CS %d\n", host, ss);
     return LGW_SPI_SUCCESS;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 /* SPI release */
-int lgw_spi_close(SPIClass *spi_target) {
+static int native_spi_close(void *spi_target_ptr) {
+    struct native_port_s *port = (struct native_port_s *)spi_target_ptr;
+    uint8_t host;
 
     /* check input variables */
-    CHECK_NULL(spi_target);
+    CHECK_NULL(port);
 
     // stop SPI
-    spi_target->end();
+    if (port->bus_held == true) {
+        port->spi->endTransaction();
+        port->bus_held = false;
+    }
+    host = (port->spi == &spi_alt) ? LGW_SPI_HOST_ALT : LGW_SPI_HOST_DEFAULT;
+    if ((host_users[host] > 0) && (--host_users[host] == 0)) {
+        port->spi->end();
+    }
+    free(port);
     
     DEBUG_MSG("Note: SPI port closed\n");
     return LGW_SPI_SUCCESS;
@@ -132,23 +214,20 @@ int lgw_spi_close(SPIClass *spi_target) {
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 /* Simple write */
-int lgw_spi_w(SPIClass *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t data) {
+static int native_spi_w(void *spi_target_ptr, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t data) {
+    struct native_port_s *port = (struct native_port_s *)spi_target_ptr;
     int a=1;
 
-    CHECK_NULL(spi_target);
+    CHECK_NULL(port);
     if ((address & 0x80) != 0) {
         DEBUG_MSG("WARNING: SPI address > 127\n");
     }
 
     /* I/O transaction */
-    digitalWrite(_ss, LOW);
-
-    spi_target->beginTransaction(_spiSettings);
-    spi_target->transfer(WRITE_ACCESS | (address & 0x7F));
-    a=spi_target->transfer(data);
-    spi_target->endTransaction();
-
-    digitalWrite(_ss, HIGH);
+    native_select(port);
+    port->spi->transfer(WRITE_ACCESS | (address & 0x7F));
+    a=port->spi->transfer(data);
+    native_deselect(port);
 
     /* determine return code */
     if (a != 0) {
@@ -163,25 +242,22 @@ int lgw_spi_w(SPIClass *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 /* Simple read */
-int lgw_spi_r(SPIClass *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data) {
+static int native_spi_r(void *spi_target_ptr, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data) {
+    struct native_port_s *port = (struct native_port_s *)spi_target_ptr;
     int a=270;
 
     /* check input variables */
-    CHECK_NULL(spi_target);
+    CHECK_NULL(port);
     if ((address & 0x80) != 0) {
         DEBUG_MSG("WARNING: SPI address > 127\n");
     }
     CHECK_NULL(data);
 
     /* I/O transaction */
-    digitalWrite(_ss, LOW);
-
-    spi_target->beginTransaction(_spiSettings);
-    spi_target->transfer(READ_ACCESS | (address & 0x7F));
-    a=spi_target->transfer(0xFF);
-    spi_target->endTransaction();
-
-    digitalWrite(_ss, HIGH);
+    native_select(port);
+    port->spi->transfer(READ_ACCESS | (address & 0x7F));
+    a=port->spi->transfer(0xFF);
+    native_deselect(port);
 
     //Serial.println(a);
     /* determine return code */
@@ -198,12 +274,13 @@ int lgw_spi_r(SPIClass *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 /* Burst (multiple-byte) write */
-int lgw_spi_wb(SPIClass *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size) {
+static int native_spi_wb(void *spi_target_ptr, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size) {
+    struct native_port_s *port = (struct native_port_s *)spi_target_ptr;
     int i;
     int a=1;
 
     /* check input parameters */
-    CHECK_NULL(spi_target);
+    CHECK_NULL(port);
     if ((address & 0x80) != 0) {
         DEBUG_MSG("WARNING: SPI address > 127\n");
     }
@@ -214,15 +291,18 @@ int lgw_spi_wb(SPIClass *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_targe
     }
 
     /* I/O transaction */
-    digitalWrite(_ss, LOW);
-    
-    spi_target->beginTransaction(_spiSettings);
-    a=spi_target->transfer(WRITE_ACCESS | (address & 0x7F));
-    for (i=0; i < size; ++i) {
-        a+=spi_target->transfer(*(data+i));
+    native_select(port);
+    a=port->spi->transfer(WRITE_ACCESS | (address & 0x7F));
+    if (lgw_spi_burst_mode == LGW_SPI_BURST_BULK) {
+        /* whole payload in one driver call, the peripheral streams it through its FIFO */
+        port->spi->writeBytes(data, size);
+        i = size;
+    } else {
+        for (i=0; i < size; ++i) {
+            a+=port->spi->transfer(*(data+i));
+        }
     }
-    spi_target->endTransaction();
-    digitalWrite(_ss, HIGH);
+    native_deselect(port);
 
     DEBUG_PRINTF("BURST WRITE: Bytes transferidos: %d # bytes totales: %d \n", i, size);
 
@@ -239,11 +319,12 @@ int lgw_spi_wb(SPIClass *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_targe
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 /* Burst (multiple-byte) read */
-int lgw_spi_rb(SPIClass *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size) {
+static int native_spi_rb(void *spi_target_ptr, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size) {
+    struct native_port_s *port = (struct native_port_s *)spi_target_ptr;
     int i;
 
     /* check input parameters */
-    CHECK_NULL(spi_target);
+    CHECK_NULL(port);
     if ((address & 0x80) != 0) {
         DEBUG_MSG("WARNING: SPI address > 127\n");
     }
@@ -254,15 +335,18 @@ int lgw_spi_rb(SPIClass *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_targe
     }
 
     /* I/O transaction */
-    digitalWrite(_ss, LOW);
-    
-    spi_target->beginTransaction(_spiSettings);
-    spi_target->transfer(READ_ACCESS | (address & 0x7F));
-    for (i=0; i < size; ++i) {
-        *(data+i)=spi_target->transfer(0);
+    native_select(port);
+    port->spi->transfer(READ_ACCESS | (address & 0x7F));
+    if (lgw_spi_burst_mode == LGW_SPI_BURST_BULK) {
+        /* NULL TX buffer: the driver clocks out dummy bytes while filling data */
+        port->spi->transferBytes(NULL, data, size);
+        i = size;
+    } else {
+        for (i=0; i < size; ++i) {
+            *(data+i)=port->spi->transfer(0);
+        }
     }
-    spi_target->endTransaction();
-    digitalWrite(_ss, HIGH);
+    native_deselect(port);
 
     DEBUG_PRINTF("BURST READ: Bytes transferidos: %d # bytes totales: %d \n", i, size);
 
@@ -277,4 +361,69 @@ int lgw_spi_rb(SPIClass *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_targe
     }
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Keep the SPI transaction opened across several lgw_spi_* calls */
+static int native_bus_acquire(void *spi_target_ptr) {
+    struct native_port_s *port = (struct native_port_s *)spi_target_ptr;
+
+    CHECK_NULL(port);
+    if (port->bus_held == false) {
+        port->spi->beginTransaction(port->settings);
+        port->bus_held = true;
+    }
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int native_bus_release(void *spi_target_ptr) {
+    struct native_port_s *port = (struct native_port_s *)spi_target_ptr;
+
+    CHECK_NULL(port);
+    if (port->bus_held == true) {
+        port->spi->endTransaction();
+        port->bus_held = false;
+    }
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Change the SPI clock, applied from the next transaction */
+static int native_set_speed(void *spi_target_ptr, uint32_t speed) {
+    struct native_port_s *port = (struct native_port_s *)spi_target_ptr;
+
+    CHECK_NULL(port);
+    if (speed == 0) {
+        return LGW_SPI_ERROR;
+    }
+    port->settings = SPISettings(speed, MSBFIRST, SPI_MODE0);
+    if (port->bus_held == true) {
+        /* settings are only loaded by beginTransaction */
+        port->spi->endTransaction();
+        port->spi->beginTransaction(port->settings);
+    }
+    DEBUG_PRINTF("Note: SPI clock set to %u Hz\n", speed);
+    return LGW_SPI_SUCCESS;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC VARIABLES ----------------------------------------------------- */
+
+const struct lgw_spi_backend_s lgw_spi_backend_native = {
+    "native",
+    native_spi_open,
+    native_spi_close,
+    native_bus_acquire,
+    native_bus_release,
+    native_spi_w,
+    native_spi_r,
+    native_spi_wb,
+    native_spi_rb,
+    native_set_speed
+};
+
+#endif
+
 /* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,290 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    SPI backend replaying a trace captured with the transaction recorder.
+    Each call is matched against the next records of the trace, within the
+    current recorded HAL operation. Unmatched calls go to a simulated
+    concentrator, which also sees every write so it stays coherent.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>        /* C99 types */
+#include <stdbool.h>       /* bool type */
+#include <string.h>        /* memset memcpy memcmp */
+
+#include "loragw_spi.h"
+#include "loragw_spi_replay.h"
+#include "loragw_debug.h"   /* Activar mensajes seriales */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#if DEBUG_SPI == 1
+    #define DEBUG_MSG(str)                Serial.print(str)
+#else
+    #define DEBUG_MSG(str)
+#endif
+#define CHECK_NULL(a)                if(a==NULL){return LGW_SPI_ERROR;}
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define REPLAY_LOOKAHEAD    16  /* records searched ahead of the cursor for a match */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct replay_rec_s {
+    uint32_t t;             /* timestamp, us */
+    uint8_t flags;          /* kind, burst and truncated bits */
+    uint8_t mux_target;
+    uint8_t addr;           /* address, or HAL operation */
+    uint16_t size;          /* transfer size */
+    uint16_t stored;        /* data bytes present in the trace */
+    const uint8_t *data;
+    uint32_t next;          /* offset of the following record */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static const uint8_t *replay_trace = NULL;
+static uint32_t replay_size = 0;
+static uint32_t replay_cursor = 0;  /* offset of the next record to match */
+static bool replay_suspended = false; /* every call goes to the sim */
+static struct lgw_replay_stats_s replay_stats;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* decode the record at offset pos, false if it does not fit in the trace */
+static bool replay_parse(uint32_t pos, struct replay_rec_s *rec) {
+    const uint8_t *p = replay_trace + pos;
+
+    if ((pos + LGW_SPI_REC_HEADER_SIZE) > replay_size) {
+        return false;
+    }
+    rec->t = p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    rec->flags = p[4] & 0x0F;
+    rec->mux_target = p[4] >> 4;
+    rec->addr = p[5];
+    rec->size = p[6] | ((uint16_t)p[7] << 8);
+    rec->stored = ((rec->flags & LGW_SPI_REC_TRUNC) != 0) ? LGW_SPI_REC_TRUNC_SIZE : rec->size;
+    rec->data = p + LGW_SPI_REC_HEADER_SIZE;
+    rec->next = pos + LGW_SPI_REC_HEADER_SIZE + rec->stored;
+    return (rec->next <= replay_size);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* find the call among the next records of the current operation, move the cursor past it */
+static bool replay_match(uint8_t kind, bool burst, uint8_t mux_target, uint8_t address, uint16_t size, struct replay_rec_s *rec) {
+    uint32_t pos = replay_cursor;
+    int n;
+
+    if ((replay_trace == NULL) || (replay_suspended == true)) {
+        return false;
+    }
+    for (n = 0; (n < REPLAY_LOOKAHEAD) && replay_parse(pos, rec); ++n) {
+        if ((rec->flags & LGW_SPI_REC_KIND_MASK) >= LGW_SPI_REC_SESSION_BEGIN) {
+            return false; /* never cross an operation boundary */
+        }
+        if (((rec->flags & LGW_SPI_REC_KIND_MASK) == kind) && (((rec->flags & LGW_SPI_REC_BURST) != 0) == burst) && (rec->mux_target == mux_target) && (rec->addr == (address & 0x7F)) && (rec->size == size)) {
+            replay_stats.skipped += n;
+            replay_cursor = rec->next;
+            ++replay_stats.matched;
+            return true;
+        }
+        pos = rec->next;
+    }
+    return false;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int replay_spi_open(void **spi_target_ptr, const struct lgw_spi_port_s *port) {
+    return lgw_spi_backend_sim.open(spi_target_ptr, port);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int replay_spi_close(void *spi_target) {
+    return lgw_spi_backend_sim.close(spi_target);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int replay_spi_w(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t data) {
+    struct replay_rec_s rec;
+
+    if (replay_match(LGW_SPI_REC_WRITE, false, spi_mux_target, address, 1, &rec) == true) {
+        if (rec.data[0] != data) {
+            ++replay_stats.data_mismatch;
+        }
+    } else {
+        replay_stats.unscripted += (replay_suspended == true) ? 0 : 1;
+    }
+    return lgw_spi_backend_sim.w(spi_target, spi_mux_mode, spi_mux_target, address, data);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int replay_spi_r(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data) {
+    struct replay_rec_s rec;
+
+    CHECK_NULL(data);
+    if (replay_match(LGW_SPI_REC_READ, false, spi_mux_target, address, 1, &rec) == true) {
+        *data = rec.data[0];
+        return LGW_SPI_SUCCESS;
+    }
+    replay_stats.unscripted += (replay_suspended == true) ? 0 : 1;
+    return lgw_spi_backend_sim.r(spi_target, spi_mux_mode, spi_mux_target, address, data);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int replay_spi_wb(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size) {
+    struct replay_rec_s rec;
+
+    CHECK_NULL(data);
+    if (replay_match(LGW_SPI_REC_WRITE, true, spi_mux_target, address, size, &rec) == true) {
+        if (memcmp(rec.data, data, rec.stored) != 0) {
+            ++replay_stats.data_mismatch;
+        }
+    } else {
+        replay_stats.unscripted += (replay_suspended == true) ? 0 : 1;
+    }
+    return lgw_spi_backend_sim.wb(spi_target, spi_mux_mode, spi_mux_target, address, data, size);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int replay_spi_rb(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size) {
+    struct replay_rec_s rec;
+    int spi_stat;
+
+    CHECK_NULL(data);
+    if (replay_match(LGW_SPI_REC_READ, true, spi_mux_target, address, size, &rec) == true) {
+        spi_stat = LGW_SPI_SUCCESS;
+        if (rec.stored < size) {
+            /* truncated in the trace, the end comes from the sim */
+            spi_stat = lgw_spi_backend_sim.rb(spi_target, spi_mux_mode, spi_mux_target, address, data, size);
+        }
+        memcpy(data, rec.data, rec.stored);
+        return spi_stat;
+    }
+    replay_stats.unscripted += (replay_suspended == true) ? 0 : 1;
+    return lgw_spi_backend_sim.rb(spi_target, spi_mux_mode, spi_mux_target, address, data, size);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC VARIABLES ----------------------------------------------------- */
+
+const struct lgw_spi_backend_s lgw_spi_backend_replay = {
+    "replay",
+    replay_spi_open,
+    replay_spi_close,
+    NULL,
+    NULL,
+    replay_spi_w,
+    replay_spi_r,
+    replay_spi_wb,
+    replay_spi_rb,
+    NULL
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int lgw_replay_load(const uint8_t *trace, uint32_t size) {
+    struct replay_rec_s rec;
+    uint32_t pos = 0;
+
+    CHECK_NULL(trace);
+    replay_trace = trace;
+    replay_size = size;
+    while (pos < size) {
+        if (replay_parse(pos, &rec) == false) {
+            DEBUG_MSG("ERROR: MALFORMED SPI TRACE\n");
+            replay_trace = NULL;
+            return LGW_SPI_ERROR;
+        }
+        pos = rec.next;
+    }
+    replay_cursor = 0;
+    memset(&replay_stats, 0, sizeof replay_stats);
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_replay_next_session(struct lgw_replay_session_s *session) {
+    struct replay_rec_s rec;
+    uint32_t pos;
+    uint32_t t0;
+
+    CHECK_NULL(session);
+    if (replay_trace == NULL) {
+        return LGW_SPI_ERROR;
+    }
+
+    /* look for the next operation start */
+    for (pos = replay_cursor; replay_parse(pos, &rec); pos = rec.next) {
+        if ((rec.flags & LGW_SPI_REC_KIND_MASK) == LGW_SPI_REC_SESSION_BEGIN) {
+            break;
+        }
+    }
+    if (pos >= replay_size) {
+        replay_cursor = replay_size;
+        return LGW_SPI_ERROR;
+    }
+    replay_cursor = rec.next;
+    memset(session, 0, sizeof(struct lgw_replay_session_s));
+    session->op = rec.addr;
+    t0 = rec.t;
+
+    /* figures of the recorded operation */
+    for (pos = replay_cursor; replay_parse(pos, &rec); pos = rec.next) {
+        if ((rec.flags & LGW_SPI_REC_KIND_MASK) >= LGW_SPI_REC_SESSION_BEGIN) {
+            break;
+        }
+        ++session->nb_transaction;
+        session->bytes += rec.size;
+        session->duration = rec.t - t0;
+    }
+    if ((pos < replay_size) && ((rec.flags & LGW_SPI_REC_KIND_MASK) == LGW_SPI_REC_SESSION_END)) {
+        session->duration = rec.t - t0;
+    }
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_replay_suspend(bool suspend) {
+    replay_suspended = suspend;
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_replay_get_stats(struct lgw_replay_stats_s *stats, bool clear) {
+    CHECK_NULL(stats);
+    *stats = replay_stats;
+    if (clear == true) {
+        memset(&replay_stats, 0, sizeof replay_stats);
+    }
+    return LGW_SPI_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,650 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    In-memory SX1301 model used as SPI backend.
+    Register defaults and read-only bits are taken from the register table, so
+    the model stays in line with loragw_reg.
+    The calibration and AGC firmwares are not executed: an AGC MCU boot with
+    a calibration command word in RADIO_SELECT (bit 4, DAC gain, always set)
+    is taken as the calibration firmware, any other as the AGC firmware, and
+    their host handshakes are answered.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>        /* C99 types */
+#include <stdbool.h>       /* bool type */
+#include <stdlib.h>        /* calloc free */
+#include <string.h>        /* memset memcpy */
+
+#include "loragw_spi.h"
+#include "loragw_spi_sim.h"
+#include "loragw_reg.h"
+#include "loragw_hal.h"
+#include "loragw_debug.h"   /* Activar mensajes seriales */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#if DEBUG_SPI == 1
+    #define DEBUG_MSG(str)                Serial.print(str)
+#else
+    #define DEBUG_MSG(str)
+#endif
+#define CHECK_NULL(a)                if(a==NULL){return LGW_SPI_ERROR;}
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define SIM_PAGE_NB         4       /* PAGE_REG is 2 bits wide */
+#define SIM_REG_NB          128     /* 7-bit register address */
+#define SIM_PROM_SIZE       8192
+#define SIM_MCU_RAM_SIZE    256
+
+#define SIM_MCU_ARB         0
+#define SIM_MCU_AGC         1
+
+#define SIM_FW_VERSION_CAL  2
+#define SIM_FW_VERSION_AGC  4
+#define SIM_FW_VERSION_ARB  1
+#define SIM_FW_VERSION_ADDR 0x20
+
+#define SIM_CAL_STATUS_OK   0xFF    /* calibration done, every step successful */
+#define SIM_AGC_CMD_WAIT    16
+#define SIM_AGC_CMD_ABORT   17
+
+#define SIM_SX1257_VERSION  0x21
+
+/* data port registers: a burst access keeps hitting the same address */
+#define IS_DATA_PORT(a)     (((a) == 4) || ((a) == 6) || ((a) == 8) || ((a) == 10))
+
+/* addresses 0-32 and 125-127 are shared by all pages */
+#define IS_COMMON(a)        (((a) <= 32) || ((a) >= 125))
+
+enum sim_agc_prog_e {
+    SIM_AGC_NONE,
+    SIM_AGC_CAL,
+    SIM_AGC_FW
+};
+
+enum sim_agc_phase_e {
+    SIM_AGC_LUT,
+    SIM_AGC_FREQ,
+    SIM_AGC_CHAN,
+    SIM_AGC_SELECT,
+    SIM_AGC_RUNNING
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct sim_fifo_s {
+    uint16_t addr;      /* start of the packet in the RX data buffer */
+    uint8_t  size;      /* payload size */
+    uint8_t  status;    /* CRC status */
+};
+
+struct lgw_sim_s {
+    uint8_t page;
+    uint8_t common[SIM_REG_NB];
+    uint8_t paged[SIM_PAGE_NB][SIM_REG_NB];
+
+    uint8_t rx_buf[LGW_DATABUFF_SIZE];
+    uint16_t rx_wr;
+    uint16_t rx_rd;
+    struct sim_fifo_s fifo[LGW_PKT_FIFO_SIZE];
+    uint8_t fifo_head;
+    uint8_t fifo_cnt;
+
+    uint8_t tx_buf[LGW_SIM_TX_BUF_SIZE];
+    uint8_t tx_last[LGW_SIM_TX_BUF_SIZE];
+
+    uint8_t prom[2][SIM_PROM_SIZE];
+    uint16_t prom_addr;
+    uint8_t mcu_ram[2][SIM_MCU_RAM_SIZE];
+
+    uint8_t agc_boot_cnt;
+    enum sim_agc_prog_e agc_prog;
+    enum sim_agc_phase_e agc_phase;
+    bool agc_waiting;
+    uint8_t agc_lut_idx;
+
+    uint8_t radio[LGW_RF_CHAIN_NB][SIM_REG_NB];
+
+    uint32_t speed;         /* SPI clock set by the host */
+    uint32_t max_speed;     /* above that clock, read data gets corrupted (0: no limit) */
+
+    struct lgw_sim_stats_s stats;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static bool sim_tables_ready = false;
+static uint8_t sim_dflt[SIM_PAGE_NB][SIM_REG_NB];   /* register defaults, per page */
+static uint8_t sim_wmask[SIM_PAGE_NB][SIM_REG_NB];  /* bits writable by the host, per page */
+static uint32_t sim_default_max_speed = 0;          /* link limit of targets opened afterwards */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* build default and writable-bits images from the register table */
+static void sim_build_tables(void) {
+    int i, p, k, size_byte, bits;
+    uint32_t v, mask;
+    struct lgw_reg_s r;
+
+    memset(sim_dflt, 0, sizeof sim_dflt);
+    memset(sim_wmask, 0xFF, sizeof sim_wmask);
+
+    for (i = 0; i < LGW_TOTALREGS; ++i) {
+        r = loregs[i];
+        size_byte = (r.offs + r.leng + 7) / 8;
+        v = (uint32_t)r.dflt;
+        for (k = 0; k < size_byte; ++k) {
+            bits = r.leng - 8 * k;
+            bits = (bits > 8) ? 8 : bits;
+            mask = (uint8_t)(((1 << bits) - 1) << ((k == 0) ? r.offs : 0));
+            for (p = 0; p < SIM_PAGE_NB; ++p) {
+                if ((r.page != -1) && (r.page != p)) {
+                    continue;
+                }
+                sim_dflt[p][r.addr + k] &= ~mask;
+                sim_dflt[p][r.addr + k] |= ((k == 0) ? (uint8_t)(v << r.offs) : (uint8_t)(v >> (8 * k))) & mask;
+                if (r.rdon == true) {
+                    sim_wmask[p][r.addr + k] &= ~mask;
+                }
+            }
+        }
+    }
+    sim_tables_ready = true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint8_t *sim_byte(struct lgw_sim_s *sim, uint8_t page, uint8_t addr) {
+    return IS_COMMON(addr) ? &sim->common[addr] : &sim->paged[page][addr];
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* value of a single-byte register field, ignoring the page currently selected */
+static uint8_t sim_field(struct lgw_sim_s *sim, uint16_t register_id) {
+    struct lgw_reg_s r = loregs[register_id];
+    uint8_t b = *sim_byte(sim, (r.page == -1) ? 0 : r.page, r.addr);
+    return (b >> r.offs) & ((1 << r.leng) - 1);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void sim_set_field(struct lgw_sim_s *sim, uint16_t register_id, uint8_t value) {
+    struct lgw_reg_s r = loregs[register_id];
+    uint8_t *b = sim_byte(sim, (r.page == -1) ? 0 : r.page, r.addr);
+    uint8_t mask = ((1 << r.leng) - 1) << r.offs;
+    *b = (*b & ~mask) | ((value << r.offs) & mask);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void sim_soft_reset(struct lgw_sim_s *sim) {
+    int p;
+
+    for (p = 0; p < SIM_PAGE_NB; ++p) {
+        memcpy(sim->paged[p], sim_dflt[p], SIM_REG_NB);
+    }
+    memcpy(sim->common, sim_dflt[0], SIM_REG_NB);
+    sim->page = 0;
+    sim->rx_wr = 0;
+    sim->rx_rd = 0;
+    sim->fifo_head = 0;
+    sim->fifo_cnt = 0;
+    sim->prom_addr = 0;
+    memset(sim->mcu_ram, 0, sizeof sim->mcu_ram);
+    sim->agc_boot_cnt = 0;
+    sim->agc_prog = SIM_AGC_NONE;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void sim_radio_reset(struct lgw_sim_s *sim) {
+    int i;
+
+    memset(sim->radio, 0, sizeof sim->radio);
+    for (i = 0; i < LGW_RF_CHAIN_NB; ++i) {
+        sim->radio[i][0x07] = SIM_SX1257_VERSION;
+        sim->radio[i][0x11] = 0x02; /* PLL locked */
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint8_t sim_prom_select(struct lgw_sim_s *sim) {
+    if ((sim_field(sim, LGW_MCU_SELECT_MUX_0) == 0) && (sim_field(sim, LGW_MCU_SELECT_MUX_1) == 1)) {
+        return SIM_MCU_ARB;
+    } else {
+        return SIM_MCU_AGC;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void sim_agc_boot(struct lgw_sim_s *sim) {
+    if ((sim_field(sim, LGW_RADIO_SELECT) & 0x10) != 0) {
+        sim->agc_prog = SIM_AGC_CAL;
+        sim->mcu_ram[SIM_MCU_AGC][SIM_FW_VERSION_ADDR] = SIM_FW_VERSION_CAL;
+        sim_set_field(sim, LGW_MCU_AGC_STATUS, 0);
+    } else {
+        sim->agc_prog = SIM_AGC_FW;
+        sim->mcu_ram[SIM_MCU_AGC][SIM_FW_VERSION_ADDR] = SIM_FW_VERSION_AGC;
+        sim_set_field(sim, LGW_MCU_AGC_STATUS, 0x10);
+        sim->agc_phase = SIM_AGC_LUT;
+        sim->agc_waiting = false;
+        sim->agc_lut_idx = 0;
+    }
+    ++sim->agc_boot_cnt;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* host commands sent to the AGC firmware through RADIO_SELECT */
+static void sim_agc_command(struct lgw_sim_s *sim, uint8_t cmd) {
+    uint8_t status;
+
+    if ((sim->agc_prog != SIM_AGC_FW) || (sim->agc_phase == SIM_AGC_RUNNING)) {
+        return;
+    }
+    if (cmd == SIM_AGC_CMD_WAIT) {
+        sim->agc_waiting = true;
+        return;
+    }
+    if (sim->agc_waiting == false) {
+        return;
+    }
+    sim->agc_waiting = false;
+
+    switch (sim->agc_phase) {
+        case SIM_AGC_LUT:
+            if (cmd == SIM_AGC_CMD_ABORT) {
+                status = 0x30;
+                sim->agc_phase = SIM_AGC_FREQ;
+            } else {
+                status = 0x30 + sim->agc_lut_idx;
+                if (++sim->agc_lut_idx >= TX_GAIN_LUT_SIZE_MAX) {
+                    sim->agc_phase = SIM_AGC_FREQ;
+                }
+            }
+            break;
+        case SIM_AGC_FREQ:
+            status = 0x30 + cmd;
+            sim->agc_phase = SIM_AGC_CHAN;
+            break;
+        case SIM_AGC_CHAN:
+            status = 0x30 + cmd;
+            sim->agc_phase = SIM_AGC_SELECT;
+            break;
+        default:
+            status = 0x40;
+            sim->agc_phase = SIM_AGC_RUNNING;
+            break;
+    }
+    sim_set_field(sim, LGW_MCU_AGC_STATUS, status);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* SX1301 SPI master: the radio transaction happens on the CS rising edge */
+static void sim_radio_transfer(struct lgw_sim_s *sim, uint8_t rf_chain) {
+    uint8_t addr, data;
+
+    if (rf_chain == 0) {
+        addr = sim_field(sim, LGW_SPI_RADIO_A__ADDR);
+        data = sim_field(sim, LGW_SPI_RADIO_A__DATA);
+    } else {
+        addr = sim_field(sim, LGW_SPI_RADIO_B__ADDR);
+        data = sim_field(sim, LGW_SPI_RADIO_B__DATA);
+    }
+    if ((addr & 0x80) != 0) {
+        if ((addr & 0x7F) != 0x11) { /* status register is read-only */
+            sim->radio[rf_chain][addr & 0x7F] = data;
+        }
+    } else {
+        sim_set_field(sim, (rf_chain == 0) ? LGW_SPI_RADIO_A__DATA_READBACK : LGW_SPI_RADIO_B__DATA_READBACK, sim->radio[rf_chain][addr & 0x7F]);
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void sim_write(struct lgw_sim_s *sim, uint8_t address, uint8_t data) {
+    uint8_t *b;
+    uint8_t old, wmask;
+    uint8_t page = sim->page;
+
+    address &= 0x7F;
+
+    /* side-effect registers */
+    switch (address) {
+        case 0: /* PAGE_REG & SOFT_RESET */
+            if ((data & 0x80) != 0) {
+                sim_soft_reset(sim);
+            } else {
+                sim->page = data & 0x03;
+                sim->common[0] = sim->page;
+            }
+            return;
+        case 4: /* RX_DATA_BUF_DATA */
+            return;
+        case 6: /* TX_DATA_BUF_DATA */
+            sim->tx_buf[sim->common[5]] = data;
+            ++sim->common[5]; /* TX_DATA_BUF_ADDR auto-increment */
+            return;
+        case 10: /* MCU_PROM_DATA */
+            sim->prom[sim_prom_select(sim)][sim->prom_addr % SIM_PROM_SIZE] = data;
+            ++sim->prom_addr;
+            return;
+        case 11: /* RX_PACKET_DATA_FIFO_NUM_STORED: any write pops the FIFO */
+            if (sim->fifo_cnt > 0) {
+                sim->fifo_head = (sim->fifo_head + 1) % LGW_PKT_FIFO_SIZE;
+                --sim->fifo_cnt;
+            }
+            return;
+        default:
+            break;
+    }
+
+    b = sim_byte(sim, page, address);
+    old = *b;
+    wmask = sim_wmask[page][address];
+    *b = (old & ~wmask) | (data & wmask);
+
+    if (address == 9) { /* MCU_PROM_ADDR */
+        sim->prom_addr = data;
+    } else if ((address == 127) && ((data & 0x01) == 0) && (sim->agc_prog == SIM_AGC_CAL)) {
+        /* EMERGENCY_FORCE_HOST_CTRL released: calibration runs to completion */
+        memset(&sim->mcu_ram[SIM_MCU_AGC][0xA0], 0, 32);
+        sim_set_field(sim, LGW_MCU_AGC_STATUS, SIM_CAL_STATUS_OK);
+    } else if ((page == 0) && (address == loregs[LGW_RADIO_SELECT].addr)) {
+        sim_agc_command(sim, data);
+    } else if ((page == 0) && (address == loregs[LGW_MCU_RST_0].addr)) {
+        if (((old & 0x01) != 0) && ((*b & 0x01) == 0)) {
+            sim->mcu_ram[SIM_MCU_ARB][SIM_FW_VERSION_ADDR] = SIM_FW_VERSION_ARB;
+        }
+        if (((old & 0x02) != 0) && ((*b & 0x02) == 0)) {
+            sim_agc_boot(sim);
+        }
+    } else if ((page == 1) && (address == loregs[LGW_TX_TRIG_ALL].addr) && ((data & 0x07) != 0)) {
+        memcpy(sim->tx_last, sim->tx_buf, sizeof sim->tx_last);
+        ++sim->stats.nb_tx;
+    } else if ((page == 2) && (address == loregs[LGW_SPI_RADIO_A__CS].addr) && ((old & 0x01) == 0) && ((*b & 0x01) != 0)) {
+        sim_radio_transfer(sim, 0);
+    } else if ((page == 2) && (address == loregs[LGW_SPI_RADIO_B__CS].addr) && ((old & 0x01) == 0) && ((*b & 0x01) != 0)) {
+        sim_radio_transfer(sim, 1);
+    } else if ((page == 2) && (address == loregs[LGW_RADIO_RST].addr) && ((old & 0x04) == 0) && ((*b & 0x04) != 0)) {
+        sim_radio_reset(sim);
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint8_t sim_read(struct lgw_sim_s *sim, uint8_t address) {
+    struct sim_fifo_s *f = &sim->fifo[sim->fifo_head];
+    uint8_t page = sim->page;
+    uint8_t data;
+
+    address &= 0x7F;
+
+    switch (address) {
+        case 4: /* RX_DATA_BUF_DATA */
+            data = sim->rx_buf[sim->rx_rd % LGW_DATABUFF_SIZE];
+            sim->rx_rd = (sim->rx_rd + 1) % LGW_DATABUFF_SIZE;
+            return data;
+        case 6: /* TX_DATA_BUF_DATA */
+            data = sim->tx_buf[sim->common[5]];
+            ++sim->common[5];
+            return data;
+        case 10: /* MCU_PROM_DATA, read path lags one byte behind the address (hence the HAL dummy read) */
+            data = sim->prom[sim_prom_select(sim)][(sim->prom_addr + SIM_PROM_SIZE - 1) % SIM_PROM_SIZE];
+            ++sim->prom_addr;
+            return data;
+        case 11: /* RX_PACKET_DATA_FIFO_NUM_STORED, also points the data buffer to the current packet */
+            sim->rx_rd = (sim->fifo_cnt > 0) ? f->addr : sim->rx_rd;
+            return sim->fifo_cnt;
+        case 12:
+            return (sim->fifo_cnt > 0) ? (uint8_t)(f->addr & 0xFF) : 0;
+        case 13:
+            return (sim->fifo_cnt > 0) ? (uint8_t)(f->addr >> 8) : 0;
+        case 14:
+            return (sim->fifo_cnt > 0) ? f->status : 0;
+        case 15:
+            return (sim->fifo_cnt > 0) ? f->size : 0;
+        default:
+            break;
+    }
+
+    if ((page == 2) && (address == loregs[LGW_DBG_AGC_MCU_RAM_DATA].addr)) {
+        return sim->mcu_ram[SIM_MCU_AGC][sim_field(sim, LGW_DBG_AGC_MCU_RAM_ADDR)];
+    } else if ((page == 2) && (address == loregs[LGW_DBG_ARB_MCU_RAM_DATA].addr)) {
+        return sim->mcu_ram[SIM_MCU_ARB][sim_field(sim, LGW_DBG_ARB_MCU_RAM_ADDR)];
+    }
+
+    return *sim_byte(sim, page, address);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* MISO sampled too late when the clock exceeds what the link supports */
+static uint8_t sim_link(struct lgw_sim_s *sim, uint8_t data) {
+    if ((sim->max_speed != 0) && (sim->speed > sim->max_speed)) {
+        return data ^ 0x01;
+    }
+    return data;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* every open creates an independent concentrator, the wiring is ignored */
+static int sim_spi_open(void **spi_target_ptr, const struct lgw_spi_port_s *port) {
+    struct lgw_sim_s *sim;
+
+    if (sim_tables_ready == false) {
+        sim_build_tables();
+    }
+    sim = (struct lgw_sim_s *)calloc(1, sizeof(struct lgw_sim_s));
+    if (sim == NULL) {
+        DEBUG_MSG("ERROR: failed to allocate simulated concentrator\n");
+        return LGW_SPI_ERROR;
+    }
+    sim_soft_reset(sim);
+    sim_radio_reset(sim);
+    sim->max_speed = sim_default_max_speed;
+    *spi_target_ptr = (void *)sim;
+
+    DEBUG_MSG("Note: simulated concentrator opened\n");
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int sim_spi_close(void *spi_target) {
+    CHECK_NULL(spi_target);
+    free(spi_target);
+    DEBUG_MSG("Note: simulated concentrator closed\n");
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int sim_spi_w(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t data) {
+    struct lgw_sim_s *sim = (struct lgw_sim_s *)spi_target;
+
+    CHECK_NULL(sim);
+    sim_write(sim, address, data);
+    ++sim->stats.nb_w;
+    ++sim->stats.bytes_w;
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int sim_spi_r(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data) {
+    struct lgw_sim_s *sim = (struct lgw_sim_s *)spi_target;
+
+    CHECK_NULL(sim);
+    CHECK_NULL(data);
+    *data = sim_link(sim, sim_read(sim, address));
+    ++sim->stats.nb_r;
+    ++sim->stats.bytes_r;
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int sim_spi_wb(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size) {
+    struct lgw_sim_s *sim = (struct lgw_sim_s *)spi_target;
+    int i;
+
+    CHECK_NULL(sim);
+    CHECK_NULL(data);
+    if (size == 0) {
+        return LGW_SPI_ERROR;
+    }
+    for (i = 0; i < size; ++i) {
+        sim_write(sim, address, data[i]);
+        if (!IS_DATA_PORT(address)) {
+            address = (address + 1) & 0x7F;
+        }
+    }
+    ++sim->stats.nb_wb;
+    sim->stats.bytes_w += size;
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int sim_spi_rb(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size) {
+    struct lgw_sim_s *sim = (struct lgw_sim_s *)spi_target;
+    int i;
+
+    CHECK_NULL(sim);
+    CHECK_NULL(data);
+    if (size == 0) {
+        return LGW_SPI_ERROR;
+    }
+    for (i = 0; i < size; ++i) {
+        data[i] = sim_link(sim, sim_read(sim, address));
+        if (!IS_DATA_PORT(address)) {
+            address = (address + 1) & 0x7F;
+        }
+    }
+    ++sim->stats.nb_rb;
+    sim->stats.bytes_r += size;
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int sim_set_speed(void *spi_target, uint32_t speed) {
+    struct lgw_sim_s *sim = (struct lgw_sim_s *)spi_target;
+
+    CHECK_NULL(sim);
+    sim->speed = speed;
+    return LGW_SPI_SUCCESS;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC VARIABLES ----------------------------------------------------- */
+
+const struct lgw_spi_backend_s lgw_spi_backend_sim = {
+    "sim",
+    sim_spi_open,
+    sim_spi_close,
+    NULL,               /* nothing to gain from holding a simulated bus */
+    NULL,
+    sim_spi_w,
+    sim_spi_r,
+    sim_spi_wb,
+    sim_spi_rb,
+    sim_set_speed
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int lgw_sim_rx_push(void *spi_target, const uint8_t *payload, uint8_t size, const uint8_t *metadata, uint8_t status) {
+    struct lgw_sim_s *sim = (struct lgw_sim_s *)spi_target;
+    struct sim_fifo_s *f;
+    int i;
+
+    CHECK_NULL(sim);
+    CHECK_NULL(payload);
+    CHECK_NULL(metadata);
+    if (sim->fifo_cnt >= LGW_PKT_FIFO_SIZE) {
+        DEBUG_MSG("WARNING: simulated RX FIFO full, packet dropped\n");
+        return LGW_SPI_ERROR;
+    }
+
+    f = &sim->fifo[(sim->fifo_head + sim->fifo_cnt) % LGW_PKT_FIFO_SIZE];
+    f->addr = sim->rx_wr;
+    f->size = size;
+    f->status = status;
+    for (i = 0; i < size; ++i) {
+        sim->rx_buf[sim->rx_wr] = payload[i];
+        sim->rx_wr = (sim->rx_wr + 1) % LGW_DATABUFF_SIZE;
+    }
+    for (i = 0; i < LGW_SIM_METADATA_NB; ++i) {
+        sim->rx_buf[sim->rx_wr] = metadata[i];
+        sim->rx_wr = (sim->rx_wr + 1) % LGW_DATABUFF_SIZE;
+    }
+    ++sim->fifo_cnt;
+
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_sim_tx_last(void *spi_target, uint8_t *buf) {
+    struct lgw_sim_s *sim = (struct lgw_sim_s *)spi_target;
+
+    CHECK_NULL(sim);
+    CHECK_NULL(buf);
+    memcpy(buf, sim->tx_last, sizeof sim->tx_last);
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_sim_set_max_speed(void *spi_target, uint32_t max_speed) {
+    struct lgw_sim_s *sim = (struct lgw_sim_s *)spi_target;
+
+    if (sim == NULL) {
+        sim_default_max_speed = max_speed;
+    } else {
+        sim->max_speed = max_speed;
+    }
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_sim_get_stats(void *spi_target, struct lgw_sim_stats_s *stats, bool clear) {
+    struct lgw_sim_s *sim = (struct lgw_sim_s *)spi_target;
+
+    CHECK_NULL(sim);
+    CHECK_NULL(stats);
+    *stats = sim->stats;
+    if (clear == true) {
+        memset(&sim->stats, 0, sizeof sim->stats);
+    }
+    return LGW_SPI_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
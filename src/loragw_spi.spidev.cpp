@@ -0,0 +1,571 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Linux spidev SPI backend, for gateways where the concentrator hangs on a
+    SoC SPI controller (Raspberry Pi and alike).
+    Writes to the page register and to the data port pointers do nothing in
+    the chip until the following access, they are held back and sent in the
+    same SPI_IOC_MESSAGE as that access, each in its own chip select frame.
+    The RX FIFO advance is held back the same way, so lgw_receive pays one
+    ioctl call per packet for the advance and the next FIFO status read.
+    Held back writes are sent at the latest when the bus is released at the
+    end of a HAL operation.
+    The system calls go through a replaceable table, so the backend can run
+    against a fake spidev.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifdef __linux__
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>        /* C99 types */
+#include <stdbool.h>       /* bool type */
+#include <stdio.h>         /* snprintf */
+#include <stdlib.h>        /* malloc free */
+#include <string.h>        /* memset memcpy */
+#include <unistd.h>        /* close */
+#include <fcntl.h>         /* open */
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+
+#include "loragw_spi.h"
+#include "loragw_spi_spidev.h"
+#include "loragw_debug.h"   /* Activar mensajes seriales */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#if DEBUG_SPI == 1
+    #define DEBUG_MSG(str)                Serial.print(str)
+    #define DEBUG_PRINTF(fmt, args...)    {\
+                                            memset(debug_msg, 0, sizeof(debug_msg));\
+                                            snprintf(debug_msg, sizeof(debug_msg),"%s:%d: " fmt, __func__, __LINE__, args);\
+                                            Serial.print(debug_msg);\
+                                            }
+#else
+    #define DEBUG_MSG(str)
+    #define DEBUG_PRINTF(fmt, args...)
+#endif
+#define CHECK_NULL(a)                if(a==NULL){return LGW_SPI_ERROR;}
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define READ_ACCESS     0x00
+#define WRITE_ACCESS    0x80
+
+#define SPIDEV_SPEED        8000000 /* clock until lgw_spi_set_speed, as the native backend */
+#define SPIDEV_BATCH_MAX    8       /* transfers per SPI_IOC_MESSAGE */
+#define SPIDEV_DEFER_MAX    (SPIDEV_BATCH_MAX - 2) /* room is kept for the command and data of the access */
+#define SPIDEV_BURST_CHUNK  1024    /* burst payload per SPI_IOC_MESSAGE, below the spidev buffer size */
+
+/* SX1301 registers whose write only prepares the next access */
+#define SX1301_PAGE_REG         0   /* bit 7 is the soft reset, never held back */
+#define SX1301_RX_DATA_BUF_ADDR 2   /* 16 bits */
+#define SX1301_TX_DATA_BUF_ADDR 5
+#define SX1301_CAPTURE_RAM_ADDR 7
+#define SX1301_MCU_PROM_ADDR    9
+#define SX1301_RX_FIFO_ADVANCE  11  /* RX_PACKET_DATA_FIFO_NUM_STORED, read back by the next status read */
+
+#define SHIM_FD_BASE    1000    /* file descriptors handed out by the fake spidev */
+#define SHIM_TARGET_NB  4       /* simulated concentrators the fake spidev can open */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct spidev_port_s {
+    int                         fd;
+    uint32_t                    speed;
+    int                         nb_deferred;                        /* writes waiting for the next access */
+    uint8_t                     deferred[SPIDEV_DEFER_MAX][3];      /* command and up to 2 data bytes */
+    struct spi_ioc_transfer     k[SPIDEV_BATCH_MAX];
+    uint8_t                     cmd[2];                             /* command and data of a single access */
+    uint8_t                     rsp[2];
+    struct lgw_spidev_stats_s   stats;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+static int libc_open(const char *path, int flags);
+static int libc_close(int fd);
+static int libc_ioctl(int fd, unsigned long request, void *arg);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static const struct lgw_spidev_io_s spidev_io_libc = {
+    libc_open,
+    libc_close,
+    libc_ioctl
+};
+
+static const struct lgw_spidev_io_s *spidev_io = &spidev_io_libc;
+static int spidev_open_cnt = 0;
+
+static void *shim_target[SHIM_TARGET_NB];   /* simulated concentrator behind each fake descriptor */
+static uint8_t shim_tx[1 + SPIDEV_BURST_CHUNK];
+static uint8_t shim_rx[1 + SPIDEV_BURST_CHUNK];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static int libc_open(const char *path, int flags) {
+    return open(path, flags);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int libc_close(int fd) {
+    return close(fd);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int libc_ioctl(int fd, unsigned long request, void *arg) {
+    return ioctl(fd, request, arg);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* true if the write can travel with the following access */
+static bool spidev_deferrable(uint8_t address, const uint8_t *data, uint16_t size) {
+    switch (address) {
+        case SX1301_PAGE_REG:
+            return (size == 1) && ((data[0] & 0x80) == 0);
+        case SX1301_RX_DATA_BUF_ADDR:
+            return (size <= 2);
+        case SX1301_TX_DATA_BUF_ADDR:
+        case SX1301_CAPTURE_RAM_ADDR:
+        case SX1301_MCU_PROM_ADDR:
+        case SX1301_RX_FIFO_ADVANCE:
+            return (size == 1);
+        default:
+            return false;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* send the held back writes followed by nb transfers of the access, already in k[] */
+static int spidev_submit(struct spidev_port_s *port, int nb) {
+    int n = port->nb_deferred + nb;
+    int expected = 0;
+    int i, a;
+
+    if (n == 0) {
+        return LGW_SPI_SUCCESS;
+    }
+    for (i = 0; i < n; ++i) {
+        port->k[i].speed_hz = port->speed;
+        port->k[i].bits_per_word = 8;
+        expected += port->k[i].len;
+    }
+    port->k[n - 1].cs_change = 0; /* CS goes up at the end of the message */
+    a = spidev_io->ioctl(port->fd, SPI_IOC_MESSAGE(n), port->k);
+
+    ++port->stats.nb_ioctl;
+    port->stats.nb_frame += port->nb_deferred + ((nb > 0) ? 1 : 0);
+    port->stats.nb_deferred += port->nb_deferred;
+    port->nb_deferred = 0;
+
+    if (a != expected) {
+        DEBUG_MSG("ERROR: SPI MESSAGE FAILURE\n");
+        return LGW_SPI_ERROR;
+    }
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* hold a write back, sending the pending ones first if there is no room */
+static int spidev_defer(struct spidev_port_s *port, uint8_t address, const uint8_t *data, uint16_t size) {
+    struct spi_ioc_transfer *k;
+    int spi_stat = LGW_SPI_SUCCESS;
+
+    if (port->nb_deferred == SPIDEV_DEFER_MAX) {
+        spi_stat = spidev_submit(port, 0);
+    }
+    port->deferred[port->nb_deferred][0] = WRITE_ACCESS | (address & 0x7F);
+    memcpy(&port->deferred[port->nb_deferred][1], data, size);
+    k = &port->k[port->nb_deferred];
+    memset(k, 0, sizeof(struct spi_ioc_transfer));
+    k->tx_buf = (unsigned long)port->deferred[port->nb_deferred];
+    k->len = 1 + size;
+    k->cs_change = 1; /* own chip select frame */
+    ++port->nb_deferred;
+    return spi_stat;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* access of one byte, after the held back writes */
+static int spidev_single(struct spidev_port_s *port, uint8_t command, uint8_t data, uint8_t *rsp) {
+    struct spi_ioc_transfer *k = &port->k[port->nb_deferred];
+    int spi_stat;
+
+    port->cmd[0] = command;
+    port->cmd[1] = data;
+    memset(k, 0, sizeof(struct spi_ioc_transfer));
+    k->tx_buf = (unsigned long)port->cmd;
+    k->rx_buf = (unsigned long)port->rsp;
+    k->len = 2;
+    spi_stat = spidev_submit(port, 1);
+    if (rsp != NULL) {
+        *rsp = port->rsp[1];
+    }
+    return spi_stat;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* burst access, one message per chunk, the held back writes go with the first */
+static int spidev_burst(struct spidev_port_s *port, uint8_t command, uint8_t *data, uint16_t size, bool read) {
+    struct spi_ioc_transfer *k;
+    uint16_t offset = 0;
+    uint16_t chunk;
+    int spi_stat = LGW_SPI_SUCCESS;
+
+    port->cmd[0] = command;
+    while (offset < size) {
+        chunk = ((size - offset) < SPIDEV_BURST_CHUNK) ? (size - offset) : SPIDEV_BURST_CHUNK;
+        k = &port->k[port->nb_deferred];
+        memset(k, 0, 2 * sizeof(struct spi_ioc_transfer));
+        k[0].tx_buf = (unsigned long)port->cmd;
+        k[0].len = 1;
+        if (read == true) {
+            k[1].rx_buf = (unsigned long)(data + offset);
+        } else {
+            k[1].tx_buf = (unsigned long)(data + offset);
+        }
+        k[1].len = chunk;
+        spi_stat |= spidev_submit(port, 2);
+        offset += chunk;
+    }
+    return spi_stat;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int spidev_spi_open(void **spi_target_ptr, const struct lgw_spi_port_s *port_conf) {
+    struct spidev_port_s *port;
+    char path[32];
+    uint8_t mode = SPI_MODE_0;
+    uint8_t bits = 8;
+    uint32_t speed = SPIDEV_SPEED;
+    int fd;
+    int a = 0;
+
+    if (port_conf == NULL) {
+        snprintf(path, sizeof(path), "%s", LGW_SPIDEV_PATH_DEFAULT);
+    } else {
+        snprintf(path, sizeof(path), "/dev/spidev%u.%d", port_conf->host, port_conf->ss);
+    }
+    fd = spidev_io->open(path, O_RDWR);
+    if (fd < 0) {
+        DEBUG_PRINTF("ERROR: failed to open SPI device %s\n", path);
+        return LGW_SPI_ERROR;
+    }
+    a |= spidev_io->ioctl(fd, SPI_IOC_WR_MODE, &mode);
+    a |= spidev_io->ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits);
+    a |= spidev_io->ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed);
+    if (a < 0) {
+        DEBUG_MSG("ERROR: failed to configure SPI device\n");
+        spidev_io->close(fd);
+        return LGW_SPI_ERROR;
+    }
+    port = (struct spidev_port_s *)calloc(1, sizeof(struct spidev_port_s));
+    if (port == NULL) {
+        spidev_io->close(fd);
+        return LGW_SPI_ERROR;
+    }
+    port->fd = fd;
+    port->speed = speed;
+    ++spidev_open_cnt;
+    *spi_target_ptr = (void *)port;
+
+    DEBUG_PRINTF("Note: SPI port %s opened and configured ok\n", path);
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int spidev_spi_close(void *spi_target) {
+    struct spidev_port_s *port = (struct spidev_port_s *)spi_target;
+    int a;
+
+    CHECK_NULL(port);
+    spidev_submit(port, 0);
+    a = spidev_io->close(port->fd);
+    free(port);
+    --spidev_open_cnt;
+    return (a < 0) ? LGW_SPI_ERROR : LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* nothing to hold, the spidev driver keeps no bus state between messages */
+static int spidev_bus_acquire(void *spi_target) {
+    CHECK_NULL(spi_target);
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* end of a HAL operation, held back writes can not wait for another access */
+static int spidev_bus_release(void *spi_target) {
+    struct spidev_port_s *port = (struct spidev_port_s *)spi_target;
+
+    CHECK_NULL(port);
+    return spidev_submit(port, 0);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int spidev_spi_w(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t data) {
+    struct spidev_port_s *port = (struct spidev_port_s *)spi_target;
+
+    CHECK_NULL(port);
+    if (spidev_deferrable(address, &data, 1) == true) {
+        return spidev_defer(port, address, &data, 1);
+    }
+    return spidev_single(port, WRITE_ACCESS | (address & 0x7F), data, NULL);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int spidev_spi_r(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data) {
+    struct spidev_port_s *port = (struct spidev_port_s *)spi_target;
+
+    CHECK_NULL(port);
+    CHECK_NULL(data);
+    return spidev_single(port, READ_ACCESS | (address & 0x7F), 0x00, data);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int spidev_spi_wb(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size) {
+    struct spidev_port_s *port = (struct spidev_port_s *)spi_target;
+
+    CHECK_NULL(port);
+    CHECK_NULL(data);
+    if (size == 0) {
+        DEBUG_MSG("ERROR: BURST OF NULL LENGTH\n");
+        return LGW_SPI_ERROR;
+    }
+    if (spidev_deferrable(address, data, size) == true) {
+        return spidev_defer(port, address, data, size);
+    }
+    return spidev_burst(port, WRITE_ACCESS | (address & 0x7F), data, size, false);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int spidev_spi_rb(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size) {
+    struct spidev_port_s *port = (struct spidev_port_s *)spi_target;
+
+    CHECK_NULL(port);
+    CHECK_NULL(data);
+    if (size == 0) {
+        DEBUG_MSG("ERROR: BURST OF NULL LENGTH\n");
+        return LGW_SPI_ERROR;
+    }
+    return spidev_burst(port, READ_ACCESS | (address & 0x7F), data, size, true);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int spidev_set_speed(void *spi_target, uint32_t speed) {
+    struct spidev_port_s *port = (struct spidev_port_s *)spi_target;
+
+    CHECK_NULL(port);
+    if (speed == 0) {
+        return LGW_SPI_ERROR;
+    }
+    spidev_submit(port, 0); /* held back writes go at the clock they were issued at */
+    if (spidev_io->ioctl(port->fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0) {
+        return LGW_SPI_ERROR;
+    }
+    port->speed = speed;
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int shim_open(const char *path, int flags) {
+    int i;
+
+    for (i = 0; i < SHIM_TARGET_NB; ++i) {
+        if (shim_target[i] == NULL) {
+            if (lgw_spi_backend_sim.open(&shim_target[i], NULL) != LGW_SPI_SUCCESS) {
+                return -1;
+            }
+            return SHIM_FD_BASE + i;
+        }
+    }
+    return -1;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int shim_close(int fd) {
+    int i = fd - SHIM_FD_BASE;
+
+    if ((i < 0) || (i >= SHIM_TARGET_NB) || (shim_target[i] == NULL)) {
+        return -1;
+    }
+    lgw_spi_backend_sim.close(shim_target[i]);
+    shim_target[i] = NULL;
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* run the chip select frame gathered in shim_tx on the simulated concentrator */
+static int shim_frame(void *sim, uint32_t len) {
+    uint8_t address = shim_tx[0] & 0x7F;
+    uint16_t size = len - 1;
+
+    shim_rx[0] = 0;
+    if (size == 0) {
+        return 0;
+    }
+    if ((shim_tx[0] & WRITE_ACCESS) != 0) {
+        if (size == 1) {
+            return lgw_spi_backend_sim.w(sim, 0, 0, address, shim_tx[1]);
+        }
+        return lgw_spi_backend_sim.wb(sim, 0, 0, address, &shim_tx[1], size);
+    }
+    if (size == 1) {
+        return lgw_spi_backend_sim.r(sim, 0, 0, address, &shim_rx[1]);
+    }
+    return lgw_spi_backend_sim.rb(sim, 0, 0, address, &shim_rx[1], size);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int shim_ioctl(int fd, unsigned long request, void *arg) {
+    struct spi_ioc_transfer *k = (struct spi_ioc_transfer *)arg;
+    int i = fd - SHIM_FD_BASE;
+    uint32_t first = 0; /* first transfer of the current frame */
+    uint32_t len = 0;
+    uint32_t total = 0;
+    uint32_t n, j, f, pos;
+
+    if ((i < 0) || (i >= SHIM_TARGET_NB) || (shim_target[i] == NULL)) {
+        return -1;
+    }
+    if (request == SPI_IOC_WR_MAX_SPEED_HZ) {
+        return lgw_spi_backend_sim.set_speed(shim_target[i], *(uint32_t *)arg);
+    }
+    if ((_IOC_TYPE(request) != SPI_IOC_MAGIC) || (_IOC_NR(request) != 0)) {
+        return 0; /* mode, word size */
+    }
+
+    /* SPI_IOC_MESSAGE(n): gather each chip select frame, run it, scatter the read data */
+    n = _IOC_SIZE(request) / sizeof(struct spi_ioc_transfer);
+    for (j = 0; j < n; ++j) {
+        if ((len + k[j].len) > sizeof(shim_tx)) {
+            return -1;
+        }
+        if (k[j].tx_buf != 0) {
+            memcpy(&shim_tx[len], (const void *)(uintptr_t)k[j].tx_buf, k[j].len);
+        } else {
+            memset(&shim_tx[len], 0, k[j].len);
+        }
+        len += k[j].len;
+        if ((k[j].cs_change == 0) && (j < (n - 1))) {
+            continue;
+        }
+        if (shim_frame(shim_target[i], len) != LGW_SPI_SUCCESS) {
+            return -1;
+        }
+        for (f = first, pos = 0; f <= j; pos += k[f].len, ++f) {
+            if (k[f].rx_buf != 0) {
+                memcpy((void *)(uintptr_t)k[f].rx_buf, &shim_rx[pos], k[f].len);
+            }
+        }
+        total += len;
+        first = j + 1;
+        len = 0;
+    }
+    return (int)total;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC VARIABLES ----------------------------------------------------- */
+
+const struct lgw_spi_backend_s lgw_spi_backend_spidev = {
+    "spidev",
+    spidev_spi_open,
+    spidev_spi_close,
+    spidev_bus_acquire,
+    spidev_bus_release,
+    spidev_spi_w,
+    spidev_spi_r,
+    spidev_spi_wb,
+    spidev_spi_rb,
+    spidev_set_speed
+};
+
+const struct lgw_spidev_io_s lgw_spidev_io_sim = {
+    shim_open,
+    shim_close,
+    shim_ioctl
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int lgw_spidev_set_io(const struct lgw_spidev_io_s *io) {
+    if (spidev_open_cnt > 0) {
+        DEBUG_MSG("ERROR: CANNOT CHANGE SPIDEV CALLS WHILE A TARGET IS OPENED\n");
+        return LGW_SPI_ERROR;
+    }
+    spidev_io = (io != NULL) ? io : &spidev_io_libc;
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_spidev_get_stats(void *spi_target, struct lgw_spidev_stats_s *stats, bool clear) {
+    struct spidev_port_s *port = (struct spidev_port_s *)spi_target;
+
+    CHECK_NULL(port);
+    CHECK_NULL(stats);
+    *stats = port->stats;
+    if (clear == true) {
+        memset(&port->stats, 0, sizeof(struct lgw_spidev_stats_s));
+    }
+    return LGW_SPI_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void *lgw_spidev_sim_target(void *spi_target) {
+    struct spidev_port_s *port = (struct spidev_port_s *)spi_target;
+    int i;
+
+    if ((port == NULL) || (spidev_io != &lgw_spidev_io_sim)) {
+        return NULL;
+    }
+    i = port->fd - SHIM_FD_BASE;
+    if ((i < 0) || (i >= SHIM_TARGET_NB)) {
+        return NULL;
+    }
+    return shim_target[i];
+}
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
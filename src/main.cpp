@@ -42,6 +42,7 @@
 #include "loragw_hal.h"
 #include "loragw_reg.h"
 #include "loragw_aux.h"
+#include "loragw_spi.h"
 #include "loragw_debug.h"
 
 
@@ -55,7 +56,7 @@ char dbug_msg[100];
 #define MSG(args...)                                   \
     {                                                  \
         memset(dbug_msg, 0, sizeof(dbug_msg));         \
-        sprintf(dbug_msg, "loragw_pkt_main: " args); \
+        snprintf(dbug_msg, sizeof(dbug_msg), "loragw_pkt_main: " args); \
         Serial.print(dbug_msg);                        \
     }
 #define STOP_EXECUTION \
@@ -112,7 +113,11 @@ TaskHandle_t Task1;
 /* -------------------------------------------------------------------------- */
 /* --- DECLARACIÓN DE TAREAS ------------------------------------------------ */
 void Configure_gateway(void *parameter);
-SemaphoreHandle_t batton;
+void Scrub_registers(void *parameter);
+
+/* La HAL protege sus propios accesos a registros, solo esperamos que el gateway arranque */
+EventGroupHandle_t gw_events;
+#define GW_STARTED_BIT (1 << 0)
 
 
 void setup()
@@ -121,17 +126,26 @@ void setup()
     Serial.begin(115200); //Iniciamos la comunicación serial para debugeo
     delay(1000);
 
-    batton = xSemaphoreCreateMutex();    //Creamos el semáforo
+    gw_events = xEventGroupCreate();    //Creamos el grupo de eventos
 
     xTaskCreate(
         Configure_gateway,   // Function that should be called
         "Configure Gateway", // Name of the task (for debugging)
-        16000,               // Stack size (bytes)
+        8192,                // Stack size (bytes), la verificación del firmware ya no usa un buffer de 8 KB
         NULL,                // Parameter to pass
         1,                   // Task priority
         &Task1                 // Task handle
     );
 
+    xTaskCreate(
+        Scrub_registers,     // Revision de registros en segundo plano
+        "Scrub Registers",   // Name of the task (for debugging)
+        4096,                // Stack size (bytes)
+        NULL,                // Parameter to pass
+        tskIDLE_PRIORITY,    // Prioridad minima, no compite con RX/TX
+        NULL                 // Task handle
+    );
+
     delay(500);                 // Tiempo para empezar la tarea
 
     //Serial.println("esto aqui");
@@ -139,7 +153,7 @@ void setup()
 
 void loop()
 {
-    xSemaphoreTake(batton, portMAX_DELAY);
+    xEventGroupWaitBits(gw_events, GW_STARTED_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
     int i,j; //Variables para loops y temporales
     uint32_t time; 
     //Serial.println("A");
@@ -245,18 +259,23 @@ void loop()
             } else {
                 /* wait for packet to finish sending */
                 MSG("Se envió mensaje de confirmación\n");
+                /* uso del bus SPI por la consulta de estado frente al envio */
+                struct lgw_spi_bus_stats_s bs[LGW_SPI_OP_NB];
+                lgw_get_bus_stats(bs, true);
+                MSG("INFO: bus status %u xfers %u us, send %u us %u page switches\n", bs[LGW_SPI_OP_STATUS].nb_transaction, bs[LGW_SPI_OP_STATUS].cs_low_time, bs[LGW_SPI_OP_SEND].cs_low_time, bs[LGW_SPI_OP_SEND].nb_page_switch);
+                /* latencia de carga TX frente a la lectura de paquetes */
+                struct lgw_reg_arbiter_stats_s as;
+                lgw_reg_get_arbiter_stats(&as, false);
+                MSG("INFO: TX load %u us (worst %u us), %u RX drain yields\n", as.latency_last, as.latency_max, as.nb_yield);
             }
              
             Serial.println("");
         }
     }
-    xSemaphoreGive(batton);
 }
 
 void Configure_gateway(void *parameter)
 {
-    xSemaphoreTake(batton, portMAX_DELAY);
-
     int i;                        //Variables para loops y temporales
     parse_SX1301_configuration(); //Subimos las configuraciones de canal
 
@@ -264,15 +283,60 @@ void Configure_gateway(void *parameter)
 
     configure_TxGainLUT(); //Configuramos las ganancias de transmisión
 
-    i = lgw_start();
+    /* Guardamos la calibración en NVS para no repetirla en cada reinicio, se rehace cada semana o cada 50 arranques */
+    struct lgw_conf_cal_s calconf;
+    memset(&calconf, 0, sizeof calconf);
+    calconf.store = &lgw_cal_store_nvs;
+    calconf.board_id = lgwm;
+    calconf.max_age = 7 * 24 * 3600;
+    calconf.max_restore = 50;
+    lgw_cal_setconf(calconf);
+
+    /* Releemos el firmware cargado: la versión no detecta un byte corrompido en el bus
+       al reloj SPI ajustado */
+    lgw_fw_setconf(false);
+
+    /* Arrancamos por fases, entre cada una las demás tareas (WiFi, watchdog) pueden correr */
+    uint32_t espera;
+    do
+    {
+        i = lgw_start_step(&espera);
+        vTaskDelay(espera / portTICK_PERIOD_MS + 1);
+    } while (i == LGW_START_IN_PROGRESS);
 
-    if (i == LGW_HAL_SUCCESS)
+    if (i == LGW_START_DONE)
     {
+        struct lgw_spi_session_stats_s ss;
+        lgw_spi_get_session_stats(LGW_SPI_OP_START, &ss);
         MSG("INFO: concentrator started, packet can now be received\n");
+        MSG("INFO: start %u SPI xfers in %u steps, %u us saved\n", ss.nb_transaction, ss.nb_session, ss.total_saved);
+        struct lgw_spi_bus_stats_s sb[LGW_SPI_OP_NB];
+        lgw_get_bus_stats(sb, false);
+        MSG("INFO: start %u page switches\n", sb[LGW_SPI_OP_START].nb_page_switch);
+        struct lgw_spi_tune_s st;
+        if (lgw_get_spi_tune(&st) == LGW_HAL_SUCCESS) {
+            MSG("INFO: SPI clock %u Hz\n", st.selected);
+        }
+        struct lgw_reg_shadow_stats_s rs;
+        lgw_reg_get_shadow_stats(&rs, false);
+        MSG("INFO: %u register reads avoided, %u done\n", rs.nb_avoided, rs.nb_read);
+        MSG("INFO: configure task, %u stack bytes never used\n", (unsigned)uxTaskGetStackHighWaterMark(NULL));
+        /* tiempo de cada fase del arranque, en ms */
+        struct lgw_boot_timing_s bt;
+        lgw_get_boot_timing(&bt);
+        MSG("INFO: calibration %s\n", bt.cal_cached ? "restored from NVS" : "done by the firmware");
+        /* en dos lineas, una sola no cabe en dbug_msg */
+        MSG("INFO: boot %u ms: connect %u, xtal %u, radio %u, calib %u\n", bt.total / 1000, bt.phase[LGW_BOOT_CONNECT] / 1000, bt.phase[LGW_BOOT_XTAL] / 1000, bt.phase[LGW_BOOT_RADIO] / 1000, bt.phase[LGW_BOOT_CALIB] / 1000);
+        MSG("INFO: boot modem %u, fw %u, agc %u\n", bt.phase[LGW_BOOT_MODEM] / 1000, bt.phase[LGW_BOOT_FIRMWARE] / 1000, bt.phase[LGW_BOOT_AGC] / 1000);
+        /* latencia del protocolo con el firmware AGC */
+        struct lgw_agc_timing_s at;
+        lgw_get_agc_timing(&at);
+        MSG("INFO: AGC handshake %u us, %u commands, slowest ack %u us\n", at.total, at.nb_cmd, at.max);
     }
     else
     {
         MSG("ERROR: failed to start the concentrator\n");
+        lgw_cal_invalidate(); /* el siguiente arranque vuelve a calibrar */
         Reseteo();
     }
 
@@ -281,7 +345,33 @@ void Configure_gateway(void *parameter)
 
     /* opening log file*/
     time(&now_time);
-    xSemaphoreGive (batton);
+    xEventGroupSetBits(gw_events, GW_STARTED_BIT);
 
     vTaskDelete(NULL);
-}
\ No newline at end of file
+}
+
+/* Revisa los registros del concentrador por partes y corrige los bytes alterados,
+   en lugar de reiniciar todo el gateway */
+void Scrub_registers(void *parameter)
+{
+    uint32_t espera;
+    struct lgw_reg_scrub_stats_s ss;
+    char scrub_msg[100]; /* buffer propio: MSG usa dbug_msg, compartido con las otras tareas */
+
+    xEventGroupWaitBits(gw_events, GW_STARTED_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+    for (;;)
+    {
+        if (lgw_scrub(&espera) != LGW_HAL_SUCCESS)
+        {
+            espera = 1000;
+        }
+        lgw_reg_get_scrub_stats(&ss, false);
+        if (ss.nb_repaired != 0)
+        {
+            lgw_reg_get_scrub_stats(&ss, true);
+            snprintf(scrub_msg, sizeof(scrub_msg), "loragw_pkt_main: WARNING: %u register bytes repaired, last page %u address %u\n", ss.nb_repaired, ss.last_page, ss.last_addr);
+            Serial.print(scrub_msg);
+        }
+        vTaskDelay(espera / portTICK_PERIOD_MS + 1);
+    }
+}
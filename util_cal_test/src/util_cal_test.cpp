@@ -0,0 +1,198 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Check of the calibration cache on the file store, on a Linux host.
+    The simulated SX1301 is started again and again with lgw_cal_store_file.
+    Each start must run the calibration firmware or restore the stored
+    record as the staleness limits say, and the record left in the file must
+    follow. Exits with EXIT_FAILURE on the first mismatch.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf fopen */
+#include <stdlib.h>     /* EXIT_* */
+#include <string.h>     /* memset */
+#include <stddef.h>     /* offsetof */
+#include <time.h>       /* time */
+
+#include "loragw_hal.h"
+#include "loragw_cal.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define MSG(args...)    fprintf(stderr, args) /* message that is destined to the user */
+
+#define CHECK(cond)     if (!(cond)) { MSG("ERROR: %s:%d: %s\n", __FILE__, __LINE__, #cond); return -1; }
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define CAL_FILE        "util_cal_test.bin"     /* record file, in the working directory */
+#define BOARD_ID        0x0123456789ABCDEFULL
+#define RF0_FREQ        915000000
+#define MAX_RESTORE     2                       /* warm starts served by one calibration */
+#define MAX_AGE         3600                    /* seconds a calibration stays valid */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void usage(void) {
+    printf("Usage: util_cal_test\n");
+    printf(" starts the simulated SX1301 with the calibration cache in %s\n", CAL_FILE);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* both radios enabled, radio A with TX */
+static int configure(void) {
+    struct lgw_conf_board_s boardconf;
+    struct lgw_conf_rxrf_s rfconf;
+    struct lgw_conf_cal_s calconf;
+    int i;
+
+    memset(&boardconf, 0, sizeof boardconf);
+    boardconf.lorawan_public = true;
+    boardconf.clksrc = 1;
+    CHECK(lgw_board_setconf(boardconf) == LGW_HAL_SUCCESS);
+    memset(&rfconf, 0, sizeof rfconf);
+    rfconf.enable = true;
+    rfconf.type = LGW_RADIO_TYPE_SX1257;
+    for (i = 0; i < LGW_RF_CHAIN_NB; ++i) {
+        rfconf.freq_hz = RF0_FREQ + i * 1000000;
+        rfconf.tx_enable = (i == 0);
+        CHECK(lgw_rxrf_setconf(i, rfconf) == LGW_HAL_SUCCESS);
+    }
+    memset(&calconf, 0, sizeof calconf);
+    calconf.store = &lgw_cal_store_file;
+    calconf.key = CAL_FILE;
+    calconf.board_id = BOARD_ID;
+    calconf.max_age = MAX_AGE;
+    calconf.max_restore = MAX_RESTORE;
+    CHECK(lgw_cal_setconf(calconf) == LGW_HAL_SUCCESS);
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* one start and stop, the stored record must be used or not as expected */
+static int start(const char *name, bool cached, uint16_t nb_restore) {
+    struct lgw_boot_timing_s bt;
+    struct lgw_cal_rec_s rec;
+
+    CHECK(lgw_start() == LGW_HAL_SUCCESS);
+    CHECK(lgw_get_boot_timing(&bt) == LGW_HAL_SUCCESS);
+    CHECK(lgw_stop() == LGW_HAL_SUCCESS);
+    printf("%-10s  %s, calibration phase %6u us\n", name, bt.cal_cached ? "restored" : "calibrated", bt.phase[LGW_BOOT_CALIB]);
+    CHECK(bt.cal_cached == cached);
+
+    /* the record in the file is intact and counts the warm starts it served */
+    CHECK(lgw_cal_store_file.load(CAL_FILE, &rec) == LGW_CAL_SUCCESS);
+    CHECK(lgw_cal_check(&rec) == LGW_CAL_SUCCESS);
+    CHECK(rec.board_id == BOARD_ID);
+    CHECK((rec.freq_hz[0] == RF0_FREQ) && (rec.freq_hz[1] == RF0_FREQ + 1000000));
+    CHECK(rec.nb_restore == nb_restore);
+    CHECK(rec.saved_at != 0);
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* a matching record serves the next starts, and counts them */
+static int test_restore(void) {
+    CHECK(start("cold", false, 0) == 0);
+    CHECK(start("warm 1", true, 1) == 0);
+    CHECK(start("warm 2", true, 2) == 0);
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* max_restore warm starts used the record up, the next start calibrates and saves again */
+static int test_max_restore(void) {
+    CHECK(start("used up", false, 0) == 0);
+    CHECK(start("warm", true, 1) == 0);
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* a record older than max_age is not used */
+static int test_max_age(void) {
+    struct lgw_cal_rec_s rec;
+
+    CHECK(lgw_cal_store_file.load(CAL_FILE, &rec) == LGW_CAL_SUCCESS);
+    rec.saved_at = (uint32_t)time(NULL) - MAX_AGE - 60;
+    CHECK(lgw_cal_seal(&rec) == LGW_CAL_SUCCESS);
+    CHECK(lgw_cal_store_file.save(CAL_FILE, &rec) == LGW_CAL_SUCCESS);
+    CHECK(start("too old", false, 0) == 0);
+    CHECK(start("warm", true, 1) == 0);
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* a record damaged in the file fails its CRC, the start calibrates and replaces it */
+static int test_corrupted(void) {
+    struct lgw_cal_rec_s rec;
+    FILE *f;
+    int c;
+
+    f = fopen(CAL_FILE, "r+b");
+    CHECK(f != NULL);
+    fseek(f, offsetof(struct lgw_cal_rec_s, offset_a_i), SEEK_SET);
+    c = fgetc(f);
+    fseek(f, offsetof(struct lgw_cal_rec_s, offset_a_i), SEEK_SET);
+    fputc(c ^ 0x01, f);
+    fclose(f);
+    CHECK(lgw_cal_store_file.load(CAL_FILE, &rec) == LGW_CAL_SUCCESS);
+    CHECK(lgw_cal_check(&rec) == LGW_CAL_ERROR);
+
+    CHECK(start("corrupted", false, 0) == 0);
+    CHECK(start("warm", true, 1) == 0);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    int x;
+
+    (void)argv;
+    if (argc != 1) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    remove(CAL_FILE);
+    if (configure() != 0) {
+        MSG("ERROR: failed to configure the HAL\n");
+        return EXIT_FAILURE;
+    }
+    x = 0;
+    if ((test_restore() != 0) || (test_max_restore() != 0) || (test_max_age() != 0) || (test_corrupted() != 0)) {
+        x = -1;
+    }
+    remove(CAL_FILE);
+    if (x != 0) {
+        return EXIT_FAILURE;
+    }
+    printf("PASS\n");
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,275 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Pack a MCU firmware (.var file) for the HAL, on a Linux host.
+    The packed image is an LZ stream with a 256 bytes history, unpacked by
+    lgw_lz_unpack while it is written to the MCU program memory; the output
+    is a .var file with the packed array, its size and the CRC-32 of the
+    unpacked firmware.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf fopen */
+#include <stdlib.h>     /* malloc free strtoul */
+#include <string.h>     /* memcmp strstr strrchr */
+#include <ctype.h>      /* toupper isxdigit */
+
+#include "loragw_aux.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define MSG(args...)    fprintf(stderr, args) /* message that is destined to the user */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define LZ_LITERAL_MAX  128     /* longest literal run of a token */
+#define LZ_MATCH_MIN    3       /* shorter matches cost more than literals */
+#define LZ_MATCH_MAX    130     /* longest match of a token */
+#define FW_MAX_BYTE     65535   /* load_firmware takes 16 bits sizes */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct check_s {
+    const uint8_t *ref;     /* original firmware */
+    uint32_t size;
+    uint32_t done;          /* bytes unpacked so far */
+    bool match;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void usage(void) {
+    printf("Usage: util_fw_pack <name> <firmware .var> <packed .var>\n");
+    printf(" name: firmware name, as in <name>_firmware (arb, agc, cal)\n");
+    printf(" firmware .var: original firmware array, as shipped by Semtech\n");
+    printf(" packed .var: generated file, included by loragw_hal.cpp\n");
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static char *load_text(const char *path) {
+    FILE *f;
+    long len;
+    char *buf;
+
+    f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = (char *)malloc((len > 0) ? len + 1 : 1);
+    if ((buf != NULL) && (fread(buf, 1, len, f) != (size_t)len)) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    if (buf != NULL) {
+        buf[(len > 0) ? len : 0] = '\0';
+    }
+    return buf;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* bytes of the array initializer, the header comment is skipped */
+static uint32_t parse_array(const char *text, uint8_t *data, uint32_t max) {
+    const char *p;
+    uint32_t n = 0;
+
+    p = strchr(text, '{');
+    if (p == NULL) {
+        return 0;
+    }
+    while (((p = strstr(p, "0x")) != NULL) && (n < max)) {
+        if ((isxdigit(p[2]) == 0) || (isxdigit(p[3]) == 0)) {
+            return 0;
+        }
+        data[n++] = (uint8_t)strtoul(p, NULL, 16);
+        p += 4;
+    }
+    return n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void put_literals(const uint8_t *lit, uint32_t nb_lit, uint8_t *out, uint32_t *nb_out) {
+    uint32_t n;
+
+    while (nb_lit > 0) {
+        n = (nb_lit > LZ_LITERAL_MAX) ? LZ_LITERAL_MAX : nb_lit;
+        out[(*nb_out)++] = (uint8_t)(n - 1);
+        memcpy(&out[*nb_out], lit, n);
+        *nb_out += n;
+        lit += n;
+        nb_lit -= n;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* greedy longest match over the whole window, firmwares are small enough */
+static uint32_t pack(const uint8_t *data, uint32_t size, uint8_t *out) {
+    uint32_t i = 0;
+    uint32_t lit = 0;   /* start of the pending literal run */
+    uint32_t nb_out = 0;
+    uint32_t dist, len, best_len, best_dist;
+
+    while (i < size) {
+        best_len = 0;
+        best_dist = 0;
+        for (dist = 1; (dist <= LGW_LZ_WINDOW) && (dist <= i); ++dist) {
+            for (len = 0; (len < LZ_MATCH_MAX) && ((i + len) < size) && (data[i + len - dist] == data[i + len]); ++len);
+            if (len > best_len) {
+                best_len = len;
+                best_dist = dist;
+            }
+        }
+        if (best_len >= LZ_MATCH_MIN) {
+            put_literals(&data[lit], i - lit, out, &nb_out);
+            out[nb_out++] = (uint8_t)(0x80 | (best_len - LZ_MATCH_MIN));
+            out[nb_out++] = (uint8_t)(best_dist - 1);
+            i += best_len;
+            lit = i;
+        } else {
+            ++i;
+        }
+    }
+    put_literals(&data[lit], i - lit, out, &nb_out);
+    return nb_out;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int check_sink(void *arg, const uint8_t *data, uint16_t size) {
+    struct check_s *chk = (struct check_s *)arg;
+
+    if (((chk->done + size) > chk->size) || (memcmp(&chk->ref[chk->done], data, size) != 0)) {
+        chk->match = false;
+        return -1;
+    }
+    chk->done += size;
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int write_var(const char *path, const char *name, const char *src_path, const char *src_text, const uint8_t *packed, uint32_t size, uint32_t crc) {
+    FILE *f;
+    const char *header_end;
+    const char *license;
+    const char *base;
+    char upper[32];
+    uint32_t i;
+
+    for (i = 0; (name[i] != '\0') && (i < (sizeof upper - 1)); ++i) {
+        upper[i] = (char)toupper((unsigned char)name[i]);
+    }
+    upper[i] = '\0';
+
+    f = fopen(path, "w");
+    if (f == NULL) {
+        return -1;
+    }
+    /* keep the header of the original firmware, with a note before its license */
+    header_end = strstr(src_text, "*/");
+    license = strstr(src_text, "License:");
+    if ((header_end != NULL) && (license != NULL) && (license < header_end)) {
+        fwrite(src_text, 1, license - src_text, f);
+        base = strrchr(src_path, '/');
+        fprintf(f, "\tPacked by util_fw_pack from %s, do not edit.\n\n", (base != NULL) ? base + 1 : src_path);
+        fwrite(license, 1, header_end + 2 - license, f);
+        fprintf(f, "\n\n");
+    }
+    fprintf(f, "#define %s_FW_LZ_BYTE %u /* size of the packed image */\n", upper, size);
+    fprintf(f, "#define %s_FW_CRC 0x%08X /* CRC-32 of the unpacked firmware */\n\n", upper, crc);
+    fprintf(f, "static const uint8_t %s_firmware_lz[%s_FW_LZ_BYTE] = {\n", name, upper);
+    for (i = 0; i < size; ++i) {
+        fprintf(f, "0x%02X, ", packed[i]);
+        if ((i % 16) == 15) {
+            fprintf(f, "\n");
+        }
+    }
+    if ((size % 16) != 0) {
+        fprintf(f, "\n");
+    }
+    fprintf(f, "};\n");
+    return (fclose(f) == 0) ? 0 : -1;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    char *text;
+    uint8_t *data;
+    uint8_t *packed;
+    uint32_t size, nb_packed, crc;
+    int32_t nb_unpacked;
+    struct check_s chk;
+
+    if (argc != 4) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    text = load_text(argv[2]);
+    if (text == NULL) {
+        MSG("ERROR: cannot read %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    data = (uint8_t *)malloc(FW_MAX_BYTE);
+    packed = (uint8_t *)malloc(FW_MAX_BYTE + FW_MAX_BYTE / LZ_LITERAL_MAX + 1); /* worst case: literals only */
+    if ((data == NULL) || (packed == NULL)) {
+        MSG("ERROR: out of memory\n");
+        return EXIT_FAILURE;
+    }
+    size = parse_array(text, data, FW_MAX_BYTE);
+    if (size == 0) {
+        MSG("ERROR: no firmware array found in %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    crc = lgw_crc32(0, data, size);
+    nb_packed = pack(data, size, packed);
+
+    /* unpack with the HAL decoder before anything is written */
+    chk.ref = data;
+    chk.size = size;
+    chk.done = 0;
+    chk.match = true;
+    nb_unpacked = lgw_lz_unpack(packed, nb_packed, check_sink, &chk);
+    if ((nb_unpacked != (int32_t)size) || (chk.match == false) || (chk.done != size)) {
+        MSG("ERROR: packed image of %s does not unpack to the original\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    if (write_var(argv[3], argv[1], argv[2], text, packed, nb_packed, crc) != 0) {
+        MSG("ERROR: cannot write %s\n", argv[3]);
+        return EXIT_FAILURE;
+    }
+    printf("%s: %u bytes packed in %u bytes (%.1f%%), CRC 0x%08X\n", argv[1], size, nb_packed, 100.0 * nb_packed / size, crc);
+
+    free(packed);
+    free(data);
+    free(text);
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
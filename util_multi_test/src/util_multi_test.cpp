@@ -0,0 +1,405 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Check of two concentrators driven by one HAL, on a Linux host.
+    Board A is the built-in context, driven by the lgw_* functions; board B
+    has its own context, driven by the lgw_ctx_* functions. Both are
+    simulated SX1301. Packets queued on one board must only come out of that
+    board, packets sent on one board must only reach that board, and the
+    configuration and counters of one board must not leak to the other.
+    A task receiving on board B hands the registers over to lgw_send calls of
+    the main task between packets; those must still reach board A. A task
+    starting board B leaves the registers to board A while the calibration
+    runs, and board B refuses register accesses meanwhile.
+    Exits with EXIT_FAILURE on the first mismatch.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf */
+#include <stdlib.h>     /* EXIT_* */
+#include <string.h>     /* memset memcmp */
+#include <pthread.h>    /* pthread_create pthread_join */
+#include <unistd.h>     /* usleep */
+
+#include "loragw_hal.h"
+#include "loragw_reg.h"
+#include "loragw_spi.h"
+#include "loragw_spi_sim.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a)   (sizeof(a) / sizeof((a)[0]))
+#define MSG(args...)    fprintf(stderr, args) /* message that is destined to the user */
+
+#define CHECK(cond)     if (!(cond)) { MSG("ERROR: %s:%d: %s\n", __FILE__, __LINE__, #cond); return -1; }
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define A_FREQ          915000000   /* radio 0 of board A, radio 1 is 1 MHz above */
+#define B_FREQ          868000000   /* radio 0 of board B, radio 1 is 1 MHz above */
+#define NB_YIELD_MIN    20          /* hand-overs of the receive task to lgw_send */
+#define NB_YIELD_TX_MAX 5000        /* lgw_send calls before giving up on them */
+#define CAL_WAIT_MAX_US 1000000     /* wait for the start of board B to reach its calibration */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static lgw_ctx_t board_b;
+static const struct lgw_spi_port_s port_b = {LGW_SPI_HOST_ALT, 5, -1};
+
+/* start task of board B */
+static int start_task_stat;
+
+/* receive task of board B */
+static volatile bool rx_task_stop;
+static uint32_t rx_task_nb_pkt;
+static uint32_t rx_task_nb_wrong;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void usage(void) {
+    printf("Usage: util_multi_test\n");
+    printf(" runs two simulated SX1301, one on the built-in context and one on its own\n");
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* 4 multi-SF channels on each radio, c NULL for the built-in context */
+static int configure(lgw_ctx_t *c, uint32_t freq_hz) {
+    struct lgw_conf_board_s boardconf;
+    struct lgw_conf_rxrf_s rfconf;
+    struct lgw_conf_rxif_s ifconf;
+    int i, x;
+
+    memset(&boardconf, 0, sizeof boardconf);
+    boardconf.lorawan_public = true;
+    boardconf.clksrc = 1;
+    x = (c == NULL) ? lgw_board_setconf(boardconf) : lgw_ctx_board_setconf(c, boardconf);
+    CHECK(x == LGW_HAL_SUCCESS);
+    memset(&rfconf, 0, sizeof rfconf);
+    rfconf.enable = true;
+    rfconf.type = LGW_RADIO_TYPE_SX1257;
+    for (i = 0; i < LGW_RF_CHAIN_NB; ++i) {
+        rfconf.freq_hz = freq_hz + i * 1000000;
+        rfconf.tx_enable = (i == 0);
+        x = (c == NULL) ? lgw_rxrf_setconf(i, rfconf) : lgw_ctx_rxrf_setconf(c, i, rfconf);
+        CHECK(x == LGW_HAL_SUCCESS);
+    }
+    memset(&ifconf, 0, sizeof ifconf);
+    ifconf.enable = true;
+    for (i = 0; i < LGW_MULTI_NB; ++i) {
+        ifconf.rf_chain = i / 4;
+        ifconf.freq_hz = -300000 + (i % 4) * 200000;
+        x = (c == NULL) ? lgw_rxif_setconf(i, ifconf) : lgw_ctx_rxif_setconf(c, i, ifconf);
+        CHECK(x == LGW_HAL_SUCCESS);
+    }
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* queue a SF7 packet on IF chain 1, its first byte tells the board */
+static int push(void *target, uint8_t tag, uint8_t size) {
+    uint8_t payload[256];
+    uint8_t md[LGW_SIM_METADATA_NB];
+
+    memset(payload, tag, sizeof payload);
+    memset(md, 0, sizeof md);
+    md[0] = 1;
+    md[1] = (7 << 4) | (1 << 1);
+    md[5] = 100;
+    return lgw_sim_rx_push(target, payload, size, md, 5);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void tx_packet(struct lgw_pkt_tx_s *tx, uint32_t freq_hz, uint8_t tag) {
+    memset(tx, 0, sizeof *tx);
+    tx->freq_hz = freq_hz;
+    tx->tx_mode = IMMEDIATE;
+    tx->rf_chain = 0;
+    tx->rf_power = 14;
+    tx->modulation = MOD_LORA;
+    tx->bandwidth = BW_125KHZ;
+    tx->datarate = DR_LORA_SF9;
+    tx->coderate = CR_LORA_4_5;
+    tx->preamble = 8;
+    tx->size = 8;
+    memset(tx->payload, tag, tx->size);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int test_receive(void *ta, void *tb) {
+    struct lgw_pkt_rx_s rx[LGW_PKT_FIFO_SIZE];
+    int nb;
+
+    CHECK(push(ta, 'A', 10) == LGW_SPI_SUCCESS);
+    CHECK(push(tb, 'B', 20) == LGW_SPI_SUCCESS);
+    CHECK(push(tb, 'B', 21) == LGW_SPI_SUCCESS);
+
+    nb = lgw_receive(ARRAY_SIZE(rx), rx);
+    CHECK(nb == 1);
+    CHECK((rx[0].size == 10) && (rx[0].payload[0] == 'A'));
+    CHECK(rx[0].freq_hz == A_FREQ - 100000);
+
+    nb = lgw_ctx_receive(&board_b, ARRAY_SIZE(rx), rx);
+    CHECK(nb == 2);
+    CHECK((rx[0].size == 20) && (rx[0].payload[0] == 'B'));
+    CHECK((rx[1].size == 21) && (rx[1].payload[0] == 'B'));
+    CHECK(rx[0].freq_hz == B_FREQ - 100000);
+
+    CHECK(lgw_receive(ARRAY_SIZE(rx), rx) == 0);
+    CHECK(lgw_ctx_receive(&board_b, ARRAY_SIZE(rx), rx) == 0);
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int test_send(void *ta, void *tb) {
+    struct lgw_pkt_tx_s tx;
+    struct lgw_sim_stats_s sa, sb;
+    uint8_t buf[LGW_SIM_TX_BUF_SIZE];
+    uint8_t code;
+
+    tx_packet(&tx, B_FREQ + 200000, 'B');
+    CHECK(lgw_ctx_send(&board_b, tx) == LGW_HAL_SUCCESS);
+    tx_packet(&tx, A_FREQ + 200000, 'A');
+    CHECK(lgw_send(tx) == LGW_HAL_SUCCESS);
+
+    lgw_sim_get_stats(ta, &sa, false);
+    lgw_sim_get_stats(tb, &sb, false);
+    CHECK((sa.nb_tx == 1) && (sb.nb_tx == 1));
+    CHECK(lgw_sim_tx_last(ta, buf) == LGW_SPI_SUCCESS);
+    CHECK(buf[16] == 'A');
+    CHECK(lgw_sim_tx_last(tb, buf) == LGW_SPI_SUCCESS);
+    CHECK(buf[16] == 'B');
+
+    CHECK(lgw_ctx_status(&board_b, TX_STATUS, &code) == LGW_HAL_SUCCESS);
+    CHECK(lgw_ctx_abort_tx(&board_b) == LGW_HAL_SUCCESS);
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int test_counters(void *ta, void *tb) {
+    struct lgw_spi_bus_stats_s ba[LGW_SPI_OP_NB], bb[LGW_SPI_OP_NB], all;
+    struct lgw_boot_timing_s bt;
+    struct lgw_sim_stats_s sa, sb;
+    uint32_t na, nb;
+    int i;
+
+    CHECK(lgw_get_bus_stats(ba, false) == LGW_HAL_SUCCESS);
+    CHECK(lgw_ctx_get_bus_stats(&board_b, bb, false) == LGW_HAL_SUCCESS);
+
+    /* each board counts its own transactions, the SPI layer sums them */
+    lgw_sim_get_stats(ta, &sa, false);
+    lgw_sim_get_stats(tb, &sb, false);
+    na = 0;
+    nb = 0;
+    for (i = 0; i < LGW_SPI_OP_NB; ++i) {
+        lgw_spi_get_bus_stats(i, &all, false);
+        CHECK(all.nb_transaction == ba[i].nb_transaction + bb[i].nb_transaction);
+        na += ba[i].nb_transaction;
+        nb += bb[i].nb_transaction;
+    }
+    CHECK(na == sa.nb_w + sa.nb_r + sa.nb_wb + sa.nb_rb);
+    CHECK(nb == sb.nb_w + sb.nb_r + sb.nb_wb + sb.nb_rb);
+    CHECK(bb[LGW_SPI_OP_SEND].nb_transaction > 0);
+
+    /* clearing one board leaves the other alone */
+    CHECK(lgw_ctx_get_bus_stats(&board_b, bb, true) == LGW_HAL_SUCCESS);
+    CHECK(lgw_ctx_get_bus_stats(&board_b, bb, false) == LGW_HAL_SUCCESS);
+    CHECK(lgw_get_bus_stats(ba, false) == LGW_HAL_SUCCESS);
+    CHECK(bb[LGW_SPI_OP_START].nb_transaction == 0);
+    CHECK(ba[LGW_SPI_OP_START].nb_transaction > 0);
+
+    CHECK(lgw_get_boot_timing(&bt) == LGW_HAL_SUCCESS);
+    CHECK(lgw_ctx_get_boot_timing(&board_b, &bt) == LGW_HAL_SUCCESS);
+    printf("board A: %u transactions, board B: %u transactions\n", na, nb);
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* keep the FIFO of board B full and drain it, until told to stop */
+static void *rx_task(void *arg) {
+    struct lgw_pkt_rx_s rx[LGW_PKT_FIFO_SIZE];
+    void *tb = arg;
+    int nb, i;
+
+    while (rx_task_stop == false) {
+        lgw_reg_lock(); /* the simulated boards are not shared safely otherwise */
+        for (i = 0; i < LGW_PKT_FIFO_SIZE; ++i) {
+            push(tb, 'B', 12);
+        }
+        lgw_reg_unlock();
+        nb = lgw_ctx_receive(&board_b, ARRAY_SIZE(rx), rx);
+        for (i = 0; i < nb; ++i) {
+            if ((rx[i].size != 12) || (rx[i].payload[0] != 'B')) {
+                ++rx_task_nb_wrong;
+            }
+        }
+        rx_task_nb_pkt += (nb > 0) ? nb : 0;
+    }
+    return NULL;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int test_yield(void *ta, void *tb) {
+    struct lgw_pkt_rx_s rx[LGW_PKT_FIFO_SIZE];
+    struct lgw_pkt_tx_s tx;
+    struct lgw_sim_stats_s sa0, sb0, sa, sb;
+    struct lgw_reg_arbiter_stats_s arb;
+    pthread_t task;
+    uint32_t nb_tx = 0;
+    int nb_fail = 0;
+
+    lgw_sim_get_stats(ta, &sa0, false);
+    lgw_sim_get_stats(tb, &sb0, false);
+    lgw_reg_get_arbiter_stats(&arb, true);
+
+    /* lgw_send comes in with priority, the receive of board B yields between two packets */
+    rx_task_stop = false;
+    CHECK(pthread_create(&task, NULL, rx_task, tb) == 0);
+    tx_packet(&tx, A_FREQ + 200000, 'A');
+    do {
+        usleep(100); /* lets the task take the registers back */
+        nb_fail += (lgw_send(tx) == LGW_HAL_SUCCESS) ? 0 : 1;
+        ++nb_tx;
+        lgw_reg_get_arbiter_stats(&arb, false);
+    } while ((arb.nb_yield < NB_YIELD_MIN) && (nb_tx < NB_YIELD_TX_MAX));
+    rx_task_stop = true;
+    pthread_join(task, NULL);
+
+    lgw_sim_get_stats(ta, &sa, false);
+    lgw_sim_get_stats(tb, &sb, false);
+    printf("yield: %u packets received on board B, %u yields, %u sends on board A\n", rx_task_nb_pkt, arb.nb_yield, nb_tx);
+    CHECK(arb.nb_yield >= NB_YIELD_MIN);
+    CHECK(nb_fail == 0);
+    CHECK(sa.nb_tx == sa0.nb_tx + nb_tx);
+    CHECK(sb.nb_tx == sb0.nb_tx);
+    CHECK(rx_task_nb_wrong == 0);
+    CHECK(lgw_ctx_receive(&board_b, ARRAY_SIZE(rx), rx) == 0);
+    CHECK(lgw_receive(ARRAY_SIZE(rx), rx) == 0);
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void *start_task(void *arg) {
+    (void)arg;
+    start_task_stat = lgw_ctx_start(&board_b);
+    return NULL;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int test_calib(void) {
+    volatile bool *cal_wait = &board_b.start_cal_wait;
+    pthread_t task;
+    uint32_t cnt;
+    uint8_t code;
+    int nb_us = 0;
+    int x = 0;
+
+    /* board B is started again, the main task catches it in its calibration */
+    CHECK(pthread_create(&task, NULL, start_task, NULL) == 0);
+    while ((*cal_wait == false) && (nb_us < CAL_WAIT_MAX_US)) {
+        usleep(10);
+        nb_us += 10;
+    }
+    if (*cal_wait == true) {
+        x |= (lgw_get_trigcnt(&cnt) == LGW_HAL_SUCCESS) ? 0 : 0x01;
+        x |= (lgw_status(TX_STATUS, &code) == LGW_HAL_SUCCESS) ? 0 : 0x02;
+        x |= (*cal_wait == true) ? 0 : 0x04; /* board A did not wait for the calibration */
+        x |= (lgw_ctx_status(&board_b, TX_STATUS, &code) == LGW_HAL_ERROR) ? 0 : 0x08;
+        x |= (lgw_ctx_abort_tx(&board_b) == LGW_HAL_ERROR) ? 0 : 0x10;
+        x |= (lgw_ctx_get_trigcnt(&board_b, &cnt) == LGW_HAL_ERROR) ? 0 : 0x20;
+    } else {
+        x = 0x40;
+    }
+    pthread_join(task, NULL);
+    printf("calibration: board B reached it after %d us, checks 0x%02X\n", nb_us, x);
+    CHECK(x == 0);
+    CHECK(start_task_stat == LGW_HAL_SUCCESS);
+    CHECK(lgw_ctx_status(&board_b, TX_STATUS, &code) == LGW_HAL_SUCCESS);
+    CHECK(code == TX_FREE);
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int test_conf(void *tb) {
+    struct lgw_conf_board_s boardconf;
+    struct lgw_spi_bus_stats_s bb[LGW_SPI_OP_NB];
+
+    /* the context of a running board can not be reset, its link stays open */
+    CHECK(lgw_ctx_init(&board_b, &port_b) == LGW_HAL_ERROR);
+    CHECK(board_b.reg.spi_target == tb);
+    CHECK(board_b.is_started == true);
+
+    /* board B running does not lock the configuration of board A, and the other way round */
+    CHECK(lgw_ctx_stop(&board_b) == LGW_HAL_SUCCESS);
+    memset(&boardconf, 0, sizeof boardconf);
+    boardconf.clksrc = 1;
+    CHECK(lgw_board_setconf(boardconf) == LGW_HAL_ERROR);
+    CHECK(lgw_ctx_board_setconf(&board_b, boardconf) == LGW_HAL_SUCCESS);
+    CHECK(lgw_ctx_get_bus_stats(&board_b, bb, false) == LGW_HAL_ERROR); /* disconnected */
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    void *ta, *tb;
+
+    (void)argv;
+    if (argc != 1) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    if ((lgw_ctx_init(&board_b, &port_b) != LGW_HAL_SUCCESS) || (configure(NULL, A_FREQ) != 0) || (configure(&board_b, B_FREQ) != 0)) {
+        MSG("ERROR: failed to configure the boards\n");
+        return EXIT_FAILURE;
+    }
+    if ((lgw_start() != LGW_HAL_SUCCESS) || (lgw_ctx_start(&board_b) != LGW_HAL_SUCCESS)) {
+        MSG("ERROR: failed to start the boards\n");
+        return EXIT_FAILURE;
+    }
+    ta = lgw_ctx_default()->reg.spi_target;
+    tb = board_b.reg.spi_target;
+    if ((ta == NULL) || (tb == NULL) || (ta == tb)) {
+        MSG("ERROR: the boards do not have their own SPI target\n");
+        return EXIT_FAILURE;
+    }
+
+    if ((test_receive(ta, tb) != 0) || (test_send(ta, tb) != 0) || (test_counters(ta, tb) != 0) || (test_yield(ta, tb) != 0) || (test_calib() != 0) || (test_conf(board_b.reg.spi_target) != 0)) {
+        return EXIT_FAILURE;
+    }
+
+    lgw_stop();
+    printf("PASS\n");
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,281 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Check of lgw_reconfigure on the simulated SX1301, on a Linux host.
+    The sim backend is wrapped to record the register bytes written. Moving
+    one 'multi' channel must only write the registers of that channel, and
+    packets must come out at its new frequency; a plan that needs a restart
+    must be rejected without touching the running one. Exits with
+    EXIT_FAILURE on the first mismatch.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf */
+#include <stdlib.h>     /* EXIT_* */
+#include <string.h>     /* memset memcpy */
+
+#include "loragw_hal.h"
+#include "loragw_reg.h"
+#include "loragw_spi.h"
+#include "loragw_spi_sim.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a)   (sizeof(a) / sizeof((a)[0]))
+#define MSG(args...)    fprintf(stderr, args) /* message that is destined to the user */
+
+#define CHECK(cond)     if (!(cond)) { MSG("ERROR: %s:%d: %s\n", __FILE__, __LINE__, #cond); return -1; }
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define RF0_FREQ        915000000
+#define PAGE_ADDR       0           /* page register, common to all pages */
+#define MOVED_IF        2           /* 'multi' channel given a new IF frequency */
+#define MOVED_IF_FREQ   150000      /* its new IF frequency, was 100 kHz */
+#define RETUNE_STEP     100000      /* RF move refused by lgw_reconfigure */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct lgw_spi_backend_s rec_backend;        /* sim backend, writes recorded */
+static int rec_page;                                /* page selected on the simulated chip */
+static bool rec_written[LGW_REG_PAGE_NB][128];      /* bytes written since the last clear */
+
+static struct lgw_conf_rxrf_s rfconf[LGW_RF_CHAIN_NB];
+static struct lgw_conf_rxif_s ifconf[LGW_IF_CHAIN_NB];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void usage(void) {
+    printf("Usage: util_reconf_test\n");
+    printf(" runs lgw_reconfigure on the simulated SX1301 and checks the registers it writes\n");
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void rec_mark(uint8_t address, uint16_t size) {
+    uint16_t i;
+
+    for (i = 0; (i < size) && ((address + i) < 128); ++i) {
+        rec_written[rec_page][address + i] = true;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int rec_w(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t data) {
+    if (address == PAGE_ADDR) {
+        rec_page = ((data & 0x80) != 0) ? 0 : (data & 0x03) % LGW_REG_PAGE_NB;
+    } else {
+        rec_mark(address, 1);
+    }
+    return lgw_spi_backend_sim.w(spi_target, spi_mux_mode, spi_mux_target, address, data);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int rec_wb(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size) {
+    rec_mark(address, size);
+    return lgw_spi_backend_sim.wb(spi_target, spi_mux_mode, spi_mux_target, address, data, size);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* true if a byte of the register was written since the last clear */
+static bool rec_reg_written(uint16_t register_id) {
+    const struct lgw_reg_s *r = &lgw_reg_map::table[register_id];
+    int p = (r->page < 0) ? 0 : r->page;
+    int i;
+
+    for (i = 0; i < (r->offs + r->leng + 7) / 8; ++i) {
+        if (rec_written[p][r->addr + i] == true) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int rec_count(void) {
+    int p, a, n = 0;
+
+    for (p = 0; p < LGW_REG_PAGE_NB; ++p) {
+        for (a = 0; a < 128; ++a) {
+            n += (rec_written[p][a] == true) ? 1 : 0;
+        }
+    }
+    return n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* 4 multi-SF channels on each radio, the LoRa 'std' and FSK channels disabled */
+static int configure(void) {
+    struct lgw_conf_board_s boardconf;
+    int i;
+
+    memset(&boardconf, 0, sizeof boardconf);
+    boardconf.lorawan_public = true;
+    boardconf.clksrc = 1;
+    CHECK(lgw_board_setconf(boardconf) == LGW_HAL_SUCCESS);
+    memset(rfconf, 0, sizeof rfconf);
+    for (i = 0; i < LGW_RF_CHAIN_NB; ++i) {
+        rfconf[i].enable = true;
+        rfconf[i].type = LGW_RADIO_TYPE_SX1257;
+        rfconf[i].freq_hz = RF0_FREQ + i * 1000000;
+        rfconf[i].tx_enable = (i == 0);
+        CHECK(lgw_rxrf_setconf(i, rfconf[i]) == LGW_HAL_SUCCESS);
+    }
+    memset(ifconf, 0, sizeof ifconf);
+    for (i = 0; i < LGW_MULTI_NB; ++i) {
+        ifconf[i].enable = true;
+        ifconf[i].rf_chain = i / 4;
+        ifconf[i].freq_hz = -300000 + (i % 4) * 200000;
+        CHECK(lgw_rxif_setconf(i, ifconf[i]) == LGW_HAL_SUCCESS);
+    }
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* one packet through the simulated RX FIFO, it must come out at the IF chain frequency */
+static int rx_check(uint8_t if_chain, uint32_t freq_hz) {
+    struct lgw_pkt_rx_s rx[LGW_PKT_FIFO_SIZE];
+    uint8_t payload[16];
+    uint8_t md[LGW_SIM_METADATA_NB];
+
+    memset(payload, 0x40 + if_chain, sizeof payload);
+    memset(md, 0, sizeof md);
+    md[0] = if_chain;
+    md[1] = (7 << 4) | (1 << 1);
+    md[5] = 100;
+    CHECK(lgw_sim_rx_push(lgw_ctx_default()->reg.spi_target, payload, sizeof payload, md, 5) == LGW_SPI_SUCCESS);
+    CHECK(lgw_receive(ARRAY_SIZE(rx), rx) == 1);
+    CHECK(rx[0].if_chain == if_chain);
+    CHECK(rx[0].status == STAT_CRC_OK);
+    CHECK((rx[0].size == sizeof payload) && (rx[0].payload[0] == 0x40 + if_chain));
+    CHECK(rx[0].freq_hz == freq_hz);
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* one 'multi' channel moved, only its registers are written */
+static int test_move(void) {
+    lgw_ctx_t *c = lgw_ctx_default();
+    int i;
+
+    ifconf[MOVED_IF].freq_hz = MOVED_IF_FREQ;
+    memset(rec_written, 0, sizeof rec_written);
+    CHECK(lgw_reconfigure(rfconf, ifconf) == LGW_HAL_SUCCESS);
+    printf("move      %d register bytes written\n", rec_count());
+    CHECK(c->if_freq[MOVED_IF] == MOVED_IF_FREQ);
+    CHECK(rec_reg_written(LGW_IF_FREQ_0 + MOVED_IF) == true);
+    for (i = 0; i < LGW_MULTI_NB; ++i) {
+        if (i == MOVED_IF) {
+            continue;
+        }
+        CHECK(rec_reg_written(LGW_IF_FREQ_0 + i) == false);
+        CHECK(rec_reg_written(LGW_CORR0_DETECT_EN + i) == false);
+    }
+    CHECK(rec_reg_written(LGW_IF_FREQ_8) == false);
+    CHECK(rec_reg_written(LGW_IF_FREQ_9) == false);
+
+    /* the moved channel decodes at its new IF, the others where they were */
+    CHECK(rx_check(MOVED_IF, RF0_FREQ + MOVED_IF_FREQ) == 0);
+    CHECK(rx_check(MOVED_IF + 1, RF0_FREQ + ifconf[MOVED_IF + 1].freq_hz) == 0);
+    CHECK(rx_check(LGW_MULTI_NB - 1, RF0_FREQ + 1000000 + ifconf[LGW_MULTI_NB - 1].freq_hz) == 0);
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* plans needing a restart are rejected as a whole, nothing written */
+static int test_reject(void) {
+    struct lgw_conf_rxrf_s rf[LGW_RF_CHAIN_NB];
+    struct lgw_conf_rxif_s ifc[LGW_IF_CHAIN_NB];
+    int32_t if_freq[LGW_IF_CHAIN_NB];
+    lgw_ctx_t *c = lgw_ctx_default();
+
+    memcpy(if_freq, c->if_freq, sizeof if_freq);
+    memset(rec_written, 0, sizeof rec_written);
+
+    /* RF chain moved, with an IF change in the same plan */
+    memcpy(rf, rfconf, sizeof rf);
+    memcpy(ifc, ifconf, sizeof ifc);
+    rf[0].freq_hz += RETUNE_STEP;
+    ifc[0].freq_hz += 50000;
+    CHECK(lgw_reconfigure(rf, ifc) == LGW_HAL_ERROR);
+    CHECK(memcmp(c->if_freq, if_freq, sizeof if_freq) == 0);
+    CHECK(c->rf_rx_freq[0] == RF0_FREQ);
+
+    /* 'multi' channel given to the other radio, with an IF change in the same plan */
+    memcpy(ifc, ifconf, sizeof ifc);
+    ifc[1].rf_chain = 1;
+    ifc[0].freq_hz += 50000;
+    CHECK(lgw_reconfigure(rfconf, ifc) == LGW_HAL_ERROR);
+    CHECK(memcmp(c->if_freq, if_freq, sizeof if_freq) == 0);
+    CHECK(c->if_rf_chain[1] == 0);
+
+    printf("reject    %d register bytes written\n", rec_count());
+    CHECK(rec_count() == 0);
+
+    /* the running plan still decodes */
+    CHECK(rx_check(0, RF0_FREQ + ifconf[0].freq_hz) == 0);
+    CHECK(rx_check(MOVED_IF, RF0_FREQ + MOVED_IF_FREQ) == 0);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    (void)argv;
+    if (argc != 1) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    rec_backend = lgw_spi_backend_sim;
+    rec_backend.name = "sim, writes recorded";
+    rec_backend.w = rec_w;
+    rec_backend.wb = rec_wb;
+    if ((lgw_spi_set_backend(&rec_backend) != LGW_SPI_SUCCESS) || (configure() != 0)) {
+        MSG("ERROR: failed to configure the HAL\n");
+        return EXIT_FAILURE;
+    }
+    if (lgw_reconfigure(rfconf, ifconf) != LGW_HAL_ERROR) {
+        MSG("ERROR: lgw_reconfigure ran on a stopped concentrator\n");
+        return EXIT_FAILURE;
+    }
+    if (lgw_start() != LGW_HAL_SUCCESS) {
+        MSG("ERROR: failed to start the concentrator\n");
+        return EXIT_FAILURE;
+    }
+    if ((rx_check(MOVED_IF, RF0_FREQ + ifconf[MOVED_IF].freq_hz) != 0) || (test_move() != 0) || (test_reject() != 0)) {
+        return EXIT_FAILURE;
+    }
+
+    lgw_stop();
+    printf("PASS\n");
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
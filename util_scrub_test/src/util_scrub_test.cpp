@@ -0,0 +1,227 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Check of the register scrubber on the simulated SX1301, on a Linux host.
+    Register bytes are changed behind the HAL with lgw_spi_w, then lgw_scrub
+    runs full passes over the pages. A byte of the configuration must be found
+    and written back once; the bytes the scrubber skips must be left as they
+    are. Exits with EXIT_FAILURE on the first mismatch.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf */
+#include <stdlib.h>     /* EXIT_* */
+#include <string.h>     /* memset */
+
+#include "loragw_hal.h"
+#include "loragw_reg.h"
+#include "loragw_spi.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define MSG(args...)    fprintf(stderr, args) /* message that is destined to the user */
+
+#define CHECK(cond)     if (!(cond)) { MSG("ERROR: %s:%d: %s\n", __FILE__, __LINE__, #cond); return -1; }
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define SCRUB_SHARE     50      /* share of the bus given to the scrubber, in % */
+#define SCRUB_CALL_MAX  10000   /* lgw_scrub calls before giving up on a pass */
+#define PAGE_ADDR       0       /* page register, common to all pages */
+
+#define DRIFT_REG       LGW_IF_FREQ_0   /* configuration byte changed behind the HAL */
+#define SKIP_PAGE       2               /* MCU RAM debug pointers, never scrubbed */
+#define SKIP_FIRST      80
+#define SKIP_LAST       81
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void usage(void) {
+    printf("Usage: util_scrub_test\n");
+    printf(" changes registers of the simulated SX1301 behind the HAL and runs lgw_scrub\n");
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* 4 multi-SF channels on each radio */
+static int configure(void) {
+    struct lgw_conf_board_s boardconf;
+    struct lgw_conf_rxrf_s rfconf;
+    struct lgw_conf_rxif_s ifconf;
+    int i;
+
+    memset(&boardconf, 0, sizeof boardconf);
+    boardconf.lorawan_public = true;
+    boardconf.clksrc = 1;
+    CHECK(lgw_board_setconf(boardconf) == LGW_HAL_SUCCESS);
+    memset(&rfconf, 0, sizeof rfconf);
+    rfconf.enable = true;
+    rfconf.type = LGW_RADIO_TYPE_SX1257;
+    for (i = 0; i < LGW_RF_CHAIN_NB; ++i) {
+        rfconf.freq_hz = 915000000 + i * 1000000;
+        rfconf.tx_enable = (i == 0);
+        CHECK(lgw_rxrf_setconf(i, rfconf) == LGW_HAL_SUCCESS);
+    }
+    memset(&ifconf, 0, sizeof ifconf);
+    ifconf.enable = true;
+    for (i = 0; i < LGW_MULTI_NB; ++i) {
+        ifconf.rf_chain = i / 4;
+        ifconf.freq_hz = -300000 + (i % 4) * 200000;
+        CHECK(lgw_rxif_setconf(i, ifconf) == LGW_HAL_SUCCESS);
+    }
+    CHECK(lgw_scrub_setconf(SCRUB_SHARE) == LGW_HAL_SUCCESS);
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* byte access behind the HAL, the page the HAL selected is put back */
+static int raw_access(uint8_t page, uint8_t addr, uint8_t *data, bool write) {
+    struct lgw_reg_ctx_s *reg = &lgw_ctx_default()->reg;
+    int x = LGW_SPI_SUCCESS;
+
+    lgw_reg_lock();
+    lgw_reg_barrier();
+    x |= lgw_spi_w(reg->spi_target, reg->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, PAGE_ADDR, page);
+    if (write == true) {
+        x |= lgw_spi_w(reg->spi_target, reg->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, addr, *data);
+    } else {
+        x |= lgw_spi_r(reg->spi_target, reg->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, addr, data);
+    }
+    x |= lgw_spi_w(reg->spi_target, reg->spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, PAGE_ADDR, (uint8_t)reg->regpage);
+    lgw_reg_unlock();
+    return (x == LGW_SPI_SUCCESS) ? 0 : -1;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* call lgw_scrub until nb more passes over the pages are complete */
+static int scrub_rounds(uint32_t nb, struct lgw_reg_scrub_stats_s *st) {
+    struct lgw_reg_scrub_stats_s st0;
+    uint32_t wait;
+    int i;
+
+    CHECK(lgw_reg_get_scrub_stats(&st0, false) == LGW_REG_SUCCESS);
+    for (i = 0; i < SCRUB_CALL_MAX; ++i) {
+        CHECK(lgw_scrub(&wait) == LGW_HAL_SUCCESS);
+        CHECK(wait > 0);
+        CHECK(lgw_reg_get_scrub_stats(st, false) == LGW_REG_SUCCESS);
+        if (st->nb_round >= (st0.nb_round + nb)) {
+            return 0;
+        }
+    }
+    MSG("ERROR: %d lgw_scrub calls did not complete %u passes\n", SCRUB_CALL_MAX, nb);
+    return -1;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* the configuration as written, nothing to repair */
+static int test_clean(void) {
+    struct lgw_reg_scrub_stats_s st;
+
+    CHECK(scrub_rounds(1, &st) == 0); /* lands on the start of a pass */
+    CHECK(lgw_reg_get_scrub_stats(&st, true) == LGW_REG_SUCCESS);
+    CHECK(scrub_rounds(1, &st) == 0);
+    printf("clean     %5u bytes checked, %u drifted, %u us on the bus\n", st.nb_checked, st.nb_drift, st.bus_time);
+    CHECK(st.nb_checked > 0);
+    CHECK(st.nb_drift == 0);
+    CHECK(st.nb_repaired == 0);
+    return 0;
+}
+
+/* one configuration byte changed, found and written back once */
+static int test_repair(void) {
+    const struct lgw_reg_s *r = &lgw_reg_map::table[DRIFT_REG];
+    struct lgw_reg_scrub_stats_s st;
+    uint8_t orig, val;
+
+    CHECK(raw_access(r->page, r->addr, &orig, false) == 0);
+    val = orig ^ 0x01;
+    CHECK(raw_access(r->page, r->addr, &val, true) == 0);
+    CHECK(lgw_reg_get_scrub_stats(&st, true) == LGW_REG_SUCCESS);
+    CHECK(scrub_rounds(2, &st) == 0);
+    printf("repair    %5u bytes checked, %u drifted, %u repaired, last page %u address %u\n", st.nb_checked, st.nb_drift, st.nb_repaired, st.last_page, st.last_addr);
+    CHECK(st.nb_drift == 1);
+    CHECK(st.nb_repaired == 1);
+    CHECK((st.last_page == r->page) && (st.last_addr == r->addr));
+    CHECK(raw_access(r->page, r->addr, &val, false) == 0);
+    CHECK(val == orig);
+    return 0;
+}
+
+/* bytes out of the scrubbed set are never written back */
+static int test_skipped(void) {
+    struct lgw_reg_scrub_stats_s st;
+    uint8_t orig[SKIP_LAST - SKIP_FIRST + 1];
+    uint8_t val;
+    int a;
+
+    for (a = SKIP_FIRST; a <= SKIP_LAST; ++a) {
+        CHECK(raw_access(SKIP_PAGE, a, &orig[a - SKIP_FIRST], false) == 0);
+        val = orig[a - SKIP_FIRST] ^ 0x5A;
+        CHECK(raw_access(SKIP_PAGE, a, &val, true) == 0);
+    }
+    CHECK(lgw_reg_get_scrub_stats(&st, true) == LGW_REG_SUCCESS);
+    CHECK(scrub_rounds(2, &st) == 0);
+    printf("skipped   %5u bytes checked, %u drifted, %u repaired\n", st.nb_checked, st.nb_drift, st.nb_repaired);
+    CHECK(st.nb_drift == 0);
+    CHECK(st.nb_repaired == 0);
+    for (a = SKIP_FIRST; a <= SKIP_LAST; ++a) {
+        CHECK(raw_access(SKIP_PAGE, a, &val, false) == 0);
+        CHECK(val == (orig[a - SKIP_FIRST] ^ 0x5A));
+        CHECK(raw_access(SKIP_PAGE, a, &orig[a - SKIP_FIRST], true) == 0);
+    }
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    uint32_t wait;
+
+    (void)argv;
+    if (argc != 1) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    if (configure() != 0) {
+        MSG("ERROR: failed to configure the HAL\n");
+        return EXIT_FAILURE;
+    }
+    if (lgw_scrub(&wait) != LGW_HAL_ERROR) {
+        MSG("ERROR: lgw_scrub ran on a stopped concentrator\n");
+        return EXIT_FAILURE;
+    }
+    if (lgw_start() != LGW_HAL_SUCCESS) {
+        MSG("ERROR: failed to start the concentrator\n");
+        return EXIT_FAILURE;
+    }
+    if ((test_clean() != 0) || (test_repair() != 0) || (test_skipped() != 0)) {
+        return EXIT_FAILURE;
+    }
+
+    lgw_stop();
+    printf("PASS\n");
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,269 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Regression check of lgw_start, lgw_receive and lgw_send on the simulated
+    SX1301, on a Linux host.
+    Packets are queued in the simulated RX FIFO and the decoded fields are
+    compared with the queued ones; a packet is sent and the TX data buffer is
+    compared with it. The SPI transactions and durations of each operation are
+    printed. Exits with EXIT_FAILURE on the first mismatch.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf */
+#include <stdlib.h>     /* EXIT_* */
+#include <string.h>     /* memset memcmp */
+
+#include "loragw_hal.h"
+#include "loragw_spi.h"
+#include "loragw_spi_sim.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a)   (sizeof(a) / sizeof((a)[0]))
+#define MSG(args...)    fprintf(stderr, args) /* message that is destined to the user */
+
+#define CHECK(cond)     if (!(cond)) { MSG("ERROR: %s:%d: %s\n", __FILE__, __LINE__, #cond); return -1; }
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define RF0_FREQ        915000000
+#define RF1_FREQ        916000000
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+/* one packet queued in the simulated RX FIFO and the fields expected back */
+struct rx_case_s {
+    uint8_t     if_chain;
+    uint8_t     sf;
+    uint8_t     cr;         /* 1 for 4/5 ... 4 for 4/8 */
+    int8_t      snr;        /* quarter dB */
+    uint8_t     status;     /* as reported in the FIFO */
+    uint8_t     size;
+    uint32_t    dr;         /* expected datarate */
+    uint8_t     coderate;   /* expected coderate */
+    uint8_t     stat;       /* expected status */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static const struct rx_case_s rx_cases[] = {
+    {0, 7,  1,  20, 5, 5,   DR_LORA_SF7,  CR_LORA_4_5, STAT_CRC_OK},
+    {3, 9,  2, -12, 7, 23,  DR_LORA_SF9,  CR_LORA_4_6, STAT_CRC_BAD},
+    {5, 12, 4,   8, 1, 64,  DR_LORA_SF12, CR_LORA_4_8, STAT_NO_CRC},
+    {7, 10, 3,   0, 5, 255, DR_LORA_SF10, CR_LORA_4_7, STAT_CRC_OK}
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void usage(void) {
+    printf("Usage: util_sim_test\n");
+    printf(" runs lgw_start, lgw_receive and lgw_send on the simulated SX1301\n");
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* same channel plan as the gateway: 4 multi-SF channels on each radio */
+static int configure(void) {
+    struct lgw_conf_board_s boardconf;
+    struct lgw_conf_rxrf_s rfconf;
+    struct lgw_conf_rxif_s ifconf;
+    int i;
+
+    memset(&boardconf, 0, sizeof boardconf);
+    boardconf.lorawan_public = true;
+    boardconf.clksrc = 1;
+    if (lgw_board_setconf(boardconf) != LGW_HAL_SUCCESS) {
+        return -1;
+    }
+    memset(&rfconf, 0, sizeof rfconf);
+    rfconf.enable = true;
+    rfconf.type = LGW_RADIO_TYPE_SX1257;
+    for (i = 0; i < LGW_RF_CHAIN_NB; ++i) {
+        rfconf.freq_hz = (i == 0) ? RF0_FREQ : RF1_FREQ;
+        rfconf.tx_enable = (i == 0);
+        if (lgw_rxrf_setconf(i, rfconf) != LGW_HAL_SUCCESS) {
+            return -1;
+        }
+    }
+    memset(&ifconf, 0, sizeof ifconf);
+    ifconf.enable = true;
+    for (i = 0; i < LGW_MULTI_NB; ++i) {
+        ifconf.rf_chain = i / 4;
+        ifconf.freq_hz = -300000 + (i % 4) * 200000;
+        if (lgw_rxif_setconf(i, ifconf) != LGW_HAL_SUCCESS) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void print_session(const char *name, uint8_t op) {
+    struct lgw_spi_session_stats_s ss;
+
+    lgw_spi_get_session_stats(op, &ss);
+    printf("%-8s sessions %3u  txn %5u  last %6u us  saved %5u us\n", name, ss.nb_session, ss.nb_transaction, ss.last_duration, ss.last_saved);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int test_receive(void *target) {
+    struct lgw_pkt_rx_s rx[LGW_PKT_FIFO_SIZE];
+    const struct rx_case_s *c;
+    uint8_t payload[256];
+    uint8_t md[LGW_SIM_METADATA_NB];
+    int32_t if_freq;
+    unsigned i, j;
+    int nb;
+
+    for (i = 0; i < ARRAY_SIZE(rx_cases); ++i) {
+        c = &rx_cases[i];
+        for (j = 0; j < c->size; ++j) {
+            payload[j] = (uint8_t)(i * 17 + j);
+        }
+        memset(md, 0, sizeof md);
+        md[0] = c->if_chain;
+        md[1] = (c->sf << 4) | (c->cr << 1);
+        md[2] = (uint8_t)c->snr;
+        md[3] = (uint8_t)(c->snr - 4);
+        md[4] = (uint8_t)(c->snr + 4);
+        md[5] = 100;
+        md[6] = 0x40; /* timestamp 0x01000040 */
+        md[9] = 0x01;
+        md[10] = 0x34; /* CRC 0x1234 */
+        md[11] = 0x12;
+        CHECK(lgw_sim_rx_push(target, payload, c->size, md, c->status) == LGW_SPI_SUCCESS);
+    }
+
+    nb = lgw_receive(ARRAY_SIZE(rx), rx);
+    CHECK(nb == (int)ARRAY_SIZE(rx_cases));
+    for (i = 0; i < ARRAY_SIZE(rx_cases); ++i) {
+        c = &rx_cases[i];
+        if_freq = -300000 + (c->if_chain % 4) * 200000;
+        CHECK(rx[i].size == c->size);
+        CHECK(rx[i].if_chain == c->if_chain);
+        CHECK(rx[i].rf_chain == c->if_chain / 4);
+        CHECK(rx[i].freq_hz == (uint32_t)((int32_t)((c->if_chain < 4) ? RF0_FREQ : RF1_FREQ) + if_freq));
+        CHECK(rx[i].modulation == MOD_LORA);
+        CHECK(rx[i].bandwidth == BW_125KHZ);
+        CHECK(rx[i].datarate == c->dr);
+        CHECK(rx[i].coderate == c->coderate);
+        CHECK(rx[i].status == c->stat);
+        CHECK(rx[i].snr == (float)c->snr / 4);
+        CHECK(rx[i].crc == 0x1234);
+        CHECK((rx[i].count_us < 0x01000040) && (rx[i].count_us > 0x01000040 - 100000));
+        for (j = 0; j < c->size; ++j) {
+            CHECK(rx[i].payload[j] == (uint8_t)(i * 17 + j));
+        }
+    }
+
+    /* the FIFO is empty now */
+    CHECK(lgw_receive(ARRAY_SIZE(rx), rx) == 0);
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int test_send(void *target) {
+    struct lgw_pkt_tx_s tx;
+    struct lgw_sim_stats_s st;
+    uint8_t buf[LGW_SIM_TX_BUF_SIZE];
+    uint8_t code;
+    unsigned i;
+
+    lgw_sim_get_stats(target, &st, false);
+    CHECK(st.nb_tx == 0);
+
+    memset(&tx, 0, sizeof tx);
+    tx.freq_hz = 915200000;
+    tx.tx_mode = IMMEDIATE;
+    tx.rf_chain = 0;
+    tx.rf_power = 14;
+    tx.modulation = MOD_LORA;
+    tx.bandwidth = BW_125KHZ;
+    tx.datarate = DR_LORA_SF9;
+    tx.coderate = CR_LORA_4_5;
+    tx.preamble = 8;
+    tx.size = 40;
+    for (i = 0; i < tx.size; ++i) {
+        tx.payload[i] = (uint8_t)(0xA0 + i);
+    }
+    CHECK(lgw_send(tx) == LGW_HAL_SUCCESS);
+
+    lgw_sim_get_stats(target, &st, false);
+    CHECK(st.nb_tx == 1);
+    CHECK(lgw_sim_tx_last(target, buf) == LGW_SPI_SUCCESS);
+    CHECK(buf[10] == tx.size);
+    CHECK(memcmp(buf + 16, tx.payload, tx.size) == 0);
+    CHECK(lgw_status(TX_STATUS, &code) == LGW_HAL_SUCCESS);
+
+    /* a packet the HAL must refuse does not reach the concentrator */
+    tx.rf_chain = 1;
+    CHECK(lgw_send(tx) == LGW_HAL_ERROR);
+    lgw_sim_get_stats(target, &st, false);
+    CHECK(st.nb_tx == 1);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    void *target;
+
+    (void)argv;
+    if (argc != 1) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    if (configure() != 0) {
+        MSG("ERROR: failed to configure the HAL\n");
+        return EXIT_FAILURE;
+    }
+    if (lgw_start() != LGW_HAL_SUCCESS) {
+        MSG("ERROR: lgw_start failed\n");
+        return EXIT_FAILURE;
+    }
+    target = lgw_ctx_default()->reg.spi_target;
+    print_session("start", LGW_SPI_OP_START);
+
+    if (test_receive(target) != 0) {
+        return EXIT_FAILURE;
+    }
+    print_session("receive", LGW_SPI_OP_RECEIVE);
+
+    if (test_send(target) != 0) {
+        return EXIT_FAILURE;
+    }
+    print_session("send", LGW_SPI_OP_SEND);
+
+    if (lgw_stop() != LGW_HAL_SUCCESS) {
+        MSG("ERROR: lgw_stop failed\n");
+        return EXIT_FAILURE;
+    }
+    printf("PASS\n");
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,62 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Arduino SPIClass interface used by the ESP32 SPI backend, for the host
+    build of util_spi_bench. The driver is a fake target: it moves no data
+    and charges every call its modelled cost on a virtual bus clock.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _BENCH_SPI_H
+#define _BENCH_SPI_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include "arduino.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define MSBFIRST    1
+#define SPI_MODE0   0
+#define VSPI        3
+#define HSPI        2
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+class SPISettings {
+public:
+    SPISettings(uint32_t clock = 1000000, uint8_t bit_order = MSBFIRST, uint8_t data_mode = SPI_MODE0) : clock(clock) { (void)bit_order; (void)data_mode; }
+    uint32_t clock;
+};
+
+class SPIClass {
+public:
+    SPIClass(uint8_t spi_bus = VSPI) { (void)spi_bus; }
+    void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1);
+    void end(void);
+    void beginTransaction(SPISettings settings);
+    void endTransaction(void);
+    uint8_t transfer(uint8_t data);
+    void writeBytes(const uint8_t *data, uint32_t size);
+    void transferBytes(const uint8_t *data, uint8_t *out, uint32_t size);
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC VARIABLES ----------------------------------------------------- */
+
+extern SPIClass SPI;
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
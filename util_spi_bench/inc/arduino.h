@@ -0,0 +1,59 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Arduino core services used by the ESP32 SPI backend, for the host build
+    of util_spi_bench. Pins are not driven, the RTOS lock is a no-op.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _BENCH_ARDUINO_H
+#define _BENCH_ARDUINO_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stddef.h>     /* NULL */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LOW         0
+#define HIGH        1
+#define INPUT       0
+#define OUTPUT      1
+
+#define portMAX_DELAY   0xFFFFFFFF
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+typedef void *SemaphoreHandle_t;
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+unsigned long micros(void);
+unsigned long millis(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void);
+int xSemaphoreTakeRecursive(SemaphoreHandle_t m, uint32_t ticks);
+int xSemaphoreGiveRecursive(SemaphoreHandle_t m);
+void vTaskDelay(uint32_t ticks);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,37 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    ESP32 GPIO set/clear registers used by the ESP32 SPI backend, for the
+    host build of util_spi_bench. Stores go to plain memory.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _BENCH_GPIO_STRUCT_H
+#define _BENCH_GPIO_STRUCT_H
+
+#include <stdint.h>     /* C99 types */
+
+struct bench_gpio_reg_s {
+    uint32_t val;
+};
+
+struct bench_gpio_s {
+    uint32_t out_w1ts;
+    uint32_t out_w1tc;
+    struct bench_gpio_reg_s out1_w1ts;
+    struct bench_gpio_reg_s out1_w1tc;
+};
+
+extern volatile struct bench_gpio_s GPIO;
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,245 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Compare the burst modes of the ESP32 SPI backend, on a Linux host.
+    The backend is built against a fake Arduino SPI driver that charges each
+    driver call a fixed overhead and each byte its time on the wire, on a
+    virtual bus clock. The bytes per second of lgw_spi_wb / lgw_spi_rb are
+    printed for LGW_SPI_BURST_BYTEWISE and LGW_SPI_BURST_BULK.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf */
+#include <stdlib.h>     /* EXIT_* strtoul */
+#include <string.h>     /* memset */
+#include <time.h>       /* clock_gettime nanosleep */
+#include <unistd.h>     /* getopt */
+
+#include <SPI.h>
+#include <soc/gpio_struct.h>
+
+#include "loragw_spi.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a)   (sizeof(a) / sizeof((a)[0]))
+#define MSG(args...)    fprintf(stderr, args) /* message that is destined to the user */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define CALL_NS_DEFAULT     1000    /* SPIClass call overhead, order of magnitude on the ESP32 */
+#define NB_BURST_DEFAULT    1000    /* bursts of each size and direction */
+#define BENCH_ADDR          0x7F    /* any register, the fake target keeps no data */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static uint32_t call_ns = CALL_NS_DEFAULT;  /*! modelled cost of one driver call */
+static uint32_t clock_hz;                   /*! clock of the current transaction */
+static uint64_t bus_ns;                     /*! virtual bus time */
+static uint32_t nb_call;                    /*! driver calls */
+static int lock_token;                      /*! non-NULL handle for the RTOS lock stub */
+
+/* -------------------------------------------------------------------------- */
+/* --- FAKE ARDUINO CORE ---------------------------------------------------- */
+
+SPIClass SPI;
+volatile struct bench_gpio_s GPIO;
+
+unsigned long micros(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (unsigned long)t.tv_sec * 1000000UL + (unsigned long)(t.tv_nsec / 1000);
+}
+
+unsigned long millis(void) {
+    return micros() / 1000UL;
+}
+
+void delay(unsigned long ms) {
+    (void)ms; /* only the reset pulse of the open, not part of the figures */
+}
+
+void delayMicroseconds(unsigned int us) {
+    (void)us;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    (void)pin;
+    (void)val;
+    ++nb_call;
+    bus_ns += call_ns;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void) {
+    return &lock_token;
+}
+
+int xSemaphoreTakeRecursive(SemaphoreHandle_t m, uint32_t ticks) {
+    (void)m;
+    (void)ticks;
+    return 1;
+}
+
+int xSemaphoreGiveRecursive(SemaphoreHandle_t m) {
+    (void)m;
+    return 1;
+}
+
+void vTaskDelay(uint32_t ticks) {
+    (void)ticks;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void bus_charge(uint32_t size) {
+    ++nb_call;
+    bus_ns += call_ns + ((uint64_t)size * 8 * 1000000000ULL) / clock_hz;
+}
+
+void SPIClass::begin(int8_t sck, int8_t miso, int8_t mosi, int8_t ss) {
+    (void)sck;
+    (void)miso;
+    (void)mosi;
+    (void)ss;
+}
+
+void SPIClass::end(void) {
+}
+
+void SPIClass::beginTransaction(SPISettings settings) {
+    clock_hz = settings.clock;
+    bus_charge(0);
+}
+
+void SPIClass::endTransaction(void) {
+    bus_charge(0);
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+    (void)data;
+    bus_charge(1);
+    return 0; /* the backend takes a non-zero write echo as a failure */
+}
+
+void SPIClass::writeBytes(const uint8_t *data, uint32_t size) {
+    (void)data;
+    bus_charge(size);
+}
+
+void SPIClass::transferBytes(const uint8_t *data, uint8_t *out, uint32_t size) {
+    (void)data;
+    if (out != NULL) {
+        memset(out, 0, size);
+    }
+    bus_charge(size);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void usage(void) {
+    printf("Usage: util_spi_bench [-c <clock>] [-o <overhead>] [-n <bursts>]\n");
+    printf(" -c SPI clock in Hz, default %u\n", (unsigned)LORA_DEFAULT_SPI_FREQUENCY);
+    printf(" -o cost of one SPI driver call in ns, default %u\n", CALL_NS_DEFAULT);
+    printf(" -n bursts of each size and direction, default %u\n", NB_BURST_DEFAULT);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* n write bursts then n read bursts, returns the virtual bus time in ns */
+static uint64_t run(void *target, uint8_t mode, uint16_t size, uint32_t n, uint32_t *calls, unsigned long *host_us) {
+    static uint8_t buf[LGW_BURST_CHUNK];
+    unsigned long t;
+    uint32_t i;
+
+    lgw_spi_set_burst_mode(mode);
+    bus_ns = 0;
+    nb_call = 0;
+    t = micros();
+    for (i = 0; i < n; ++i) {
+        lgw_spi_wb(target, LGW_SPI_MUX_MODE0, LGW_SPI_MUX_TARGET_SX1301, BENCH_ADDR, buf, size);
+    }
+    for (i = 0; i < n; ++i) {
+        lgw_spi_rb(target, LGW_SPI_MUX_MODE0, LGW_SPI_MUX_TARGET_SX1301, BENCH_ADDR, buf, size);
+    }
+    *host_us = micros() - t;
+    *calls = nb_call;
+    return bus_ns;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    static const uint16_t sizes[] = {16, 64, 256, LGW_BURST_CHUNK};
+    uint32_t speed = LORA_DEFAULT_SPI_FREQUENCY;
+    uint32_t n = NB_BURST_DEFAULT;
+    void *target;
+    uint64_t ns_byte, ns_bulk;
+    uint32_t calls_byte, calls_bulk;
+    unsigned long host_byte, host_bulk;
+    double bytes;
+    unsigned i;
+    int c;
+
+    while ((c = getopt(argc, argv, "hc:o:n:")) != -1) {
+        switch (c) {
+            case 'c':
+                speed = strtoul(optarg, NULL, 0);
+                break;
+            case 'o':
+                call_ns = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                n = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+    if ((speed == 0) || (n == 0)) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    if ((lgw_spi_open(&target) != LGW_SPI_SUCCESS) || (lgw_spi_set_speed(target, speed) != LGW_SPI_SUCCESS)) {
+        MSG("ERROR: failed to open the SPI target\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("clock %u Hz, driver call %u ns, %u bursts each way\n", speed, call_ns, n);
+    printf(" size  calls/burst (byte/bulk)  kB/s bytewise  kB/s bulk  gain  host us (byte/bulk)\n");
+    for (i = 0; i < ARRAY_SIZE(sizes); ++i) {
+        ns_byte = run(target, LGW_SPI_BURST_BYTEWISE, sizes[i], n, &calls_byte, &host_byte);
+        ns_bulk = run(target, LGW_SPI_BURST_BULK, sizes[i], n, &calls_bulk, &host_bulk);
+        bytes = 2.0 * n * sizes[i];
+        printf("%5u  %11.1f / %-11.1f  %13.1f  %9.1f  %4.2f  %8lu / %-8lu\n", sizes[i], (double)calls_byte / (2 * n), (double)calls_bulk / (2 * n), bytes * 1e6 / ns_byte, bytes * 1e6 / ns_bulk, (double)ns_byte / ns_bulk, host_byte, host_bulk);
+    }
+
+    lgw_spi_close(target);
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
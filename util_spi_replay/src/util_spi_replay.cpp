@@ -0,0 +1,167 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Replay a SPI trace captured on the gateway with lgw_spi_rec_start /
+    lgw_spi_rec_dump through the HAL, on a Linux host.
+    Every recorded lgw_receive is run again against the trace; recorded and
+    replayed durations are printed side by side.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf fopen */
+#include <stdlib.h>     /* malloc free */
+#include <string.h>     /* memset */
+
+#include "loragw_hal.h"
+#include "loragw_spi.h"
+#include "loragw_spi_replay.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a)   (sizeof(a) / sizeof((a)[0]))
+#define MSG(args...)    fprintf(stderr, args) /* message that is destined to the user */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void usage(void) {
+    printf("Usage: util_spi_replay <trace file>\n");
+    printf(" trace file: binary output of lgw_spi_rec_dump\n");
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint8_t *load_file(const char *path, uint32_t *size) {
+    FILE *f;
+    long len;
+    uint8_t *buf;
+
+    f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = (uint8_t *)malloc((len > 0) ? len : 1);
+    if ((buf != NULL) && (fread(buf, 1, len, f) != (size_t)len)) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    *size = (uint32_t)len;
+    return buf;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* channel plan used to bring the HAL up, the trace does not carry it */
+static int configure(void) {
+    struct lgw_conf_board_s boardconf;
+    struct lgw_conf_rxrf_s rfconf;
+    struct lgw_conf_rxif_s ifconf;
+    int i;
+
+    memset(&boardconf, 0, sizeof boardconf);
+    boardconf.lorawan_public = true;
+    boardconf.clksrc = 1;
+    if (lgw_board_setconf(boardconf) != LGW_HAL_SUCCESS) {
+        return -1;
+    }
+    memset(&rfconf, 0, sizeof rfconf);
+    rfconf.enable = true;
+    rfconf.type = LGW_RADIO_TYPE_SX1257;
+    for (i = 0; i < LGW_RF_CHAIN_NB; ++i) {
+        rfconf.freq_hz = 902700000 + i * 800000;
+        rfconf.tx_enable = (i == 0);
+        if (lgw_rxrf_setconf(i, rfconf) != LGW_HAL_SUCCESS) {
+            return -1;
+        }
+    }
+    memset(&ifconf, 0, sizeof ifconf);
+    ifconf.enable = true;
+    for (i = 0; i < LGW_MULTI_NB; ++i) {
+        ifconf.rf_chain = i / 4;
+        ifconf.freq_hz = -300000 + (i % 4) * 200000;
+        if (lgw_rxif_setconf(i, ifconf) != LGW_HAL_SUCCESS) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    static const char *op_name[LGW_SPI_OP_NB] = {"none", "start", "receive", "send", "status", "radio", "agc"};
+    uint8_t *trace;
+    uint32_t trace_size;
+    struct lgw_replay_session_s sess;
+    struct lgw_replay_stats_s st;
+    struct lgw_pkt_rx_s rxpkt[LGW_PKT_FIFO_SIZE];
+    unsigned long t;
+    uint32_t rec_total = 0, rep_total = 0;
+    int nb_pkt, i = 0;
+
+    if (argc != 2) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    trace = load_file(argv[1], &trace_size);
+    if (trace == NULL) {
+        MSG("ERROR: failed to read %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    if ((lgw_spi_set_backend(&lgw_spi_backend_replay) != LGW_SPI_SUCCESS) || (lgw_replay_load(trace, trace_size) != LGW_SPI_SUCCESS)) {
+        MSG("ERROR: %s is not a valid SPI trace\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    /* bring the HAL up on the simulated concentrator, the trace is left for the operations */
+    lgw_replay_suspend(true);
+    if ((configure() != 0) || (lgw_start() != LGW_HAL_SUCCESS)) {
+        MSG("ERROR: failed to start the HAL\n");
+        return EXIT_FAILURE;
+    }
+    lgw_replay_suspend(false);
+    lgw_replay_get_stats(&st, true);
+
+    printf("  #  operation  recorded_us  replayed_us  txn    bytes  pkt  matched  skipped  unscripted  mismatch\n");
+    while (lgw_replay_next_session(&sess) == LGW_SPI_SUCCESS) {
+        if (sess.op != LGW_SPI_OP_RECEIVE) {
+            /* start and send depend on configuration and packets the trace does not carry */
+            printf("%3d  %-9s  %11u  %11s  %4u  %7u\n", i++, (sess.op < LGW_SPI_OP_NB) ? op_name[sess.op] : "?", sess.duration, "-", sess.nb_transaction, sess.bytes);
+            continue;
+        }
+        t = micros();
+        nb_pkt = lgw_receive(ARRAY_SIZE(rxpkt), rxpkt);
+        t = micros() - t;
+        lgw_replay_get_stats(&st, true);
+        rec_total += sess.duration;
+        rep_total += t;
+        printf("%3d  %-9s  %11u  %11lu  %4u  %7u  %3d  %7u  %7u  %10u  %8u\n", i++, op_name[sess.op], sess.duration, t, sess.nb_transaction, sess.bytes, nb_pkt, st.matched, st.skipped, st.unscripted, st.data_mismatch);
+    }
+    printf("receive total: recorded %u us, replayed %u us\n", rec_total, rep_total);
+
+    lgw_stop();
+    free(trace);
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,241 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Check of the spidev SPI backend against the sim backend, on a Linux host.
+    lgw_start and lgw_receive run once on the simulated SX1301 directly and
+    once through the spidev backend on lgw_spidev_io_sim. The register state
+    left by each operation and its transactions must be the same, and the
+    spidev backend must carry every transaction in one chip select frame,
+    held back writes sharing the ioctl call of the next access, and save
+    ioctl calls on both operations. Exits with EXIT_FAILURE on the first
+    mismatch.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf */
+#include <stdlib.h>     /* EXIT_* */
+#include <string.h>     /* memset */
+
+#include "loragw_hal.h"
+#include "loragw_reg.h"
+#include "loragw_spi.h"
+#include "loragw_spi_sim.h"
+#include "loragw_spi_spidev.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a)   (sizeof(a) / sizeof((a)[0]))
+#define MSG(args...)    fprintf(stderr, args) /* message that is destined to the user */
+
+#define CHECK(cond)     if (!(cond)) { MSG("ERROR: %s:%d: %s\n", __FILE__, __LINE__, #cond); return -1; }
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_PKT          3       /* packets queued before lgw_receive */
+#define START_SAVED_MIN 16      /* ioctl calls lgw_start saves at least, page and pointer writes held back */
+
+enum run_e {
+    RUN_SIM,        /* sim backend */
+    RUN_SPIDEV,     /* spidev backend on lgw_spidev_io_sim */
+    RUN_NB
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+/* what one HAL operation left behind */
+struct op_result_s {
+    int32_t     reg[LGW_TOTALREGS];     /* register values after the operation */
+    uint32_t    nb_transaction;         /* lgw_spi_* transactions of the operation */
+    struct lgw_spidev_stats_s dev;      /* system calls of the operation, spidev run only */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct op_result_s res_start[RUN_NB];
+static struct op_result_s res_rx[RUN_NB];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void usage(void) {
+    printf("Usage: util_spidev_test\n");
+    printf(" runs lgw_start and lgw_receive on the sim and spidev backends and compares them\n");
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* 4 multi-SF channels on each radio */
+static int configure(void) {
+    struct lgw_conf_board_s boardconf;
+    struct lgw_conf_rxrf_s rfconf;
+    struct lgw_conf_rxif_s ifconf;
+    int i;
+
+    memset(&boardconf, 0, sizeof boardconf);
+    boardconf.lorawan_public = true;
+    boardconf.clksrc = 1;
+    CHECK(lgw_board_setconf(boardconf) == LGW_HAL_SUCCESS);
+    memset(&rfconf, 0, sizeof rfconf);
+    rfconf.enable = true;
+    rfconf.type = LGW_RADIO_TYPE_SX1257;
+    for (i = 0; i < LGW_RF_CHAIN_NB; ++i) {
+        rfconf.freq_hz = 915000000 + i * 1000000;
+        rfconf.tx_enable = (i == 0);
+        CHECK(lgw_rxrf_setconf(i, rfconf) == LGW_HAL_SUCCESS);
+    }
+    memset(&ifconf, 0, sizeof ifconf);
+    ifconf.enable = true;
+    for (i = 0; i < LGW_MULTI_NB; ++i) {
+        ifconf.rf_chain = i / 4;
+        ifconf.freq_hz = -300000 + (i % 4) * 200000;
+        CHECK(lgw_rxif_setconf(i, ifconf) == LGW_HAL_SUCCESS);
+    }
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* register values and bus figures of the operation that just ran */
+static int collect(enum run_e run, struct op_result_s *res) {
+    struct lgw_spi_bus_stats_s bs[LGW_SPI_OP_NB];
+    struct lgw_spidev_stats_s dev;
+    void *target = lgw_ctx_default()->reg.spi_target;
+    int i;
+
+    CHECK(lgw_get_bus_stats(bs, true) == LGW_HAL_SUCCESS);
+    res->nb_transaction = 0;
+    for (i = 0; i < LGW_SPI_OP_NB; ++i) {
+        res->nb_transaction += bs[i].nb_transaction;
+    }
+    memset(&res->dev, 0, sizeof res->dev);
+    if (run == RUN_SPIDEV) {
+        CHECK(lgw_spidev_get_stats(target, &res->dev, true) == LGW_SPI_SUCCESS);
+    }
+
+    /* the data ports move a buffer pointer on each read, they are left alone */
+    for (i = 0; i < LGW_TOTALREGS; ++i) {
+        res->reg[i] = 0;
+        if ((i == LGW_RX_DATA_BUF_DATA) || (i == LGW_TX_DATA_BUF_DATA) || (i == LGW_CAPTURE_RAM_DATA) || (i == LGW_MCU_PROM_DATA)) {
+            continue;
+        }
+        CHECK(lgw_reg_r(i, &res->reg[i]) == LGW_REG_SUCCESS);
+    }
+
+    /* the register dump is not part of the next operation */
+    lgw_get_bus_stats(bs, true);
+    if (run == RUN_SPIDEV) {
+        lgw_spidev_get_stats(target, &dev, true);
+    }
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int run(enum run_e r) {
+    struct lgw_pkt_rx_s rx[LGW_PKT_FIFO_SIZE];
+    uint8_t payload[64];
+    uint8_t md[LGW_SIM_METADATA_NB];
+    void *target;
+    void *sim;
+    int i;
+
+    if (r == RUN_SPIDEV) {
+        CHECK(lgw_spi_set_backend(&lgw_spi_backend_spidev) == LGW_SPI_SUCCESS);
+        CHECK(lgw_spidev_set_io(&lgw_spidev_io_sim) == LGW_SPI_SUCCESS);
+    } else {
+        CHECK(lgw_spi_set_backend(&lgw_spi_backend_sim) == LGW_SPI_SUCCESS);
+    }
+
+    CHECK(lgw_start() == LGW_HAL_SUCCESS);
+    target = lgw_ctx_default()->reg.spi_target;
+    sim = (r == RUN_SPIDEV) ? lgw_spidev_sim_target(target) : target;
+    CHECK(sim != NULL);
+    CHECK(collect(r, &res_start[r]) == 0);
+
+    for (i = 0; i < NB_PKT; ++i) {
+        memset(payload, 0x30 + i, sizeof payload);
+        memset(md, 0, sizeof md);
+        md[0] = i;
+        md[1] = ((7 + i) << 4) | (1 << 1);
+        md[5] = 100;
+        CHECK(lgw_sim_rx_push(sim, payload, 10 + i * 20, md, 5) == LGW_SPI_SUCCESS);
+    }
+    CHECK(lgw_receive(ARRAY_SIZE(rx), rx) == NB_PKT);
+    for (i = 0; i < NB_PKT; ++i) {
+        CHECK((rx[i].size == 10 + i * 20) && (rx[i].payload[0] == 0x30 + i));
+    }
+    CHECK(collect(r, &res_rx[r]) == 0);
+
+    CHECK(lgw_stop() == LGW_HAL_SUCCESS);
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int compare(const char *name, const struct op_result_s *res, uint32_t saved_min) {
+    int nb_diff = 0;
+    int i;
+
+    for (i = 0; i < LGW_TOTALREGS; ++i) {
+        if (res[RUN_SIM].reg[i] != res[RUN_SPIDEV].reg[i]) {
+            MSG("ERROR: %s, register %d is %d on sim and %d on spidev\n", name, i, res[RUN_SIM].reg[i], res[RUN_SPIDEV].reg[i]);
+            ++nb_diff;
+        }
+    }
+    printf("%-8s  txn sim %5u  txn spidev %5u  ioctl %5u  frames %5u  deferred %3u\n", name, res[RUN_SIM].nb_transaction, res[RUN_SPIDEV].nb_transaction, res[RUN_SPIDEV].dev.nb_ioctl, res[RUN_SPIDEV].dev.nb_frame, res[RUN_SPIDEV].dev.nb_deferred);
+    CHECK(nb_diff == 0);
+    CHECK(res[RUN_SIM].nb_transaction == res[RUN_SPIDEV].nb_transaction);
+
+    /* every transaction is one chip select frame, deferred writes share the ioctl of the next access */
+    CHECK(res[RUN_SPIDEV].dev.nb_frame == res[RUN_SPIDEV].nb_transaction);
+    CHECK(res[RUN_SPIDEV].dev.nb_ioctl + res[RUN_SPIDEV].dev.nb_deferred >= res[RUN_SPIDEV].dev.nb_frame);
+    CHECK(res[RUN_SPIDEV].dev.nb_ioctl <= res[RUN_SPIDEV].dev.nb_frame);
+
+    /* and the batching pays off */
+    CHECK(res[RUN_SPIDEV].dev.nb_ioctl + saved_min <= res[RUN_SPIDEV].nb_transaction);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+    (void)argv;
+    if (argc != 1) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    if (configure() != 0) {
+        MSG("ERROR: failed to configure the HAL\n");
+        return EXIT_FAILURE;
+    }
+    if ((run(RUN_SIM) != 0) || (run(RUN_SPIDEV) != 0)) {
+        return EXIT_FAILURE;
+    }
+    /* each FIFO advance travels with the next FIFO status read */
+    if ((compare("start", res_start, START_SAVED_MIN) != 0) || (compare("receive", res_rx, NB_PKT) != 0)) {
+        return EXIT_FAILURE;
+    }
+    printf("PASS\n");
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */